@@ -1,5 +1,11 @@
 #include "../audioplayer/error_code.hpp"
+#include "../audioplayer/mix_kernels.hpp"
+#include "../audioplayer/bus_table.hpp"
+#include "../audioplayer/audio_stats.hpp"
+#include "../audioplayer/echo_canceller.hpp"
 #include "ogg_play.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <thread>
@@ -255,6 +261,166 @@ extern "C"
         return true;
     }
 
+    // Đặt thư mục lưu seek-index cache (vd: getCacheDir() của app), chuỗi rỗng = thư mục tạm.
+    // sidecar = true để lưu file .idx cạnh file gốc (dirPath bị bỏ qua)
+    void set_index_cache_dir(const char *dirPath, bool sidecar)
+    {
+        AudioPlayer::getInstance()->setIndexCacheDirectory(dirPath ? std::string(dirPath) : std::string(), sidecar);
+    }
+
+    // Đo loudness (EBU R128) cho danh sách file ở nền, kết quả được cache cạnh seek-index.
+    // Các bài đang/sẽ phát tự được chuẩn hóa khi đã có kết quả.
+    void analyze_library_loudness(const char **filePaths, int count)
+    {
+        std::vector<std::string> files;
+        for (int i = 0; i < count; i++)
+        {
+            if (filePaths[i])
+            {
+                files.emplace_back(filePaths[i]);
+            }
+        }
+        AudioPlayer::getInstance()->analyzeLoudness(files);
+    }
+
+    // Bật/tắt chuẩn hóa loudness, targetLufs: mức loudness đích (vd: -16)
+    void set_loudness_normalization(bool enabled, double targetLufs)
+    {
+        AudioPlayer::getInstance()->setLoudnessNormalization(enabled, targetLufs);
+    }
+
+    // Gain (dB) đang áp dụng cho bài hiện tại: output gain của file + chuẩn hóa loudness
+    double get_output_gain_db()
+    {
+        return current_session != nullptr ? current_session->getOutputGainDb() : 0.0;
+    }
+
+    // Microbenchmark mixer: ns trên mỗi frame đầu ra khi mix busCount bus (vd: 1, 4, 8) + limiter.
+    // Log kết quả của mọi bộ kernel CPU hỗ trợ, trả về kết quả của bộ đang dùng.
+    double benchmark_mixer(int busCount)
+    {
+        for (mix::Isa isa : {mix::Isa::Scalar, mix::Isa::Neon, mix::Isa::Sse2, mix::Isa::Avx2})
+        {
+            if (const mix::Kernels *kernels = mix::forIsa(isa))
+            {
+                LOGI("Mixer benchmark %s, %d buses: %.2f ns/frame",
+                     kernels->name, busCount, mix::benchmarkNsPerFrame(*kernels, busCount));
+            }
+        }
+        return mix::benchmarkNsPerFrame(mix::active(), busCount);
+    }
+
+    // Benchmark seek-index cache: loadFile khi quét toàn bộ file so với khi đọc cache, lặp iterations lần.
+    // Xóa rồi ghi lại cache của file. Trả về số lần nhanh hơn của bước dựng index, âm nếu lỗi.
+    double benchmark_index_cache(const char *filePath, int iterations)
+    {
+        if (!player_initialized || filePath == nullptr || *filePath == '\0')
+        {
+            return -1.0;
+        }
+        const double speedup = OggPlay::getInstance()->benchmarkIndexCache(filePath, std::max(iterations, 1));
+        LOGI("Index cache benchmark %s: %.1fx", filePath, speedup);
+        return speedup;
+    }
+
+    // Trạng thái bộ khử echo của mic full-duplex: out nhận 3 float [đã chốt độ trễ (0/1),
+    // độ trễ (ms), ERLE (dB)]. false nếu player chưa khởi tạo hoặc mic chưa mở lần nào.
+    bool get_echo_canceller_stats(float *out)
+    {
+        AdaptiveEchoCanceller::Stats stats;
+        if (!player_initialized || out == nullptr || !player->getAudioLayer()->getEchoCancellerStats(stats))
+        {
+            return false;
+        }
+        out[0] = stats.delayLocked ? 1.0f : 0.0f;
+        out[1] = 1000.0f * stats.delayFrames / player->getAudioLayer()->getSampleRate();
+        out[2] = stats.erleDb;
+        return true;
+    }
+
+    // Tải CPU của mixer cho bài hiện tại (0.01 = 1% thời gian thực), -1 nếu không có bài nào.
+    // Log thêm thời gian trung bình/lớn nhất mỗi lần mix.
+    double get_playback_cpu_load()
+    {
+        AudioLayer::InputCpuStats stats;
+        if (current_session == nullptr || !current_session->getCpuStats(stats))
+        {
+            return -1.0;
+        }
+        LOGI("Playback CPU: %.1f us avg, %.1f us peak over %llu blocks",
+             stats.averageMicros, stats.peakMicros, static_cast<unsigned long long>(stats.blocks));
+        return stats.load;
+    }
+
+    // Độ trễ đầu ra hiện tại (ms) mà vị trí phát đã bù trừ, theo kích thước buffer đang được chọn.
+    // Dùng để canh lời bài hát / tiếng mic với nhạc nền, -1 nếu player chưa khởi tạo.
+    double get_output_latency_ms()
+    {
+        if (!player_initialized)
+        {
+            return -1.0;
+        }
+        return player->getAudioLayer()->getOutputLatencyMillis();
+    }
+
+    // Thống kê glitch dạng JSON (thời gian/jitter callback, xrun, underflow/overflow, thời gian decode)
+    // của mọi stream và session đang sống. Giống snprintf: trả về độ dài JSON (không tính '\0'),
+    // chỉ ghi vào out khi capacity > độ dài, nên gọi lại với buffer lớn hơn nếu cần.
+    int get_audio_stats(char *out, int capacity)
+    {
+        const std::string json = AudioStats::getInstance().snapshotJson();
+        const int length = static_cast<int>(json.size());
+        if (out != nullptr && capacity > length)
+        {
+            std::memcpy(out, json.c_str(), json.size() + 1);
+        }
+        return length;
+    }
+
+    // Meter của mixer: master rồi tới từng bus, mỗi phần tử 6 float
+    // [busId (-1 = master), peakL, peakR, rmsL, rmsR, clips], biên độ tuyến tính (1.0 = 0 dBFS).
+    // out có ít nhất maxEntries * 6 float, trả về số phần tử đã ghi.
+    int get_meter_levels(float *out, int maxEntries)
+    {
+        if (!player_initialized || out == nullptr || maxEntries <= 0)
+        {
+            return 0;
+        }
+        MeterLevels levels[BusTable::MAX_BUSES + 1];
+        const int count = player->getAudioLayer()->getMeterLevels(levels, std::min(maxEntries, BusTable::MAX_BUSES + 1));
+        for (int i = 0; i < count; i++)
+        {
+            float *entry = out + i * 6;
+            entry[0] = static_cast<float>(levels[i].busId);
+            entry[1] = levels[i].peak[0];
+            entry[2] = levels[i].peak[1];
+            entry[3] = levels[i].rms[0];
+            entry[4] = levels[i].rms[1];
+            entry[5] = static_cast<float>(levels[i].clips);
+        }
+        return count;
+    }
+
+    // Ballistics của meter: cửa sổ RMS (ms), thời gian giữ peak (ms), tốc độ hạ peak (dB/s)
+    void set_meter_ballistics(float rmsWindowMs, float peakHoldMs, float peakDecayDbPerSecond)
+    {
+        if (!player_initialized)
+        {
+            return;
+        }
+        MeterBallistics ballistics;
+        ballistics.rmsWindowMillis = rmsWindowMs;
+        ballistics.peakHoldMillis = peakHoldMs;
+        ballistics.peakDecayDbPerSecond = peakDecayDbPerSecond;
+        player->getAudioLayer()->setMeterBallistics(ballistics);
+    }
+
+    // Bus của bài hiện tại trong kết quả get_meter_levels, -1 nếu không có bài nào
+    int get_playback_bus_id()
+    {
+        return current_session != nullptr ? current_session->getMixerBusId() : -1;
+    }
+
     // Hàm phát âm thanh
     bool play_audio(const char *filePath)
     {
@@ -415,6 +581,61 @@ extern "C"
         return false;
     }
 
+    // Phát lặp A-B cho session cụ thể, lặp đến khi clear_multi_loop_region
+    bool set_multi_loop_region(int sessionId, int startMs, int endMs)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            LOGI("Loop region %d-%d ms for session %d", startMs, endMs, sessionId);
+            clear_multi_notification_queue(sessionId);
+            return it->second->setLoopRegion(startMs, endMs).isSuccess();
+        }
+        LOGE("Session %d not found", sessionId);
+        return false;
+    }
+
+    bool clear_multi_loop_region(int sessionId)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            it->second->clearLoopRegion();
+            return true;
+        }
+        LOGE("Session %d not found", sessionId);
+        return false;
+    }
+
+    // Stem của file multistream (vd: beat + bè trong một file), 0 nếu file chỉ có một stream
+    int get_multi_stem_count(int sessionId)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            return static_cast<int>(it->second->getStemCount());
+        }
+        LOGE("Session %d not found", sessionId);
+        return -1;
+    }
+
+    bool set_multi_stem_volume(int sessionId, int stem, float volume)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            return it->second->setStemVolume(stem, volume).isSuccess();
+        }
+        LOGE("Session %d not found", sessionId);
+        return false;
+    }
+
+    bool mute_multi_stem(int sessionId, int stem, bool mute)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            return it->second->muteStem(stem, mute).isSuccess();
+        }
+        LOGE("Session %d not found", sessionId);
+        return false;
+    }
+
     // Thêm: Giải phóng một session cụ thể
     bool release_multi_session(int sessionId)
     {
@@ -457,6 +678,26 @@ extern "C"
         return -1;
     }
 
+    // Vị trí đang phát ra loa (ms) của session cụ thể, không khóa nên gọi được mỗi frame UI
+    int get_multi_position_ms(int sessionId)
+    {
+        auto it = multi_sessions.find(sessionId);
+        if (it != multi_sessions.end()) {
+            return static_cast<int>(it->second->getPlaybackPositionMs());
+        }
+        return -1;
+    }
+
+    // Vị trí đang phát ra loa (ms) của session chính, dùng để đồng bộ lời bài hát và chấm điểm
+    int get_playback_position_ms()
+    {
+        if (current_session != nullptr)
+        {
+            return static_cast<int>(current_session->getPlaybackPositionMs());
+        }
+        return -1;
+    }
+
     // Hàm dừng phát âm thanh
     void stop()
     {
@@ -508,4 +749,46 @@ extern "C"
             return;
         }
     }
+    // Phát lặp đoạn A-B (vd: luyện điệp khúc): sau vòng đầu phát từ bộ nhớ, không đọc file
+    bool set_loop_region(int startMs, int endMs)
+    {
+        if (current_session != nullptr)
+        {
+            clear_notification_queue();
+            return current_session->setLoopRegion(startMs, endMs).isSuccess();
+        }
+        return false;
+    }
+    void clear_loop_region()
+    {
+        if (current_session != nullptr)
+        {
+            current_session->clearLoopRegion();
+        }
+    }
+    // Stem của file multistream đang phát: bật/tắt hoặc chỉnh âm lượng từng stem
+    int get_stem_count()
+    {
+        if (current_session != nullptr)
+        {
+            return static_cast<int>(current_session->getStemCount());
+        }
+        return 0;
+    }
+    bool set_stem_volume(int stem, float volume)
+    {
+        if (current_session != nullptr)
+        {
+            return current_session->setStemVolume(stem, volume).isSuccess();
+        }
+        return false;
+    }
+    bool mute_stem(int stem, bool mute)
+    {
+        if (current_session != nullptr)
+        {
+            return current_session->muteStem(stem, mute).isSuccess();
+        }
+        return false;
+    }
 }
\ No newline at end of file
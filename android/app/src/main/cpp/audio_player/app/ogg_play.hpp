@@ -26,6 +26,9 @@ public:
     bool playOggWithCallback(const string& fileName, uint32_t seekTime, uint32_t endTime, int loop, float volume = 1.0f);
     bool analyzeFileOgg();
     bool printFileOgg();
+    // So sánh thời gian loadFile khi quét toàn bộ file (cold) và khi dùng index cache (warm).
+    // Trả về số lần nhanh hơn của bước dựng index, âm nếu lỗi
+    double benchmarkIndexCache(const string& fileName, int iterations = 20);
 private:
     OggPlay();
     ~OggPlay();
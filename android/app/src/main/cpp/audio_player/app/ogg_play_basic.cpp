@@ -1,5 +1,6 @@
 #include "ogg_play.hpp"
 #include "../audioplayer/audio_player_types.hpp"
+#include "../audioplayer/ogg_index_cache.hpp"
 #include <iostream>
 #include <filesystem>
 #include <thread>
@@ -171,4 +172,84 @@ bool OggPlay::printFileOgg() {
         printOggFileInfo(filename);
     }
     return true;
-}
\ No newline at end of file
+}
+
+double OggPlay::benchmarkIndexCache(const string& fileName, int iterations) {
+    if (!player) {
+        if (!init()) {
+            cerr << "Failed to initialize player" << endl;
+            return -1.0;
+        }
+    }
+    if (!filesystem::exists(fileName) || iterations <= 0) {
+        cerr << "File không tồn tại: " << fileName << endl;
+        return -1.0;
+    }
+
+    cout << "\n=== Benchmark seek-index cache: " << fileName << " ===" << endl;
+
+    // Đo thời gian loadFile, xóa cache trước mỗi lần nếu là cold scan
+    auto measure = [&](bool cold) -> double {
+        double totalMs = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            if (cold) {
+                OggIndexCache::remove(fileName);
+            }
+            auto start = chrono::steady_clock::now();
+            AudioSession* session = player->loadFile(fileName);
+            auto end = chrono::steady_clock::now();
+            if (!session) {
+                return -1.0;
+            }
+            totalMs += chrono::duration<double, milli>(end - start).count();
+            // Chờ luồng index nền ghi xong cache trước khi hủy session
+            while (!session->isIndexComplete()) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            player->destroySession(session);
+        }
+        return totalMs / iterations;
+    };
+
+    // Chỉ riêng bước dựng index: quét mọi page trong file so với đọc file .idx
+    auto measureIndex = [&](bool cold) -> double {
+        double totalMs = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            OggOpusFile file{};
+            auto start = chrono::steady_clock::now();
+            if (cold) {
+                if (!file.source.open(fileName)) {
+                    return -1.0;
+                }
+                ogg_page og;
+                int64_t offset = 0;
+                while (file.source.nextPage(&og, &offset) == 1) {
+                    file.page_table.push_back({static_cast<uint16_t>(file.page_table.size()),
+                                               ogg_page_granulepos(&og), offset,
+                                               static_cast<uint32_t>(og.header_len + og.body_len)});
+                }
+            } else if (!OggIndexCache::load(fileName, file)) {
+                return -1.0;
+            }
+            auto end = chrono::steady_clock::now();
+            totalMs += chrono::duration<double, milli>(end - start).count();
+        }
+        return totalMs / iterations;
+    };
+
+    double coldMs = measure(true);
+    // Lần cold cuối cùng đã ghi lại cache cho các lần warm
+    double warmMs = measure(false);
+    double coldIndexMs = measureIndex(true);
+    double warmIndexMs = measureIndex(false);
+    if (coldMs < 0 || warmMs < 0 || coldIndexMs < 0 || warmIndexMs < 0) {
+        cerr << "Failed to load file: " << fileName << endl;
+        return -1.0;
+    }
+
+    cout << "loadFile   cold: " << coldMs << " ms, warm: " << warmMs << " ms" << endl;
+    cout << "Index only cold: " << coldIndexMs << " ms, warm: " << warmIndexMs << " ms" << endl;
+    const double speedup = warmIndexMs > 0 ? coldIndexMs / warmIndexMs : 0.0;
+    cout << "Index speedup: " << speedup << "x" << endl;
+    return speedup;
+}
@@ -1,27 +1,90 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include "common.hpp"
 #include <functional>
+#include <memory>
 
 #include "audio_player_types.hpp"
+#include "echo_canceller.hpp"
+#include "level_meter.hpp"
+#include "processing_graph.hpp"
 
 class AudioLayer {
 public:
+    // Volume tối đa của bus, trên 1.0 để bù output gain/chuẩn hóa loudness (~+6 dB)
+    static constexpr float MAX_INPUT_VOLUME = 2.0f;
+
+    // Thời gian CPU mixer dùng cho một bus (graph + mix, stem tính vào bus nguồn)
+    struct InputCpuStats {
+        uint64_t blocks = 0;        // Số lần mixer chạy bus
+        double averageMicros = 0.0; // Trung bình mỗi lần chạy
+        double peakMicros = 0.0;    // Lâu nhất kể từ lần đọc trước
+        double load = 0.0;          // Thời gian CPU / thời lượng audio đã xử lý (0.01 = 1%)
+    };
+
     virtual ~AudioLayer() = default;
 
     virtual bool initialize() = 0;
     virtual void shutdown() = 0;
         
-    // Thay đổi signature của acquireInputBus
-    virtual int acquireInputBus() = 0;
+    // channels: số kênh bus đưa vào (1 = mono, 2 = stereo).
+    // Callback của bus ghi frames * channels mẫu interleaved.
+    virtual int acquireInputBus(int channels = 1) = 0;
+    // Bus stem: mix nhóm kênh [firstChannel, firstChannel + channels) (mono/stereo) lấy từ
+    // callback của sourceBusId. Bus nguồn có stem không được mix trực tiếp, callback của nó được
+    // gọi một lần mỗi chu kỳ cho mọi stem; volume/mute của bus nguồn áp dụng cho cả các stem.
+    // Release bus nguồn thì các stem của nó cũng bị release.
+    virtual int acquireStemBus(int sourceBusId, int firstChannel, int channels) = 0;
     virtual void releaseInputBus(int busId) = 0;
+    // Volume, mute và pan được làm mượt trong mixer (ramp ~10ms) nên không gây click.
+    // Mute là fade về 0; bus đã mute và fade xong thì callback của nó không còn được gọi.
     virtual void setInputVolume(int busId, float volume) = 0;
     virtual void muteInputBus(int busId, bool mute) = 0;
+    // pan: -1 (trái) .. 0 (giữa) .. 1 (phải)
+    virtual void setInputPan(int busId, float pan) = 0;
     
-    // Set callbacks cho từng bus
+    // Set callbacks cho từng bus (tương đương graph chỉ có một CallbackSourceNode)
     virtual void setAudioCallback(int busId, AudioCallback callback) = 0;
+    // Thay nguồn của bus bằng một graph xử lý (vd: session -> pitch -> reverb -> gain).
+    // Graph phải đã compile, output cùng số kênh với bus và chỉ gắn vào một bus.
+    // Trả về false nếu graph không hợp lệ với bus.
+    virtual bool setBusGraph(int busId, std::shared_ptr<ProcessingGraph> graph) = 0;
+    // Thống kê CPU của bus từ lúc acquire (đặt lại peak). Bus chưa có nguồn hoặc đã mute xong
+    // không tốn CPU của mixer. Trả về false nếu bus không dùng.
+    virtual bool getInputCpuStats(int busId, InputCpuStats& stats) = 0;
+
+    // Meter peak/RMS/clip của master và mọi bus, đo ngay trong lúc mix (không tốn thêm lượt duyệt).
+    // Ballistics áp dụng cho mọi meter từ block tiếp theo.
+    virtual void setMeterBallistics(const MeterBallistics& ballistics) = 0;
+    // Ghi master (busId = -1) rồi các bus đang dùng theo busId vào out, tối đa maxCount phần tử.
+    // Không chặn audio thread. Trả về số phần tử đã ghi.
+    virtual int getMeterLevels(MeterLevels* out, int maxCount) = 0;
+
+    // Full-duplex: đọc mic ngay trong callback đầu ra (cùng clock với nhạc, không qua ring buffer
+    // giữa hai stream). Trả về nguồn mono cho bus của mic: dùng với setAudioCallback hoặc làm
+    // CallbackSourceNode đầu vocal chain trong setBusGraph, chỉ gắn vào một bus.
+    // tap (tùy chọn) nhận nguyên block mic trên audio thread, vd để ghi âm.
+    // Đang mở thì trả về nguồn hiện có (giữ tap cũ). Trả về callback rỗng nếu không mở được mic.
+    virtual AudioCallback openCapture(CaptureTap tap = nullptr) = 0;
+    // Đóng mic, nguồn đã trả về chỉ còn cho ra im lặng
+    virtual void closeCapture() = 0;
+    // Khử echo nhạc (tiếng loa lọt vào mic) trên mic full-duplex, trước tap và bus của mic.
+    // Reference là mix của các bus có echo reference. Bật lại thì học lại từ đầu. Mặc định tắt.
+    virtual void setEchoCancellation(bool enabled) = 0;
+    // Bus có nằm trong reference của bộ khử echo không (mặc định có). Bus của mic phải loại ra.
+    virtual bool setInputEchoReference(int busId, bool include) = 0;
+    // false nếu mic chưa mở lần nào
+    virtual bool getEchoCancellerStats(AdaptiveEchoCanceller::Stats& stats) = 0;
     
     virtual void start() = 0;
     virtual void stop() = 0;
+
+    // Sample rate của mix đầu ra (cũng là của mic full-duplex)
+    virtual int getSampleRate() const = 0;
+
+    // Ước lượng độ trễ đầu ra (ms): từ lúc callback trả frame đến lúc frame đó ra loa.
+    // Không block, gọi được từ mọi thread kể cả audio callback.
+    virtual double getOutputLatencyMillis() const = 0;
 };
\ No newline at end of file
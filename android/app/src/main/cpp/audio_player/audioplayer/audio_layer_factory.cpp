@@ -5,7 +5,8 @@
 #elif defined(__ANDROID__)
     #include "oboe_layer.hpp"
 #elif defined(_WIN32) || defined(__linux__)
-    #include "port_audio_layer.hpp"
+    #include <cstdlib>
+    #include "file_sink_audio_layer.hpp"
 #else
     #error "Platform not supported"
 #endif
@@ -17,7 +18,14 @@ std::unique_ptr<AudioLayer> AudioLayerFactory::createAudioLayer() {
 #elif defined(__ANDROID__)
     return std::make_unique<OboeLayer>();
 #elif defined(_WIN32) || defined(__linux__)
-    return std::make_unique<PortAudioLayer>();
+    // Không có thiết bị (CI, benchmark): render theo đồng hồ ảo, cấu hình qua biến môi trường AUDIO_LAYER_*.
+    // AUDIO_LAYER_WAV=<đường dẫn> để ghi kết quả mix ra file WAV.
+    const NullAudioLayer::Config config = NullAudioLayer::Config::fromEnvironment();
+    const char* path = std::getenv("AUDIO_LAYER_WAV");
+    if (path && *path) {
+        return std::make_unique<FileSinkAudioLayer>(path, config);
+    }
+    return std::make_unique<NullAudioLayer>(config);
 #else
     #error "Platform not supported"
 #endif
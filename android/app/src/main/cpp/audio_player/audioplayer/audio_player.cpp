@@ -4,6 +4,7 @@
 #include "audio_layer.hpp"
 #include "common.hpp"
 #include "audio_session.hpp"
+#include "ogg_index_cache.hpp"
 #include <memory>
 #include <mutex>
 #include <filesystem>
@@ -39,6 +40,12 @@ Result AudioPlayer::init() {
 }
 
 void AudioPlayer::shutdown() {
+    {
+        // Các file chưa đo bị bỏ, chờ worker đang đo xong file hiện tại trước khi hủy session
+        unique_lock<mutex> lock(loudnessMutex);
+        loudnessQueue.clear();
+        loudnessIdle.wait(lock, [this]() { return loudnessWorkers == 0; });
+    }
     unique_lock lock(sessionsMutex);
     sessions.clear();
     
@@ -99,6 +106,80 @@ AudioSession* AudioPlayer::loadFile(const string& fileName) {
     return session;
 }
 
+void AudioPlayer::setIndexCacheDirectory(const string& dir, bool sidecar) {
+    debugPrint("Index cache directory: {}", sidecar ? "<sidecar>" : dir.empty() ? "<default>" : dir);
+    OggIndexCache::setCacheDirectory(dir, sidecar);
+}
+
+void AudioPlayer::analyzeLoudness(const vector<string>& fileNames, LoudnessCallback callback) {
+    size_t workersToStart = 0;
+    {
+        lock_guard<mutex> lock(loudnessMutex);
+        for (const auto& fileName : fileNames) {
+            loudnessQueue.emplace_back(fileName, callback);
+        }
+        // playOggAt chỉ chờ kết quả 5s nên không được để phân tích chiếm hết worker
+        const size_t poolSize = threadPool.threadCount();
+        const size_t maxWorkers = poolSize > 1 ? poolSize - 1 : 1;
+        if (loudnessWorkers < maxWorkers) {
+            workersToStart = min(maxWorkers - loudnessWorkers, loudnessQueue.size());
+            loudnessWorkers += workersToStart;
+        }
+    }
+    debugPrint("Loudness analysis queued {} files on {} new workers", fileNames.size(), workersToStart);
+    for (size_t i = 0; i < workersToStart; i++) {
+        threadPool.submitTask([this]() { loudnessWorker(); });
+    }
+}
+
+void AudioPlayer::loudnessWorker() {
+    while (true) {
+        pair<string, LoudnessCallback> job;
+        {
+            lock_guard<mutex> lock(loudnessMutex);
+            if (loudnessQueue.empty()) {
+                if (--loudnessWorkers == 0) {
+                    loudnessIdle.notify_all();
+                }
+                return;
+            }
+            job = std::move(loudnessQueue.front());
+            loudnessQueue.pop_front();
+        }
+
+        const string& fileName = job.first;
+        double loudness = 0.0;
+        bool ok = OggIndexCache::loadLoudness(fileName, loudness);
+        if (!ok) {
+            ok = AudioSession::measureLoudness(fileName, loudness).isSuccess();
+            if (ok) {
+                OggIndexCache::storeLoudness(fileName, loudness);
+            }
+        }
+
+        if (ok) {
+            shared_lock lock(sessionsMutex);
+            for (const auto& pair : sessions) {
+                if (pair.first->getFileName() == fileName) {
+                    pair.first->setMeasuredLoudness(loudness);
+                }
+            }
+        }
+        if (job.second) {
+            job.second(fileName, ok, loudness);
+        }
+    }
+}
+
+void AudioPlayer::setLoudnessNormalization(bool enabled, double target) {
+    loudnessNormalization.store(enabled);
+    targetLoudness.store(target);
+    shared_lock lock(sessionsMutex);
+    for (const auto& pair : sessions) {
+        pair.first->updateOutputGain();
+    }
+}
+
 PlayOggResult AudioPlayer::playOggAt(const string& fileName, uint32_t seekTime, uint32_t endTime, int loop,
     PlaybackCallback playbackCallback, StateChangeCallback stateChangeCallback) {
     auto resultPromise = make_shared<promise<PlayOggResult>>();
@@ -5,6 +5,9 @@
 #include "error_code.hpp"
 #include "thread_pool.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <shared_mutex>
@@ -21,6 +24,8 @@ class AudioPlayer
 {
 public:
     static constexpr size_t MAX_SESSIONS = 8;
+    // Mức loudness chuẩn hóa mặc định, chừa headroom cho giọng hát mix chung
+    static constexpr double DEFAULT_TARGET_LOUDNESS = -16.0; // LUFS
 
     // Singleton access
     static AudioPlayer *getInstance()
@@ -45,6 +50,18 @@ public:
     PlayOggResult playOggAt(const string &fileName, uint32_t seekTime = 0, uint32_t endTime = 0, int loop = 1,
                             PlaybackCallback playbackCallback = nullptr, StateChangeCallback stateChangeCallback = nullptr);
 
+    // Thư mục lưu seek-index cache của file Ogg (nên là thư mục cache của app), chuỗi rỗng =
+    // thư mục tạm của hệ thống. sidecar = true: ghi file "<file>.idx" cạnh file gốc
+    void setIndexCacheDirectory(const string &dir, bool sidecar = false);
+
+    // Đo loudness EBU R128 cho cả thư viện trên ThreadPool, song song nhiều file, luôn chừa một
+    // worker cho playOggAt. File đã có kết quả trong cache (cạnh seek-index) không bị đo lại.
+    // Session đang mở file được cập nhật gain ngay khi đo xong. callback chạy trên worker.
+    void analyzeLoudness(const vector<string> &fileNames, LoudnessCallback callback = nullptr);
+    void setLoudnessNormalization(bool enabled, double targetLoudness = DEFAULT_TARGET_LOUDNESS);
+    bool isLoudnessNormalizationEnabled() const { return loudnessNormalization.load(); }
+    double getTargetLoudness() const { return targetLoudness.load(); }
+
 private:
     // Constructor and assignment operators
     AudioPlayer();
@@ -55,5 +72,16 @@ private:
     unique_ptr<AudioLayer> audioLayer;
     mutable shared_mutex sessionsMutex;
     unordered_map<AudioSession *, unique_ptr<AudioSession>> sessions;
+
+    // Hàng đợi file cần đo loudness, được các worker trên threadPool lấy dần.
+    // Khai báo trước threadPool để còn sống tới khi ~ThreadPool join xong các worker
+    void loudnessWorker();
+    atomic<bool> loudnessNormalization{true};
+    atomic<double> targetLoudness{DEFAULT_TARGET_LOUDNESS};
+    mutex loudnessMutex;
+    condition_variable loudnessIdle; // Báo khi loudnessWorkers về 0
+    deque<pair<string, LoudnessCallback>> loudnessQueue;
+    size_t loudnessWorkers = 0;
+
     ThreadPool threadPool;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <functional>
+#include <string>
 
 
 enum class PlayState {
@@ -28,8 +29,12 @@ struct StateChangeInfo {
 
 using StateChangeCallback = std::function<void(const StateChangeInfo&)>; // Callback cho sự kiện thay đổi trạng thái
 using PlaybackCallback = std::function<void(const PlaybackInfo&)>; // Callback cho audio data và playback info
+// Kết quả đo loudness một file: ok = false nếu không đọc/decode được, loudness đơn vị LUFS
+using LoudnessCallback = std::function<void(const std::string& fileName, bool ok, double loudness)>;
 
 // Callback cho audio data
 // position: kiểu int64_t để đếm số lượng mẫu đã phát
 // timestamp: kiểu int64_t để lưu thời gian theo nanosecond
-using AudioCallback = std::function<size_t(float* pcm_to_speaker, size_t frames)>; 
\ No newline at end of file
+using AudioCallback = std::function<size_t(float* pcm_to_speaker, size_t frames)>;
+// Nhận nguyên block mic (mono) trên audio thread trong chế độ full-duplex, vd để ghi âm
+using CaptureTap = std::function<void(const float* mono, size_t frames)>;
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "audio_player_types.hpp"
 #include <chrono>
 #include <functional>
+#include <mutex>
 
 using namespace std;
 AudioSession::AudioSession(AudioPlayer* player)
@@ -17,13 +18,14 @@ AudioSession::~AudioSession() {
 Result AudioSession::acquireInputBus() {
     if (mixerBusId >= 0) {
         // Nếu đã có bus, release nó trước
+        releaseStemBuses();
         auto* audioLayer = player->getAudioLayer();
         audioLayer->releaseInputBus(mixerBusId);
         mixerBusId = -1;
     }
 
     auto* audioLayer = player->getAudioLayer();
-    mixerBusId = audioLayer->acquireInputBus();
+    mixerBusId = audioLayer->acquireInputBus(static_cast<int>(channels));
     
     if (mixerBusId < 0) {
         return Result::error(ErrorCode::AudioSetupError, "Failed to acquire mixer bus");
@@ -32,17 +34,107 @@ Result AudioSession::acquireInputBus() {
     audioLayer->setAudioCallback(mixerBusId, 
             bind(&AudioSession::audioCallbackOgg, this, placeholders::_1, placeholders::_2));
 
+    Result result = acquireStemBuses();
+    if (!result.isSuccess()) {
+        audioLayer->releaseInputBus(mixerBusId);
+        mixerBusId = -1;
+        return result;
+    }
+
+    this->pcmBuffer = make_unique<float[]>(MAX_FRAME_SIZE * MAX_DECODE_CHANNELS);
+    this->planarIn = make_unique<float[]>(MAX_FRAME_SIZE * channels);
+    this->planarOut = make_unique<float[]>(MAX_STRETCH_FRAMES * channels);
+    this->stretchScratch = make_unique<float[]>(MAX_STRETCH_FRAMES * channels);
+
+    return Result::success();
+}
+
+/*
+File multistream có nhiều stream: bus của session trở thành bus nguồn (gọi callback một lần mỗi
+chu kỳ, không mix trực tiếp), mỗi stream được mix qua một bus stem đọc nhóm kênh của nó.
+Thứ tự kênh theo initOpusDecoder: stream coupled (2 kênh) trước, stream mono sau.
+*/
+Result AudioSession::acquireStemBuses() {
+    const OpusHeader& header = oggFile->header;
+    if (header.channel_mapping == 0 || header.nb_streams < 2) {
+        return Result::success();
+    }
+
+    auto* audioLayer = player->getAudioLayer();
+    for (int s = 0; s < header.nb_streams; s++) {
+        StemRoute stem;
+        stem.firstChannel = s + min(s, header.nb_coupled);
+        stem.channels = s < header.nb_coupled ? 2 : 1;
+        stem.busId = audioLayer->acquireStemBus(mixerBusId, stem.firstChannel, stem.channels);
+        if (stem.busId < 0) {
+            releaseStemBuses();
+            return Result::error(ErrorCode::AudioSetupError, "Failed to acquire stem bus");
+        }
+        stems.push_back(stem);
+    }
+    debugPrint("Routed {} stems from {} decoded channels", stems.size(), channels);
+    return Result::success();
+}
 
-    this->pcmBuffer = make_unique<float[]>(MAX_FRAME_SIZE);
+void AudioSession::releaseStemBuses() {
+    auto* audioLayer = player->getAudioLayer();
+    for (const auto& stem : stems) {
+        audioLayer->releaseInputBus(stem.busId);
+    }
+    stems.clear();
+}
 
+Result AudioSession::setStemVolume(size_t stem, float newVolume) {
+    if (stem >= stems.size()) {
+        return Result::error(ErrorCode::InvalidParameter, "Invalid stem index");
+    }
+    player->getAudioLayer()->setInputVolume(stems[stem].busId, clamp(newVolume, 0.0f, 1.0f));
+    return Result::success();
+}
+
+Result AudioSession::muteStem(size_t stem, bool mute) {
+    if (stem >= stems.size()) {
+        return Result::error(ErrorCode::InvalidParameter, "Invalid stem index");
+    }
+    player->getAudioLayer()->muteInputBus(stems[stem].busId, mute);
     return Result::success();
 }
 
 void AudioSession::setVolume(float newVolume) {
     volume = clamp(newVolume, 0.0f, 1.0f);
+    applyBusVolume();
+}
+
+void AudioSession::setPan(float pan) {
     if (mixerBusId >= 0) {
-        auto* audioLayer = player->getAudioLayer();
-        audioLayer->setInputVolume(mixerBusId, volume);
+        player->getAudioLayer()->setInputPan(mixerBusId, clamp(pan, -1.0f, 1.0f));
+    }
+}
+
+bool AudioSession::getCpuStats(AudioLayer::InputCpuStats& stats) const {
+    return mixerBusId >= 0 && player->getAudioLayer()->getInputCpuStats(mixerBusId, stats);
+}
+
+void AudioSession::setMeasuredLoudness(double loudness) {
+    measuredLoudness.store(loudness);
+    updateOutputGain();
+}
+
+void AudioSession::updateOutputGain() {
+    double gainDb = headerGainDb;
+    const double loudness = measuredLoudness.load();
+    // Loudness được đo trên PCM chưa tính output gain nên target - loudness đã bao gồm nó
+    if (player->isLoudnessNormalizationEnabled() && isfinite(loudness)) {
+        gainDb = player->getTargetLoudness() - loudness;
+    }
+    outputGainDb.store(min(gainDb, MAX_OUTPUT_GAIN_DB));
+    applyBusVolume();
+}
+
+void AudioSession::applyBusVolume() {
+    if (mixerBusId >= 0) {
+        const double gain = pow(10.0, outputGainDb.load() / 20.0);
+        player->getAudioLayer()->setInputVolume(mixerBusId, static_cast<float>(volume * gain));
     }
 }
 
@@ -52,15 +144,7 @@ void AudioSession::pause() {
         return;
     }
     
-    // Tính toán và lưu thời gian đã phát trước khi pause
-    if (timing.hasStartTime) {
-        auto now = chrono::steady_clock::now();
-        auto timeSinceSpeedChange = chrono::duration_cast<chrono::milliseconds>(
-            now - timing.speedChangeTime).count();
-        timing.accumulatedTime += timeSinceSpeedChange * timing.speed;
-        timing.hasStartTime = false;
-    }
-    
+    // Mute là fade out ngắn, sau đó mixer ngừng gọi callback nên đồng hồ phát tự dừng
     auto* audioLayer = player->getAudioLayer();
     audioLayer->muteInputBus(mixerBusId, true);
     setState(PlayState::PAUSED);
@@ -75,10 +159,6 @@ void AudioSession::resume() {
     auto* audioLayer = player->getAudioLayer();
     audioLayer->muteInputBus(mixerBusId, false);
     
-    // Reset thời điểm bắt đầu đo tốc độ mới
-    timing.speedChangeTime = chrono::steady_clock::now();
-    timing.hasStartTime = true;
-    
     setState(PlayState::PLAYING);
 }
 
@@ -89,7 +169,8 @@ void AudioSession::stop() {
         return;
     }
     
-    buffer->clear();
+    // Không xóa RingBuffer ở đây vì stop() có thể được gọi từ audio callback,
+    // playAt/seek sẽ làm mới buffer trước lần phát tiếp theo
     setState(PlayState::STOPPED);
 }
 
@@ -97,10 +178,14 @@ void AudioSession::release() {
     stop();
     
     if (mixerBusId >= 0) {
+        releaseStemBuses();
         auto* audioLayer = player->getAudioLayer();
         audioLayer->releaseInputBus(mixerBusId);
         mixerBusId = -1;
     }
+    // Dừng luồng decode trước khi giải phóng RubberBand mà nó đang dùng
+    stopDecodeThread();
+    stopIndexThread();
     cleanupResample();
     setState(PlayState::IDLE);
 }
@@ -111,9 +196,19 @@ void AudioSession::reset() {
     if (state.load() == PlayState::ERROR) {
         setState(PlayState::IDLE);
     }
+    lock_guard<mutex> lock(decodeMutex);
     timing = PlayBackTiming();
-    buffer->clear();
-    pcmBuffer.reset();
+    publishPlaybackWindow();
+    if (buffer) {
+        flushBuffer();
+        resetPlaybackPosition(0);
+        flushing.store(false);
+    }
+}
+
+void AudioSession::publishPlaybackWindow() {
+    callbackSeekTime.store(timing.seekTime, memory_order_relaxed);
+    callbackEndFrame.store(static_cast<int64_t>(timing.endTime) * SAMPLE_RATE / 1000, memory_order_release);
 }
 
 void AudioSession::setPlaybackCallback(PlaybackCallback callback) {
@@ -8,6 +8,8 @@
 #include <functional>
 #include <ogg/ogg.h>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <rubberband/RubberBandStretcher.h>
 
 #include "audio_player_types.hpp"
@@ -15,8 +17,10 @@
 #include "error_code.hpp"
 #include "audio_layer.hpp"
 #include "opus_types.hpp"
+#include "playback_clock.hpp"
+#include "audio_stats.hpp"
 
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) || defined(AUDIO_OPUS_FLAT_INCLUDE)
     #include <opus.h>
 #else
     #include <opus/opus.h>
@@ -36,22 +40,41 @@ struct PlayBackTiming {
 
 
     uint32_t duration{0};       //Thời lượng phát âm thanh
-    uint32_t pauseTime{0};      //Thời gian đã tạm dừng phát âm thanh
     uint32_t endTime{0};        //Thời gian khi phát hết âm thanh
-    uint32_t elapsedTime{0};    // Thời gian đã phát tính bằng millisecond từ lúc bắt đầu phát
-    uint32_t currentTime{0};    // Vị trí hiện tại đang phát tính bằng millisecond
 
    // uint64_t currentFilePos{0};
     uint64_t prerollFilePos{0};    // Vị trí cần seek đơn vị bytes để chuẩn bị preroll
     uint64_t prerollGranulePos{0}; // Granule position đơn vị mẫu âm thanh tại vị trí cần seek để chuẩn bị preroll
-    
-    //Thời điểm bắt đầu phát âm thanh
-    bool hasStartTime{false};   //Đã đánh dấu startTime để đo elapsedTime chưa
-    chrono::time_point<chrono::steady_clock> startTime;
 
     double speed{1.0};                    // Tốc độ phát hiện tại
-    double accumulatedTime{0.0};          // Thời gian đã tích lũy từ các lần pause/resume trước
-    chrono::time_point<chrono::steady_clock> speedChangeTime; // Thời điểm thay đổi speed gần nhất
+};
+
+/*
+    Vùng phát lặp A-B: PCM (trước time-stretch) của [A, B) được giữ lại sau vòng decode
+    đầu tiên, các vòng sau phát thẳng từ bộ nhớ (không đọc file, không decode).
+    Đuôi vùng được trộn sẵn với đầu vùng để đường nối B -> A liền mạch.
+    Chỉ luồng decode (hoặc thread đang giữ decodeMutex) truy cập.
+*/
+struct LoopRegionCache {
+    bool enabled{false};
+    int64_t startFrame{0};      // A, frame nguồn tính từ đầu file sau preskip
+    int64_t endFrame{0};        // B
+    size_t crossfadeFrames{0};  // Độ dài crossfade ở đường nối B -> A
+    vector<float> pcm;          // PCM interleaved [A, B), cấp phát một lần trong setLoopRegion
+    size_t frames{0};           // Độ dài vùng (frame)
+    size_t captured{0};         // Số frame liên tục tính từ A đã có trong pcm
+    bool ready{false};          // pcm đủ và đuôi đã được trộn với đầu vùng
+    bool tailPending{false};    // Đã dừng ghi file ở B - crossfade, chờ phát đuôi từ cache
+    bool playingFromCache{false};
+    size_t cursor{0};           // Frame tiếp theo trong pcm sẽ ghi vào RingBuffer
+};
+
+// Thống kê của luồng decode nền, đọc được từ bất kỳ thread nào
+struct DecodeStats {
+    uint64_t underruns;       // Số lần callback không lấy đủ frame từ RingBuffer
+    uint64_t underrunFrames;  // Tổng số frame bị thiếu (đã phát im lặng thay thế)
+    size_t bufferedFrames;    // Số frame luồng decode đang đi trước callback
+    uint32_t bufferedMs;      // bufferedFrames quy đổi ra millisecond
 };
 
 /*
@@ -65,8 +88,27 @@ public:
     static constexpr uint32_t SAMPLE_RATE = 48000;
     static constexpr size_t FRAME_SIZE = 960; // Opus frame size
     static constexpr size_t MAX_FRAME_SIZE = 6*960; // Max opus frame size
-    static constexpr size_t OGG_BUFFER_SIZE = 2*8192;
-    static constexpr size_t RING_BUFFER_SIZE = (FRAME_SIZE * 8);
+    static constexpr size_t MAX_DECODE_CHANNELS = 8;  // Multistream: tối đa 8 kênh decode (vd: 4 stem stereo)
+    static constexpr size_t MAX_OUTPUT_CHANNELS = 2;  // Mỗi bus/stem đưa vào mixer: mono hoặc stereo
+    // Khoảng tốc độ phát hỗ trợ, quyết định kích thước buffer tạm của time-stretch
+    static constexpr double MIN_PLAYBACK_SPEED = 0.5;
+    static constexpr double MAX_PLAYBACK_SPEED = 2.5;
+    // RubberBand có thể trả ra nhiều hơn input/speed trong một lần, dự phòng gấp đôi
+    static constexpr size_t MAX_STRETCH_FRAMES = static_cast<size_t>(MAX_FRAME_SIZE / MIN_PLAYBACK_SPEED) * 2;
+    static constexpr size_t RING_BUFFER_SIZE = (FRAME_SIZE * 16);
+    // Khoảng trống tối thiểu trong RingBuffer để decode thêm một packet (kể cả khi time-stretch)
+    static constexpr size_t MIN_WRITE_SPACE = (FRAME_SIZE * 4);
+    // Mặc định: đánh thức luồng decode khi còn dưới 80ms, decode đến khi có 200ms
+    static constexpr size_t DEFAULT_LOW_WATERMARK = (FRAME_SIZE * 4);
+    static constexpr size_t DEFAULT_HIGH_WATERMARK = (FRAME_SIZE * 10);
+    // Giới hạn vùng lặp A-B và độ dài crossfade ở đường nối. PCM của vùng là float * channels nên
+    // ngoài giới hạn thời gian còn giới hạn theo byte (60s stereo ~ 23MB, file 8 kênh chỉ ~16s)
+    static constexpr uint32_t MIN_LOOP_REGION_MS = 500;
+    static constexpr uint32_t MAX_LOOP_REGION_MS = 60000;
+    static constexpr size_t MAX_LOOP_CACHE_BYTES = 24 * 1024 * 1024;
+    static constexpr uint32_t LOOP_CROSSFADE_MS = 10;
+    // Gain tối đa (output gain + chuẩn hóa loudness) được phép tăng, tránh đẩy bài quá nhỏ vào clip
+    static constexpr double MAX_OUTPUT_GAIN_DB = 6.0;
     
     // Constructor & Destructor
     explicit AudioSession(AudioPlayer* player);
@@ -89,16 +131,53 @@ public:
     void resume();
     void release();
     void reset();
+
+    // Phát lặp A-B (ms) cho đến khi clearLoopRegion(). Vòng đầu decode từ file và giữ lại
+    // PCM của vùng, các vòng sau phát từ bộ nhớ với crossfade ở đường nối.
+    // Nếu đang phát ngoài vùng thì nhảy về A.
+    Result setLoopRegion(uint32_t startMs, uint32_t endMs);
+    void clearLoopRegion();
+    bool hasLoopRegion() const { return loopRegionActive.load(memory_order_acquire); }
     
-    // Volume Control
+    // Volume Control (được mixer làm mượt, không gây click)
     void setVolume(float volume);
+    // pan: -1 (trái) .. 0 (giữa) .. 1 (phải), áp dụng cho bus của session
+    void setPan(float pan);
+
+    // Loudness normalization: volume của bus = volume * output gain.
+    // Output gain = OpusHeader::gain, hoặc (target - loudness đo được) nếu AudioPlayer bật chuẩn hóa
+    // và file đã được đo. Không tốn thêm phép nhân nào trên từng mẫu.
+    // measureLoudness decode toàn bộ file (chạy trên ThreadPool, không dùng session nào).
+    static Result measureLoudness(const string& fileName, double& loudness);
+    void setMeasuredLoudness(double loudness);
+    void updateOutputGain();
+    double getOutputGainDb() const { return outputGainDb.load(memory_order_relaxed); }
+    // Thời gian CPU mixer dùng cho session (decode qua callback + mix mọi stem)
+    bool getCpuStats(AudioLayer::InputCpuStats& stats) const;
+    // Bus của session trong mixer (để đọc meter), -1 nếu chưa phát
+    int getMixerBusId() const { return mixerBusId; }
     
     // State & Info Access
     PlayState getState() const { return state; }
-    uint32_t getCurrentTime() const { return timing.currentTime; }
+    uint32_t getCurrentTime() const { return getPlaybackPositionMs(); }
+
+    // Vị trí đang phát ra loa, tính từ số frame audio callback đã lấy (quy đổi qua tốc độ
+    // time-stretch) trừ đi độ trễ đầu ra. Không khóa, gọi được từ mọi thread.
+    int64_t getPlaybackPositionFrames() const;
+    uint32_t getPlaybackPositionMs() const;
 
     const string& getFileName() const { return fileName; }
     const uint32_t getDuration() const { return oggFile->file_duration; }
+    // Số kênh decode ra (theo OpusHeader), callback của bus ghi PCM interleaved
+    size_t getChannelCount() const { return channels; }
+
+    // Stem của file multistream (channel mapping 1/255): mỗi stream Opus là một stem có bus riêng
+    // trên mixer, cùng một luồng decode, một lần seek và preroll cho mọi stem.
+    // File một stream: 0 stem, dùng setVolume() như bình thường. setVolume()/pause() vẫn áp dụng
+    // cho cả session (nhân với volume của từng stem).
+    size_t getStemCount() const { return stems.size(); }
+    Result setStemVolume(size_t stem, float volume);
+    Result muteStem(size_t stem, bool mute);
     // Audio Processing Callbacks;
     void setPlaybackCallback(PlaybackCallback callback);
 
@@ -108,6 +187,8 @@ public:
     // Ogg/Opus methods
     Result parseOpusHeader(ogg_packet* op);
     Result initOpusDecoder();
+    static Result parseOpusHeader(const ogg_packet* op, OpusHeader& header);
+    static Result initOpusDecoder(OggOpusFile& file);
 
     // Ogg/Opus analyze
     Result printOggPageInfo(const string& fileName);
@@ -116,6 +197,13 @@ public:
     double getPlaybackSpeed();
     Result setPlaybackSpeed(double speed);
 
+    // Ngưỡng RingBuffer cho luồng decode nền (đơn vị frame):
+    // callback đánh thức decoder khi dữ liệu xuống dưới lowFrames, decoder dừng khi đạt highFrames
+    void setBufferWatermarks(size_t lowFrames, size_t highFrames);
+    DecodeStats getDecodeStats() const;
+    // page_table đã được dựng xong (seek tới mọi vị trí không phải chờ)
+    bool isIndexComplete() const { return indexComplete.load(memory_order_acquire); }
+
 private:
     AudioPlayer* player;
     // File Management & Metadata
@@ -128,18 +216,38 @@ private:
 
     // Audio Buffer & Mixing
     unique_ptr<RingBuffer> buffer;
-    unique_ptr<float[]> pcmBuffer; // Temporary buffer for decoded PCM data
+    // Buffer tạm cấp phát một lần cho mỗi session, đường decode khi phát không cấp phát bộ nhớ
+    unique_ptr<float[]> pcmBuffer;      // PCM interleaved vừa decode (MAX_FRAME_SIZE * MAX_DECODE_CHANNELS)
+    unique_ptr<float[]> planarIn;       // Đầu vào RubberBand, từng kênh liền nhau (MAX_FRAME_SIZE * channels)
+    unique_ptr<float[]> planarOut;      // Đầu ra RubberBand, từng kênh liền nhau (MAX_STRETCH_FRAMES * channels)
+    unique_ptr<float[]> stretchScratch; // Đầu ra RubberBand đã interleave (MAX_STRETCH_FRAMES * channels)
+    size_t channels = 1;                // Số kênh của RingBuffer, RubberBand và bus
     int mixerBusId = -1;
+
+    // Nhóm kênh liền nhau trong PCM decode ra, phát qua bus stem riêng
+    struct StemRoute {
+        int firstChannel;
+        int channels;
+        int busId;
+    };
+    vector<StemRoute> stems;
+    Result acquireStemBuses();
+    void releaseStemBuses();
     float volume = 1.0f;
+    double headerGainDb = 0.0;              // OpusHeader::gain (dB)
+    atomic<double> measuredLoudness{NAN};   // LUFS, NAN nếu chưa đo
+    atomic<double> outputGainDb{0.0};
+    void applyBusVolume();
  
     // Callback cập nhật ứng dụng gọi
     PlaybackCallback playbackCallback;
     void initResample();
     void cleanupResample();
 
-    // Đầu vào ra dạng mono
-    Result resampleRubberBand(size_t input_frames, size_t output_frames,
-                             const float* in, float* out);
+    // Đầu vào ra dạng planar (một con trỏ cho mỗi kênh)
+    // Trả về số frame thực sự lấy được qua retrieved (có thể khác input/speed)
+    Result resampleRubberBand(size_t input_frames, size_t output_capacity,
+                             const float* const* in, float* const* out, size_t& retrieved);
 
     // AudioCallBack
     size_t audioCallbackOgg(float* pcm_to_speaker, size_t frames);
@@ -150,16 +258,80 @@ private:
     Result acquireInputBus();
     Result setState(PlayState newState);
     Result seekBeginOfFile();
+    Result parseHeaderPage();
+    Result readDurationFromLastPage();
+    Result initFromIndexCache();
     Result decodeAndResample(
     const unsigned char* packet,
     int bytes,
     int skipSamples,
     int maxSamples,
     bool applySpeed);
+    // PCM interleaved vừa decode từ file: giữ lại phần thuộc vùng lặp A-B rồi ghi vào RingBuffer
+    Result writeSourceFrames(const float* interleaved, size_t frames, bool applySpeed);
+    // Time-stretch (nếu cần), đăng ký với PlaybackClock rồi ghi vào RingBuffer
+    Result writeToRing(const float* interleaved, size_t frames, bool applySpeed);
+    // Đặt lại đồng hồ phát và vị trí decode sau khi RingBuffer vừa được làm rỗng
+    void resetPlaybackPosition(int64_t sourceFrame);
+    // Decode tiếp từ sourceFrame mà không làm rỗng RingBuffer (đồng hồ nhảy đúng lúc phát tới)
+    Result seekGapless(int64_t sourceFrame);
     Result preroll_decode(ogg_int64_t target_pcm_pos, ogg_int64_t preroll_granulepos);
     OggPageStartPos findPageStartPos(OggOpusFile *opusFile, ogg_int64_t position);
     Result preroll_seek(int64_t prerollFilePos, int64_t prerollGranulePos, int64_t target_pcm_pos);
     Result fillBuffer();
+    Result seekToTimeLocked(uint32_t timeMs);
+
+    // Phát lặp A-B từ cache
+    void captureLoopFrames(const float* interleaved, int64_t chunkStart, int64_t chunkEnd);
+    void finalizeLoopCache();
+    Result jumpToLoopStart();
+    Result fillFromLoopCache();
+
+    // Luồng decode nền: đọc file, decode Opus, time-stretch rồi ghi vào RingBuffer.
+    // Audio callback chỉ copy từ RingBuffer và đánh thức luồng này khi cần.
+    void startDecodeThread();
+    void stopDecodeThread();
+    void decodeThreadLoop();
+    void wakeDecoder();
+    void handleEndReached();
+    // Cập nhật bản sao endTime/seekTime cho callback. Gọi khi đang giữ decodeMutex.
+    void publishPlaybackWindow();
+    void flushBuffer();
+
+    // Luồng dựng page_table nền: loadFile chỉ đọc header và page cuối rồi chuyển sang READY,
+    // page_table được bổ sung dần, seek vào vùng chưa index sẽ chờ luồng này.
+    void startIndexThread();
+    void stopIndexThread();
+    void indexThreadLoop();
+
+    thread decodeThread;
+    mutex decodeMutex;                      // Bảo vệ oggFile/decoder giữa luồng decode và seek/play
+    condition_variable decodeCondition;
+    atomic<bool> decodeThreadRunning{false};
+    atomic<bool> decodeRequested{false};
+    atomic<bool> decodeEof{false};          // Đã decode đến hết file, chờ seek/loop
+    atomic<bool> endReached{false};         // Callback đã phát tới endTime: luồng decode phát lặp hoặc dừng
+    // Bản sao của timing cho callback (timing chỉ được đọc/ghi khi giữ decodeMutex)
+    atomic<int64_t> callbackEndFrame{0};    // endTime theo frame
+    atomic<uint32_t> callbackSeekTime{0};   // seekTime (ms)
+    atomic<bool> flushing{false};           // RingBuffer đang được làm mới, callback phát im lặng
+    atomic<bool> callbackActive{false};     // Callback đang đọc RingBuffer
+    atomic<size_t> lowWatermark{DEFAULT_LOW_WATERMARK};
+    atomic<size_t> highWatermark{DEFAULT_HIGH_WATERMARK};
+    SessionStats stats;                     // Underflow/overflow của RingBuffer và thời gian decode (telemetry)
+
+    // Đồng hồ phát theo frame: luồng decode đăng ký frame ghi vào RingBuffer, callback đăng ký frame đã đọc
+    PlaybackClock clock;
+    int64_t decodePosition{0};              // Frame nguồn tiếp theo luồng decode sẽ ghi (giữ decodeMutex)
+
+    LoopRegionCache loopRegion;             // Bảo vệ bởi decodeMutex
+    atomic<bool> loopRegionActive{false};   // Callback bỏ qua endTime khi đang lặp A-B
+
+    thread indexThread;
+    mutable mutex indexMutex;               // Bảo vệ oggFile->page_table khi luồng index đang ghi
+    condition_variable indexCondition;      // Báo có thêm page được index hoặc đã index xong
+    atomic<bool> indexThreadRunning{false};
+    atomic<bool> indexComplete{false};
 
     RubberBand::RubberBandStretcher* rubberBand{nullptr};
 }; 
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "audio_session.hpp"
 #include "ring_buffer.hpp"
+#include "ogg_index_cache.hpp"
 #include <cstring>
 #include <chrono>
 #include <mutex>
@@ -12,119 +13,159 @@ Result AudioSession::loadFile(const string &fileName)
     debugPrint("Loading file: {}", fileName);
 
     this->fileName = fileName;
+    stats.setLabel(fileName);
 
-    // Mở file
-    FILE *fin = fopen(fileName.c_str(), "rb");
-    if (!fin)
+    // Luồng index của file trước (nếu có) đang dùng oggFile cũ
+    stopIndexThread();
+    indexComplete.store(false);
+
+    // Vùng lặp A-B thuộc về file cũ
+    loopRegionActive.store(false);
+    loopRegion = LoopRegionCache();
+
+    // Khởi tạo OggOpusFile và mmap file
+    oggFile = make_unique<OggOpusFile>();
+    if (!oggFile->source.open(fileName))
     {
         setState(PlayState::ERROR);
         return Result::error(ErrorCode::FileNotFound, "Cannot open file");
     }
 
-    // Khởi tạo OggOpusFile
-    oggFile = make_unique<OggOpusFile>();
-    oggFile->fin = fin;
-
-    // Khởi tạo ogg_sync_state
-    ogg_sync_init(&oggFile->oy);
-
-    bool header_parsed = false;
-    long page_start_offset = 0;
-    uint16_t page_index_counter = 0;
-
-    // Duyệt qua toàn bộ file
-    while (true)
+    // Ưu tiên index đã lưu từ lần load trước. Nếu không có cache thì chỉ đọc header
+    // và page cuối để lấy thời lượng, page_table được dựng ở luồng nền sau khi READY.
+    Result result;
+    bool indexCached = OggIndexCache::load(fileName, *oggFile);
+    if (indexCached)
     {
-        char *buffer = ogg_sync_buffer(&oggFile->oy, OGG_BUFFER_SIZE);
-        size_t bytes = fread(buffer, 1, OGG_BUFFER_SIZE, fin);
-        if (bytes == 0)
-            break;
-
-        ogg_sync_wrote(&oggFile->oy, bytes);
-
-        ogg_page og;
-        while (ogg_sync_pageout(&oggFile->oy, &og) == 1)
-        {
-            if (!header_parsed)
-            {
-                if (ogg_stream_init(&oggFile->os, ogg_page_serialno(&og)) < 0)
-                {
-                    setState(PlayState::ERROR);
-                    return Result::error(ErrorCode::OggStreamError, "Failed to init ogg stream");
-                }
-
-                ogg_stream_pagein(&oggFile->os, &og);
-
-                ogg_packet op;
-                if (ogg_stream_packetout(&oggFile->os, &op) != 1)
-                {
-                    setState(PlayState::ERROR);
-                    return Result::error(ErrorCode::OggPacketCorrupt, "Failed to read header packet");
-                }
-
-                Result result = parseOpusHeader(&op);
-                if (!result.isSuccess())
-                {
-                    setState(PlayState::ERROR);
-                    return result;
-                }
-
-                result = initOpusDecoder();
-                if (!result.isSuccess())
-                {
-                    setState(PlayState::ERROR);
-                    return result;
-                }
-
-                header_parsed = true;
-            }
-
-            OggPageIndex page_index;
-            page_index.index = page_index_counter++;
-            page_index.file_offset = page_start_offset;
-            page_index.granule_pos = ogg_page_granulepos(&og);
-            page_index.size = og.header_len + og.body_len;
-
-            oggFile->page_table.push_back(page_index);
-
-            if (page_index.granule_pos >= 0)
-            {
-                oggFile->last_granulepos = page_index.granule_pos;
-            }
-
-            page_start_offset += page_index.size;
-        }
+        debugPrint("Loaded seek index from cache: {}", fileName);
+        result = initFromIndexCache();
+        indexComplete.store(true, memory_order_release);
     }
-
-    if (oggFile->last_granulepos > 0)
+    else
     {
-        oggFile->file_duration = ((oggFile->last_granulepos - oggFile->header.preskip) * 1000.0) / SAMPLE_RATE;
+        result = parseHeaderPage();
+        if (result.isSuccess())
+        {
+            result = readDurationFromLastPage();
+        }
     }
-    else
+    if (!result.isSuccess())
     {
         setState(PlayState::ERROR);
-        return Result::error(ErrorCode::OggMetadataError, "Could not determine duration");
+        return result;
     }
+
+    // RingBuffer giữ đúng số kênh decode ra (mono, stereo hoặc mọi stem), không downmix
+    channels = static_cast<size_t>(oggFile->decodedChannels);
+
+    // Output gain của file và loudness đã đo (nếu có), áp dụng vào volume của bus
+    headerGainDb = oggFile->header.gain / 256.0;
+    double loudness;
+    measuredLoudness.store(OggIndexCache::loadLoudness(fileName, loudness) ? loudness : NAN);
+
     // Chỉ khi nào load file Opus.ogg thành công thì mới acquireInputBus của AudioLayer
-    Result result = acquireInputBus();
+    result = acquireInputBus();
     if (!result.isSuccess()) {
         setState(PlayState::ERROR);
         return result;
     }
+    updateOutputGain();
     // Tạo lại buffer với số kênh đúng
-    buffer = make_unique<RingBuffer>(RING_BUFFER_SIZE);
+    buffer = make_unique<RingBuffer>(RING_BUFFER_SIZE, channels);
     // Khởi tạo bộ chuyển đổi tần số lấy mẫu (resampler) cho audio session
     initResample();
 
-    fseek(fin, 0, SEEK_SET);
-    ogg_sync_reset(&oggFile->oy);
+    oggFile->source.seek(0);
     ogg_stream_reset(&oggFile->os);
 
+    // Luồng decode nền giữ RingBuffer luôn có dữ liệu trong khi phát
+    startDecodeThread();
+    if (!indexCached)
+    {
+        startIndexThread();
+    }
+
     setState(PlayState::READY);
     return Result::success();
 }
 
+/*
+Đọc page đầu tiên (BOS) của file: khởi tạo ogg stream, parse OpusHead và tạo decoder.
+Các page còn lại được index ở luồng nền.
+*/
+Result AudioSession::parseHeaderPage()
+{
+    ogg_page og;
+    if (oggFile->source.nextPage(&og) != 1)
+    {
+        return Result::error(ErrorCode::OggInvalidFormat, "No Ogg page found");
+    }
+
+    oggFile->serialno = ogg_page_serialno(&og);
+    if (ogg_stream_init(&oggFile->os, oggFile->serialno) < 0)
+    {
+        return Result::error(ErrorCode::OggStreamError, "Failed to init ogg stream");
+    }
+
+    ogg_stream_pagein(&oggFile->os, &og);
+
+    ogg_packet op;
+    if (ogg_stream_packetout(&oggFile->os, &op) != 1)
+    {
+        return Result::error(ErrorCode::OggPacketCorrupt, "Failed to read header packet");
+    }
+
+    Result result = parseOpusHeader(&op);
+    if (!result.isSuccess())
+    {
+        return result;
+    }
+    return initOpusDecoder();
+}
+
+/*
+Lấy thời lượng từ granule_pos của page cuối cùng, quét ngược từ cuối file
+*/
+Result AudioSession::readDurationFromLastPage()
+{
+    ogg_page og;
+    if (!oggFile->source.lastPage(oggFile->serialno, &og))
+    {
+        return Result::error(ErrorCode::OggMetadataError, "Could not determine duration");
+    }
+
+    oggFile->last_granulepos = ogg_page_granulepos(&og);
+    if (oggFile->last_granulepos <= 0)
+    {
+        return Result::error(ErrorCode::OggMetadataError, "Could not determine duration");
+    }
+    oggFile->file_duration = ((oggFile->last_granulepos - oggFile->header.preskip) * 1000.0) / SAMPLE_RATE;
+    return Result::success();
+}
+
+/*
+Khởi tạo stream và decoder từ thông tin đã có trong index cache,
+không cần đọc lại header packet trong file.
+*/
+Result AudioSession::initFromIndexCache()
+{
+    if (ogg_stream_init(&oggFile->os, oggFile->serialno) < 0)
+    {
+        return Result::error(ErrorCode::OggStreamError, "Failed to init ogg stream");
+    }
+    if (oggFile->file_duration == 0)
+    {
+        return Result::error(ErrorCode::OggMetadataError, "Could not determine duration");
+    }
+    return initOpusDecoder();
+}
+
 Result AudioSession::parseOpusHeader(ogg_packet *op)
+{
+    return parseOpusHeader(op, oggFile->header);
+}
+
+Result AudioSession::parseOpusHeader(const ogg_packet *op, OpusHeader &opusHeader)
 {
     // Kiểm tra magic signature
     if (op->bytes < 8 || memcmp(op->packet, "OpusHead", 8) != 0)
@@ -133,7 +174,7 @@ Result AudioSession::parseOpusHeader(ogg_packet *op)
     }
 
     // Parse header
-    OpusHeader *header = &oggFile->header;
+    OpusHeader *header = &opusHeader;
     const unsigned char *data = op->packet;
 
     header->version = data[8];
@@ -141,20 +182,86 @@ Result AudioSession::parseOpusHeader(ogg_packet *op)
     header->preskip = (data[10] | (data[11] << 8));
     header->input_sample_rate = (data[12] | (data[13] << 8) |
                                  (data[14] << 16) | (data[15] << 24));
-    header->gain = (data[16] | (data[17] << 8));
+    header->gain = static_cast<int16_t>(data[16] | (data[17] << 8)); // Q7.8 dB, có dấu
+    header->channel_mapping = data[18];
+
+    if (header->channel_mapping == 0)
+    {
+        // Mono/stereo: một stream, coupled nếu stereo
+        if (header->channels < 1 || header->channels > 2)
+        {
+            return Result::error(ErrorCode::InvalidFormat, "Invalid channel count for mapping family 0");
+        }
+        header->nb_streams = 1;
+        header->nb_coupled = header->channels - 1;
+        header->stream_map[0] = 0;
+        header->stream_map[1] = 1;
+        return Result::success();
+    }
+
+    // Multistream (family 1/255): 21 byte cố định + stream_map một byte cho mỗi kênh
+    if (header->channels < 1 || op->bytes < 21 + header->channels)
+    {
+        return Result::error(ErrorCode::InvalidFormat, "Truncated channel mapping table");
+    }
+    header->nb_streams = data[19];
+    header->nb_coupled = data[20];
+    if (header->nb_streams < 1 || header->nb_coupled > header->nb_streams)
+    {
+        return Result::error(ErrorCode::InvalidFormat, "Invalid stream count");
+    }
+    memcpy(header->stream_map, data + 21, header->channels);
     return Result::success();
 }
 
+/*
+Tạo decoder theo channel mapping:
+- Family 0: OpusDecoder mono/stereo
+- Family 1/255: OpusMSDecoder. Mỗi stream là một stem (stream coupled = stem stereo), PCM được
+  decode theo thứ tự stream thay vì stream_map của file: các stream coupled (L R) trước,
+  stream mono sau, để mỗi stem là một nhóm kênh liền nhau. Thứ tự loa của stream_map bị bỏ qua
+  vì player chỉ phát stereo.
+*/
 Result AudioSession::initOpusDecoder()
 {
-    int error;
-    oggFile->decoder = opus_decoder_create(SAMPLE_RATE,
-                                           oggFile->header.channels,
-                                           &error);
+    return initOpusDecoder(*oggFile);
+}
+
+Result AudioSession::initOpusDecoder(OggOpusFile& file)
+{
+    const OpusHeader& header = file.header;
+    int error = OPUS_OK;
+
+    if (header.channel_mapping == 0)
+    {
+        file.decodedChannels = header.channels;
+        file.decoder = opus_decoder_create(SAMPLE_RATE, header.channels, &error);
+        if (error != OPUS_OK || !file.decoder)
+        {
+            return Result::error(ErrorCode::DecoderError, "Failed to create decoder");
+        }
+        return Result::success();
+    }
+
+    const int decodedChannels = header.nb_streams + header.nb_coupled;
+    if (decodedChannels > static_cast<int>(MAX_DECODE_CHANNELS))
+    {
+        return Result::error(ErrorCode::DecoderError, "Too many streams in multistream file");
+    }
+
+    unsigned char mapping[MAX_DECODE_CHANNELS];
+    for (int c = 0; c < decodedChannels; c++)
+    {
+        mapping[c] = static_cast<unsigned char>(c);
+    }
 
-    if (error != OPUS_OK || !oggFile->decoder)
+    file.decodedChannels = decodedChannels;
+    file.msDecoder = opus_multistream_decoder_create(SAMPLE_RATE, decodedChannels,
+                                                         header.nb_streams, header.nb_coupled,
+                                                         mapping, &error);
+    if (error != OPUS_OK || !file.msDecoder)
     {
-        return Result::error(ErrorCode::DecoderError, "Failed to create decoder");
+        return Result::error(ErrorCode::DecoderError, "Failed to create multistream decoder");
     }
     return Result::success();
 }
\ No newline at end of file
@@ -266,6 +266,7 @@ void AudioSession::printOggInfo() const
     printDebug("Output gain: {} dB", static_cast<float>(header.gain) / 256.0f);
     
     // In thông tin page table
+    lock_guard<mutex> lock(indexMutex);
     printDebug("┌─────────┬────────────┬────────────┬───────────────┐");
     printDebug("│ Page #  │File Offset │ Page Size  │ Granule Pos   │");
     printDebug("├─────────┼────────────┼────────────┼───────────────┤");
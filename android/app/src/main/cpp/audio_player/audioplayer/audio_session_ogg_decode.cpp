@@ -0,0 +1,178 @@
+#include "audio_session.hpp"
+#include "ring_buffer.hpp"
+#include "rt_alloc_guard.hpp"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// Thời gian chờ tối đa của luồng decode khi không được đánh thức.
+// Callback đánh thức decoder mà không giữ mutex nên có thể lỡ một lần notify,
+// timeout này đảm bảo RingBuffer vẫn được nạp lại kịp thời.
+static constexpr auto DECODE_IDLE_TIMEOUT = chrono::milliseconds(10);
+
+void AudioSession::startDecodeThread()
+{
+    if (decodeThreadRunning.load())
+    {
+        return;
+    }
+    decodeEof.store(false);
+    endReached.store(false);
+    decodeThreadRunning.store(true);
+    decodeThread = thread(&AudioSession::decodeThreadLoop, this);
+}
+
+void AudioSession::stopDecodeThread()
+{
+    if (!decodeThreadRunning.exchange(false))
+    {
+        return;
+    }
+    decodeCondition.notify_all();
+    if (decodeThread.joinable())
+    {
+        decodeThread.join();
+    }
+}
+
+/*
+Đánh thức luồng decode từ audio callback.
+Không khóa mutex: chỉ bật cờ rồi notify, luồng decode tự kiểm tra cờ khi thức dậy.
+*/
+void AudioSession::wakeDecoder()
+{
+    decodeRequested.store(true, memory_order_release);
+    decodeCondition.notify_one();
+}
+
+/*
+Làm rỗng RingBuffer một cách an toàn với audio callback:
+1. Bật cờ flushing để callback không đọc RingBuffer nữa (phát im lặng)
+2. Chờ callback đang chạy (nếu có) đọc xong
+3. Xóa RingBuffer
+Người gọi phải tắt cờ flushing sau khi đã nạp lại dữ liệu.
+Không được gọi từ audio callback.
+*/
+void AudioSession::flushBuffer()
+{
+    flushing.store(true);
+    while (callbackActive.load())
+    {
+        this_thread::yield();
+    }
+    buffer->clear();
+}
+
+/*
+Callback đã phát tới endTime (gọi khi đang giữ decodeMutex):
+- Còn lượt lặp: seek lại về điểm bắt đầu phát, đồng hồ phát được đặt lại trong seek
+- Hết lượt: dừng phát (callback không gọi stop() trên thread real-time)
+*/
+void AudioSession::handleEndReached()
+{
+    debugPrint("End reached, loop: {}/{}", timing.currentLoop + 1, timing.totalLoop);
+    if (timing.totalLoop != 0 && timing.currentLoop + 1 >= timing.totalLoop)
+    {
+        debugPrint("File finished");
+        stop();
+        endReached.store(false, memory_order_release);
+        return;
+    }
+    timing.currentLoop++;
+
+    Result result;
+    if (timing.seekTime == 0)
+    {
+        result = seekBeginOfFile();
+    }
+    else
+    {
+        flushBuffer();
+        result = preroll_seek(timing.prerollFilePos, timing.prerollGranulePos, timing.target_pcm_pos);
+        flushing.store(false);
+    }
+    if (!result.isSuccess())
+    {
+        debugPrint("Loop seek failed: {}", result.getErrorString());
+    }
+    endReached.store(false, memory_order_release);
+}
+
+/*
+Vòng lặp của luồng decode:
+- Chờ đến khi callback đánh thức (dữ liệu dưới low watermark) hoặc hết timeout
+- Xử lý yêu cầu phát lặp nếu có
+- Decode cho đến khi RingBuffer đạt high watermark hoặc hết file
+*/
+void AudioSession::decodeThreadLoop()
+{
+    while (decodeThreadRunning.load())
+    {
+        unique_lock<mutex> lock(decodeMutex);
+        decodeCondition.wait_for(lock, DECODE_IDLE_TIMEOUT, [this] {
+            return !decodeThreadRunning.load() ||
+                   decodeRequested.load(memory_order_acquire) ||
+                   endReached.load(memory_order_acquire);
+        });
+        decodeRequested.store(false, memory_order_relaxed);
+
+        if (!decodeThreadRunning.load())
+        {
+            break;
+        }
+
+        if (endReached.load(memory_order_acquire))
+        {
+            handleEndReached();
+            continue;
+        }
+
+        PlayState currentState = state.load();
+        if (currentState != PlayState::PLAYING && currentState != PlayState::PAUSED)
+        {
+            continue;
+        }
+
+        if (decodeEof.load() || buffer->availableForRead() >= highWatermark.load())
+        {
+            continue;
+        }
+
+        Result result;
+        {
+            // Decode khi đang phát (không seek) không được cấp phát bộ nhớ
+            RT_NO_ALLOC_SCOPE("AudioSession::fillBuffer");
+            const auto decodeStart = chrono::steady_clock::now();
+            result = fillBuffer();
+            stats.decodeTime.record(chrono::duration_cast<chrono::microseconds>(
+                chrono::steady_clock::now() - decodeStart).count());
+        }
+        if (!result.isSuccess())
+        {
+            debugPrint("Background decode failed: {}", result.getErrorString());
+        }
+    }
+}
+
+void AudioSession::setBufferWatermarks(size_t lowFrames, size_t highFrames)
+{
+    const size_t maxHigh = RING_BUFFER_SIZE - MIN_WRITE_SPACE;
+    highFrames = clamp(highFrames, FRAME_SIZE, maxHigh);
+    lowFrames = min(lowFrames, highFrames - FRAME_SIZE / 2);
+
+    lowWatermark.store(lowFrames);
+    highWatermark.store(highFrames);
+    wakeDecoder();
+}
+
+DecodeStats AudioSession::getDecodeStats() const
+{
+    size_t buffered = buffer ? buffer->availableForRead() : 0;
+    return DecodeStats{
+        stats.ring.underflows.load(memory_order_relaxed),
+        stats.ring.underflowFrames.load(memory_order_relaxed),
+        buffered,
+        static_cast<uint32_t>((buffered * 1000) / SAMPLE_RATE)};
+}
@@ -0,0 +1,92 @@
+#include "audio_session.hpp"
+#include "ogg_index_cache.hpp"
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// Số page được gom lại trước mỗi lần khóa indexMutex để thêm vào page_table
+static constexpr size_t INDEX_BATCH_PAGES = 64;
+
+void AudioSession::startIndexThread()
+{
+    stopIndexThread();
+    indexComplete.store(false);
+    indexThreadRunning.store(true);
+    indexThread = thread(&AudioSession::indexThreadLoop, this);
+}
+
+void AudioSession::stopIndexThread()
+{
+    {
+        // Giữ khóa để seek đang chờ index không bỏ lỡ thông báo dừng
+        lock_guard<mutex> lock(indexMutex);
+        indexThreadRunning.store(false);
+    }
+    indexCondition.notify_all();
+    if (indexThread.joinable())
+    {
+        indexThread.join();
+    }
+}
+
+/*
+Quét toàn bộ file từ đầu bằng con trỏ đọc riêng (không ảnh hưởng luồng decode),
+thêm page vào page_table theo từng lô và báo cho các seek đang chờ.
+Khi xong thì ghi index ra cache để lần load sau không phải quét lại.
+*/
+void AudioSession::indexThreadLoop()
+{
+    vector<OggPageIndex> batch;
+    batch.reserve(INDEX_BATCH_PAGES);
+
+    int64_t cursor = 0;
+    int64_t pageOffset = 0;
+    uint16_t pageCounter = 0;
+    ogg_page og;
+    bool finished = false;
+
+    while (indexThreadRunning.load(memory_order_relaxed))
+    {
+        bool hasPage = oggFile->source.readPage(cursor, &og, &pageOffset) == 1;
+        if (hasPage)
+        {
+            OggPageIndex page_index;
+            page_index.index = pageCounter++;
+            page_index.file_offset = pageOffset;
+            page_index.granule_pos = ogg_page_granulepos(&og);
+            page_index.size = og.header_len + og.body_len;
+            batch.push_back(page_index);
+        }
+
+        if (batch.size() >= INDEX_BATCH_PAGES || (!hasPage && !batch.empty()))
+        {
+            lock_guard<mutex> lock(indexMutex);
+            oggFile->page_table.insert(oggFile->page_table.end(), batch.begin(), batch.end());
+            batch.clear();
+            indexCondition.notify_all();
+        }
+
+        if (!hasPage)
+        {
+            finished = true;
+            break;
+        }
+    }
+
+    if (!finished)
+    {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(indexMutex);
+        indexComplete.store(true, memory_order_release);
+        indexThreadRunning.store(false);
+    }
+    indexCondition.notify_all();
+    debugPrint("Background index complete: {} pages", oggFile->page_table.size());
+
+    // page_table không còn bị ghi nữa, có thể đọc mà không cần khóa
+    OggIndexCache::store(fileName, *oggFile);
+}
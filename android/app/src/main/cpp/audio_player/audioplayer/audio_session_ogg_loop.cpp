@@ -0,0 +1,276 @@
+#include "audio_session.hpp"
+#include "ring_buffer.hpp"
+#include <cstring>
+#include <mutex>
+
+using namespace std;
+
+/*
+Bật phát lặp A-B.
+PCM của vùng được cấp phát ở đây (ngoài luồng decode), luồng decode điền dần khi decode qua vùng.
+Nếu đang phát ngoài vùng thì seek về A để vòng đầu tiên thu được toàn bộ vùng.
+*/
+Result AudioSession::setLoopRegion(uint32_t startMs, uint32_t endMs)
+{
+    if (!oggFile || !buffer)
+    {
+        return Result::error(ErrorCode::NotInitialized, "File not loaded");
+    }
+
+    endMs = min(endMs, oggFile->file_duration);
+    if (startMs >= endMs || endMs - startMs < MIN_LOOP_REGION_MS)
+    {
+        return Result::error(ErrorCode::InvalidParameter, "Loop region too short");
+    }
+    if (endMs - startMs > MAX_LOOP_REGION_MS)
+    {
+        return Result::error(ErrorCode::InvalidParameter, "Loop region too long");
+    }
+
+    const int64_t startFrame = static_cast<int64_t>(startMs) * SAMPLE_RATE / 1000;
+    const int64_t endFrame = static_cast<int64_t>(endMs) * SAMPLE_RATE / 1000;
+
+    // Cấp phát trước khi khóa để không chặn luồng decode, vùng cũ được giải phóng sau khi mở khóa
+    const size_t regionFrames = static_cast<size_t>(endFrame - startFrame);
+    if (regionFrames * channels * sizeof(float) > MAX_LOOP_CACHE_BYTES)
+    {
+        return Result::error(ErrorCode::InvalidParameter, "Loop region too long for this channel count");
+    }
+    vector<float> pcm(regionFrames * channels);
+
+    lock_guard<mutex> lock(decodeMutex);
+
+    // Đang phát đuôi/cache của vùng cũ: nối lại từ file tại đúng vị trí đã ghi
+    if (loopRegion.playingFromCache || loopRegion.tailPending)
+    {
+        const int64_t resumeFrame = loopRegion.playingFromCache
+            ? loopRegion.startFrame + static_cast<int64_t>(loopRegion.cursor)
+            : loopRegion.endFrame - static_cast<int64_t>(loopRegion.crossfadeFrames);
+        Result result = seekGapless(resumeFrame);
+        if (!result.isSuccess())
+        {
+            return result;
+        }
+    }
+
+    loopRegion.pcm.swap(pcm);
+    loopRegion.frames = regionFrames;
+    loopRegion.enabled = true;
+    loopRegion.startFrame = startFrame;
+    loopRegion.endFrame = endFrame;
+    loopRegion.crossfadeFrames = static_cast<size_t>(LOOP_CROSSFADE_MS) * SAMPLE_RATE / 1000;
+    loopRegion.captured = 0;
+    loopRegion.ready = false;
+    loopRegion.tailPending = false;
+    loopRegion.playingFromCache = false;
+    loopRegion.cursor = 0;
+    loopRegionActive.store(true, memory_order_release);
+
+    debugPrint("Loop region: {}ms - {}ms", startMs, endMs);
+
+    PlayState currentState = state.load();
+    if (currentState == PlayState::PLAYING || currentState == PlayState::PAUSED)
+    {
+        const int64_t position = clock.position();
+        if (position < startFrame || position >= endFrame)
+        {
+            return seekToTimeLocked(startMs);
+        }
+    }
+    return Result::success();
+}
+
+/*
+Tắt phát lặp A-B, phát tiếp từ file ngay sau đoạn đã có trong RingBuffer.
+*/
+void AudioSession::clearLoopRegion()
+{
+    vector<float> released;
+    lock_guard<mutex> lock(decodeMutex);
+    if (!loopRegion.enabled)
+    {
+        return;
+    }
+
+    loopRegionActive.store(false, memory_order_release);
+    if (loopRegion.playingFromCache || loopRegion.tailPending)
+    {
+        const int64_t resumeFrame = loopRegion.playingFromCache
+            ? loopRegion.startFrame + static_cast<int64_t>(loopRegion.cursor)
+            : loopRegion.endFrame - static_cast<int64_t>(loopRegion.crossfadeFrames);
+        Result result = seekGapless(resumeFrame);
+        if (!result.isSuccess())
+        {
+            debugPrint("Leave loop region failed: {}", result.getErrorString());
+        }
+    }
+
+    released.swap(loopRegion.pcm);
+    loopRegion = LoopRegionCache();
+}
+
+/*
+PCM interleaved vừa decode từ file (frame nguồn [decodePosition, decodePosition + frames)):
+1. Giữ lại phần thuộc [A, B) nếu nối tiếp đoạn đã thu
+2. Ghi vào RingBuffer, trừ phần đuôi [B - crossfade, B) khi cả vùng sẽ có trong cache:
+   đuôi đó được phát từ cache sau khi trộn với đầu vùng
+3. Khi decode tới B: chuyển sang phát từ cache, hoặc quay về A bằng file nếu vùng chưa thu đủ
+   (vd: bật vùng lặp khi đang phát giữa vùng)
+*/
+Result AudioSession::writeSourceFrames(const float* interleaved, size_t frames, bool applySpeed)
+{
+    const int64_t chunkStart = decodePosition;
+    const int64_t chunkEnd = chunkStart + static_cast<int64_t>(frames);
+    decodePosition = chunkEnd;
+
+    if (!loopRegion.enabled)
+    {
+        return writeToRing(interleaved, frames, applySpeed);
+    }
+
+    LoopRegionCache& loop = loopRegion;
+    captureLoopFrames(interleaved, chunkStart, chunkEnd);
+
+    const int64_t seamStart = loop.endFrame - static_cast<int64_t>(loop.crossfadeFrames);
+    const bool cacheComplete = loop.ready ||
+        loop.startFrame + static_cast<int64_t>(loop.captured) >= min(chunkEnd, loop.endFrame);
+    if (!loop.tailPending && cacheComplete && chunkStart <= seamStart && chunkEnd > seamStart)
+    {
+        loop.tailPending = true;
+    }
+    const int64_t cut = loop.tailPending ? seamStart : loop.endFrame;
+
+    if (chunkStart < cut)
+    {
+        Result result = writeToRing(interleaved, static_cast<size_t>(min(chunkEnd, cut) - chunkStart), applySpeed);
+        if (!result.isSuccess())
+        {
+            return result;
+        }
+    }
+
+    if (chunkEnd < loop.endFrame)
+    {
+        return Result::success();
+    }
+
+    // Đã decode tới B
+    if (loop.tailPending)
+    {
+        if (!loop.ready)
+        {
+            finalizeLoopCache();
+        }
+        // Phát tiếp đuôi đã trộn từ cache, liền mạch với đoạn vừa ghi
+        loop.tailPending = false;
+        loop.playingFromCache = true;
+        loop.cursor = loop.frames - loop.crossfadeFrames;
+        decodePosition = seamStart;
+        return Result::success();
+    }
+    return jumpToLoopStart();
+}
+
+void AudioSession::captureLoopFrames(const float* interleaved, int64_t chunkStart, int64_t chunkEnd)
+{
+    LoopRegionCache& loop = loopRegion;
+    if (loop.ready)
+    {
+        return;
+    }
+
+    // Chỉ thu khi đoạn này nối tiếp đúng frame còn thiếu, nếu không thì chờ vòng sau từ A
+    const int64_t next = loop.startFrame + static_cast<int64_t>(loop.captured);
+    if (next < chunkStart || next >= chunkEnd || next >= loop.endFrame)
+    {
+        return;
+    }
+
+    const size_t count = static_cast<size_t>(min(chunkEnd, loop.endFrame) - next);
+    memcpy(loop.pcm.data() + loop.captured * channels,
+           interleaved + (next - chunkStart) * channels,
+           count * channels * sizeof(float));
+    loop.captured += count;
+}
+
+/*
+Vùng đã thu đủ: trộn đuôi [B - X, B) với đầu vùng [A, A + X) (equal-power vì hai đoạn không tương quan).
+Sau khi trộn, mỗi vòng phát [A + X, B) từ cache: đuôi đã chứa phần đầu vùng nên đường nối không bị gãy.
+*/
+void AudioSession::finalizeLoopCache()
+{
+    LoopRegionCache& loop = loopRegion;
+    const size_t fade = loop.crossfadeFrames;
+    float* tail = loop.pcm.data() + (loop.frames - fade) * channels;
+    const float* head = loop.pcm.data();
+
+    for (size_t i = 0; i < fade; i++)
+    {
+        const float t = (static_cast<float>(i) + 0.5f) / static_cast<float>(fade);
+        const float angle = t * static_cast<float>(M_PI) * 0.5f;
+        const float fadeOut = cos(angle);
+        const float fadeIn = sin(angle);
+        for (size_t c = 0; c < channels; c++)
+        {
+            const size_t s = i * channels + c;
+            tail[s] = tail[s] * fadeOut + head[s] * fadeIn;
+        }
+    }
+    loop.ready = true;
+    debugPrint("Loop region cached: {} frames", loop.frames);
+}
+
+/*
+Quay về đầu vùng lặp mà không làm rỗng RingBuffer.
+Cache đã sẵn sàng: bỏ qua phần đầu đã trộn vào đuôi, ngược lại decode lại từ file và thu vùng.
+*/
+Result AudioSession::jumpToLoopStart()
+{
+    LoopRegionCache& loop = loopRegion;
+    loop.tailPending = false;
+    if (loop.ready)
+    {
+        loop.playingFromCache = true;
+        loop.cursor = loop.crossfadeFrames;
+        decodePosition = loop.startFrame + static_cast<int64_t>(loop.cursor);
+        clock.onDiscontinuity(decodePosition, timing.speed);
+        return Result::success();
+    }
+
+    loop.captured = 0;
+    return seekGapless(loop.startFrame);
+}
+
+/*
+Nạp RingBuffer từ cache của vùng lặp (không đọc file, không decode).
+Time-stretch vẫn áp dụng trên PCM gốc nên đổi tốc độ khi đang lặp không phải thu lại vùng.
+*/
+Result AudioSession::fillFromLoopCache()
+{
+    LoopRegionCache& loop = loopRegion;
+    const size_t targetFrames = highWatermark.load();
+    const size_t length = loop.frames;
+
+    while (buffer->availableForRead() < targetFrames &&
+           buffer->availableForWrite() >= MIN_WRITE_SPACE)
+    {
+        if (loop.cursor >= length)
+        {
+            Result result = jumpToLoopStart();
+            if (!result.isSuccess())
+            {
+                return result;
+            }
+        }
+
+        const size_t count = min(FRAME_SIZE, length - loop.cursor);
+        Result result = writeToRing(loop.pcm.data() + loop.cursor * channels, count, true);
+        if (!result.isSuccess())
+        {
+            return result;
+        }
+        loop.cursor += count;
+        decodePosition = loop.startFrame + static_cast<int64_t>(loop.cursor);
+    }
+    return Result::success();
+}
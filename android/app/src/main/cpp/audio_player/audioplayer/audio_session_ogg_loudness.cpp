@@ -0,0 +1,108 @@
+#include "audio_session.hpp"
+#include "loudness_meter.hpp"
+#include <cstring>
+
+using namespace std;
+
+/*
+Trộn PCM decode ra thành stereo giống hệt mixer của AudioLayer (mọi stem volume 1.0):
+stream stereo vào L/R, stream mono nhân đôi sang hai kênh.
+Nhờ vậy loudness đo được là loudness thực sự phát ra loa, kể cả file mono.
+*/
+static void mixToStereo(const float* pcm, const OpusHeader& header, int decodedChannels,
+                        float* stereo, size_t frames)
+{
+    memset(stereo, 0, frames * 2 * sizeof(float));
+    for (int s = 0; s < header.nb_streams; s++)
+    {
+        const int first = s + min(s, header.nb_coupled);
+        const bool coupled = s < header.nb_coupled;
+        for (size_t i = 0; i < frames; i++)
+        {
+            const float* frame = pcm + i * decodedChannels + first;
+            stereo[i * 2] += frame[0];
+            stereo[i * 2 + 1] += coupled ? frame[1] : frame[0];
+        }
+    }
+}
+
+/*
+Decode toàn bộ file bằng OggOpusFile riêng (không đụng tới session đang phát) và đo
+integrated loudness theo EBU R128. Kết quả chưa tính OpusHeader::gain.
+*/
+Result AudioSession::measureLoudness(const string& fileName, double& loudness)
+{
+    auto file = make_unique<OggOpusFile>();
+    if (!file->source.open(fileName))
+    {
+        return Result::error(ErrorCode::FileNotFound, "Cannot open file");
+    }
+
+    ogg_page og;
+    ogg_packet op;
+    if (file->source.nextPage(&og) != 1)
+    {
+        return Result::error(ErrorCode::OggInvalidFormat, "No Ogg page found");
+    }
+    file->serialno = ogg_page_serialno(&og);
+    if (ogg_stream_init(&file->os, file->serialno) < 0)
+    {
+        return Result::error(ErrorCode::OggStreamError, "Failed to init ogg stream");
+    }
+    ogg_stream_pagein(&file->os, &og);
+    if (ogg_stream_packetout(&file->os, &op) != 1)
+    {
+        return Result::error(ErrorCode::OggPacketCorrupt, "Failed to read header packet");
+    }
+
+    Result result = parseOpusHeader(&op, file->header);
+    if (result.isSuccess())
+    {
+        result = initOpusDecoder(*file);
+    }
+    if (!result.isSuccess())
+    {
+        return result;
+    }
+
+    vector<float> pcm(MAX_FRAME_SIZE * MAX_DECODE_CHANNELS);
+    vector<float> stereo(MAX_FRAME_SIZE * 2);
+    LoudnessMeter meter;
+    int64_t skip = file->header.preskip;
+    int64_t packetCount = 0;
+
+    while (file->source.nextPage(&og) == 1)
+    {
+        if (ogg_page_serialno(&og) != file->serialno)
+        {
+            continue;
+        }
+        ogg_stream_pagein(&file->os, &og);
+
+        int status;
+        while ((status = ogg_stream_packetout(&file->os, &op)) != 0)
+        {
+            // Packet đầu tiên sau OpusHead là OpusTags, packet hỏng thì bỏ qua
+            if (status < 0 || packetCount++ == 0)
+            {
+                continue;
+            }
+            int frames = file->decode(op.packet, op.bytes, pcm.data(), MAX_FRAME_SIZE);
+            if (frames <= 0)
+            {
+                continue;
+            }
+
+            const int64_t skipped = min<int64_t>(skip, frames);
+            skip -= skipped;
+            const size_t count = static_cast<size_t>(frames - skipped);
+            mixToStereo(pcm.data() + skipped * file->decodedChannels, file->header,
+                        file->decodedChannels, stereo.data(), count);
+            meter.process(stereo.data(), count);
+        }
+    }
+
+    loudness = meter.integratedLoudness();
+    debugPrint("Integrated loudness of {}: {} LUFS", fileName, loudness);
+    return Result::success();
+}
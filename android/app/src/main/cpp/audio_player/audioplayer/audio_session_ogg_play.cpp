@@ -1,5 +1,8 @@
 #include "audio_session.hpp"
 #include "ring_buffer.hpp"
+#include "audio_player.hpp"
+#include "rt_alloc_guard.hpp"
+#include "pcm_interleave.hpp"
 #include <cstring>
 #include <chrono>
 #include <mutex>
@@ -14,12 +17,7 @@ Result AudioSession::decodeAndResample(
     bool applySpeed)
 {
     // Decode packet opus
-    int frames = opus_decode_float(oggFile->decoder,
-                                 packet,
-                                 bytes,
-                                 pcmBuffer.get(),
-                                 5760,
-                                 0);
+    int frames = oggFile->decode(packet, bytes, pcmBuffer.get(), MAX_FRAME_SIZE);
                                  
     if (frames < 0) {
         return Result::error(ErrorCode::OpusDecodeError, "Failed to decode Opus packet");
@@ -39,118 +37,134 @@ Result AudioSession::decodeAndResample(
         samplesToProcess = maxSamples;
     }
     
-    // Chuẩn bị dữ liệu mono cho RingBuffer
-    float* monoBuffer = new float[samplesToProcess];
-    
-    if (oggFile->header.channels == 1) {
-        // Sao chép trực tiếp cho mono, bỏ qua skipSamples
-        memcpy(monoBuffer, pcmBuffer.get() + skipSamples, samplesToProcess * sizeof(float));
-    } else {
-        // Chuyển đổi stereo thành mono bằng cách lấy trung bình giá trị của 2 kênh
-        const float* pTemp = pcmBuffer.get() + skipSamples * 2;        
-        for (int i = 0; i < samplesToProcess; i++) {
-            float left = *pTemp++;
-            float right = *pTemp++;
-            monoBuffer[i] = (left + right) * 0.5f; // Lấy trung bình của 2 kênh
-        }
+    // Số kênh decode bằng số kênh của RingBuffer: ghi thẳng PCM interleaved, bỏ qua skipSamples
+    return writeSourceFrames(pcmBuffer.get() + skipSamples * channels, samplesToProcess, applySpeed);
+}
+
+Result AudioSession::writeToRing(const float* interleaved, size_t frames, bool applySpeed)
+{
+    if (frames == 0)
+    {
+        return Result::success();
     }
-    
+
     // Resample dữ liệu nếu speed khác 1.0 và cần áp dụng speed
     if (applySpeed && timing.speed != 1.0)
     {
-        // Tính số lượng output frames sau khi resample
-        size_t output_frames = static_cast<size_t>(samplesToProcess / timing.speed);
-        
-        // Tạo buffer tạm cho dữ liệu đã resample
-        float* resampledBuffer = new float[output_frames];
-        
-        // Sử dụng hàm resampleRubberBand mới chỉ hỗ trợ mono
+        // RubberBand nhận PCM planar: mono dùng thẳng buffer, nhiều kênh thì tách kênh trước
+        const float* in[MAX_DECODE_CHANNELS] = {interleaved};
+        float* out[MAX_DECODE_CHANNELS] = {stretchScratch.get()};
+        if (channels > 1)
+        {
+            float* planar[MAX_DECODE_CHANNELS];
+            for (size_t c = 0; c < channels; c++)
+            {
+                planar[c] = planarIn.get() + c * MAX_FRAME_SIZE;
+                in[c] = planar[c];
+                out[c] = planarOut.get() + c * MAX_STRETCH_FRAMES;
+            }
+            pcm::deinterleave(interleaved, planar, channels, frames);
+        }
+
+        // RubberBand trả ra số frame xấp xỉ frames / speed, lấy hết những gì có sẵn
+        size_t retrieved = 0;
         Result result = resampleRubberBand(
-            samplesToProcess,
-            output_frames,
-            monoBuffer,
-            resampledBuffer
+            frames,
+            MAX_STRETCH_FRAMES,
+            in,
+            out,
+            retrieved
         );
         
         if (!result.isSuccess())
         {
             debugPrint("Resampling error during decode: {}", result.getErrorString());
-            delete[] monoBuffer;
-            delete[] resampledBuffer;
             return result;
         }
+
+        if (channels > 1)
+        {
+            pcm::interleave(out, stretchScratch.get(), channels, retrieved);
+        }
         
-        // Ghi dữ liệu đã resample vào buffer (chỉ dùng cho mono)
-        size_t framesWritten = buffer->write(resampledBuffer, output_frames);
+        // Chỉ ghi đúng số frame RubberBand đã trả ra
+        clock.onFramesWritten(retrieved, timing.speed);
+        size_t framesWritten = buffer->write(stretchScratch.get(), retrieved);
         
-        if (framesWritten < output_frames)
+        if (framesWritten < retrieved)
         {
-            delete[] monoBuffer;
-            delete[] resampledBuffer;
+            stats.ring.addOverflow(retrieved - framesWritten);
             return Result::error(ErrorCode::BufferOverflow, "Buffer overflow during decode");
         }
-        
-        // Giải phóng bộ nhớ
-        delete[] resampledBuffer;
     }
     else
     {
         // Ghi trực tiếp vào buffer nếu speed = 1.0 hoặc không áp dụng speed
-        size_t framesWritten = buffer->write(monoBuffer, samplesToProcess);
+        clock.onFramesWritten(frames, 1.0);
+        size_t framesWritten = buffer->write(interleaved, frames);
         
-        if (framesWritten < samplesToProcess)
+        if (framesWritten < frames)
         {
-            delete[] monoBuffer;
+            stats.ring.addOverflow(frames - framesWritten);
             return Result::error(ErrorCode::BufferOverflow, "Buffer overflow during decode");
         }
     }
 
-    // Giải phóng bộ nhớ sau khi sử dụng
-    delete[] monoBuffer;
-    
     return Result::success();
 }
 
+/*
+Decode cho đến khi RingBuffer đạt high watermark (hoặc không còn đủ chỗ cho một packet).
+Được gọi từ luồng decode nền hoặc từ seek/play, luôn trong khi giữ decodeMutex.
+*/
 Result AudioSession::fillBuffer()
 {
-  // Pre-allocate buffer cho việc đọc file
-  char *readBuffer = ogg_sync_buffer(&oggFile->oy, OGG_BUFFER_SIZE);
-  if (!readBuffer)
+  const size_t targetFrames = highWatermark.load();
+
+  // Vùng lặp A-B đã nằm trong bộ nhớ: không đọc file
+  if (loopRegion.playingFromCache)
   {
-    return Result::error(ErrorCode::MemoryAllocFailed, "Failed to allocate read buffer");
+    return fillFromLoopCache();
   }
 
-  // Đọc và decode cho đến khi buffer đầy 50%
-  while (buffer->availableForWrite() >= RING_BUFFER_SIZE / 2)
+  while (buffer->availableForRead() < targetFrames &&
+         buffer->availableForWrite() >= MIN_WRITE_SPACE)
   {
+    if (loopRegion.playingFromCache)
+    {
+      // Vừa decode tới B, phần còn lại lấy từ cache
+      return fillFromLoopCache();
+    }
+
     // Đọc packet từ ogg stream
     ogg_packet op;
     while (ogg_stream_packetout(&oggFile->os, &op) != 1)
     {
-      // Đọc dữ liệu từ file
-      int bytes = fread(readBuffer, 1, OGG_BUFFER_SIZE, oggFile->fin);
-      if (bytes == 0)
-      {
-        debugPrint("fillBuffer EOF {}", timing.totalLoop);
-        // EOF - quay lại đầu file nếu loop
-        return Result::success(); // Hết file
-      }
-      ogg_sync_wrote(&oggFile->oy, bytes);
-
-      // Xử lý tất cả các page trong buffer
+      // Lấy page tiếp theo trực tiếp từ vùng mmap
       ogg_page og;
-      while (ogg_sync_pageout(&oggFile->oy, &og) == 1)
+      if (oggFile->source.nextPage(&og) != 1)
       {
-        ogg_stream_pagein(&oggFile->os, &og);
-
-        // Cập nhật currentTime
-        ogg_int64_t granulepos = ogg_page_granulepos(&og);
-        if (granulepos >= 0)
+        debugPrint("fillBuffer EOF {}", timing.totalLoop);
+        if (loopRegion.enabled)
         {
-          timing.currentTime = static_cast<uint32_t>(
-              ((granulepos - oggFile->header.preskip) * 1000.0) / SAMPLE_RATE);
+          // File hỏng/ngắn hơn thời lượng khai báo: quay về A thay vì dừng
+          Result result = jumpToLoopStart();
+          if (!result.isSuccess())
+          {
+            return result;
+          }
+          if (loopRegion.playingFromCache)
+          {
+            return fillFromLoopCache();
+          }
+          continue;
         }
+        // EOF - luồng decode chờ seek/loop tiếp theo
+        decodeEof.store(true);
+        return Result::success(); // Hết file
       }
+
+      ogg_stream_pagein(&oggFile->os, &og);
     }
 
     // Kiểm tra kích thước packet
@@ -186,86 +200,98 @@ Result AudioSession::fillBuffer()
 }
 
 /*
-Hàm callback xử lý audio cho định dạng Ogg:
+Hàm callback xử lý audio cho định dạng Ogg (chạy trên thread real-time của AudioLayer):
 
-1. Xử lý dữ liệu PCM:
-   - Nếu speed = 1.0: Đọc trực tiếp từ buffer vào output
-   - Nếu speed != 1.0:
-     + Tính số lượng input frames cần thiết (input_frames = output_frames * speed)
-     + Đọc đủ dữ liệu vào buffer tạm
-     + Thực hiện resampling để tạo ra đúng số output frames yêu cầu
+1. Chỉ copy dữ liệu PCM đã được luồng decode nền chuẩn bị sẵn trong RingBuffer.
+   Không đọc file, không decode, không time-stretch ở đây.
+   - Khi RingBuffer đang được làm mới (seek/loop) thì phát im lặng
+   - Khi dữ liệu xuống dưới low watermark thì đánh thức luồng decode (không khóa)
+   - Đếm số lần underrun khi không đủ dữ liệu
 
-2. Cập nhật timing và callback:
-   - Tính thời gian phát thực tế dựa trên tốc độ phát
+2. Cập nhật đồng hồ phát và callback:
+   - Thời gian phát được tính từ số frame đã đọc khỏi RingBuffer (PlaybackClock),
+     không phụ thuộc steady_clock nên không trôi khi pause/resume hay đổi tốc độ
    - Gọi callback để thông báo tiến độ phát
 
 3. Xử lý loop và kết thúc:
-   - Kiểm tra nếu đã phát hết duration
-   - Xử lý loop hoặc dừng phát tùy theo cấu hình
+   - Chỉ đọc đúng số frame còn lại tới endTime
+   - Khi chạm endTime: báo cho luồng decode, luồng decode seek lại để phát lặp hoặc dừng phát.
+     Callback chỉ đọc bản sao atomic của endTime/seekTime, không đọc timing
 
-Trả về: Số frames đã xử lý (output_frames) hoặc 0 nếu có lỗi
+Trả về: Số frames đã copy vào pcm_to_speaker
 */
 size_t AudioSession::audioCallbackOgg(float* pcm_to_speaker, size_t frames)
 {
-    if (state.load() != PlayState::PLAYING)
+    RT_NO_ALLOC_SCOPE("AudioSession::audioCallbackOgg");
+
+    // Khi PAUSED bus đã bị mute: mixer vẫn đọc tiếp trong lúc fade out (~10ms) rồi mới ngừng gọi
+    const PlayState current = state.load();
+    if (current != PlayState::PLAYING && current != PlayState::PAUSED)
         return 0;
-    
-    // Không cần nhân với số kênh vì API mới đã xử lý từng kênh riêng biệt
-    size_t framesRead = buffer->read(pcm_to_speaker, frames);
 
-    if (!timing.hasStartTime) {
-        timing.startTime = chrono::steady_clock::now();
-        timing.speedChangeTime = timing.startTime;
-        timing.hasStartTime = true;
-        timing.accumulatedTime = 0.0;
+    // Đánh dấu callback đang đọc RingBuffer trước khi kiểm tra cờ flushing,
+    // flushBuffer() bật cờ rồi chờ callbackActive = false trước khi xóa buffer
+    callbackActive.store(true);
+    if (flushing.load() || endReached.load(memory_order_acquire)) {
+        callbackActive.store(false);
+        return 0;
     }
 
-    // Tính thời gian từ lần start/resume gần nhất
-    auto now = chrono::steady_clock::now();
-    auto timeSinceSpeedChange = chrono::duration_cast<chrono::milliseconds>(
-        now - timing.speedChangeTime).count();
-    
-    // Tính thời gian phát thực tế (real playback time)
-    uint32_t currentPlayTime = static_cast<uint32_t>(
-        timing.accumulatedTime + (timeSinceSpeedChange * timing.speed)
-    );
+    // Khi lặp A-B luồng decode tự nối B -> A trong RingBuffer, callback không xử lý endTime
+    const bool regionLoop = loopRegionActive.load(memory_order_acquire);
+    const int64_t endFrame = callbackEndFrame.load(memory_order_acquire);
+    const size_t framesUntilEnd = regionLoop ? frames : clock.outputFramesUntil(endFrame);
+    const bool drained = !regionLoop && decodeEof.load() && buffer->availableForRead() == 0;
+
+    // Kiểm tra kết thúc
+    if (framesUntilEnd == 0 || drained) {
+        // Phát lặp (seek) hoặc dừng do luồng decode quyết định, callback phát im lặng cho đến khi xong
+        callbackActive.store(false);
+        endReached.store(true, memory_order_release);
+        wakeDecoder();
+        return 0;
+    }
+
+    size_t framesRead = buffer->read(pcm_to_speaker, min(frames, framesUntilEnd));
+    clock.onFramesConsumed(framesRead);
 
-    // Cập nhật callback với thời gian hiện tại
+    if (framesRead < frames && framesRead < framesUntilEnd && !decodeEof.load()) {
+        stats.ring.addUnderflow(frames - framesRead);
+    }
+
+    if (buffer->availableForRead() < lowWatermark.load(memory_order_relaxed)) {
+        wakeDecoder();
+    }
+
+    // Cập nhật callback với vị trí đang phát ra loa
     if (this->playbackCallback) {
+        // Callback của ứng dụng nằm ngoài phạm vi kiểm tra cấp phát của engine
+        RT_ALLOW_ALLOC_SCOPE();
+        uint32_t currentTime = getPlaybackPositionMs();
+        const uint32_t seekTime = callbackSeekTime.load(memory_order_relaxed);
         this->playbackCallback(PlaybackInfo {
-            timing.seekTime + currentPlayTime,  // Vị trí tổng từ đầu file
-            currentPlayTime,                    // Thời gian đã phát
-            oggFile->file_duration              // Tổng thời lượng file
+            currentTime,                                 // Vị trí tổng từ đầu file
+            currentTime > seekTime ? currentTime - seekTime : 0, // Thời gian đã phát
+            oggFile->file_duration                                     // Tổng thời lượng file
         });
     }
 
-    // Kiểm tra kết thúc
-    if (currentPlayTime >= timing.duration) {
-        debugPrint("audioCallbackOgg current loop: {}/{}", timing.currentLoop + 1, timing.totalLoop);
-        debugPrint("currentPlayTime: {} duration: {} speed: {}", 
-                  currentPlayTime, timing.duration, timing.speed);
+    callbackActive.store(false);
+    return framesRead;
+}
 
-        if (timing.totalLoop == 0 || timing.currentLoop < timing.totalLoop - 1) {
-            timing.currentLoop++;
-            if (timing.target_pcm_pos == 0) {
-                seekBeginOfFile();
-            } else {
-                preroll_seek(timing.prerollFilePos, timing.prerollGranulePos, timing.target_pcm_pos);
-            }
-            return framesRead;
-        } else {
-            debugPrint("File finished");
-            stop();
-            return framesRead;
-        }
-    }
-    
-    if (framesRead < frames) {
-        fillBuffer();
-        // Đọc thêm dữ liệu vào phần còn lại của buffer
-        size_t additionalFrames = buffer->read(pcm_to_speaker + framesRead, frames - framesRead);
-        framesRead += additionalFrames;
+int64_t AudioSession::getPlaybackPositionFrames() const
+{
+    // Khi không phát, dữ liệu còn trong buffer của thiết bị đã phát hết nên không trừ độ trễ
+    double latencyFrames = 0.0;
+    if (state.load() == PlayState::PLAYING && player) {
+        latencyFrames = player->getAudioLayer()->getOutputLatencyMillis() * SAMPLE_RATE / 1000.0;
     }
+    return clock.presentedPosition(latencyFrames);
+}
 
-    return framesRead;
+uint32_t AudioSession::getPlaybackPositionMs() const
+{
+    int64_t frames = getPlaybackPositionFrames();
+    return frames > 0 ? static_cast<uint32_t>(frames * 1000 / SAMPLE_RATE) : 0;
 }
\ No newline at end of file
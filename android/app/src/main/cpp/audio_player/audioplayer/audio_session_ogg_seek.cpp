@@ -1,15 +1,33 @@
 #include "audio_session.hpp"
 #include "ring_buffer.hpp"
 #include <chrono>
+#include <mutex>
 
 using namespace std;
+
+// Decode trước điểm seek để bộ decode Opus hội tụ (SILK/CELT cần vài packet trước đó)
+static constexpr int PREROLL_MS = 40;
+
 /*
 Tìm kiếm page trong page_table có granule_pos >= position và page trước đó có granule_pos < position.
 Trả index của page tìm được, file_offset của page tìm được, granule_pos của page trước đó.
+Nếu luồng index chưa đi tới position thì chờ cho đến khi page đó được index.
 */
 OggPageStartPos AudioSession::findPageStartPos(OggOpusFile *opusFile, ogg_int64_t position)
 {
-    if (!opusFile || opusFile->page_table.empty())
+    if (!opusFile)
+    {
+        return {0, -1, -1};
+    }
+
+    unique_lock<mutex> lock(indexMutex);
+    indexCondition.wait(lock, [&] {
+        return indexComplete.load(memory_order_acquire) ||
+               !indexThreadRunning.load() ||
+               (!opusFile->page_table.empty() && opusFile->page_table.back().granule_pos >= position);
+    });
+
+    if (opusFile->page_table.empty())
     {
         return {0, -1, -1}; // Trả về giá trị invalid
     }
@@ -39,23 +57,28 @@ Seek đến đầu file, đọc buffer ra
 */
 Result AudioSession::seekBeginOfFile()
 {
-    buffer->clear();
-    timing.hasStartTime = false;
+    flushBuffer();
+    // fillBuffer ghi cả preskip vào RingBuffer, frame đầu tiên là -preskip
+    resetPlaybackPosition(-static_cast<int64_t>(oggFile->header.preskip));
     timing.seekTime = 0;
     timing.target_pcm_pos = oggFile->header.preskip;
+    publishPlaybackWindow();
+    decodeEof.store(false);
 
     // Seek về đầu file
-    if (fseek(oggFile->fin, 0, SEEK_SET) != 0)
+    if (!oggFile->source.seek(0))
     {
+        flushing.store(false);
         return Result::error(ErrorCode::SeekError, "Failed to seek to beginning");
     }
 
     // Reset decoder states
-    ogg_sync_reset(&oggFile->oy);
     ogg_stream_reset(&oggFile->os);
 
-    // Fill buffer và return
-    return fillBuffer();
+    // Fill buffer, sau đó cho phép callback đọc lại RingBuffer
+    Result result = fillBuffer();
+    flushing.store(false);
+    return result;
 }
 
 /*
@@ -79,19 +102,11 @@ Result AudioSession::preroll_decode(ogg_int64_t target_pcm_pos, ogg_int64_t prer
 
         if (result == 0)
         {
-            // Cần thêm dữ liệu
-            char *ogg_buffer = ogg_sync_buffer(&oggFile->oy, 4096);
-            size_t bytes = fread(ogg_buffer, 1, 4096, oggFile->fin);
-            if (bytes == 0)
+            // Cần thêm dữ liệu: lấy page tiếp theo từ vùng mmap
+            if (oggFile->source.nextPage(&oggFile->og) != 1)
             {
                 return Result::error(ErrorCode::FileReadError, "Unexpected EOF during preroll");
             }
-            ogg_sync_wrote(&oggFile->oy, bytes);
-
-            if (ogg_sync_pageout(&oggFile->oy, &oggFile->og) != 1)
-            {
-                return Result::error(ErrorCode::OggSyncError, "Failed to sync page during preroll");
-            }
 
             if (ogg_stream_pagein(&oggFile->os, &oggFile->og) < 0)
             {
@@ -119,12 +134,7 @@ Result AudioSession::preroll_decode(ogg_int64_t target_pcm_pos, ogg_int64_t prer
         }
 
         // Decode packet opus
-        int frames = opus_decode_float(oggFile->decoder,
-                                       oggFile->op.packet,
-                                       oggFile->op.bytes,
-                                       pcmBuffer.get(),
-                                       5760,
-                                       0);
+        int frames = oggFile->decode(oggFile->op.packet, oggFile->op.bytes, pcmBuffer.get(), MAX_FRAME_SIZE);
 
         if (frames < 0)
         {
@@ -149,28 +159,26 @@ Result AudioSession::preroll_decode(ogg_int64_t target_pcm_pos, ogg_int64_t prer
     }
 }
 /*
-Seek file stream đến offset của preroll_page
+Seek đến offset của preroll_page trong vùng mmap
 Reset trạng thái của Ogg decoder
-Lấy buffer tạm từ ogg sync state
 Thực hiện preroll
 Fill thêm dữ liệu vào buffer cho đến khi đạt 50% buffer size
 */
 Result AudioSession::preroll_seek(int64_t prerollFilePos, int64_t prerollGranulePos, int64_t target_pcm_pos)
 {
-    // Seek file stream đến offset của preroll_page
-    if (fseek(oggFile->fin, prerollFilePos, SEEK_SET) != 0)
+    decodeEof.store(false);
+
+    // Seek đến offset của preroll_page: chỉ là đặt lại con trỏ trong vùng mmap
+    if (!oggFile->source.seek(prerollFilePos))
     {
         return Result::error(ErrorCode::SeekError, "Failed to seek to preroll position");
     }
 
     // Reset trạng thái của Ogg decoder
-    ogg_sync_reset(&oggFile->oy);
     ogg_stream_reset(&oggFile->os);
 
-    // Lấy buffer tạm từ ogg sync state
-    char *ogg_buffer = ogg_sync_buffer(&oggFile->oy, 4096);
-    size_t bytes = fread(ogg_buffer, 1, 4096, oggFile->fin);
-    ogg_sync_wrote(&oggFile->oy, bytes);
+    // Frame đầu tiên được ghi vào RingBuffer chính là target_pcm_pos
+    resetPlaybackPosition(target_pcm_pos - oggFile->header.preskip);
 
     // Thực hiện preroll
     Result prerollResult = preroll_decode(target_pcm_pos, prerollGranulePos);
@@ -185,26 +193,73 @@ Result AudioSession::preroll_seek(int64_t prerollFilePos, int64_t prerollGranule
     {
         return fillResult;
     }
-    // 8. Cập nhật trạng thái
-    // Reset các biến theo dõi thời gian
-    timing.elapsedTime = 0;
-    timing.startTime = chrono::steady_clock::now();
-    timing.hasStartTime = true;
-
     // Debug thông tin seek
     debugPrint("Seek completed: time={}, buffer_size={}",
                timing.seekTime, this->buffer->availableForRead());
 
     return Result::success();
 }
+/*
+Đặt lại đồng hồ phát khi RingBuffer vừa được làm rỗng.
+Vùng lặp A-B chưa decode đủ phải thu lại từ đầu vì đoạn đã giữ không còn liên tục.
+*/
+void AudioSession::resetPlaybackPosition(int64_t sourceFrame)
+{
+    clock.reset(sourceFrame);
+    decodePosition = sourceFrame;
+    loopRegion.playingFromCache = false;
+    loopRegion.tailPending = false;
+    if (!loopRegion.ready)
+    {
+        loopRegion.captured = 0;
+    }
+}
+
+/*
+Chuyển vị trí decode tới sourceFrame mà không làm rỗng RingBuffer:
+phần đã có trong RingBuffer vẫn được phát hết, frame của sourceFrame nối ngay sau đó.
+Dùng cho phát lặp A-B (quay về A khi chưa có cache, hoặc rời cache khi bỏ vùng lặp).
+Người gọi phải giữ decodeMutex.
+*/
+Result AudioSession::seekGapless(int64_t sourceFrame)
+{
+    const ogg_int64_t target_pcm_pos = sourceFrame + oggFile->header.preskip;
+    const ogg_int64_t preroll_pos = max<ogg_int64_t>(0, target_pcm_pos - (PREROLL_MS * SAMPLE_RATE) / 1000);
+
+    OggPageStartPos pageStartPos = findPageStartPos(oggFile.get(), preroll_pos);
+    if (pageStartPos.file_offset < 0 || !oggFile->source.seek(pageStartPos.file_offset))
+    {
+        return Result::error(ErrorCode::SeekError, "Failed to find preroll page");
+    }
+    ogg_stream_reset(&oggFile->os);
+    decodeEof.store(false);
+
+    clock.onDiscontinuity(sourceFrame, 1.0);
+    decodePosition = sourceFrame;
+    loopRegion.playingFromCache = false;
+    loopRegion.tailPending = false;
+
+    return preroll_decode(target_pcm_pos, pageStartPos.granule_pos);
+}
+
 Result AudioSession::seekToTime(uint32_t timeMs)
+{
+    lock_guard<mutex> lock(decodeMutex);
+    return seekToTimeLocked(timeMs);
+}
+
+/*
+Seek đến thời điểm timeMs, người gọi phải giữ decodeMutex
+*/
+Result AudioSession::seekToTimeLocked(uint32_t timeMs)
 {
     // 1. Kiểm tra điều kiện tiên quyết
-    // - Kiểm tra trạng thái hợp lệ (PLAYING, PAUSED, READY)
+    // - Kiểm tra trạng thái hợp lệ (PLAYING, PAUSED, READY, STOPPED: playAt phát lại từ seekTime)
     auto currentState = state.load();
     if (currentState != PlayState::PLAYING &&
         currentState != PlayState::PAUSED &&
-        currentState != PlayState::READY)
+        currentState != PlayState::READY &&
+        currentState != PlayState::STOPPED)
     {
         return Result::error(ErrorCode::NotReady, "Invalid state for seeking");
     }
@@ -216,13 +271,12 @@ Result AudioSession::seekToTime(uint32_t timeMs)
 
     // - Kiểm tra và giới hạn thời gian seek không vượt quá độ dài file
     timeMs = min(timeMs, this->oggFile->file_duration);
-    timing.seekTime = timeMs;
     // 2. Chuẩn bị buffer và trạng thái
-    // - Xóa buffer hiện tại
+    // - Xóa buffer hiện tại (callback phát im lặng cho đến khi seek xong)
     // - Reset các biến trạng thái
-    buffer->clear();
-    timing.hasStartTime = false;  // Reset thời điểm bắt đầu
-    timing.accumulatedTime = 0.0; // Reset accumulated time
+    flushBuffer();
+    timing.seekTime = timeMs;
+    publishPlaybackWindow();
 
     // 3. Tính toán vị trí seek
     // - Chuyển đổi thời gian (ms) sang số mẫu (samples)
@@ -239,8 +293,7 @@ Result AudioSession::seekToTime(uint32_t timeMs)
     debugPrint("seekToTime={}  target_pcm_pos={}", timeMs, timing.target_pcm_pos);
 
     // 4. Tìm page chứa preroll_granulepos
-    // Tính số samples cho preroll (80ms)
-    const int PREROLL_MS = 40;
+    // Tính số samples cho preroll
     int64_t preroll_samples = (PREROLL_MS * SAMPLE_RATE) / 1000;
 
     // Tính preroll_granulepos
@@ -253,6 +306,7 @@ Result AudioSession::seekToTime(uint32_t timeMs)
 
     if (pageStartPos.file_offset < 0)
     {
+        flushing.store(false);
         return Result::error(ErrorCode::SeekError, "Failed to find preroll page");
     }
     timing.prerollFilePos = pageStartPos.file_offset;
@@ -265,7 +319,9 @@ Result AudioSession::seekToTime(uint32_t timeMs)
                pageStartPos.granule_pos,
                pageStartPos.file_offset);
 
-    return preroll_seek(timing.prerollFilePos, timing.prerollGranulePos, timing.target_pcm_pos);
+    Result result = preroll_seek(timing.prerollFilePos, timing.prerollGranulePos, timing.target_pcm_pos);
+    flushing.store(false);
+    return result;
 }
 
 /*
@@ -276,6 +332,7 @@ Phát âm thanh khi file ogg đã được load thành công
 */
 Result AudioSession::playAt(uint32_t seekTime, uint32_t duration, int loop)
 {
+    lock_guard<mutex> lock(decodeMutex);
     auto currentState = state.load();
     if (currentState != PlayState::READY &&
         currentState != PlayState::STOPPED)
@@ -297,10 +354,7 @@ Result AudioSession::playAt(uint32_t seekTime, uint32_t duration, int loop)
     // Reset các biến timing
     timing.totalLoop = loop;
     timing.currentLoop = 0;
-    timing.hasStartTime = false;
-    timing.accumulatedTime = 0.0;                         // Reset accumulated time
-    timing.speed = 1.0;                                   // Reset speed về mặc định khi bắt đầu phát mới
-    timing.speedChangeTime = chrono::steady_clock::now(); // Reset thời điểm thay đổi speed
+    timing.speed = 1.0; // Reset speed về mặc định khi bắt đầu phát mới
 
     // Nếu duration = 0, phát đến hết file
     if (duration == 0)
@@ -316,11 +370,13 @@ Result AudioSession::playAt(uint32_t seekTime, uint32_t duration, int loop)
     }
     timing.duration = timing.endTime - seekTime; // Gán lại thời lượng phát âm thanh
     timing.seekTime = seekTime;
+    endReached.store(false, memory_order_release);
+    publishPlaybackWindow();
 
     if (seekTime > 0)
     {
         // Thực hiện seek - buffer đã được fill trong seekToTime
-        Result seekResult = seekToTime(seekTime);
+        Result seekResult = seekToTimeLocked(seekTime);
         if (!seekResult.isSuccess())
         {
             setState(PlayState::ERROR);
@@ -329,8 +385,8 @@ Result AudioSession::playAt(uint32_t seekTime, uint32_t duration, int loop)
     }
     else
     {
-        // Fill buffer trước khi bắt đầu phát
-        Result result = fillBuffer();
+        // Quay về đầu file và fill buffer trước khi bắt đầu phát
+        Result result = seekBeginOfFile();
         if (!result.isSuccess())
         {
             setState(PlayState::ERROR);
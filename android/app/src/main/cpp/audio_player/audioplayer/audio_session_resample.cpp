@@ -14,18 +14,27 @@ void AudioSession::initResample() {
                   RubberBand::RubberBandStretcher::OptionWindowShort |
                   RubberBand::RubberBandStretcher::OptionThreadingAlways;
     
-    // Luôn khởi tạo với 1 kênh (mono)
-    rubberBand = new RubberBand::RubberBandStretcher(SAMPLE_RATE, 1, options);
+    // Stereo: xử lý hai kênh chung (OptionChannelsTogether) để giữ nguyên hình ảnh stereo.
+    // Nhiều stem: mỗi kênh độc lập, các stem không có quan hệ L/R với nhau
+    if (channels == 2) {
+        options |= RubberBand::RubberBandStretcher::OptionChannelsTogether;
+    }
+    rubberBand = new RubberBand::RubberBandStretcher(SAMPLE_RATE, channels, options);
     if (!rubberBand) {
         debugPrint("Lỗi khởi tạo RubberBand stretcher");
         return;
     }
+    // Cấp phát sẵn buffer nội bộ cho packet lớn nhất, process() không phải cấp phát lại khi phát
+    rubberBand->setMaxProcessSize(MAX_FRAME_SIZE);
     // Priming RubberBand với dữ liệu im lặng
     const size_t primingFrames = FRAME_SIZE * 3; // Tăng số frame priming
     
     // Sử dụng calloc để cấp phát và khởi tạo về 0 trong một bước
     float* silenceBuffer = static_cast<float*>(calloc(primingFrames, sizeof(float)));
-    float* inputChannelsArray[1] = { silenceBuffer };
+    float* inputChannelsArray[MAX_DECODE_CHANNELS];
+    for (size_t c = 0; c < channels; c++) {
+        inputChannelsArray[c] = silenceBuffer;
+    }
     
     // Thực hiện nhiều lần process để đảm bảo buffer được khởi tạo đầy đủ
     {
@@ -68,17 +77,13 @@ double AudioSession::getPlaybackSpeed()
  *
  * Cách hoạt động:
  * 1. Kiểm tra tính hợp lệ:
- *    - speed phải > 0
+ *    - speed phải nằm trong [MIN_PLAYBACK_SPEED, MAX_PLAYBACK_SPEED]
  *    - state phải là PLAYING, PAUSED hoặc READY
  *
- * 2. Nếu đang phát (state = PLAYING):
- *    - Tính thời gian đã phát với tốc độ cũ
- *    - Cộng dồn vào accumulated_time để giữ chính xác vị trí phát
- *
- * 3. Cập nhật tốc độ mới:
+ * 2. Cập nhật tốc độ mới:
  *    - Lưu speed mới
- *    - Lưu thời điểm thay đổi speed
  *    - Các frame tiếp theo sẽ được resample theo tốc độ mới
+ *    - Frame đã nằm trong RingBuffer vẫn được PlaybackClock quy đổi theo tốc độ cũ
  *
  * Trả về:
  * - Result::success() nếu thành công
@@ -86,9 +91,9 @@ double AudioSession::getPlaybackSpeed()
  */
 Result AudioSession::setPlaybackSpeed(double speed)
 {
-  if (speed <= 0.0)
+  if (speed < MIN_PLAYBACK_SPEED || speed > MAX_PLAYBACK_SPEED)
   {
-    return Result::error(ErrorCode::InvalidParameter, "Speed must be positive");
+    return Result::error(ErrorCode::InvalidParameter, "Speed out of supported range");
   }
 
   auto currentState = state.load();
@@ -99,20 +104,10 @@ Result AudioSession::setPlaybackSpeed(double speed)
     return Result::error(ErrorCode::InvalidState, "Invalid state for changing speed");
   }
 
-  // Tính toán thời gian đã phát với tốc độ cũ
-  if (timing.hasStartTime && currentState == PlayState::PLAYING)
-  {
-    auto now = chrono::steady_clock::now();
-    auto timeSinceSpeedChange = chrono::duration_cast<chrono::milliseconds>(
-                                    now - timing.speedChangeTime)
-                                    .count();
-
-    // Cộng dồn thời gian đã phát với tốc độ cũ
-    timing.accumulatedTime += timeSinceSpeedChange * timing.speed;
-  }
-
-  // Sử dụng mutex để đồng bộ hóa
+  // Giữ decodeMutex để luồng decode không đọc speed giữa chừng,
+  // các frame decode sau đó được gắn đúng tốc độ mới trong PlaybackClock
   {
+    std::lock_guard<std::mutex> decodeLock(decodeMutex);
     std::lock_guard<std::mutex> lock(rubberBandMutex);
     // Cập nhật tốc độ mới và thời điểm thay đổi
     timing.speed = speed;
@@ -120,21 +115,20 @@ Result AudioSession::setPlaybackSpeed(double speed)
     rubberBand->setTimeRatio(1.0f /speed);
   }
 
-  timing.speedChangeTime = chrono::steady_clock::now();
-
   return Result::success();
 }
 
 
 /*
  * Hàm thực hiện việc resample (tái lấy mẫu) dữ liệu PCM để thay đổi tốc độ phát
- * sử dụng thư viện RubberBand với dữ liệu mono
+ * sử dụng thư viện RubberBand với dữ liệu planar (channels kênh)
  *
  * Tham số:
  * - input_frames: Số lượng frame âm thanh trong buffer đầu vào
- * - output_frames: Số lượng frame âm thanh mong muốn ở đầu ra
- * - in: Buffer chứa dữ liệu mono đầu vào
- * - out: Buffer sẽ chứa dữ liệu mono đã được resample
+ * - output_capacity: Số frame tối đa buffer đầu ra chứa được
+ * - in: Con trỏ tới dữ liệu đầu vào của từng kênh
+ * - out: Con trỏ tới buffer đầu ra của từng kênh (mỗi kênh chứa được output_capacity frame)
+ * - retrieved: Số frame thực sự ghi vào out (0 nếu RubberBand chưa có đầu ra)
  *
  * Cách hoạt động:
  * 1. Chuẩn bị dữ liệu đầu vào theo định dạng yêu cầu của RubberBand
@@ -145,45 +139,31 @@ Result AudioSession::setPlaybackSpeed(double speed)
  * - Result::success() nếu thành công
  * - Result::error() với mã lỗi tương ứng nếu thất bại
  */
-Result AudioSession::resampleRubberBand(size_t input_frames, size_t output_frames,
-                                        const float* in, float* out) {
+Result AudioSession::resampleRubberBand(size_t input_frames, size_t output_capacity,
+                                        const float* const* in, float* const* out, size_t& retrieved) {
+    retrieved = 0;
     // Kiểm tra tính hợp lệ của dữ liệu đầu vào
     if (!in || !out) {
         return Result::error(ErrorCode::InvalidParameter, "Input or output buffer is null");
     }
     
-    // Sử dụng mảng tĩnh thay vì vector để tránh cấp phát động
-    float* inputChannelsArray[1];
-    float* outputChannelsArray[1];
-    
-    // Gán trực tiếp con trỏ, tránh const_cast
-    // RubberBand API yêu cầu float* không phải const float*, nên vẫn cần cast
-    inputChannelsArray[0] = const_cast<float*>(in);
-    outputChannelsArray[0] = out;
-    
     // Sử dụng mutex khi gọi các hàm của RubberBand
     {
         std::lock_guard<std::mutex> lock(rubberBandMutex);
-        rubberBand->process(inputChannelsArray, input_frames, false);
+        rubberBand->process(in, input_frames, false);
     }
     
-    // Lấy dữ liệu đã xử lý
-    size_t available = rubberBand->available();
-    if (available == 0) {
-        debugPrint("Không có dữ liệu đầu ra từ RubberBand {}, {}, {}", available, input_frames, output_frames);
-        return Result::error(ErrorCode::ResampleError, "No output available from RubberBand");
+    // Lấy dữ liệu đã xử lý. RubberBand có thể chưa có đầu ra ngay (đang tích lũy),
+    // phần này sẽ ra ở lần gọi sau nên không coi là lỗi
+    int available = rubberBand->available();
+    if (available <= 0) {
+        return Result::success();
     }
     
-    // Giới hạn số lượng frame lấy ra không vượt quá kích thước buffer đầu ra
-    size_t frames_to_retrieve = std::min(available, output_frames);
-    
-    // Lấy dữ liệu đã xử lý từ RubberBand
-    size_t retrieved = rubberBand->retrieve(outputChannelsArray, frames_to_retrieve);
-    
-    if (retrieved == 0) {
-        debugPrint("Không thể lấy dữ liệu từ RubberBand");
-        return Result::error(ErrorCode::ResampleError, "Failed to retrieve data from RubberBand");
-    }
+    // Giới hạn số lượng frame lấy ra không vượt quá kích thước buffer đầu ra,
+    // phần dư (nếu có) vẫn nằm trong RubberBand cho lần sau
+    size_t frames_to_retrieve = std::min(static_cast<size_t>(available), output_capacity);
+    retrieved = rubberBand->retrieve(out, frames_to_retrieve);
     
     return Result::success();
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "audio_stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+namespace {
+
+int64_t nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int bucketOf(uint64_t micros) {
+    int bucket = 0;
+    while (micros > 0 && bucket < TimingHistogram::BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void appendFormat(string& out, const char* format, ...) {
+    char text[128];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length > 0) {
+        out.append(text, min<size_t>(length, sizeof(text) - 1));
+    }
+}
+
+void appendString(string& out, const string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            appendFormat(out, "\\u%04x", static_cast<unsigned>(c));
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void appendHistogram(string& out, const char* key, const TimingHistogram& histogram) {
+    const TimingHistogram::Snapshot snapshot = histogram.snapshot();
+    appendFormat(out, "\"%s\":{\"count\":%" PRIu64 ",\"sum\":%" PRIu64 ",\"max\":%" PRIu64 ",\"buckets\":[",
+                 key, snapshot.count, snapshot.sumMicros, snapshot.maxMicros);
+    for (int i = 0; i < TimingHistogram::BUCKETS; i++) {
+        appendFormat(out, i == 0 ? "%" PRIu64 : ",%" PRIu64, snapshot.counts[i]);
+    }
+    out += "]}";
+}
+
+void appendRing(string& out, const RingCounters& ring) {
+    appendFormat(out, "\"underflows\":%" PRIu64 ",\"underflowFrames\":%" PRIu64 ",",
+                 ring.underflows.load(memory_order_relaxed), ring.underflowFrames.load(memory_order_relaxed));
+    appendFormat(out, "\"overflows\":%" PRIu64 ",\"overflowFrames\":%" PRIu64,
+                 ring.overflows.load(memory_order_relaxed), ring.overflowFrames.load(memory_order_relaxed));
+}
+
+} // namespace
+
+// ------------------------------- TimingHistogram -------------------------------
+
+void TimingHistogram::record(uint64_t micros) {
+    counts[bucketOf(micros)].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    sumMicros.fetch_add(micros, memory_order_relaxed);
+    // Mỗi histogram chỉ có một thread ghi tại một thời điểm nên load + store không mất giá trị lớn nhất
+    if (micros > maxMicros.load(memory_order_relaxed)) {
+        maxMicros.store(micros, memory_order_relaxed);
+    }
+}
+
+TimingHistogram::Snapshot TimingHistogram::snapshot() const {
+    Snapshot snapshot;
+    for (int i = 0; i < BUCKETS; i++) {
+        snapshot.counts[i] = counts[i].load(memory_order_relaxed);
+    }
+    snapshot.count = count.load(memory_order_relaxed);
+    snapshot.sumMicros = sumMicros.load(memory_order_relaxed);
+    snapshot.maxMicros = maxMicros.load(memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t TimingHistogram::bucketUpperMicros(int bucket) {
+    return bucket >= 0 && bucket < BUCKETS - 1 ? uint64_t(1) << bucket : 0;
+}
+
+// ------------------------------- StreamStats -------------------------------
+
+StreamStats::StreamStats(const char* name)
+    : name(name) {
+    AudioStats::getInstance().add(this);
+}
+
+StreamStats::~StreamStats() {
+    AudioStats::getInstance().remove(this);
+}
+
+StreamStats::CallbackScope::CallbackScope(StreamStats& stats, int32_t numFrames, int32_t sampleRate)
+    : stats(stats), beganAtNanos(nowNanos()) {
+    stats.callbacks.fetch_add(1, memory_order_relaxed);
+    stats.sampleRate.store(sampleRate, memory_order_relaxed);
+
+    // Callback lẽ ra tới sau đúng thời lượng của callback trước
+    const int64_t previousBegin = stats.lastBeginNanos.exchange(beganAtNanos, memory_order_relaxed);
+    if (previousBegin > 0 && stats.lastPeriodNanos > 0) {
+        const int64_t deviation = llabs((beganAtNanos - previousBegin) - stats.lastPeriodNanos);
+        stats.periodJitter.record(static_cast<uint64_t>(deviation / 1000));
+    }
+    stats.lastPeriodNanos = sampleRate > 0 ? static_cast<int64_t>(numFrames) * 1000000000LL / sampleRate : 0;
+}
+
+StreamStats::CallbackScope::~CallbackScope() {
+    stats.callbackDuration.record(static_cast<uint64_t>((nowNanos() - beganAtNanos) / 1000));
+}
+
+void StreamStats::setXRunCount(int32_t xruns) {
+    if (xruns >= 0) {
+        xrunCount.store(xruns, memory_order_relaxed);
+    }
+}
+
+// ------------------------------- SessionStats -------------------------------
+
+SessionStats::SessionStats()
+    : id(AudioStats::getInstance().add(this)) {
+}
+
+SessionStats::~SessionStats() {
+    AudioStats::getInstance().remove(this);
+}
+
+void SessionStats::setLabel(const std::string& newLabel) {
+    lock_guard<std::mutex> lock(AudioStats::getInstance().mutex);
+    label = newLabel;
+}
+
+// ------------------------------- AudioStats -------------------------------
+
+AudioStats& AudioStats::getInstance() {
+    // Không bao giờ hủy: stream/session trong các đối tượng static khác có thể hủy đăng ký lúc thoát
+    static AudioStats* instance = new AudioStats();
+    return *instance;
+}
+
+void AudioStats::add(StreamStats* stream) {
+    lock_guard<std::mutex> lock(mutex);
+    streams.push_back(stream);
+}
+
+void AudioStats::remove(StreamStats* stream) {
+    lock_guard<std::mutex> lock(mutex);
+    streams.erase(std::remove(streams.begin(), streams.end(), stream), streams.end());
+}
+
+uint64_t AudioStats::add(SessionStats* session) {
+    lock_guard<std::mutex> lock(mutex);
+    sessions.push_back(session);
+    return nextSessionId++;
+}
+
+void AudioStats::remove(SessionStats* session) {
+    lock_guard<std::mutex> lock(mutex);
+    sessions.erase(std::remove(sessions.begin(), sessions.end(), session), sessions.end());
+}
+
+string AudioStats::snapshotJson() {
+    string out = "{\"bucketUpperMicros\":[";
+    for (int i = 0; i < TimingHistogram::BUCKETS; i++) {
+        appendFormat(out, i == 0 ? "%" PRIu64 : ",%" PRIu64, TimingHistogram::bucketUpperMicros(i));
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    out += "],\"streams\":[";
+    for (size_t i = 0; i < streams.size(); i++) {
+        const StreamStats& stream = *streams[i];
+        out += i == 0 ? "{\"name\":" : ",{\"name\":";
+        appendString(out, stream.getName());
+        appendFormat(out, ",\"sampleRate\":%d,\"callbacks\":%" PRIu64 ",\"xruns\":%d,",
+                     stream.getSampleRate(), stream.getCallbacks(), stream.getXRunCount());
+        appendRing(out, stream.ring);
+        out += ',';
+        appendHistogram(out, "callbackMicros", stream.getCallbackDuration());
+        out += ',';
+        appendHistogram(out, "periodJitterMicros", stream.getPeriodJitter());
+        out += '}';
+    }
+    out += "],\"sessions\":[";
+    for (size_t i = 0; i < sessions.size(); i++) {
+        const SessionStats& session = *sessions[i];
+        appendFormat(out, i == 0 ? "{\"id\":%" PRIu64 ",\"label\":" : ",{\"id\":%" PRIu64 ",\"label\":", session.id);
+        appendString(out, session.label);
+        out += ',';
+        appendRing(out, session.ring);
+        out += ',';
+        appendHistogram(out, "decodeMicros", session.decodeTime);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
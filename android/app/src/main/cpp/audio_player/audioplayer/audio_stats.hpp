@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    Thống kê glitch cho telemetry: thời gian và nhịp của audio callback, xrun của stream,
+    underflow/overflow của RingBuffer và thời gian decode của từng session.
+    Audio thread chỉ cộng atomic (relaxed), không khóa, không cấp phát. Thread app đọc mọi
+    nguồn đang sống qua AudioStats::snapshotJson() (FFI get_audio_stats).
+*/
+
+// Histogram thời gian không khóa theo thang log2 (micro giây):
+// bucket 0 là < 1us, bucket i (i >= 1) là [2^(i-1), 2^i) us, bucket cuối gồm mọi giá trị lớn hơn.
+class TimingHistogram {
+public:
+    static constexpr int BUCKETS = 20; // Bucket cuối bắt đầu từ 2^18 us (~262ms)
+
+    struct Snapshot {
+        uint64_t counts[BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t sumMicros = 0;
+        uint64_t maxMicros = 0;
+    };
+
+    // Gọi được từ audio callback. Chỉ một thread ghi tại một thời điểm, mọi thread đọc.
+    void record(uint64_t micros);
+    Snapshot snapshot() const;
+
+    // Cận trên (không tính) của bucket, 0 với bucket cuối (không giới hạn)
+    static uint64_t bucketUpperMicros(int bucket);
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumMicros{0};
+    std::atomic<uint64_t> maxMicros{0};
+};
+
+// Số lần RingBuffer cạn (người đọc không đủ dữ liệu) và đầy (người ghi phải bỏ dữ liệu)
+struct RingCounters {
+    std::atomic<uint64_t> underflows{0};
+    std::atomic<uint64_t> underflowFrames{0};
+    std::atomic<uint64_t> overflows{0};
+    std::atomic<uint64_t> overflowFrames{0};
+
+    void addUnderflow(uint64_t frames) {
+        underflows.fetch_add(1, std::memory_order_relaxed);
+        underflowFrames.fetch_add(frames, std::memory_order_relaxed);
+    }
+    void addOverflow(uint64_t frames) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        overflowFrames.fetch_add(frames, std::memory_order_relaxed);
+    }
+};
+
+/*
+    Thống kê của một audio stream (OboeLayer, MicrophoneRecorder, MicrophonePlayer, NullAudioLayer).
+    Tự đăng ký với AudioStats khi tạo và hủy đăng ký khi hủy, nên là member của đối tượng sở hữu stream.
+    - Thời gian mỗi callback (đầu tới cuối onAudioReady)
+    - Jitter của chu kỳ: |khoảng cách giữa hai lần callback - thời lượng của callback trước|
+    - Xrun do stream báo (-1 nếu API không hỗ trợ, vd OpenSL ES)
+*/
+class StreamStats {
+public:
+    explicit StreamStats(const char* name);
+    ~StreamStats();
+
+    StreamStats(const StreamStats&) = delete;
+    StreamStats& operator=(const StreamStats&) = delete;
+
+    // Audio thread: đo một callback từ lúc tạo tới lúc hủy
+    class CallbackScope {
+    public:
+        CallbackScope(StreamStats& stats, int32_t numFrames, int32_t sampleRate);
+        ~CallbackScope();
+
+        CallbackScope(const CallbackScope&) = delete;
+        CallbackScope& operator=(const CallbackScope&) = delete;
+
+    private:
+        StreamStats& stats;
+        int64_t beganAtNanos;
+    };
+
+    // Audio thread: giá trị getXRunCount() mới nhất của stream, bỏ qua nếu âm (không hỗ trợ)
+    void setXRunCount(int32_t xruns);
+    // Thread app: stream vừa start lại, khoảng lặng trước đó không tính vào jitter
+    void resetPeriod() { lastBeginNanos.store(0, std::memory_order_relaxed); }
+
+    RingCounters ring;
+
+    const char* getName() const { return name; }
+    uint64_t getCallbacks() const { return callbacks.load(std::memory_order_relaxed); }
+    int32_t getXRunCount() const { return xrunCount.load(std::memory_order_relaxed); }
+    int32_t getSampleRate() const { return sampleRate.load(std::memory_order_relaxed); }
+    const TimingHistogram& getCallbackDuration() const { return callbackDuration; }
+    const TimingHistogram& getPeriodJitter() const { return periodJitter; }
+
+private:
+    const char* name;
+    TimingHistogram callbackDuration;
+    TimingHistogram periodJitter;
+    std::atomic<uint64_t> callbacks{0};
+    std::atomic<int32_t> xrunCount{-1};
+    std::atomic<int32_t> sampleRate{0};
+    std::atomic<int64_t> lastBeginNanos{0}; // 0 = chưa có callback trước (hoặc vừa start lại)
+    int64_t lastPeriodNanos = 0;            // Chỉ audio thread: thời lượng của callback trước
+};
+
+// Thống kê RingBuffer và luồng decode của một AudioSession
+class SessionStats {
+public:
+    SessionStats();
+    ~SessionStats();
+
+    SessionStats(const SessionStats&) = delete;
+    SessionStats& operator=(const SessionStats&) = delete;
+
+    // Thread app: tên hiện trong snapshot (vd: file đang phát)
+    void setLabel(const std::string& label);
+
+    RingCounters ring;
+    TimingHistogram decodeTime; // Mỗi lần luồng decode nạp RingBuffer (fillBuffer)
+
+    uint64_t getId() const { return id; }
+
+private:
+    friend class AudioStats;
+    const uint64_t id;
+    std::string label; // Bảo vệ bởi mutex của AudioStats
+};
+
+// Danh sách các nguồn thống kê đang sống, dùng chung cho player và karaoke
+class AudioStats {
+public:
+    static AudioStats& getInstance();
+
+    // Snapshot JSON của mọi stream và session:
+    // {"bucketUpperMicros":[...],"streams":[...],"sessions":[...]}, các bộ đếm cộng dồn từ lúc tạo.
+    std::string snapshotJson();
+
+private:
+    friend class StreamStats;
+    friend class SessionStats;
+
+    void add(StreamStats* stream);
+    void remove(StreamStats* stream);
+    // Trả về id của session
+    uint64_t add(SessionStats* session);
+    void remove(SessionStats* session);
+
+    std::mutex mutex;
+    std::vector<StreamStats*> streams;
+    std::vector<SessionStats*> sessions;
+    uint64_t nextSessionId = 1;
+};
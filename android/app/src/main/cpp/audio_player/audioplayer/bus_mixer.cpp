@@ -0,0 +1,311 @@
+#include "bus_mixer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// Đầu ra mono: mẫu được tính cho cả hai kênh của meter
+void meterMono(mix::Levels& levels, float sample) {
+    const float magnitude = fabsf(sample);
+    for (int channel = 0; channel < 2; channel++) {
+        if (magnitude > levels.peak[channel]) {
+            levels.peak[channel] = magnitude;
+        }
+        levels.sumSquares[channel] += sample * sample;
+    }
+    levels.clips += magnitude > 1.0f ? 1u : 0u;
+}
+
+} // namespace
+
+BusMixer::BusMixer()
+    : mixKernels(&mix::active()) {
+    setMeterBallistics(MeterBallistics(), 48000);
+}
+
+bool BusMixer::render(float* output, int32_t numFrames, int outputChannels, float* echoReference) {
+    // Một atomic load, snapshot được giữ nguyên cho tới hết lần render
+    BusTable::ReadScope busScope(busTable);
+    const auto& snapshot = busScope.snapshot();
+    const auto& buses = snapshot.buses;
+    channels = outputChannels;
+    applyParameterChanges(snapshot);
+
+    bool anyActiveStream = false;
+
+    // Xử lý theo từng đoạn lớn để giảm overhead
+    for (int frameOffset = 0; frameOffset < numFrames; frameOffset += MAX_FRAMES_PER_ITERATION) {
+        const int framesToProcess = min(MAX_FRAMES_PER_ITERATION, numFrames - frameOffset);
+        const LevelMeter::Coefficients& coefficients = meterCoefficients(framesToProcess);
+
+        // Xóa buffer tạm thời
+        memset(mixBuffer.data(), 0, framesToProcess * channels * sizeof(float));
+
+        // Chỉ duyệt danh sách bus đang dùng: chi phí tỉ lệ với số bus có nguồn, không phải kích thước bảng.
+        // Cần reference thì mix các bus thuộc reference trước, chép mix lúc đó ra rồi mới tới các bus còn lại.
+        for (int busId : snapshot.active) {
+            if (!echoReference || buses[busId].echoReference) {
+                anyActiveStream |= renderBus(snapshot, buses[busId], framesToProcess);
+            }
+        }
+        if (echoReference) {
+            float* reference = echoReference + frameOffset;
+            if (channels == 2) {
+                for (int i = 0; i < framesToProcess; i++) {
+                    reference[i] = 0.5f * (mixBuffer[i * 2] + mixBuffer[i * 2 + 1]);
+                }
+            } else {
+                memcpy(reference, mixBuffer.data(), framesToProcess * sizeof(float));
+            }
+            for (int busId : snapshot.active) {
+                if (!buses[busId].echoReference) {
+                    anyActiveStream |= renderBus(snapshot, buses[busId], framesToProcess);
+                }
+            }
+        }
+
+        // Ramp và meter chạy theo thời gian của stream, kể cả khi bus không có dữ liệu trong block này
+        // (meter của bus im lặng hạ dần về 0)
+        for (int busId : snapshot.active) {
+            BusTable::BusState& state = *buses[busId].state;
+            for (int stemId : buses[busId].stems) {
+                finishBlock(*buses[stemId].state, framesToProcess, coefficients, &state.levels);
+            }
+            finishBlock(state, framesToProcess, coefficients, nullptr);
+        }
+
+        // Soft limiter (thay cho hard clip) rồi copy sang output
+        mix::Levels masterLevels;
+        limiterLastOutput = mixKernels->limit(mixBuffer.data(), framesToProcess * channels, limiterLastOutput,
+                                              &masterLevels);
+        if (channels == 1) {
+            // Kernel chia mẫu mono theo chẵn/lẻ: gộp lại cho cả hai kênh của meter
+            const float peak = max(masterLevels.peak[0], masterLevels.peak[1]);
+            const float sumSquares = masterLevels.sumSquares[0] + masterLevels.sumSquares[1];
+            masterLevels.peak[0] = masterLevels.peak[1] = peak;
+            masterLevels.sumSquares[0] = masterLevels.sumSquares[1] = sumSquares;
+        }
+        masterMeter.update(masterLevels, framesToProcess, coefficients);
+        memcpy(output + frameOffset * channels, mixBuffer.data(), framesToProcess * channels * sizeof(float));
+    }
+
+    return anyActiveStream;
+}
+
+bool BusMixer::renderBus(const BusTable::Snapshot& snapshot, const BusTable::Bus& bus, int32_t frames) {
+    // Bus đã mute và fade xong thì không đọc callback (giống pause)
+    if (!bus.graph || isParked(snapshot, bus)) {
+        return false;
+    }
+
+    // Thời gian chạy graph + mix (kể cả các stem) được tính cho bus này
+    const auto startedAt = chrono::steady_clock::now();
+
+    // Chạy danh sách node đã compile của bus một lần cho cả block
+    const int32_t framesRead = bus.graph->process(frames);
+    if (framesRead > 0) {
+        const float* busOutput = bus.graph->getOutput();
+
+        if (bus.hasStems()) {
+            // Mỗi stem lấy nhóm kênh của mình từ output của graph nguồn,
+            // gain của stem đã gồm volume/mute của bus nguồn
+            for (int stemId : bus.stems) {
+                const auto& stem = snapshot.buses[stemId];
+                mixBus(busOutput + stem.firstChannel, bus.channels, stem.channels, framesRead,
+                       stem.state->ramp, stem.state->levels);
+            }
+        } else if (bus.channels <= 2) { // Bus nhiều kênh chỉ phát được qua stem
+            mixBus(busOutput, bus.channels, bus.channels, framesRead, bus.state->ramp, bus.state->levels);
+        }
+    }
+
+    const auto elapsed = chrono::steady_clock::now() - startedAt;
+    bus.state->addCpuTime(chrono::duration_cast<chrono::nanoseconds>(elapsed).count(), frames);
+    return framesRead > 0;
+}
+
+bool BusMixer::getCpuStats(int busId, int sampleRate, AudioLayer::InputCpuStats& stats) {
+    BusTable::CpuUsage usage;
+    if (!busTable.isValid(busId) || !busTable.cpuUsage(busId, usage)) {
+        return false;
+    }
+    stats.blocks = usage.blocks;
+    stats.averageMicros = usage.blocks > 0 ? usage.nanos / 1000.0 / usage.blocks : 0.0;
+    stats.peakMicros = usage.peakNanos / 1000.0;
+    // Thời gian CPU so với thời lượng audio đã xử lý
+    stats.load = usage.frames > 0 && sampleRate > 0 ? usage.nanos / (usage.frames * 1e9 / sampleRate) : 0.0;
+    return true;
+}
+
+void BusMixer::setMeterBallistics(const MeterBallistics& ballistics, int sampleRate) {
+    const float framesPerMilli = max(sampleRate, 1) / 1000.0f;
+    meterRmsWindowFrames.store(max(ballistics.rmsWindowMillis, 0.0f) * framesPerMilli, memory_order_relaxed);
+    meterHoldFrames.store(max(ballistics.peakHoldMillis, 0.0f) * framesPerMilli, memory_order_relaxed);
+    meterDecayDbPerFrame.store(max(ballistics.peakDecayDbPerSecond, 0.0f) / max(sampleRate, 1),
+                               memory_order_relaxed);
+    meterVersion.fetch_add(1, memory_order_release);
+}
+
+int BusMixer::readMeters(MeterLevels* out, int maxCount) {
+    if (maxCount <= 0) {
+        return 0;
+    }
+    out[0] = masterMeter.read();
+    out[0].busId = -1;
+    return 1 + busTable.readMeters(out + 1, maxCount - 1);
+}
+
+/*
+Hệ số meter (exp/pow) chỉ được tính lại khi số frame của block hoặc ballistics đổi, nên mỗi block
+chỉ tốn vài phép nhân cho mỗi bus. Đọc ballistics trúng lúc thread app đang ghi thì version đã đổi
+và hệ số được tính lại ở block sau.
+*/
+const LevelMeter::Coefficients& BusMixer::meterCoefficients(int32_t frames) {
+    const uint32_t version = meterVersion.load(memory_order_acquire);
+    if (frames != cachedCoefficientFrames || version != cachedMeterVersion) {
+        cachedCoefficients = LevelMeter::Coefficients::compute(meterRmsWindowFrames.load(memory_order_relaxed),
+                                                               meterHoldFrames.load(memory_order_relaxed),
+                                                               meterDecayDbPerFrame.load(memory_order_relaxed),
+                                                               frames);
+        cachedCoefficientFrames = frames;
+        cachedMeterVersion = version;
+    }
+    return cachedCoefficients;
+}
+
+void BusMixer::finishBlock(BusTable::BusState& state, int32_t frames, const LevelMeter::Coefficients& coefficients,
+                           mix::Levels* source) {
+    state.ramp.advance(frames);
+    state.meter.update(state.levels, frames, coefficients);
+    if (source) {
+        // Bus nguồn: peak lớn nhất và tổng công suất của các stem
+        for (int channel = 0; channel < 2; channel++) {
+            source->peak[channel] = max(source->peak[channel], state.levels.peak[channel]);
+            source->sumSquares[channel] += state.levels.sumSquares[channel];
+        }
+        source->clips += state.levels.clips;
+    }
+    state.levels = mix::Levels();
+}
+
+/*
+Lấy các thay đổi volume/mute/pan mà thread app đã đẩy vào hàng đợi của BusTable rồi tính lại
+gain đích của các bus đang dùng. Stem nhân thêm volume, mute của bus nguồn và cộng pan của bus nguồn.
+Thay đổi chỉ áp dụng cho đúng lần acquire (generation) của bus. Bus mới (chưa mix lần nào) đọc
+tham số mới nhất từ BusState và nhảy thẳng tới gain đích, các thay đổi sau đó được ramp.
+*/
+void BusMixer::applyParameterChanges(const BusTable::Snapshot& snapshot) {
+    const auto& buses = snapshot.buses;
+    const bool resync = busTable.takeResyncRequest();
+    BusTable::ParameterChange change;
+    while (busTable.popParameterChange(change)) {
+        if (change.busId < 0 || change.busId >= static_cast<int>(buses.size())) {
+            continue;
+        }
+        // Bus đã release, hoặc chưa có trong snapshot này (khi xuất hiện nó sẽ đọc lại tham số)
+        BusTable::BusState* state = buses[change.busId].state.get();
+        if (state && state->generation == change.generation) {
+            state->parameters = change.parameters;
+        }
+    }
+
+    for (int busId : snapshot.active) {
+        const auto& bus = buses[busId];
+        BusTable::BusState& state = *bus.state;
+        if (state.fresh || resync) {
+            state.parameters = state.load();
+        }
+        updateGainTarget(state, nullptr);
+
+        for (int stemId : bus.stems) {
+            BusTable::BusState& stemState = *buses[stemId].state;
+            if (stemState.fresh || resync) {
+                stemState.parameters = stemState.load();
+            }
+            updateGainTarget(stemState, &state.parameters);
+        }
+    }
+}
+
+void BusMixer::updateGainTarget(BusTable::BusState& state, const BusTable::Parameters* source) {
+    float gain = state.parameters.volume;
+    bool muted = state.parameters.muted;
+    float pan = state.parameters.pan;
+    if (source) {
+        gain *= source->volume;
+        muted = muted || source->muted;
+        pan = clamp(pan + source->pan, -1.0f, 1.0f);
+    }
+    state.mutedEffective = muted;
+    if (state.fresh) {
+        state.ramp.forceCurrent(muted ? 0.0f : gain, pan);
+        state.fresh = false;
+    } else {
+        state.ramp.setTarget(muted ? 0.0f : gain, pan);
+    }
+}
+
+bool BusMixer::isParked(const BusTable::Snapshot& snapshot, const BusTable::Bus& bus) {
+    if (!bus.hasStems()) {
+        return bus.state->parked();
+    }
+    for (int stemId : bus.stems) {
+        if (!snapshot.buses[stemId].state->parked()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BusMixer::mixBus(const float* input, int stride, int busChannels, int32_t frames, StereoGainRamp ramp,
+                      mix::Levels& levels) {
+    // Gain 0 (volume 0 hoặc mute đã fade xong): không cần mix
+    if (ramp.isSilent()) {
+        return;
+    }
+    int32_t done = 0;
+    while (done < frames) {
+        mix::StereoGain gain;
+        const int32_t count = ramp.nextSegment(frames - done, gain);
+        mixInto(mixBuffer.data() + done * channels, input + done * stride, stride, busChannels, count, gain, levels);
+        ramp.advance(count);
+        done += count;
+    }
+}
+
+/*
+Mix một đoạn của bus (hoặc một nhóm kênh của bus nguồn) vào out theo số kênh đầu ra:
+mono -> stereo nhân đôi, stereo -> mono lấy trung bình.
+Đầu ra stereo (trường hợp thường gặp) dùng kernel SIMD, kernel đo mức luôn phần vừa cộng.
+*/
+void BusMixer::mixInto(float* out, const float* input, int stride, int busChannels,
+                       size_t frames, const mix::StereoGain& gain, mix::Levels& levels) const {
+    if (channels == 2) {
+        if (busChannels == 1) {
+            mixKernels->spreadMono(out, input, stride, frames, gain, &levels);
+        } else {
+            mixKernels->accumulateStereo(out, input, stride, frames, gain, &levels);
+        }
+        return;
+    }
+
+    // Đầu ra mono: pan không có tác dụng, dùng trung bình gain hai bên
+    const float start = (gain.left + gain.right) * 0.5f;
+    const float step = (gain.leftStep + gain.rightStep) * 0.5f;
+    for (size_t i = 0; i < frames; i++) {
+        const float volume = start + step * static_cast<float>(i);
+        float sample;
+        if (busChannels == 1) {
+            sample = input[i * stride] * volume;
+        } else {
+            // Lấy trung bình của 2 kênh
+            sample = (input[i * stride] + input[i * stride + 1]) * 0.5f * volume;
+        }
+        out[i] += sample;
+        meterMono(levels, sample);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "audio_layer.hpp"
+#include "bus_table.hpp"
+#include "gain_ramp.hpp"
+#include "level_meter.hpp"
+#include "mix_kernels.hpp"
+
+/*
+    BusMixer: phần mix dùng chung của các AudioLayer (OboeLayer trên thiết bị, NullAudioLayer khi chạy
+    không có thiết bị). Giữ bảng bus, kernel SIMD và trạng thái limiter; layer chỉ lo stream/thread
+    gọi render() và chuyển tiếp các hàm quản lý bus sang getBusTable().
+    render() chạy trên audio thread: không khóa, không cấp phát.
+    Meter của từng bus và của master được cập nhật mỗi block từ mức kernel mix/limiter đo được
+    trong cùng vòng lặp (không duyệt lại buffer).
+*/
+class BusMixer {
+public:
+    // Graph của bus được chạy theo block tối đa MAX_FRAMES_PER_ITERATION frame
+    static constexpr int MAX_FRAMES_PER_ITERATION = BusTable::MAX_BLOCK_FRAMES;
+
+    BusMixer();
+
+    BusTable& getBusTable() { return busTable; }
+    const mix::Kernels& getKernels() const { return *mixKernels; }
+
+    // Audio thread: mix mọi bus đang dùng vào output (numFrames frame interleaved, outputChannels là 1
+    // hoặc 2), qua soft limiter. Trả về true nếu có bus nào cho dữ liệu.
+    // echoReference (tùy chọn, numFrames mẫu): nhận mix mono của các bus có echoReference (trước
+    // limiter), làm reference cho bộ khử echo của mic.
+    bool render(float* output, int32_t numFrames, int outputChannels, float* echoReference = nullptr);
+
+    // Thống kê CPU của bus (đặt lại peak), sampleRate để tính tải so với thời gian thực
+    bool getCpuStats(int busId, int sampleRate, AudioLayer::InputCpuStats& stats);
+
+    // Thread app: ballistics của mọi meter, quy đổi sang frame theo sampleRate của stream.
+    // Mặc định MeterBallistics() ở 48kHz.
+    void setMeterBallistics(const MeterBallistics& ballistics, int sampleRate);
+    // Thread app: master (busId = -1) rồi tới các bus đang dùng, tối đa maxCount. Trả về số phần tử đã ghi.
+    int readMeters(MeterLevels* out, int maxCount);
+
+private:
+    // Chạy graph của bus cho frames frame và mix vào mixBuffer. Trả về true nếu bus cho dữ liệu.
+    bool renderBus(const BusTable::Snapshot& snapshot, const BusTable::Bus& bus, int32_t frames);
+    // Nhận thay đổi tham số từ hàng đợi, cập nhật gain đích của các bus đang dùng
+    void applyParameterChanges(const BusTable::Snapshot& snapshot);
+    // Tính gain đích của một bus, source là tham số của bus nguồn (với stem)
+    static void updateGainTarget(BusTable::BusState& state, const BusTable::Parameters* source);
+    // Bus (hoặc mọi stem của bus nguồn) đã mute và fade xong: không cần chạy graph
+    static bool isParked(const BusTable::Snapshot& snapshot, const BusTable::Bus& bus);
+    // Mix một bus theo từng đoạn ramp (ramp là bản copy, trạng thái thật được advance cuối block),
+    // cộng mức của phần đã mix vào levels
+    void mixBus(const float* input, int stride, int busChannels, int32_t frames, StereoGainRamp ramp,
+                mix::Levels& levels);
+    // Cộng frames frame từ input (stride mẫu mỗi frame, busChannels kênh đầu) vào out
+    void mixInto(float* out, const float* input, int stride, int busChannels,
+                 size_t frames, const mix::StereoGain& gain, mix::Levels& levels) const;
+    // Cuối block: advance ramp, cập nhật meter từ mức đã đo rồi xóa mức.
+    // source: mức của bus nguồn để gộp mức của stem vào (nullptr với bus thường)
+    static void finishBlock(BusTable::BusState& state, int32_t frames, const LevelMeter::Coefficients& coefficients,
+                            mix::Levels* source);
+    // Hệ số meter cho block frames frame, chỉ tính lại khi số frame hoặc ballistics đổi
+    const LevelMeter::Coefficients& meterCoefficients(int32_t frames);
+
+    // Thread app sửa bảng bus, render() đọc snapshot không khóa
+    BusTable busTable;
+    // Kernel mix/limiter SIMD chọn theo CPU lúc tạo mixer
+    const mix::Kernels* mixKernels;
+
+    // Ballistics theo frame: thread app ghi rồi tăng meterVersion, audio thread tính lại hệ số
+    std::atomic<float> meterRmsWindowFrames{0.0f};
+    std::atomic<float> meterHoldFrames{0.0f};
+    std::atomic<float> meterDecayDbPerFrame{0.0f};
+    std::atomic<uint32_t> meterVersion{0};
+
+    // Master (sau limiter): audio thread ghi, thread app đọc
+    LevelMeter masterMeter;
+
+    // Chỉ audio thread dùng
+    int channels = 2;                 // Số kênh đầu ra của lần render hiện tại
+    float limiterLastOutput = 0.0f;   // Output hợp lệ cuối của limiter (thay cho mẫu NaN)
+    std::array<float, MAX_FRAMES_PER_ITERATION * 2> mixBuffer;
+    LevelMeter::Coefficients cachedCoefficients;
+    int32_t cachedCoefficientFrames = -1;
+    uint32_t cachedMeterVersion = 0;
+};
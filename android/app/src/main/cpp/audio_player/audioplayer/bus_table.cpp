@@ -0,0 +1,322 @@
+#include "bus_table.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+BusTable::ReadScope::ReadScope(BusTable& table)
+    : table(table), slot(0) {
+    // Giữ slot đầu tiên đang trống (chẵn -> lẻ). seq_cst: cặp với publish(), xem giải thích ở đó
+    for (;; slot = (slot + 1) % MAX_READERS) {
+        uint64_t sequence = table.readerSequence[slot].load(memory_order_relaxed);
+        if ((sequence & 1) == 0 &&
+            table.readerSequence[slot].compare_exchange_weak(sequence, sequence + 1, memory_order_seq_cst)) {
+            break;
+        }
+    }
+    current = table.published.load(memory_order_seq_cst);
+}
+
+BusTable::ReadScope::~ReadScope() {
+    table.readerSequence[slot].fetch_add(1, memory_order_release);
+}
+
+BusTable::BusTable()
+    : current(make_unique<Snapshot>()) {
+    published.store(current.get());
+}
+
+BusTable::~BusTable() = default;
+
+/*
+Với từng slot: nếu writer đọc được bộ đếm chẵn sau khi store snapshot mới thì reader giữ slot
+đó sau này đều thấy snapshot mới (cả hai phía dùng seq_cst). Nếu lẻ, reader đang giữ slot có thể
+vẫn đọc snapshot cũ cho tới khi nó ra (bộ đếm lớn hơn giá trị đã đọc).
+*/
+BusTable::ReaderMarks BusTable::publish(unique_ptr<Snapshot> next) {
+    published.store(next.get(), memory_order_seq_cst);
+    ReaderMarks marks;
+    for (int i = 0; i < MAX_READERS; i++) {
+        marks.sequence[i] = readerSequence[i].load(memory_order_seq_cst);
+    }
+    retired.push_back({std::move(current), marks});
+    current = std::move(next);
+    return marks;
+}
+
+bool BusTable::readersPassed(const ReaderMarks& marks) const {
+    for (int i = 0; i < MAX_READERS; i++) {
+        if ((marks.sequence[i] & 1) && readerSequence[i].load(memory_order_acquire) <= marks.sequence[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BusTable::waitForReaders(const ReaderMarks& marks) const {
+    const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(RELEASE_TIMEOUT_MS);
+    while (!readersPassed(marks)) {
+        if (chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void BusTable::reclaim() {
+    // Snapshot mà reader còn có thể đọc (kể cả khi release() đã hết thời gian chờ) được giữ lại
+    // tới lần publish/release sau
+    for (size_t i = 0; i < retired.size();) {
+        if (readersPassed(retired[i].marks)) {
+            retired[i] = std::move(retired.back());
+            retired.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+int BusTable::allocateSlot(Snapshot& next) {
+    auto slot = find_if(next.buses.begin(), next.buses.end(), [](const Bus& bus) { return !bus.inUse; });
+    int busId = static_cast<int>(slot - next.buses.begin());
+    if (slot == next.buses.end()) {
+        if (busId >= MAX_BUSES) {
+            return -1;
+        }
+        next.buses.emplace_back();
+    }
+    next.buses[busId] = Bus();
+    next.buses[busId].inUse = true;
+    next.buses[busId].state = make_shared<BusState>(nextGeneration++);
+    return busId;
+}
+
+BusTable::BusState* BusTable::stateOf(int busId) const {
+    if (!isValid(busId) || busId >= static_cast<int>(current->buses.size()) || !current->buses[busId].inUse) {
+        return nullptr;
+    }
+    return current->buses[busId].state.get();
+}
+
+void BusTable::pushParameterChange(int busId, const BusState& state) {
+    ParameterChange change;
+    change.busId = busId;
+    change.generation = state.generation;
+    change.parameters = state.load();
+    if (!parameterQueue.push(change)) {
+        // Mixer sẽ đọc lại tham số của mọi bus ở chu kỳ tới
+        resyncRequested.store(true, memory_order_release);
+    }
+}
+
+void BusTable::setVolume(int busId, float volume) {
+    lock_guard<mutex> lock(writeMutex);
+    if (BusState* state = stateOf(busId)) {
+        state->volume.store(volume, memory_order_relaxed);
+        pushParameterChange(busId, *state);
+    }
+}
+
+void BusTable::setMuted(int busId, bool muted) {
+    lock_guard<mutex> lock(writeMutex);
+    if (BusState* state = stateOf(busId)) {
+        state->muted.store(muted, memory_order_relaxed);
+        pushParameterChange(busId, *state);
+    }
+}
+
+void BusTable::setPan(int busId, float pan) {
+    lock_guard<mutex> lock(writeMutex);
+    if (BusState* state = stateOf(busId)) {
+        state->pan.store(pan, memory_order_relaxed);
+        pushParameterChange(busId, *state);
+    }
+}
+
+BusTable::Parameters BusTable::parameters(int busId) {
+    lock_guard<mutex> lock(writeMutex);
+    const BusState* state = stateOf(busId);
+    return state ? state->load() : Parameters();
+}
+
+bool BusTable::cpuUsage(int busId, CpuUsage& usage) {
+    lock_guard<mutex> lock(writeMutex);
+    BusState* state = stateOf(busId);
+    if (!state) {
+        return false;
+    }
+    usage.nanos = state->cpuNanos.load(memory_order_relaxed);
+    usage.frames = state->cpuFrames.load(memory_order_relaxed);
+    usage.blocks = state->cpuBlocks.load(memory_order_relaxed);
+    usage.peakNanos = state->cpuPeakNanos.exchange(0, memory_order_relaxed);
+    return true;
+}
+
+int BusTable::busCount() {
+    lock_guard<mutex> lock(writeMutex);
+    return static_cast<int>(count_if(current->buses.begin(), current->buses.end(),
+                                     [](const Bus& bus) { return bus.inUse; }));
+}
+
+int BusTable::readMeters(MeterLevels* out, int maxCount) {
+    lock_guard<mutex> lock(writeMutex);
+    int count = 0;
+    for (int busId = 0; busId < static_cast<int>(current->buses.size()) && count < maxCount; busId++) {
+        const Bus& bus = current->buses[busId];
+        if (bus.inUse) {
+            out[count] = bus.state->meter.read();
+            out[count].busId = busId;
+            count++;
+        }
+    }
+    return count;
+}
+
+int BusTable::acquire(int channels) {
+    if (channels < 1 || channels > MAX_SOURCE_CHANNELS) {
+        return -1;
+    }
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+    auto next = make_unique<Snapshot>(*current);
+    const int busId = allocateSlot(*next);
+    if (busId < 0) {
+        return -1;
+    }
+    next->buses[busId].channels = static_cast<uint8_t>(channels);
+    next->active.push_back(busId);
+    publish(std::move(next));
+    return busId;
+}
+
+int BusTable::acquireStem(int sourceBusId, int firstChannel, int channels) {
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+    if (!stateOf(sourceBusId)) {
+        return -1;
+    }
+    const Bus& source = current->buses[sourceBusId];
+    if (source.sourceBus >= 0 ||
+        channels < 1 || channels > 2 || firstChannel < 0 ||
+        firstChannel + channels > source.channels) {
+        return -1;
+    }
+
+    // Stem và danh sách stem của bus nguồn xuất hiện cùng lúc trong một snapshot
+    auto next = make_unique<Snapshot>(*current);
+    const int busId = allocateSlot(*next);
+    if (busId < 0) {
+        return -1;
+    }
+    next->buses[busId].channels = static_cast<uint8_t>(channels);
+    next->buses[busId].sourceBus = sourceBusId;
+    next->buses[busId].firstChannel = static_cast<uint8_t>(firstChannel);
+    next->buses[sourceBusId].stems.push_back(busId);
+    publish(std::move(next));
+    return busId;
+}
+
+bool BusTable::release(int busId) {
+    ReaderMarks marks;
+    {
+        lock_guard<mutex> lock(writeMutex);
+        if (!stateOf(busId)) {
+            return true;
+        }
+        auto next = make_unique<Snapshot>(*current);
+        const int sourceBus = next->buses[busId].sourceBus;
+
+        if (sourceBus < 0) {
+            // Bus nguồn: các stem của nó không còn dữ liệu
+            for (int stem : next->buses[busId].stems) {
+                next->buses[stem] = Bus();
+            }
+            auto& list = next->active;
+            list.erase(remove(list.begin(), list.end(), busId), list.end());
+        } else {
+            // Stem cuối cùng của bus nguồn: bus nguồn trở lại bus thường
+            auto& stems = next->buses[sourceBus].stems;
+            stems.erase(remove(stems.begin(), stems.end(), busId), stems.end());
+        }
+        next->buses[busId] = Bus();
+
+        // Thu gọn đuôi bảng để snapshot sau copy ít hơn
+        while (!next->buses.empty() && !next->buses.back().inUse) {
+            next->buses.pop_back();
+        }
+        marks = publish(std::move(next));
+    }
+
+    // Chờ ngoài khóa để các thread app khác không bị chặn theo
+    const bool left = waitForReaders(marks);
+    if (!left) {
+        // Callback bị treo vẫn có thể đang đọc snapshot cũ: reclaim() giữ nó lại tới lần sau
+        debugPrint("BusTable: audio callback did not leave snapshot within {} ms", RELEASE_TIMEOUT_MS);
+    }
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+    return left;
+}
+
+bool BusTable::setCallback(int busId, AudioCallback callback) {
+    int channels;
+    {
+        lock_guard<mutex> lock(writeMutex);
+        if (!stateOf(busId)) {
+            return false;
+        }
+        channels = current->buses[busId].channels;
+    }
+    shared_ptr<ProcessingGraph> graph;
+    if (callback) {
+        graph = ProcessingGraph::fromCallback(channels, MAX_BLOCK_FRAMES, std::move(callback));
+    }
+    return setGraph(busId, std::move(graph));
+}
+
+bool BusTable::setGraph(int busId, shared_ptr<ProcessingGraph> graph) {
+    if (graph && (!graph->isCompiled() || graph->getMaxFrames() < MAX_BLOCK_FRAMES)) {
+        debugPrint("BusTable: graph for bus {} is not compiled or too small", busId);
+        return false;
+    }
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+    if (!stateOf(busId)) {
+        return false;
+    }
+    const Bus& bus = current->buses[busId];
+    if (bus.sourceBus >= 0 || (graph && graph->getOutputChannels() != bus.channels)) {
+        debugPrint("BusTable: graph does not match bus {}", busId);
+        return false;
+    }
+    auto next = make_unique<Snapshot>(*current);
+    next->buses[busId].graph = std::move(graph);
+    publish(std::move(next));
+    return true;
+}
+
+bool BusTable::setEchoReference(int busId, bool include) {
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+    if (!stateOf(busId) || current->buses[busId].sourceBus >= 0) {
+        return false;
+    }
+    auto next = make_unique<Snapshot>(*current);
+    next->buses[busId].echoReference = include;
+    publish(std::move(next));
+    return true;
+}
+
+void BusTable::clear() {
+    ReaderMarks marks;
+    {
+        lock_guard<mutex> lock(writeMutex);
+        marks = publish(make_unique<Snapshot>());
+    }
+    waitForReaders(marks);
+    lock_guard<mutex> lock(writeMutex);
+    reclaim();
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "audio_player_types.hpp"
+#include "gain_ramp.hpp"
+#include "level_meter.hpp"
+#include "parameter_queue.hpp"
+#include "processing_graph.hpp"
+
+/*
+    BusTable: bảng bus của mixer dạng RCU, audio callback đọc không khóa và không race.
+    - Cấu trúc bus (inUse, số kênh, stem, graph xử lý) nằm trong Snapshot bất biến.
+      Thread app sửa bảng bằng cách copy snapshot hiện tại, sửa bản copy rồi publish
+      bằng một atomic store. Callback lấy snapshot bằng một atomic load.
+    - Số bus không cố định: bảng lớn dần khi cần (tới MAX_BUSES), slot trống được dùng lại.
+      Snapshot giữ danh sách dày `active` các bus mixer phải chạy, nên chi phí mỗi chu kỳ
+      chỉ tỉ lệ với số bus đang dùng chứ không phải kích thước bảng.
+    - Mỗi lần acquire tạo một BusState mới (sống cùng các snapshot tham chiếu tới nó):
+      volume/mute/pan mới nhất (atomic, để đọc lại), trạng thái ramp của mixer, thống kê CPU và meter.
+      Volume/mute/pan không tạo snapshot mới mà được đẩy qua ParameterQueue cho mixer làm mượt.
+    - Snapshot cũ chỉ được giải phóng trên thread app khi mọi reader chắc chắn đã rời nó.
+      Mỗi reader (callback của thiết bị, renderFrames() của NullAudioLayer trên thread khác...)
+      giữ một slot trong MAX_READERS slot, đánh dấu vào/ra bằng bộ đếm riêng của slot đó.
+      release() chờ điều đó để người gọi có thể hủy đối tượng mà callback của bus đang tham chiếu
+      ngay sau khi release() trả về. Hết RELEASE_TIMEOUT_MS mà reader chưa ra (callback bị treo)
+      thì snapshot cũ vẫn được giữ lại và chỉ giải phóng ở lần publish/release sau khi reader đã ra.
+    Audio thread không bao giờ khóa, cấp phát, hay hủy graph (graph cũ được hủy cùng snapshot cũ
+    trên thread app).
+*/
+class BusTable {
+public:
+    static constexpr int MAX_BUSES = 64;          // Giới hạn an toàn của bảng (kể cả bus stem)
+    static constexpr int MAX_SOURCE_CHANNELS = 8; // Số kênh tối đa của bus nguồn có stem
+    static constexpr int MAX_BLOCK_FRAMES = 4096;  // Số frame tối đa mỗi lần mixer chạy graph của bus
+
+    struct Parameters {
+        float volume = 1.0f;
+        bool muted = false;
+        float pan = 0.0f; // -1 (trái) .. 1 (phải)
+    };
+
+    // Thống kê CPU của một bus (graph + mix, stem tính vào bus nguồn)
+    struct CpuUsage {
+        uint64_t nanos = 0;      // Tổng thời gian CPU
+        uint64_t frames = 0;     // Tổng số frame đã xử lý
+        uint64_t blocks = 0;     // Số lần mixer chạy bus
+        uint32_t peakNanos = 0;  // Lần chạy lâu nhất kể từ lần đọc trước
+    };
+
+    // Trạng thái riêng của một lần acquire bus
+    struct BusState {
+        explicit BusState(uint32_t generation) : generation(generation) {}
+
+        const uint32_t generation;
+
+        // Thread app ghi, mixer đọc lại khi bus mới xuất hiện hoặc khi hàng đợi tràn
+        std::atomic<float> volume{1.0f};
+        std::atomic<bool> muted{false};
+        std::atomic<float> pan{0.0f};
+        Parameters load() const {
+            return {volume.load(std::memory_order_relaxed), muted.load(std::memory_order_relaxed),
+                    pan.load(std::memory_order_relaxed)};
+        }
+
+        // Chỉ audio thread
+        Parameters parameters;       // Tham số mới nhất mixer đã nhận
+        bool fresh = true;           // Chưa được mix lần nào: nhảy thẳng tới gain đích, không ramp
+        bool mutedEffective = false; // Đã tính cả mute của bus nguồn (với stem)
+        StereoGainRamp ramp;
+        mix::Levels levels;          // Mức đo được trong block đang mix (bus nguồn: gộp từ các stem)
+
+        // Audio thread ghi, thread app đọc
+        std::atomic<uint64_t> cpuNanos{0};
+        std::atomic<uint64_t> cpuFrames{0};
+        std::atomic<uint64_t> cpuBlocks{0};
+        std::atomic<uint32_t> cpuPeakNanos{0};
+        void addCpuTime(uint64_t nanos, uint32_t frames) {
+            cpuNanos.fetch_add(nanos, std::memory_order_relaxed);
+            cpuFrames.fetch_add(frames, std::memory_order_relaxed);
+            cpuBlocks.fetch_add(1, std::memory_order_relaxed);
+            if (nanos > cpuPeakNanos.load(std::memory_order_relaxed)) {
+                cpuPeakNanos.store(static_cast<uint32_t>(nanos), std::memory_order_relaxed);
+            }
+        }
+
+        // Audio thread ghi mỗi block, thread app đọc
+        LevelMeter meter;
+
+        // Audio thread: bus đã mute và fade xong, không cần đọc callback nữa
+        bool parked() const { return mutedEffective && ramp.isSilent(); }
+    };
+
+    struct Bus {
+        bool inUse = false;
+        uint8_t channels = 1;        // Số kênh của bus
+        int sourceBus = -1;          // Bus stem: bus nguồn cấp dữ liệu, -1 nếu bus thường
+        uint8_t firstChannel = 0;    // Bus stem: kênh đầu tiên trong PCM của bus nguồn
+        std::vector<int> stems;      // Bus nguồn: các bus stem, chỉ chạy graph cho chúng, không mix trực tiếp
+        // Graph sinh dữ liệu của bus (output cùng số kênh với bus). Bus stem không có graph.
+        std::shared_ptr<ProcessingGraph> graph;
+        std::shared_ptr<BusState> state;
+        // Bus có trong reference của bộ khử echo (nhạc phát ra loa). Bus mic thì không.
+        bool echoReference = true;
+
+        bool hasStems() const { return !stems.empty(); }
+    };
+
+    // Trạng thái tham số của một bus sau một lần thay đổi
+    struct ParameterChange {
+        int busId = -1;
+        uint32_t generation = 0;
+        Parameters parameters;
+    };
+
+    struct Snapshot {
+        std::vector<Bus> buses;  // Chỉ số = busId, có slot trống
+        std::vector<int> active; // Bus thường và bus nguồn đang dùng (không gồm stem), theo thứ tự acquire
+    };
+
+    // Audio callback giữ một ReadScope trong suốt thời gian dùng snapshot
+    class ReadScope {
+    public:
+        explicit ReadScope(BusTable& table);
+        ~ReadScope();
+        const Snapshot& snapshot() const { return *current; }
+
+        ReadScope(const ReadScope&) = delete;
+        ReadScope& operator=(const ReadScope&) = delete;
+
+    private:
+        BusTable& table;
+        const Snapshot* current;
+        int slot;
+    };
+
+    BusTable();
+    ~BusTable();
+
+    // Thread app. Trả về busId, -1 nếu hết bus hoặc tham số sai
+    int acquire(int channels);
+    int acquireStem(int sourceBusId, int firstChannel, int channels);
+    // Release bus nguồn thì các stem của nó cũng bị release.
+    // Chờ audio callback đang chạy (nếu có) xong chu kỳ hiện tại, tối đa RELEASE_TIMEOUT_MS.
+    // false nếu hết thời gian mà callback chưa ra (snapshot cũ vẫn được giữ, không giải phóng).
+    bool release(int busId);
+    // Bus chỉ có một nguồn: tạo graph một node từ callback
+    bool setCallback(int busId, AudioCallback callback);
+    // Graph phải đã compile, output cùng số kênh với bus, maxFrames >= MAX_BLOCK_FRAMES
+    bool setGraph(int busId, std::shared_ptr<ProcessingGraph> graph);
+    // Bus thường hoặc bus nguồn (các stem đi theo bus nguồn)
+    bool setEchoReference(int busId, bool include);
+    // Xóa mọi bus (khi stream đã dừng)
+    void clear();
+
+    bool isValid(int busId) const { return busId >= 0 && busId < MAX_BUSES; }
+    void setVolume(int busId, float volume);
+    void setMuted(int busId, bool muted);
+    void setPan(int busId, float pan);
+    // Tham số mới nhất đã set, mặc định nếu bus không dùng
+    Parameters parameters(int busId);
+    // Thống kê CPU của bus từ lần acquire, đặt lại peak. false nếu bus không dùng.
+    bool cpuUsage(int busId, CpuUsage& usage);
+    // Số bus đang dùng (kể cả stem)
+    int busCount();
+    // Meter của các bus đang dùng (kể cả stem) theo thứ tự busId, tối đa maxCount.
+    // Trả về số bus đã ghi vào out.
+    int readMeters(MeterLevels* out, int maxCount);
+
+    // Audio thread: lấy thay đổi tham số theo thứ tự đã set
+    bool popParameterChange(ParameterChange& change) { return parameterQueue.pop(change); }
+    // Audio thread: true nếu hàng đợi từng bị đầy, khi đó phải đọc lại tham số của mọi bus
+    bool takeResyncRequest() { return resyncRequested.exchange(false, std::memory_order_acquire); }
+
+private:
+    static constexpr int RELEASE_TIMEOUT_MS = 200;
+    static constexpr size_t PARAMETER_QUEUE_SIZE = 256;
+    // Số reader đọc snapshot cùng lúc tối đa (reader thứ MAX_READERS + 1 chờ tới khi có slot trống)
+    static constexpr int MAX_READERS = 4;
+
+    // Bộ đếm của mọi slot reader lúc publish: slot nào đang đọc (lẻ) phải tăng qua giá trị đó
+    struct ReaderMarks {
+        uint64_t sequence[MAX_READERS];
+    };
+
+    struct Retired {
+        std::unique_ptr<Snapshot> snapshot;
+        ReaderMarks marks;
+    };
+
+    // Publish next thay cho snapshot hiện tại, trả về mốc của các reader mà từ đó snapshot vừa thay không còn được đọc. Gọi khi đang giữ writeMutex.
+    ReaderMarks publish(std::unique_ptr<Snapshot> next);
+    bool readersPassed(const ReaderMarks& marks) const;
+    bool waitForReaders(const ReaderMarks& marks) const;
+    void reclaim();
+    // Slot trống đầu tiên của next (mở rộng bảng nếu cần) với BusState mới, -1 nếu đã đủ MAX_BUSES.
+    // Gọi khi đang giữ writeMutex.
+    int allocateSlot(Snapshot& next);
+    // BusState của bus đang dùng, nullptr nếu không có. Gọi khi đang giữ writeMutex.
+    BusState* stateOf(int busId) const;
+    // Đẩy tham số hiện tại của bus cho mixer. Gọi khi đang giữ writeMutex.
+    void pushParameterChange(int busId, const BusState& state);
+
+    std::atomic<const Snapshot*> published;
+    // Mỗi slot tăng khi một reader bắt đầu và khi kết thúc đọc snapshot: lẻ = đang có reader
+    std::atomic<uint64_t> readerSequence[MAX_READERS] = {};
+
+    std::mutex writeMutex;               // Chỉ giữa các thread app (kể cả phía producer của parameterQueue)
+    std::unique_ptr<Snapshot> current;   // Snapshot đang publish (sở hữu)
+    std::vector<Retired> retired;
+    uint32_t nextGeneration = 1;
+
+    ParameterQueue<ParameterChange, PARAMETER_QUEUE_SIZE> parameterQueue;
+    std::atomic<bool> resyncRequested{false};
+};
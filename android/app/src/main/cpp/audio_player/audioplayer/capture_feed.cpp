@@ -0,0 +1,112 @@
+#include "capture_feed.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+
+CaptureFeed::CaptureFeed()
+    : block(make_unique<float[]>(MAX_BLOCK_FRAMES)),
+      reference(make_unique<float[]>(MAX_BLOCK_FRAMES)) {
+}
+
+void CaptureFeed::open(CaptureTap newTap, int sampleRate) {
+    if (isOpen()) {
+        return;
+    }
+    // Audio thread không đọc tap hay bộ khử echo khi feed đóng (close() đã chờ nó ra ngoài)
+    tap = std::move(newTap);
+    if (!echoCanceller || echoCanceller->getSampleRate() != sampleRate) {
+        echoCanceller = make_unique<AdaptiveEchoCanceller>(sampleRate);
+    }
+    echoActive = false;
+    referenceFrames = 0;
+    active.store(true, memory_order_seq_cst);
+}
+
+void CaptureFeed::close() {
+    active.store(false, memory_order_seq_cst);
+    while (inUse.load(memory_order_seq_cst)) {
+        this_thread::yield();
+    }
+}
+
+void CaptureFeed::setEchoCancellation(bool enabled) {
+    echoEnabled.store(enabled, memory_order_release);
+}
+
+bool CaptureFeed::getEchoCancellerStats(AdaptiveEchoCanceller::Stats& stats) const {
+    if (!echoCanceller) {
+        return false;
+    }
+    stats = echoCanceller->getStats();
+    return true;
+}
+
+float* CaptureFeed::beginBlock(int32_t frames) {
+    segmentFrames = clamp<int32_t>(frames, 0, MAX_BLOCK_FRAMES);
+    blockFrames = 0;
+    readOffset = 0;
+    if (!active.load(memory_order_acquire)) {
+        return nullptr;
+    }
+    // Dekker với close(): hoặc close() thấy inUse, hoặc block này thấy feed đã đóng
+    inUse.store(true, memory_order_seq_cst);
+    if (!active.load(memory_order_seq_cst)) {
+        inUse.store(false, memory_order_release);
+        return nullptr;
+    }
+    return block.get();
+}
+
+void CaptureFeed::endBlock(int32_t framesCaptured) {
+    blockFrames = clamp<int32_t>(framesCaptured, 0, segmentFrames);
+    cancelEcho();
+    if (tap && blockFrames > 0) {
+        tap(block.get(), static_cast<size_t>(blockFrames));
+    }
+    inUse.store(false, memory_order_release);
+}
+
+void CaptureFeed::cancelEcho() {
+    if (!echoEnabled.load(memory_order_acquire)) {
+        echoActive = false;
+        referenceFrames = 0;
+        return;
+    }
+    if (!echoActive) {
+        // Reference đẩy vào dưới đây bị bỏ khi reset được áp dụng, reference của đoạn này khớp
+        // với mic của đoạn này
+        echoCanceller->reset();
+        echoActive = true;
+    }
+    if (referenceFrames > 0) {
+        echoCanceller->pushReference(reference.get(), static_cast<size_t>(referenceFrames));
+        referenceFrames = 0;
+    }
+    // Mic thiếu mẫu (input underflow) vẫn được khử đủ cả đoạn để mic và reference không lệch nhau
+    fill(block.get() + blockFrames, block.get() + segmentFrames, 0.0f);
+    echoCanceller->process(block.get(), static_cast<size_t>(segmentFrames));
+}
+
+float* CaptureFeed::referenceBlock() {
+    if (!active.load(memory_order_acquire) || !echoEnabled.load(memory_order_acquire)) {
+        return nullptr;
+    }
+    return reference.get();
+}
+
+void CaptureFeed::endReference(int32_t frames) {
+    referenceFrames = clamp<int32_t>(frames, 0, MAX_BLOCK_FRAMES);
+}
+
+AudioCallback CaptureFeed::source() {
+    return [this](float* out, size_t frames) { return read(out, frames); };
+}
+
+size_t CaptureFeed::read(float* out, size_t frames) {
+    const size_t count = min(frames, static_cast<size_t>(blockFrames - readOffset));
+    memcpy(out, block.get() + readOffset, count * sizeof(float));
+    readOffset += static_cast<int32_t>(count);
+    return count;
+}
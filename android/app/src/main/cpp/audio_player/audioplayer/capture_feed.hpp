@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "audio_player_types.hpp"
+#include "echo_canceller.hpp"
+
+/*
+    CaptureFeed: block mic của chế độ full-duplex.
+    Audio layer đọc mic ngay trong callback đầu ra (beginBlock/endBlock), ngay trước khi mixer
+    chạy đoạn đó, rồi bus của mic kéo block qua AudioCallback của source() như mọi nguồn khác.
+    Mic và nhạc vì vậy chạy cùng một callback, cùng một clock, không có ring buffer giữa hai stream.
+
+    Buffer cấp phát một lần khi tạo. Nguồn đọc được cả khi feed đã đóng (trả về im lặng),
+    nên graph của bus mic không cần gỡ ra trước khi đóng.
+
+    Khử echo (tùy chọn): mixer ghi mix của các bus nhạc vào referenceBlock() khi mix mỗi đoạn,
+    endBlock() của đoạn sau đưa reference đó vào AdaptiveEchoCanceller rồi khử echo trên block mic,
+    trước tap và bus mic. Bộ khử echo chỉ được dùng giữa beginBlock() và endBlock() nên close()
+    cũng chờ được nó.
+*/
+class CaptureFeed {
+public:
+    // Callback đầu ra dài hơn được audio layer chia thành nhiều đoạn
+    static constexpr int32_t MAX_BLOCK_FRAMES = 4096;
+
+    CaptureFeed();
+
+    CaptureFeed(const CaptureFeed&) = delete;
+    CaptureFeed& operator=(const CaptureFeed&) = delete;
+
+    // Thread app: bắt đầu nhận mic, tap (có thể rỗng) nhận từng block trên audio thread.
+    // sampleRate của stream dùng cho bộ khử echo (tạo lại nếu khác lần mở trước).
+    void open(CaptureTap tap, int sampleRate);
+    // Thread app: ngừng nhận và chờ audio thread ra khỏi beginBlock()..endBlock().
+    // Sau khi trả về, audio layer đóng được input stream một cách an toàn.
+    void close();
+    bool isOpen() const { return active.load(std::memory_order_acquire); }
+
+    // Thread bất kỳ: bật/tắt khử echo, bật lại thì học lại từ đầu. Mặc định tắt.
+    void setEchoCancellation(bool enabled);
+    bool isEchoCancellationEnabled() const { return echoEnabled.load(std::memory_order_acquire); }
+    // Thread app: false nếu feed chưa mở lần nào
+    bool getEchoCancellerStats(AdaptiveEchoCanceller::Stats& stats) const;
+
+    // Audio thread: buffer MAX_BLOCK_FRAMES mẫu để ghi mic của đoạn sắp mix (frames frame),
+    // nullptr nếu feed đang đóng (không được gọi endBlock()).
+    float* beginBlock(int32_t frames);
+    // Audio thread: framesCaptured frame đầu của buffer là mic hợp lệ
+    void endBlock(int32_t framesCaptured);
+
+    // Audio thread: buffer MAX_BLOCK_FRAMES mẫu cho reference (mono) của đoạn đang mix,
+    // nullptr nếu không cần (feed đóng hoặc khử echo tắt)
+    float* referenceBlock();
+    // Audio thread: mixer đã ghi frames mẫu vào referenceBlock()
+    void endReference(int32_t frames);
+
+    // Nguồn mono cho bus của mic, đọc lần lượt block hiện tại (mixer có thể gọi nhiều lần
+    // mỗi đoạn). Chỉ gắn vào một bus.
+    AudioCallback source();
+
+private:
+    size_t read(float* out, size_t frames);
+    // Audio thread, trong endBlock(): đưa reference của đoạn trước vào rồi khử echo cả đoạn
+    void cancelEcho();
+
+    std::unique_ptr<float[]> block;
+    std::unique_ptr<float[]> reference;
+    CaptureTap tap;
+    std::unique_ptr<AdaptiveEchoCanceller> echoCanceller;
+    // Chỉ audio thread
+    int32_t segmentFrames = 0;
+    int32_t blockFrames = 0;
+    int32_t readOffset = 0;
+    int32_t referenceFrames = 0;
+    bool echoActive = false; // Bộ khử echo đang chạy, false thì lần bật kế tiếp reset nó
+
+    std::atomic<bool> echoEnabled{false};
+
+    std::atomic<bool> active{false};
+    std::atomic<bool> inUse{false}; // Audio thread đang ở giữa beginBlock() và endBlock()
+};
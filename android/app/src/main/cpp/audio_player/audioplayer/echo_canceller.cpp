@@ -0,0 +1,469 @@
+#include "echo_canceller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "FFT.h"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t REFERENCE_RING_FRAMES = 16384;
+
+// Năng lượng trung bình mỗi mẫu dưới mức này (-70 dBFS) thì coi là im lặng
+constexpr float ACTIVE_ENERGY = 1e-7f;
+// Phổ nhị phân: băng đầu tiên (Hz), ngưỡng mỗi băng là trung bình trượt ~50 block
+constexpr float BAND_LOW_HZ = 300.0f;
+constexpr float BAND_MEAN_RATE = 0.02f;
+// Ước lượng độ trễ: làm mượt số bit khác nhau ~100 block, độ trễ tốt nhất phải ít hơn trung bình
+// LOCK_MARGIN_BITS bit và giữ nguyên LOCK_BLOCKS block liên tiếp mới được chốt
+constexpr float MISMATCH_RATE = 0.01f;
+constexpr float LOCK_MARGIN_BITS = 3.0f;
+constexpr int LOCK_BLOCKS = 40;
+// Partition đầu bắt đầu trước độ trễ đã chốt LEAD_BLOCKS block: độ trễ ước lượng là trọng tâm năng
+// lượng của echo, phần đầu của đáp ứng xung tới sớm hơn
+constexpr int LEAD_BLOCKS = 2;
+// NLMS: bước thích nghi, điều chuẩn theo công suất mỗi bin
+constexpr float STEP = 0.5f;
+constexpr float REGULARIZATION = 1e-6f * 256;
+// Phát hiện hát chồng: hệ số tương quan (bình phương) giữa mic và echo ước lượng của background,
+// dưới COHERENCE_FREEZE thì ngừng thích nghi, trên COHERENCE_FULL thì thích nghi đủ bước
+constexpr float COHERENCE_FREEZE = 0.6f;
+constexpr float COHERENCE_FULL = 0.95f;
+constexpr int FREEZE_TIMEOUT_MILLIS = 2000;
+// Chọn bộ lọc: năng lượng lỗi làm mượt ~10 block
+constexpr float ERROR_RATE = 0.1f;
+constexpr float COPY_RATIO = 0.8f;
+constexpr float COPY_MAX_RESIDUAL = 0.25f;
+constexpr int COPY_BLOCKS = 4;
+constexpr float DIVERGED_RATIO = 8.0f;
+
+float blockEnergy(const float* samples, size_t count) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i] * samples[i];
+    }
+    return sum / count;
+}
+
+} // namespace
+
+AdaptiveEchoCanceller::AdaptiveEchoCanceller(int rate, int tailMillis, int maxDelayMillis)
+    : sampleRate(max(rate, 1)),
+      partitions(max(1, static_cast<int>(ceil(max(tailMillis, 1) * sampleRate / 1000.0 / BLOCK_FRAMES)))),
+      delayCandidates(max(1, static_cast<int>(ceil(max(maxDelayMillis, 0) * sampleRate / 1000.0 / BLOCK_FRAMES)))),
+      historySize(delayCandidates + partitions + LEAD_BLOCKS),
+      fft(make_unique<RubberBand::FFT>(FFT_SIZE)),
+      reference(REFERENCE_RING_FRAMES),
+      freezeTimeoutBlocks(FREEZE_TIMEOUT_MILLIS * sampleRate / 1000 / BLOCK_FRAMES) {
+    fft->initFloat();
+
+    // 32 băng mỗi băng một bin, từ ~300 Hz (dưới đó phòng và loa điện thoại làm méo nhiều)
+    firstBandBin = clamp(static_cast<int>(lround(BAND_LOW_HZ * FFT_SIZE / sampleRate)), 1, BINS - 1 - BANDS);
+
+    historyRe.resize(static_cast<size_t>(historySize) * BINS);
+    historyIm.resize(static_cast<size_t>(historySize) * BINS);
+    historyBlock.resize(historySize);
+    historyBits.resize(historySize);
+    historyEnergy.resize(historySize);
+    referenceBlock.resize(BLOCK_FRAMES);
+    referencePrevious.resize(BLOCK_FRAMES);
+
+    micInput.resize(BLOCK_FRAMES);
+    micOutput.resize(BLOCK_FRAMES);
+    micPrevious.resize(BLOCK_FRAMES);
+
+    const size_t coefficients = static_cast<size_t>(partitions) * BINS;
+    backRe.resize(coefficients);
+    backIm.resize(coefficients);
+    foreRe.resize(coefficients);
+    foreIm.resize(coefficients);
+    power.resize(BINS);
+
+    time.resize(FFT_SIZE);
+    spectrumRe.resize(BINS);
+    spectrumIm.resize(BINS);
+    echoRe.resize(BINS);
+    echoIm.resize(BINS);
+    foreEchoRe.resize(BINS);
+    foreEchoIm.resize(BINS);
+    backError.resize(BLOCK_FRAMES);
+    foreError.resize(BLOCK_FRAMES);
+
+    mismatch.resize(delayCandidates);
+
+    clearState();
+}
+
+AdaptiveEchoCanceller::~AdaptiveEchoCanceller() = default;
+
+void AdaptiveEchoCanceller::clearState() {
+    fill(historyBlock.begin(), historyBlock.end(), -1);
+    fill(historyEnergy.begin(), historyEnergy.end(), 0.0f);
+    fill(referencePrevious.begin(), referencePrevious.end(), 0.0f);
+    fill(begin(referenceBandMean), end(referenceBandMean), 0.0f);
+    fill(micPrevious.begin(), micPrevious.end(), 0.0f);
+    fill(begin(micBandMean), end(micBandMean), 0.0f);
+
+    fill(backRe.begin(), backRe.end(), 0.0f);
+    fill(backIm.begin(), backIm.end(), 0.0f);
+    fill(foreRe.begin(), foreRe.end(), 0.0f);
+    fill(foreIm.begin(), foreIm.end(), 0.0f);
+    fill(power.begin(), power.end(), 0.0f);
+    filterDelay = 0;
+    nextConstraint = 0;
+
+    // Chưa có dữ liệu: mọi độ trễ ứng viên khác nhau nửa số bit
+    fill(mismatch.begin(), mismatch.end(), BANDS / 2.0f);
+    candidate = -1;
+    candidateBlocks = 0;
+    echoDelay = -1;
+
+    backErrorLevel = 0.0f;
+    foreErrorLevel = 0.0f;
+    micLevel = 0.0f;
+    micEchoLevel = 0.0f;
+    echoLevel = 0.0f;
+    frozenBlocks = 0;
+    relearning = false;
+    betterBlocks = 0;
+    syncPending = true;
+
+    statDelayFrames.store(-1, memory_order_relaxed);
+    statErleDb.store(0.0f, memory_order_relaxed);
+}
+
+void AdaptiveEchoCanceller::reset() {
+    resetRequested.store(true, memory_order_release);
+}
+
+AdaptiveEchoCanceller::Stats AdaptiveEchoCanceller::getStats() const {
+    Stats stats;
+    const int32_t delay = statDelayFrames.load(memory_order_relaxed);
+    stats.delayLocked = delay >= 0;
+    stats.delayFrames = max(delay, 0);
+    stats.erleDb = statErleDb.load(memory_order_relaxed);
+    return stats;
+}
+
+void AdaptiveEchoCanceller::pushReference(const float* mono, size_t frames) {
+    if (reference.write(mono, frames) < frames) {
+        // Phía mic không đọc kịp (hoặc đã dừng): reference mất mẫu, phải căn lại thứ tự hai phía
+        resyncRequested.store(true, memory_order_release);
+    }
+}
+
+void AdaptiveEchoCanceller::process(float* inout, size_t frames) {
+    if (resetRequested.exchange(false, memory_order_acq_rel)) {
+        clearState();
+    }
+    if (resyncRequested.exchange(false, memory_order_acq_rel)) {
+        syncPending = true;
+    }
+    if (syncPending) {
+        // Bỏ reference cũ, mẫu reference đẩy vào sau đây ứng với mẫu mic kế tiếp
+        while (reference.read(referenceBlock.data(), BLOCK_FRAMES) > 0) {
+        }
+        fill(historyBlock.begin(), historyBlock.end(), -1);
+        fill(referenceBlock.begin(), referenceBlock.end(), 0.0f);
+        referenceBlocks = micBlocks;
+        referenceFill = micFill;
+        syncPending = false;
+    }
+    ingestReference();
+
+    size_t done = 0;
+    while (done < frames) {
+        const size_t count = min(frames - done, BLOCK_FRAMES - micFill);
+        // Chép mẫu vào trước khi ghi mẫu ra: xử lý tại chỗ
+        copy(inout + done, inout + done + count, micInput.begin() + micFill);
+        copy(micOutput.begin() + micFill, micOutput.begin() + micFill + count, inout + done);
+        micFill += count;
+        done += count;
+
+        if (micFill == BLOCK_FRAMES) {
+            processBlock();
+            micFill = 0;
+        }
+    }
+}
+
+int AdaptiveEchoCanceller::historySlot(int64_t block) const {
+    if (block < 0) {
+        return -1;
+    }
+    const int slot = static_cast<int>(block % historySize);
+    return historyBlock[slot] == block ? slot : -1;
+}
+
+uint32_t AdaptiveEchoCanceller::binarySpectrum(const float* re, const float* im, float* bandMean) const {
+    uint32_t bits = 0;
+    for (int band = 0; band < BANDS; band++) {
+        const int bin = firstBandBin + band;
+        const float energy = re[bin] * re[bin] + im[bin] * im[bin];
+        if (energy > bandMean[band]) {
+            bits |= 1u << band;
+        }
+        bandMean[band] += BAND_MEAN_RATE * (energy - bandMean[band]);
+    }
+    return bits;
+}
+
+void AdaptiveEchoCanceller::ingestReference() {
+    while (true) {
+        referenceFill += reference.read(referenceBlock.data() + referenceFill, BLOCK_FRAMES - referenceFill);
+        if (referenceFill < BLOCK_FRAMES) {
+            return;
+        }
+        referenceFill = 0;
+
+        const int slot = static_cast<int>(referenceBlocks % historySize);
+        float* re = historyRe.data() + static_cast<size_t>(slot) * BINS;
+        float* im = historyIm.data() + static_cast<size_t>(slot) * BINS;
+        copy(referencePrevious.begin(), referencePrevious.end(), time.begin());
+        copy(referenceBlock.begin(), referenceBlock.end(), time.begin() + BLOCK_FRAMES);
+        fft->forward(time.data(), re, im);
+
+        historyBits[slot] = binarySpectrum(re, im, referenceBandMean);
+        historyEnergy[slot] = blockEnergy(referenceBlock.data(), BLOCK_FRAMES);
+        historyBlock[slot] = referenceBlocks++;
+        referencePrevious.swap(referenceBlock);
+    }
+}
+
+void AdaptiveEchoCanceller::updateDelayEstimate(int64_t block, uint32_t micBits, float micEnergy) {
+    if (micEnergy < ACTIVE_ENERGY) {
+        return;
+    }
+    // Chỉ so với block reference có nhạc, độ trễ nào không so được thì giữ giá trị cũ
+    for (int delay = 0; delay < delayCandidates; delay++) {
+        const int slot = historySlot(block - delay);
+        if (slot < 0 || historyEnergy[slot] < ACTIVE_ENERGY) {
+            continue;
+        }
+        const float differentBits = static_cast<float>(__builtin_popcount(micBits ^ historyBits[slot]));
+        mismatch[delay] += MISMATCH_RATE * (differentBits - mismatch[delay]);
+    }
+
+    int best = 0;
+    float sum = 0.0f;
+    for (int delay = 0; delay < delayCandidates; delay++) {
+        sum += mismatch[delay];
+        if (mismatch[delay] < mismatch[best]) {
+            best = delay;
+        }
+    }
+    const bool confident = sum / delayCandidates - mismatch[best] > LOCK_MARGIN_BITS;
+    if (!confident || best != candidate) {
+        candidate = best;
+        candidateBlocks = 0;
+        return;
+    }
+    if (++candidateBlocks < LOCK_BLOCKS || best == echoDelay) {
+        return;
+    }
+
+    echoDelay = best;
+    statDelayFrames.store(echoDelay * BLOCK_FRAMES, memory_order_relaxed);
+    // Chỉ dời bộ lọc khi echo chính nằm ngoài phần đầu của nó, lệch ít (kể cả độ trễ ước lượng
+    // nhảy qua lại giữa hai block kề nhau) thì bộ lọc tự theo được
+    const int offset = echoDelay - filterDelay;
+    if (offset < 1 || offset > max(LEAD_BLOCKS, partitions / 4)) {
+        shiftFilters(max(0, echoDelay - LEAD_BLOCKS));
+    }
+}
+
+void AdaptiveEchoCanceller::shiftFilters(int newDelay) {
+    // Partition p cũ nhân với reference trễ filterDelay + p, sau khi dời là partition p + shift
+    const int shift = filterDelay - newDelay;
+    filterDelay = newDelay;
+    if (shift == 0) {
+        return;
+    }
+    // Trễ mới chỉ đúng tới một block, phần lệch còn lại phải học lại
+    relearning = true;
+    for (auto* coefficients : { &backRe, &backIm, &foreRe, &foreIm }) {
+        float* w = coefficients->data();
+        if (shift > 0) {
+            for (int p = partitions - 1; p >= 0; p--) {
+                float* target = w + static_cast<size_t>(p) * BINS;
+                if (p - shift >= 0) {
+                    memcpy(target, w + static_cast<size_t>(p - shift) * BINS, BINS * sizeof(float));
+                } else {
+                    memset(target, 0, BINS * sizeof(float));
+                }
+            }
+        } else {
+            for (int p = 0; p < partitions; p++) {
+                float* target = w + static_cast<size_t>(p) * BINS;
+                if (p - shift < partitions) {
+                    memcpy(target, w + static_cast<size_t>(p - shift) * BINS, BINS * sizeof(float));
+                } else {
+                    memset(target, 0, BINS * sizeof(float));
+                }
+            }
+        }
+    }
+}
+
+void AdaptiveEchoCanceller::constrainPartition(int partition) {
+    float* re = backRe.data() + static_cast<size_t>(partition) * BINS;
+    float* im = backIm.data() + static_cast<size_t>(partition) * BINS;
+    fft->inverse(re, im, time.data());
+    // inverse() không chia cho FFT_SIZE
+    const float scale = 1.0f / FFT_SIZE;
+    for (int i = 0; i < BLOCK_FRAMES; i++) {
+        time[i] *= scale;
+    }
+    fill(time.begin() + BLOCK_FRAMES, time.end(), 0.0f);
+    fft->forward(time.data(), re, im);
+}
+
+void AdaptiveEchoCanceller::processBlock() {
+    const int64_t block = micBlocks++;
+    const float* mic = micInput.data();
+
+    // Phổ nhị phân của mic cho ước lượng độ trễ
+    copy(micPrevious.begin(), micPrevious.end(), time.begin());
+    copy(micInput.begin(), micInput.end(), time.begin() + BLOCK_FRAMES);
+    fft->forward(time.data(), spectrumRe.data(), spectrumIm.data());
+    const uint32_t micBits = binarySpectrum(spectrumRe.data(), spectrumIm.data(), micBandMean);
+    copy(micInput.begin(), micInput.end(), micPrevious.begin());
+    const float micEnergy = blockEnergy(mic, BLOCK_FRAMES);
+    updateDelayEstimate(block, micBits, micEnergy);
+
+    // Echo ước lượng của hai bộ lọc: tổng W_p * X(block - filterDelay - p) qua mọi partition
+    fill(echoRe.begin(), echoRe.end(), 0.0f);
+    fill(echoIm.begin(), echoIm.end(), 0.0f);
+    fill(foreEchoRe.begin(), foreEchoRe.end(), 0.0f);
+    fill(foreEchoIm.begin(), foreEchoIm.end(), 0.0f);
+    for (int p = 0; p < partitions; p++) {
+        const int slot = historySlot(block - filterDelay - p);
+        if (slot < 0) {
+            continue;
+        }
+        const float* xr = historyRe.data() + static_cast<size_t>(slot) * BINS;
+        const float* xi = historyIm.data() + static_cast<size_t>(slot) * BINS;
+        const float* br = backRe.data() + static_cast<size_t>(p) * BINS;
+        const float* bi = backIm.data() + static_cast<size_t>(p) * BINS;
+        const float* fr = foreRe.data() + static_cast<size_t>(p) * BINS;
+        const float* fi = foreIm.data() + static_cast<size_t>(p) * BINS;
+        for (int k = 0; k < BINS; k++) {
+            echoRe[k] += br[k] * xr[k] - bi[k] * xi[k];
+            echoIm[k] += br[k] * xi[k] + bi[k] * xr[k];
+            foreEchoRe[k] += fr[k] * xr[k] - fi[k] * xi[k];
+            foreEchoIm[k] += fr[k] * xi[k] + fi[k] * xr[k];
+        }
+    }
+
+    // Overlap-save: nửa sau của tích chập vòng là tích chập tuyến tính
+    const float scale = 1.0f / FFT_SIZE;
+    fft->inverse(echoRe.data(), echoIm.data(), time.data());
+    for (int i = 0; i < BLOCK_FRAMES; i++) {
+        backError[i] = mic[i] - time[BLOCK_FRAMES + i] * scale;
+    }
+    fft->inverse(foreEchoRe.data(), foreEchoIm.data(), time.data());
+    float micEcho = 0.0f;
+    float echoEnergy = 0.0f;
+    for (int i = 0; i < BLOCK_FRAMES; i++) {
+        const float echo = time[BLOCK_FRAMES + i] * scale;
+        foreError[i] = mic[i] - echo;
+        micEcho += mic[i] * echo;
+        echoEnergy += echo * echo;
+    }
+
+    // Công suất reference theo bin, làm mượt qua khoảng bằng độ dài bộ lọc
+    const int newestSlot = historySlot(block - filterDelay);
+    const bool farEndActive = newestSlot >= 0 && historyEnergy[newestSlot] >= ACTIVE_ENERGY;
+    const float powerRate = 1.0f / partitions;
+    if (newestSlot >= 0) {
+        const float* xr = historyRe.data() + static_cast<size_t>(newestSlot) * BINS;
+        const float* xi = historyIm.data() + static_cast<size_t>(newestSlot) * BINS;
+        for (int k = 0; k < BINS; k++) {
+            power[k] += powerRate * (xr[k] * xr[k] + xi[k] * xi[k] - power[k]);
+        }
+    } else {
+        for (int k = 0; k < BINS; k++) {
+            power[k] -= powerRate * power[k];
+        }
+    }
+
+    // Chỉ có echo thì mic gần như tỷ lệ với echo ước lượng của foreground (kể cả khi nó mới học được
+    // một phần), có giọng thì tương quan giảm theo tỷ lệ giọng / echo. Dùng foreground vì nó không
+    // thích nghi theo giọng. Foreground còn rỗng thì chưa có gì để giữ, còn ngừng quá lâu thì nhiều
+    // khả năng đường echo đã đổi (foreground sai chứ không phải đang hát): thích nghi đủ bước.
+    micLevel += ERROR_RATE * (micEnergy - micLevel);
+    micEchoLevel += ERROR_RATE * (micEcho / BLOCK_FRAMES - micEchoLevel);
+    echoLevel += ERROR_RATE * (echoEnergy / BLOCK_FRAMES - echoLevel);
+    if (frozenBlocks >= freezeTimeoutBlocks) {
+        relearning = true;
+    }
+    float coherence = 1.0f;
+    if (!relearning && echoLevel > ACTIVE_ENERGY * 1e-2f) {
+        // Giá trị làm mượt giữ trạng thái hát chồng qua các quãng ngắt, giá trị của riêng block này
+        // bắt được ngay lúc bắt đầu hát
+        coherence = min(micEchoLevel * micEchoLevel / max(micLevel * echoLevel, 1e-30f),
+                        micEcho * micEcho / max(micEnergy * BLOCK_FRAMES * echoEnergy, 1e-30f));
+    }
+    const float stepScale = clamp((coherence - COHERENCE_FREEZE) / (COHERENCE_FULL - COHERENCE_FREEZE), 0.0f, 1.0f);
+    frozenBlocks = stepScale > 0.0f || !farEndActive ? 0 : frozenBlocks + 1;
+
+    if (farEndActive && stepScale > 0.0f) {
+        // NLMS cho background: W_p += step * conj(X_p) * E / (partitions * công suất)
+        fill(time.begin(), time.begin() + BLOCK_FRAMES, 0.0f);
+        copy(backError.begin(), backError.end(), time.begin() + BLOCK_FRAMES);
+        fft->forward(time.data(), spectrumRe.data(), spectrumIm.data());
+        for (int k = 0; k < BINS; k++) {
+            const float norm = STEP * stepScale / (partitions * power[k] + REGULARIZATION);
+            spectrumRe[k] *= norm;
+            spectrumIm[k] *= norm;
+        }
+        for (int p = 0; p < partitions; p++) {
+            const int slot = historySlot(block - filterDelay - p);
+            if (slot < 0) {
+                continue;
+            }
+            const float* xr = historyRe.data() + static_cast<size_t>(slot) * BINS;
+            const float* xi = historyIm.data() + static_cast<size_t>(slot) * BINS;
+            float* br = backRe.data() + static_cast<size_t>(p) * BINS;
+            float* bi = backIm.data() + static_cast<size_t>(p) * BINS;
+            for (int k = 0; k < BINS; k++) {
+                br[k] += xr[k] * spectrumRe[k] + xi[k] * spectrumIm[k];
+                bi[k] += xr[k] * spectrumIm[k] - xi[k] * spectrumRe[k];
+            }
+        }
+        // Mỗi block chỉ ràng buộc một partition để chi phí cố định
+        constrainPartition(nextConstraint);
+        nextConstraint = (nextConstraint + 1) % partitions;
+    }
+
+    // Foreground nhận hệ số của background khi không hát chồng, background khử tốt hơn rõ ràng vài
+    // block liền và bản thân nó khử được ít nhất 6 dB so với mic. Background lệch quá xa thì quay lại
+    // từ foreground.
+    backErrorLevel += ERROR_RATE * (blockEnergy(backError.data(), BLOCK_FRAMES) - backErrorLevel);
+    foreErrorLevel += ERROR_RATE * (blockEnergy(foreError.data(), BLOCK_FRAMES) - foreErrorLevel);
+    if (farEndActive) {
+        if (stepScale > 0.0f && backErrorLevel < COPY_RATIO * foreErrorLevel &&
+            backErrorLevel < COPY_MAX_RESIDUAL * micLevel) {
+            if (++betterBlocks >= COPY_BLOCKS) {
+                copy(backRe.begin(), backRe.end(), foreRe.begin());
+                copy(backIm.begin(), backIm.end(), foreIm.begin());
+                foreErrorLevel = backErrorLevel;
+                betterBlocks = 0;
+                relearning = false;
+            }
+        } else {
+            betterBlocks = 0;
+            if (backErrorLevel > DIVERGED_RATIO * foreErrorLevel) {
+                copy(foreRe.begin(), foreRe.end(), backRe.begin());
+                copy(foreIm.begin(), foreIm.end(), backIm.begin());
+                backErrorLevel = foreErrorLevel;
+            }
+        }
+        if (micLevel >= ACTIVE_ENERGY) {
+            statErleDb.store(10.0f * log10f(micLevel / max(foreErrorLevel, 1e-12f)), memory_order_relaxed);
+        }
+    }
+
+    copy(foreError.begin(), foreError.end(), micOutput.begin());
+}
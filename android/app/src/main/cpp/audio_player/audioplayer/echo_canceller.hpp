@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ring_buffer.hpp"
+
+namespace RubberBand {
+class FFT;
+}
+
+/*
+    AdaptiveEchoCanceller: khử tiếng nhạc nền từ loa lọt vào mic (mono), dùng chung cho mọi nền tảng.
+    - Bộ lọc thích nghi NLMS miền tần số chia khối (partitioned-block, overlap-save) trên FFT của
+      rubberband: block BLOCK_FRAMES mẫu, đuôi echo tailMillis ms chia thành nhiều partition.
+    - Reference (far-end) là nhạc đã mix đưa ra loa, không gồm giọng từ mic (giọng hát ngân dài
+      tương quan với chính nó, lọc theo nó sẽ khử luôn giọng). pushReference() và process() gọi
+      được trên hai thread khác nhau, ở giữa là ring một producer / một consumer.
+    - Độ trễ loa -> mic (buffer đầu ra + đầu vào + đường truyền âm) được ước lượng tự động tới
+      maxDelayMillis: phổ nhị phân của mic (băng nào mạnh hơn trung bình của nó) được so với phổ
+      nhị phân của từng block reference trong lịch sử. Bộ lọc chỉ phủ phần đuôi sau độ trễ đó,
+      trễ đổi (vd buffer đầu ra được chỉnh) thì hệ số được dời theo chứ không học lại.
+    - Hai bộ lọc: background thích nghi liên tục, foreground tạo output và chỉ nhận hệ số của
+      background khi background khử tốt hơn. Lúc hát chồng lên nhạc (double-talk) background lệch
+      đi nhưng foreground giữ nguyên; background lệch quá xa thì được đặt lại từ foreground.
+    - Chi phí mỗi block cố định, không phụ thuộc tín hiệu: 7 FFT kích thước 2 * BLOCK_FRAMES,
+      3 lượt nhân phức qua mọi partition, ràng buộc gradient cho một partition (xoay vòng) và so
+      phổ nhị phân với mọi độ trễ ứng viên.
+    Cấp phát trong constructor, pushReference()/process() không cấp phát, không khóa.
+*/
+class AdaptiveEchoCanceller {
+public:
+    // Kích thước block xử lý, cũng là độ trễ process() thêm vào đường mic
+    static constexpr int BLOCK_FRAMES = 128;
+
+    struct Stats {
+        bool delayLocked = false; // Đã tìm được độ trễ loa -> mic
+        int32_t delayFrames = 0;  // Độ trễ đó (bội số của BLOCK_FRAMES)
+        float erleDb = 0.0f;      // Echo đã khử: mức mic so với output khi có nhạc
+    };
+
+    explicit AdaptiveEchoCanceller(int sampleRate, int tailMillis = 64, int maxDelayMillis = 500);
+    ~AdaptiveEchoCanceller();
+
+    AdaptiveEchoCanceller(const AdaptiveEchoCanceller&) = delete;
+    AdaptiveEchoCanceller& operator=(const AdaptiveEchoCanceller&) = delete;
+
+    // Thread phát: nhạc (mono) vừa đưa ra loa, theo đúng thứ tự phát
+    void pushReference(const float* mono, size_t frames);
+    // Thread mic: khử echo tại chỗ, output trễ BLOCK_FRAMES mẫu so với input
+    void process(float* inout, size_t frames);
+    // Thread bất kỳ: bỏ bộ lọc và độ trễ đã học, áp dụng ở lần process() kế tiếp
+    void reset();
+
+    Stats getStats() const;
+    int getSampleRate() const { return sampleRate; }
+
+private:
+    static constexpr int FFT_SIZE = BLOCK_FRAMES * 2;
+    static constexpr int BINS = BLOCK_FRAMES + 1;
+    static constexpr int BANDS = 32; // Số bit của phổ nhị phân
+
+    // Đưa mọi block reference đã đủ vào lịch sử phổ
+    void ingestReference();
+    // Khử echo cho micInput, ghi vào micOutput
+    void processBlock();
+    void updateDelayEstimate(int64_t block, uint32_t micBits, float micEnergy);
+    // Dời hệ số của cả hai bộ lọc khi độ trễ của partition đầu đổi sang newDelay (block)
+    void shiftFilters(int newDelay);
+    // Ràng buộc gradient: hệ số của partition chỉ giữ BLOCK_FRAMES tap đầu
+    void constrainPartition(int partition);
+    // Phổ nhị phân của các băng, cập nhật ngưỡng (trung bình trượt) của từng băng
+    uint32_t binarySpectrum(const float* re, const float* im, float* bandMean) const;
+    // Vị trí của block reference trong lịch sử, -1 nếu không có (chưa tới hoặc đã bị ghi đè)
+    int historySlot(int64_t block) const;
+    void clearState();
+
+    const int sampleRate;
+    const int partitions;      // Số partition của bộ lọc (đuôi echo)
+    const int delayCandidates; // Số độ trễ ứng viên (block)
+    const int historySize;     // Số block phổ reference giữ lại
+    int firstBandBin = 1;
+
+    std::unique_ptr<RubberBand::FFT> fft;
+    RingBuffer reference;
+    const int freezeTimeoutBlocks;
+
+    // Lịch sử reference: phổ của cửa sổ [block trước, block này], phổ nhị phân, năng lượng
+    std::vector<float> historyRe;
+    std::vector<float> historyIm;
+    std::vector<int64_t> historyBlock;
+    std::vector<uint32_t> historyBits;
+    std::vector<float> historyEnergy;
+    int64_t referenceBlocks = 0; // Chỉ số block reference kế tiếp
+    std::vector<float> referenceBlock; // Block reference đang gom
+    size_t referenceFill = 0;
+    std::vector<float> referencePrevious;
+    float referenceBandMean[BANDS];
+
+    // Mic: gom đủ block rồi xử lý, output trễ một block
+    std::vector<float> micInput;
+    std::vector<float> micOutput;
+    std::vector<float> micPrevious;
+    size_t micFill = 0;
+    int64_t micBlocks = 0;
+    float micBandMean[BANDS];
+
+    // Hệ số: partitions * BINS, partition p nhân với reference trễ filterDelay + p block
+    std::vector<float> backRe;
+    std::vector<float> backIm;
+    std::vector<float> foreRe;
+    std::vector<float> foreIm;
+    std::vector<float> power; // Công suất reference theo bin (làm mượt)
+    int filterDelay = 0;
+    int nextConstraint = 0;
+
+    // Buffer tạm
+    std::vector<float> time;
+    std::vector<float> spectrumRe;
+    std::vector<float> spectrumIm;
+    std::vector<float> echoRe;
+    std::vector<float> echoIm;
+    std::vector<float> foreEchoRe;
+    std::vector<float> foreEchoIm;
+    std::vector<float> backError;
+    std::vector<float> foreError;
+
+    // Ước lượng độ trễ
+    std::vector<float> mismatch; // Số bit khác nhau trung bình theo từng độ trễ ứng viên
+    int candidate = -1;
+    int candidateBlocks = 0;
+    int echoDelay = -1; // Độ trễ đã chốt (block), -1 nếu chưa
+
+    // Chọn bộ lọc
+    float backErrorLevel = 0.0f;
+    float foreErrorLevel = 0.0f;
+    float micLevel = 0.0f;
+    float micEchoLevel = 0.0f; // Tương quan mic với echo ước lượng của foreground
+    float echoLevel = 0.0f;
+    int frozenBlocks = 0;      // Số block liền ngừng thích nghi
+    bool relearning = false;   // Thích nghi đủ bước tới lần chép sang foreground kế tiếp
+    int betterBlocks = 0;
+    // Căn block reference kế tiếp theo vị trí mic hiện tại (sau reset hoặc khi reference mất mẫu)
+    bool syncPending = true;
+
+    std::atomic<bool> resetRequested{false};
+    std::atomic<bool> resyncRequested{false};
+    std::atomic<int32_t> statDelayFrames{-1};
+    std::atomic<float> statErleDb{0.0f};
+};
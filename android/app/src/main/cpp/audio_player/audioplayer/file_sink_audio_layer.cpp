@@ -0,0 +1,122 @@
+#include "file_sink_audio_layer.hpp"
+#include "common.hpp"
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+// RIFF header (12) + fmt chunk (8 + 18) + fact chunk (8 + 4) + header data chunk (8)
+constexpr uint32_t HEADER_BYTES = 12 + 26 + 12 + 8;
+constexpr uint64_t MAX_DATA_BYTES = numeric_limits<uint32_t>::max() - HEADER_BYTES;
+
+void putLE(uint8_t*& out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *out++ = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void putTag(uint8_t*& out, const char* tag) {
+    for (int i = 0; i < 4; i++) {
+        *out++ = static_cast<uint8_t>(tag[i]);
+    }
+}
+
+} // namespace
+
+FileSinkAudioLayer::FileSinkAudioLayer(string path)
+    : FileSinkAudioLayer(std::move(path), Config()) {
+}
+
+FileSinkAudioLayer::FileSinkAudioLayer(string path, const Config& config)
+    : NullAudioLayer(config), path(std::move(path)) {
+}
+
+FileSinkAudioLayer::~FileSinkAudioLayer() {
+    // Dừng thread render trước khi hủy file mà onBlockRendered đang ghi
+    NullAudioLayer::stop();
+    closeFile();
+}
+
+bool FileSinkAudioLayer::initialize() {
+    if (!NullAudioLayer::initialize()) {
+        return false;
+    }
+    closeFile();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        debugPrint("FileSinkAudioLayer: cannot open {}", path);
+        return false;
+    }
+    dataBytes = 0;
+    writeHeader();
+    return true;
+}
+
+void FileSinkAudioLayer::shutdown() {
+    NullAudioLayer::shutdown();
+    closeFile();
+}
+
+void FileSinkAudioLayer::stop() {
+    NullAudioLayer::stop();
+    if (file) {
+        writeHeader();
+        fflush(file);
+    }
+}
+
+void FileSinkAudioLayer::onBlockRendered(const float* mix, int32_t frames) {
+    if (!file) {
+        return;
+    }
+    // PCM float little-endian: ghi thẳng buffer (Android/x86 đều little-endian)
+    const uint64_t bytes = min<uint64_t>(static_cast<uint64_t>(frames) * frameBytes(), MAX_DATA_BYTES - dataBytes);
+    if (bytes > 0 && fwrite(mix, 1, bytes, file) == bytes) {
+        dataBytes += bytes;
+    }
+}
+
+void FileSinkAudioLayer::writeHeader() {
+    const Config& config = getConfig();
+    const uint32_t sampleRate = static_cast<uint32_t>(config.sampleRate);
+    const uint32_t channels = static_cast<uint32_t>(config.channels);
+    const uint32_t dataSize = static_cast<uint32_t>(dataBytes);
+
+    uint8_t header[HEADER_BYTES];
+    uint8_t* out = header;
+    putTag(out, "RIFF");
+    putLE(out, HEADER_BYTES - 8 + dataSize, 4);
+    putTag(out, "WAVE");
+
+    putTag(out, "fmt ");
+    putLE(out, 18, 4);
+    putLE(out, WAVE_FORMAT_IEEE_FLOAT, 2);
+    putLE(out, channels, 2);
+    putLE(out, sampleRate, 4);
+    putLE(out, sampleRate * frameBytes(), 4); // Byte mỗi giây
+    putLE(out, frameBytes(), 2);              // Block align
+    putLE(out, 32, 2);                        // Bit mỗi mẫu
+    putLE(out, 0, 2);                         // cbSize
+
+    // Định dạng không phải PCM cần chunk fact (số frame)
+    putTag(out, "fact");
+    putLE(out, 4, 4);
+    putLE(out, dataSize / frameBytes(), 4);
+
+    putTag(out, "data");
+    putLE(out, dataSize, 4);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), file);
+    fseek(file, 0, SEEK_END);
+}
+
+void FileSinkAudioLayer::closeFile() {
+    if (file) {
+        writeHeader();
+        fclose(file);
+        file = nullptr;
+    }
+}
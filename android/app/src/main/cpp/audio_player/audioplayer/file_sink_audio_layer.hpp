@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "null_audio_layer.hpp"
+
+/*
+    FileSinkAudioLayer: NullAudioLayer ghi thêm kết quả mix ra file WAV float 32-bit (IEEE float),
+    đúng từng mẫu mà thiết bị sẽ nhận. Dùng để so sánh đầu ra trong test hồi quy hoặc nghe lại
+    kết quả của CI. File được mở lại (ghi đè) ở mỗi initialize(); header được cập nhật ở mỗi stop()
+    nên file luôn đọc được sau khi dừng. Giới hạn 4 GB của RIFF: phần vượt quá bị bỏ.
+*/
+class FileSinkAudioLayer : public NullAudioLayer {
+public:
+    explicit FileSinkAudioLayer(std::string path);
+    FileSinkAudioLayer(std::string path, const Config& config);
+    ~FileSinkAudioLayer() override;
+
+    bool initialize() override;
+    void shutdown() override;
+    void stop() override;
+
+    const std::string& getPath() const { return path; }
+    // Số frame đã ghi vào file
+    uint64_t getFramesWritten() const { return dataBytes / frameBytes(); }
+
+protected:
+    void onBlockRendered(const float* mix, int32_t frames) override;
+
+private:
+    uint32_t frameBytes() const { return static_cast<uint32_t>(getConfig().channels * sizeof(float)); }
+    void writeHeader();
+    void closeFile();
+
+    std::string path;
+    FILE* file = nullptr;
+    uint64_t dataBytes = 0; // Chỉ thread render ghi khi đang chạy
+};
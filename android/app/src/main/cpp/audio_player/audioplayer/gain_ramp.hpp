@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "mix_kernels.hpp"
+
+/*
+    Làm mượt gain theo cách của oboe::flowgraph::RampLinear: đổi target thì gain chạy tuyến tính
+    từ mức hiện tại tới target trong lengthInFrames frame, đổi target giữa chừng thì ramp mới
+    bắt đầu từ mức đang có. Chỉ dùng trên audio thread (target đến từ hàng đợi tham số/atomic).
+*/
+class GainRamp {
+public:
+    static constexpr int32_t DEFAULT_RAMP_FRAMES = 480; // 10ms ở 48kHz
+
+    explicit GainRamp(float level = 1.0f, int32_t lengthInFrames = DEFAULT_RAMP_FRAMES)
+        : lengthInFrames(std::max<int32_t>(lengthInFrames, 1)), levelFrom(level), levelTo(level) {}
+
+    void setTarget(float target) {
+        if (target != levelTo) {
+            levelFrom = current();
+            levelTo = target;
+            remaining = lengthInFrames;
+            scaler = (levelTo - levelFrom) / lengthInFrames;
+        }
+    }
+
+    // Nhảy thẳng tới level, chỉ dùng khi bus chưa phát (không có ramp để tránh click)
+    void forceCurrent(float level) {
+        levelFrom = level;
+        levelTo = level;
+        remaining = 0;
+        scaler = 0.0f;
+    }
+
+    float current() const { return levelTo - remaining * scaler; }
+    float target() const { return levelTo; }
+    bool isRamping() const { return remaining > 0; }
+    bool isSilent() const { return remaining == 0 && levelTo == 0.0f; }
+
+    // Số frame (tối đa maxFrames) mà gain còn tuyến tính với cùng một bước
+    int32_t segmentFrames(int32_t maxFrames) const { return remaining > 0 ? std::min(maxFrames, remaining) : maxFrames; }
+    float step() const { return remaining > 0 ? scaler : 0.0f; }
+    void advance(int32_t frames) { remaining = std::max<int32_t>(remaining - frames, 0); }
+
+    // Nhân gain (có ramp) vào buffer interleaved
+    void apply(float* buffer, int32_t frames, int32_t channels) {
+        int32_t done = 0;
+        while (done < frames) {
+            const int32_t count = segmentFrames(frames - done);
+            const float start = current();
+            const float delta = step();
+            float* frame = buffer + done * channels;
+            for (int32_t i = 0; i < count; i++) {
+                const float gain = start + delta * i;
+                for (int32_t c = 0; c < channels; c++) {
+                    frame[i * channels + c] *= gain;
+                }
+            }
+            advance(count);
+            done += count;
+        }
+    }
+
+private:
+    int32_t lengthInFrames;
+    int32_t remaining = 0;
+    float scaler = 0.0f;
+    float levelFrom;
+    float levelTo;
+};
+
+/*
+    Gain trái/phải của một bus khi mix ra stereo (volume, mute và pan), mỗi bên một GainRamp.
+    Pan kiểu balance: giữa (0) giữ nguyên hai kênh, lệch sang một bên thì giảm dần bên kia.
+*/
+class StereoGainRamp {
+public:
+    void setTarget(float gain, float pan) {
+        left.setTarget(gain * panLeft(pan));
+        right.setTarget(gain * panRight(pan));
+    }
+
+    void forceCurrent(float gain, float pan) {
+        left.forceCurrent(gain * panLeft(pan));
+        right.forceCurrent(gain * panRight(pan));
+    }
+
+    bool isSilent() const { return left.isSilent() && right.isSilent(); }
+
+    // Đoạn tiếp theo (tối đa maxFrames) có gain tuyến tính trên cả hai kênh.
+    // Gọi advance() với số frame đã dùng.
+    int32_t nextSegment(int32_t maxFrames, mix::StereoGain& gain) const {
+        gain = {left.current(), right.current(), left.step(), right.step()};
+        return std::min(left.segmentFrames(maxFrames), right.segmentFrames(maxFrames));
+    }
+
+    void advance(int32_t frames) {
+        left.advance(frames);
+        right.advance(frames);
+    }
+
+    static float panLeft(float pan) { return pan > 0.0f ? 1.0f - pan : 1.0f; }
+    static float panRight(float pan) { return pan < 0.0f ? 1.0f + pan : 1.0f; }
+
+private:
+    GainRamp left;
+    GainRamp right;
+};
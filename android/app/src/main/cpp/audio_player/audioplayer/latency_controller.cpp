@@ -0,0 +1,108 @@
+#include "latency_controller.hpp"
+#include <algorithm>
+
+using namespace std;
+
+int32_t LatencyController::reset(int32_t framesPerBurst, int32_t capacityFrames, int32_t sampleRate,
+                                 int32_t stableMillis) {
+    this->framesPerBurst = max(framesPerBurst, 1);
+    this->capacityFrames = max(capacityFrames, this->framesPerBurst);
+    minimumFrames = min(this->framesPerBurst * MIN_BURSTS, this->capacityFrames);
+    baseStableFrames = static_cast<int64_t>(max(sampleRate, 1)) * max(stableMillis, 1) / 1000;
+
+    idleCallbacks = 0;
+    lastXRunCount = 0;
+    requestedFrames = 0;
+    framesSinceChange = 0;
+    stableFrames = baseStableFrames;
+    lastChangeWasDecay = false;
+
+    bufferFrames.store(minimumFrames, memory_order_relaxed);
+    state.store(State::Idle, memory_order_relaxed);
+    return minimumFrames;
+}
+
+void LatencyController::resume() {
+    if (state.load(memory_order_relaxed) == State::Unsupported) {
+        return;
+    }
+    idleCallbacks = 0;
+    framesSinceChange = 0;
+    state.store(State::Idle, memory_order_relaxed);
+}
+
+void LatencyController::disable(int32_t bufferFrames) {
+    this->bufferFrames.store(bufferFrames, memory_order_relaxed);
+    state.store(State::Unsupported, memory_order_relaxed);
+}
+
+int32_t LatencyController::onCallback(int32_t xrunCount, int32_t numFrames) {
+    const State current = state.load(memory_order_relaxed);
+    if (current == State::Unsupported) {
+        return 0;
+    }
+    if (xrunCount < 0) {
+        state.store(State::Unsupported, memory_order_relaxed);
+        return 0;
+    }
+
+    if (current == State::Idle) {
+        // Lấy mốc xrun sau giai đoạn khởi động, các xrun trước đó không phản ánh kích thước buffer
+        lastXRunCount = xrunCount;
+        if (++idleCallbacks >= IDLE_CALLBACKS) {
+            state.store(State::Active, memory_order_relaxed);
+        }
+        return 0;
+    }
+
+    const int32_t frames = bufferFrames.load(memory_order_relaxed);
+    if (xrunCount > lastXRunCount) {
+        lastXRunCount = xrunCount;
+        // Xrun ngay sau khi bớt buffer: lần bớt vừa rồi là quá tay, chờ lâu hơn trước lần sau
+        if (lastChangeWasDecay) {
+            stableFrames = min(stableFrames * 2, baseStableFrames * MAX_BACKOFF);
+        }
+        lastChangeWasDecay = false;
+        framesSinceChange = 0;
+        if (current == State::AtMax) {
+            return 0;
+        }
+        if (frames >= capacityFrames) {
+            state.store(State::AtMax, memory_order_relaxed);
+            return 0;
+        }
+        requestedFrames = min(frames + framesPerBurst, capacityFrames);
+        return requestedFrames;
+    }
+
+    framesSinceChange += numFrames;
+    if (framesSinceChange < stableFrames) {
+        return 0;
+    }
+    framesSinceChange = 0;
+    // Lần bớt trước đã chạy ổn định trọn một chu kỳ: quên dần các lần dao động trước đó
+    if (lastChangeWasDecay) {
+        stableFrames = max(stableFrames / 2, baseStableFrames);
+    }
+    if (frames <= minimumFrames) {
+        return 0;
+    }
+    lastChangeWasDecay = true;
+    requestedFrames = max(frames - framesPerBurst, minimumFrames);
+    return requestedFrames;
+}
+
+void LatencyController::onBufferSizeApplied(int32_t actualFrames) {
+    if (actualFrames <= 0) {
+        // Stream từ chối đổi buffer: giữ kích thước đang có
+        state.store(State::Unsupported, memory_order_relaxed);
+        return;
+    }
+    const int32_t previous = bufferFrames.exchange(actualFrames, memory_order_relaxed);
+    // Yêu cầu tăng mà thiết bị không cho lớn hơn: không thử tăng nữa
+    if (requestedFrames > previous && actualFrames <= previous) {
+        state.store(State::AtMax, memory_order_relaxed);
+    } else if (state.load(memory_order_relaxed) == State::AtMax && actualFrames < capacityFrames) {
+        state.store(State::Active, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+    LatencyController: chọn kích thước buffer đầu ra nhỏ nhất không bị underrun, theo kiểu
+    oboe::LatencyTuner.
+    - Bắt đầu từ MIN_BURSTS burst
+    - Mỗi lần bộ đếm xrun của stream tăng: thêm một burst (tối đa bằng capacity của stream)
+    - Chạy ổn định đủ lâu (stablePeriod) không xrun: bớt một burst, không xuống dưới mức tối thiểu
+    - Bớt xong mà xrun lại ngay trong stablePeriod thì lần bớt sau phải chờ gấp đôi (tối đa
+      MAX_BACKOFF lần), tránh dao động quanh ngưỡng
+
+    Trạng thái thay đổi trên audio thread (onCallback), thread app đọc kích thước buffer hiện tại
+    qua getBufferFrames() để quy đổi ra độ trễ.
+*/
+class LatencyController {
+public:
+    enum class State {
+        Idle,       // Vài callback đầu sau khi start, xrun lúc khởi động không tính
+        Active,
+        AtMax,      // Đã bằng capacity, không tăng được nữa
+        Unsupported // Stream không báo xrun hoặc không cho đổi buffer: giữ nguyên kích thước
+    };
+
+    static constexpr int32_t MIN_BURSTS = 2;
+    static constexpr int32_t IDLE_CALLBACKS = 8;
+    static constexpr int32_t DEFAULT_STABLE_MILLIS = 10000;
+    static constexpr int32_t MAX_BACKOFF = 16;
+
+    // Thread app, stream chưa chạy: bắt đầu lại từ buffer tối thiểu.
+    // Trả về kích thước buffer cần đặt cho stream.
+    int32_t reset(int32_t framesPerBurst, int32_t capacityFrames, int32_t sampleRate,
+                  int32_t stableMillis = DEFAULT_STABLE_MILLIS);
+    // Thread app, stream sắp start lại: giữ kích thước đã chọn, lấy lại mốc xrun sau khởi động
+    void resume();
+    // Thread app: stream không hỗ trợ điều chỉnh, bufferFrames là kích thước cố định của nó
+    void disable(int32_t bufferFrames);
+
+    // Audio thread, mỗi callback: xrunCount là bộ đếm cộng dồn của stream (âm = không đọc được).
+    // Trả về kích thước buffer mới cần đặt, 0 nếu giữ nguyên.
+    int32_t onCallback(int32_t xrunCount, int32_t numFrames);
+    // Audio thread: kết quả setBufferSizeInFrames() cho yêu cầu vừa trả về (âm = thất bại)
+    void onBufferSizeApplied(int32_t actualFrames);
+
+    // Mọi thread
+    int32_t getBufferFrames() const { return bufferFrames.load(std::memory_order_relaxed); }
+    State getState() const { return state.load(std::memory_order_relaxed); }
+
+private:
+    int32_t framesPerBurst = 0;
+    int32_t minimumFrames = 0;
+    int32_t capacityFrames = 0;
+    int64_t baseStableFrames = 0;
+
+    // Chỉ audio thread (và reset() khi stream dừng)
+    int32_t idleCallbacks = 0;
+    int32_t lastXRunCount = 0;
+    int32_t requestedFrames = 0;
+    int64_t framesSinceChange = 0;
+    int64_t stableFrames = 0;
+    bool lastChangeWasDecay = false;
+
+    std::atomic<int32_t> bufferFrames{0};
+    std::atomic<State> state{State::Unsupported};
+};
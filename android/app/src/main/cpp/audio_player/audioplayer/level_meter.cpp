@@ -0,0 +1,84 @@
+#include "level_meter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+LevelMeter::Coefficients LevelMeter::Coefficients::compute(float rmsWindowFrames, float holdFrames,
+                                                           float decayDbPerFrame, int32_t blockFrames) {
+    Coefficients coefficients;
+    // Trung bình mũ theo block: tương đương lọc một cực với hằng số thời gian rmsWindowFrames
+    coefficients.rmsAlpha = rmsWindowFrames > 0.0f ? 1.0f - expf(-blockFrames / rmsWindowFrames) : 1.0f;
+    coefficients.peakDecay = powf(10.0f, -max(decayDbPerFrame, 0.0f) * blockFrames / 20.0f);
+    coefficients.holdFrames = llroundf(max(holdFrames, 0.0f));
+    return coefficients;
+}
+
+void LevelMeter::update(const mix::Levels& levels, int32_t frames, const Coefficients& coefficients) {
+    if (frames <= 0) {
+        return;
+    }
+
+    for (int channel = 0; channel < 2; channel++) {
+        // Block có NaN/inf (nguồn lỗi) không được đưa vào để meter không kẹt ở NaN
+        const float blockMeanSquare = levels.sumSquares[channel] / frames;
+        if (isfinite(blockMeanSquare)) {
+            meanSquare[channel] += coefficients.rmsAlpha * (blockMeanSquare - meanSquare[channel]);
+        }
+        if (meanSquare[channel] < SILENCE * SILENCE) {
+            meanSquare[channel] = 0.0f;
+        }
+
+        const float blockPeak = isfinite(levels.peak[channel]) ? levels.peak[channel] : 0.0f;
+        if (blockPeak >= heldPeak[channel]) {
+            heldPeak[channel] = blockPeak;
+            holdRemaining[channel] = coefficients.holdFrames;
+        } else if (holdRemaining[channel] > 0) {
+            holdRemaining[channel] -= frames;
+        } else {
+            heldPeak[channel] = max(heldPeak[channel] * coefficients.peakDecay, blockPeak);
+        }
+        if (heldPeak[channel] < SILENCE) {
+            heldPeak[channel] = 0.0f;
+        }
+    }
+    totalClips += levels.clips;
+
+    const uint32_t begin = sequence.load(memory_order_relaxed);
+    sequence.store(begin + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int channel = 0; channel < 2; channel++) {
+        publishedPeak[channel].store(heldPeak[channel], memory_order_relaxed);
+        publishedRms[channel].store(sqrtf(meanSquare[channel]), memory_order_relaxed);
+    }
+    publishedClips.store(totalClips, memory_order_relaxed);
+    sequence.store(begin + 2, memory_order_release);
+}
+
+MeterLevels LevelMeter::read() const {
+    MeterLevels result;
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++) {
+        const uint32_t before = sequence.load(memory_order_acquire);
+        if (before & 1) {
+            this_thread::yield();
+            continue;
+        }
+        loadPublished(result);
+        atomic_thread_fence(memory_order_acquire);
+        if (sequence.load(memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+    // Chỉ xảy ra nếu audio thread ghi liên tục: trả về lần đọc cuối, từng trường vẫn hợp lệ
+    loadPublished(result);
+    return result;
+}
+
+void LevelMeter::loadPublished(MeterLevels& levels) const {
+    for (int channel = 0; channel < 2; channel++) {
+        levels.peak[channel] = publishedPeak[channel].load(memory_order_relaxed);
+        levels.rms[channel] = publishedRms[channel].load(memory_order_relaxed);
+    }
+    levels.clips = publishedClips.load(memory_order_relaxed);
+}
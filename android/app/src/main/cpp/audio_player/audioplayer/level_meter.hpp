@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "mix_kernels.hpp"
+
+// Đặc tính động của meter (giống đồng hồ VU/PPM trên bàn mixer)
+struct MeterBallistics {
+    float rmsWindowMillis = 300.0f;     // Hằng số thời gian của RMS
+    float peakHoldMillis = 1000.0f;     // Giữ peak cao nhất trước khi cho hạ xuống
+    float peakDecayDbPerSecond = 20.0f; // Tốc độ hạ của peak sau thời gian giữ
+};
+
+// Mức của một bus (hoặc master) tại lần đọc, biên độ tuyến tính (1.0 = 0 dBFS)
+struct MeterLevels {
+    int busId = -1; // -1 = master (sau limiter)
+    float peak[2] = {0.0f, 0.0f};
+    float rms[2] = {0.0f, 0.0f};
+    uint32_t clips = 0; // Số mẫu vượt 0 dBFS cộng dồn từ lúc acquire bus (master: từ lúc tạo mixer)
+};
+
+/*
+    LevelMeter: peak (có giữ và hạ dần) và RMS (trung bình mũ) của một bus, cập nhật mỗi block
+    trên audio thread từ mix::Levels mà kernel mix đã đo, không duyệt lại mẫu.
+    Kết quả được publish qua seqlock: audio thread không chờ, thread app đọc được bộ giá trị
+    của cùng một block (thử lại nếu đọc trúng lúc đang ghi).
+*/
+class LevelMeter {
+public:
+    // Hệ số của một block, tính một lần cho mọi bus (cùng số frame, cùng ballistics)
+    struct Coefficients {
+        float rmsAlpha = 1.0f;   // Trọng số của block mới trong trung bình mũ
+        float peakDecay = 0.0f;  // Hệ số nhân peak mỗi block sau khi hết giữ
+        int64_t holdFrames = 0;
+
+        // Ballistics theo đơn vị frame (đã quy đổi theo sample rate)
+        static Coefficients compute(float rmsWindowFrames, float holdFrames, float decayDbPerFrame,
+                                    int32_t blockFrames);
+    };
+
+    // Audio thread: levels là mức đo được trong block frames frame (Levels() nếu bus không phát)
+    void update(const mix::Levels& levels, int32_t frames, const Coefficients& coefficients);
+
+    // Mọi thread. busId của kết quả để -1, người gọi điền.
+    MeterLevels read() const;
+
+private:
+    void loadPublished(MeterLevels& levels) const;
+
+    static constexpr int READ_RETRIES = 16;
+    // Dưới mức này (~-120 dBFS) coi là im lặng để meter về đúng 0
+    static constexpr float SILENCE = 1e-6f;
+
+    // Chỉ audio thread
+    float meanSquare[2] = {0.0f, 0.0f};
+    float heldPeak[2] = {0.0f, 0.0f};
+    int64_t holdRemaining[2] = {0, 0};
+    uint32_t totalClips = 0;
+
+    // Seqlock: lẻ = đang ghi
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<float> publishedPeak[2] = {{0.0f}, {0.0f}};
+    std::atomic<float> publishedRms[2] = {{0.0f}, {0.0f}};
+    std::atomic<uint32_t> publishedClips{0};
+};
@@ -0,0 +1,96 @@
+#include "loudness_meter.hpp"
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t SUB_BLOCK_FRAMES = LoudnessMeter::SAMPLE_RATE / 10; // 100ms
+constexpr size_t SUB_BLOCKS_PER_BLOCK = 4;                           // Khối đo 400ms
+constexpr double ABSOLUTE_GATE_LUFS = -70.0;
+constexpr double RELATIVE_GATE_LU = -10.0;
+
+// Hệ số K-weighting cho 48kHz (BS.1770-4, bảng 1 và 2)
+constexpr double SHELF_B[3] = {1.53512485958697, -2.69169618940638, 1.19839281085285};
+constexpr double SHELF_A[2] = {-1.69065929318241, 0.73248077421585};
+constexpr double HIGH_PASS_B[3] = {1.0, -2.0, 1.0};
+constexpr double HIGH_PASS_A[2] = {-1.99004745483398, 0.99007225036621};
+
+// Loudness của một khối từ năng lượng trung bình (đã cộng mọi kênh, trọng số kênh L/R = 1)
+double blockLoudness(double meanSquare) {
+    return -0.691 + 10.0 * log10(meanSquare);
+}
+
+} // namespace
+
+LoudnessMeter::LoudnessMeter() {
+    reset();
+}
+
+void LoudnessMeter::reset() {
+    for (size_t c = 0; c < CHANNELS; c++) {
+        shelf[c] = Biquad{SHELF_B[0], SHELF_B[1], SHELF_B[2], SHELF_A[0], SHELF_A[1]};
+        highPass[c] = Biquad{HIGH_PASS_B[0], HIGH_PASS_B[1], HIGH_PASS_B[2], HIGH_PASS_A[0], HIGH_PASS_A[1]};
+    }
+    subBlockEnergy.clear();
+    currentEnergy = 0.0;
+    currentFrames = 0;
+}
+
+void LoudnessMeter::process(const float* interleaved, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        for (size_t c = 0; c < CHANNELS; c++) {
+            const double y = highPass[c].process(shelf[c].process(interleaved[i * CHANNELS + c]));
+            currentEnergy += y * y;
+        }
+        if (++currentFrames == SUB_BLOCK_FRAMES) {
+            subBlockEnergy.push_back(currentEnergy);
+            currentEnergy = 0.0;
+            currentFrames = 0;
+        }
+    }
+}
+
+double LoudnessMeter::integratedLoudness() const {
+    if (subBlockEnergy.size() < SUB_BLOCKS_PER_BLOCK) {
+        return -HUGE_VAL;
+    }
+
+    // Năng lượng trung bình của các khối 400ms (bước 100ms)
+    const size_t blockCount = subBlockEnergy.size() - SUB_BLOCKS_PER_BLOCK + 1;
+    vector<double> blocks(blockCount);
+    double window = 0.0;
+    for (size_t i = 0; i < SUB_BLOCKS_PER_BLOCK - 1; i++) {
+        window += subBlockEnergy[i];
+    }
+    for (size_t j = 0; j < blockCount; j++) {
+        window += subBlockEnergy[j + SUB_BLOCKS_PER_BLOCK - 1];
+        blocks[j] = window / (SUB_BLOCK_FRAMES * SUB_BLOCKS_PER_BLOCK);
+        window -= subBlockEnergy[j];
+    }
+
+    // Gate tuyệt đối, rồi gate tương đối theo trung bình các khối còn lại
+    const double absoluteGate = pow(10.0, (ABSOLUTE_GATE_LUFS + 0.691) / 10.0);
+    double sum = 0.0;
+    size_t count = 0;
+    for (double z : blocks) {
+        if (z > absoluteGate) {
+            sum += z;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return -HUGE_VAL;
+    }
+
+    const double relativeGate = pow(10.0, (blockLoudness(sum / count) + RELATIVE_GATE_LU + 0.691) / 10.0);
+    double gatedSum = 0.0;
+    size_t gatedCount = 0;
+    for (double z : blocks) {
+        if (z > absoluteGate && z > relativeGate) {
+            gatedSum += z;
+            gatedCount++;
+        }
+    }
+    return gatedCount > 0 ? blockLoudness(gatedSum / gatedCount) : -HUGE_VAL;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+    LoudnessMeter đo integrated loudness (LUFS) theo EBU R128 / ITU-R BS.1770-4
+    cho PCM stereo interleaved 48kHz:
+    - Lọc K-weighting (high-shelf + high-pass) từng kênh
+    - Năng lượng được gom theo khối 100ms, khối đo 400ms chồng nhau 75%
+    - Gating tuyệt đối -70 LUFS, gating tương đối -10 LU
+    Chỉ lưu năng lượng mỗi 100ms nên đo được cả bài dài với bộ nhớ nhỏ.
+*/
+class LoudnessMeter {
+public:
+    static constexpr unsigned SAMPLE_RATE = 48000;
+    static constexpr size_t CHANNELS = 2;
+
+    LoudnessMeter();
+
+    // frames frame stereo interleaved
+    void process(const float* interleaved, size_t frames);
+
+    // LUFS của toàn bộ dữ liệu đã đưa vào, -HUGE_VAL nếu im lặng (mọi khối bị gate)
+    double integratedLoudness() const;
+
+    void reset();
+
+private:
+    // Biquad dạng transposed direct form II
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0, z2 = 0.0;
+
+        double process(double x) {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    Biquad shelf[CHANNELS];
+    Biquad highPass[CHANNELS];
+
+    std::vector<double> subBlockEnergy; // Tổng bình phương (mọi kênh) của từng khối 100ms
+    double currentEnergy = 0.0;
+    size_t currentFrames = 0;
+};
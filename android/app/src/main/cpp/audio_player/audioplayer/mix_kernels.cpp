@@ -0,0 +1,951 @@
+#include "mix_kernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define MIX_USE_NEON 1
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define MIX_USE_SSE2 1
+    #if defined(__GNUC__) || defined(__clang__)
+        // Bản AVX2 được build riêng bằng target attribute, chỉ gọi khi CPU hỗ trợ
+        #define MIX_USE_AVX2 1
+        #define MIX_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+using namespace std;
+
+namespace mix {
+
+namespace {
+
+/*
+Soft limiter của flowgraph::Limiter: |x| <= 1 giữ nguyên, từ 1 tới kXWhenYis3Decibels là spline
+bậc hai Ax^2 + Bx + C (đạo hàm 1 tại 1, 0 tại đầu kia), trên đó là sqrt(2) (+3 dB).
+Mixer ghi thẳng ra stream float của thiết bị nên trần phải là 0 dBFS: đường cong được co lại
+theo sqrt(2) (y = f(x * sqrt2) / sqrt2). Tín hiệu dưới -3 dBFS đi qua nguyên vẹn,
+knee mềm tới 1.0 tại |x| = kXWhenYis3Decibels / sqrt2 ~ 1.29.
+*/
+constexpr float SPLINE_A = -0.6035533905f; // -(1+sqrt(2))/4
+constexpr float SPLINE_B = 2.2071067811f;  // (3+sqrt(2))/2
+constexpr float SPLINE_C = -0.6035533905f; // -(1+sqrt(2))/4
+constexpr float X_WHEN_Y_IS_3DB = 1.8284271247f; // -1+2sqrt(2)
+constexpr float SQRT2 = 1.4142135624f;
+
+constexpr float KNEE_START = 1.0f / SQRT2;           // Bắt đầu nén
+constexpr float KNEE_END = X_WHEN_Y_IS_3DB / SQRT2;  // Từ đây output = 1.0
+// Spline theo |x| gốc: f(a * sqrt2) / sqrt2 = A*sqrt2*a^2 + B*a + C/sqrt2
+constexpr float KNEE_A = SPLINE_A * SQRT2;
+constexpr float KNEE_B = SPLINE_B;
+constexpr float KNEE_C = SPLINE_C / SQRT2;
+
+inline float limitSample(float in)
+{
+    const float a = fabsf(in);
+    if (a <= KNEE_START)
+    {
+        return in;
+    }
+    const float out = a < KNEE_END ? (KNEE_A * a + KNEE_B) * a + KNEE_C : 1.0f;
+    return in < 0 ? -out : out;
+}
+
+// ------------------------------- Đo mức -------------------------------
+
+// Peak và bình phương của mẫu sample vào kênh channel. So sánh kiểu này bỏ qua NaN (giữ peak cũ).
+inline void addLevel(Levels& levels, int channel, float sample)
+{
+    const float magnitude = fabsf(sample);
+    if (magnitude > levels.peak[channel])
+    {
+        levels.peak[channel] = magnitude;
+    }
+    levels.sumSquares[channel] += sample * sample;
+}
+
+inline void countClip(Levels& levels, float sample)
+{
+    levels.clips += fabsf(sample) > 1.0f ? 1u : 0u;
+}
+
+// Số bit 1 trong mask 4 bit của movemask
+inline uint32_t countMask4(int mask)
+{
+    static const uint8_t BITS[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    return BITS[mask & 0xF];
+}
+
+// ------------------------------- Vô hướng -------------------------------
+
+inline bool isConstant(const StereoGain& gain)
+{
+    return gain.leftStep == 0.0f && gain.rightStep == 0.0f;
+}
+
+/*
+Mỗi kernel là template theo Metered: bản không đo mức (levels = nullptr) được compile không có
+phần đo, bản đo mức cộng peak/bình phương/clip của mẫu vừa tính ngay trong vòng lặp mix.
+*/
+template <bool Metered>
+void accumulateStereoScalarImpl(float* out, const float* in, size_t inStride, size_t frames,
+                                const StereoGain& gain, Levels* levels)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float step = static_cast<float>(i);
+        const float left = in[i * inStride] * (gain.left + gain.leftStep * step);
+        const float right = in[i * inStride + 1] * (gain.right + gain.rightStep * step);
+        out[i * 2] += left;
+        out[i * 2 + 1] += right;
+        if (Metered)
+        {
+            addLevel(*levels, 0, left);
+            addLevel(*levels, 1, right);
+            countClip(*levels, left);
+            countClip(*levels, right);
+        }
+    }
+}
+
+template <bool Metered>
+void spreadMonoScalarImpl(float* out, const float* in, size_t inStride, size_t frames,
+                          const StereoGain& gain, Levels* levels)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float step = static_cast<float>(i);
+        const float sample = in[i * inStride];
+        const float left = sample * (gain.left + gain.leftStep * step);
+        const float right = sample * (gain.right + gain.rightStep * step);
+        out[i * 2] += left;
+        out[i * 2 + 1] += right;
+        if (Metered)
+        {
+            addLevel(*levels, 0, left);
+            addLevel(*levels, 1, right);
+            countClip(*levels, left);
+            countClip(*levels, right);
+        }
+    }
+}
+
+void accumulateStereoScalar(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                            Levels* levels)
+{
+    if (levels)
+    {
+        accumulateStereoScalarImpl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        accumulateStereoScalarImpl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+void spreadMonoScalar(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                      Levels* levels)
+{
+    if (levels)
+    {
+        spreadMonoScalarImpl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        spreadMonoScalarImpl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+// Phần lẻ cuối của kernel SIMD: tiếp tục ramp từ frame thứ done
+StereoGain offsetGain(const StereoGain& gain, size_t done)
+{
+    const float step = static_cast<float>(done);
+    return {gain.left + gain.leftStep * step, gain.right + gain.rightStep * step, gain.leftStep, gain.rightStep};
+}
+
+// Mẫu [begin, samples) của limiter, begin chẵn khi đo mức để mẫu chẵn vẫn là kênh trái
+float limitTail(float* buffer, size_t begin, size_t samples, float lastValidOutput, Levels* levels)
+{
+    for (size_t i = begin; i < samples; i++)
+    {
+        if (!isnan(buffer[i]))
+        {
+            if (levels)
+            {
+                countClip(*levels, buffer[i]);
+            }
+            lastValidOutput = limitSample(buffer[i]);
+        }
+        buffer[i] = lastValidOutput;
+        if (levels)
+        {
+            addLevel(*levels, static_cast<int>(i & 1), lastValidOutput);
+        }
+    }
+    return lastValidOutput;
+}
+
+float limitScalar(float* buffer, size_t samples, float lastValidOutput, Levels* levels)
+{
+    return limitTail(buffer, 0, samples, lastValidOutput, levels);
+}
+
+// ------------------------------- NEON -------------------------------
+
+#if defined(MIX_USE_NEON)
+
+// Mức của một kênh theo 4 lane, gộp vào Levels ở cuối kernel
+struct ChannelMeterNeon
+{
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    float32x4_t squares = vdupq_n_f32(0.0f);
+    uint32x4_t clips = vdupq_n_u32(0);
+
+    void add(float32x4_t v)
+    {
+        const float32x4_t magnitude = vabsq_f32(v);
+        // So sánh rồi chọn (không dùng vmaxq) để NaN không ghi đè peak
+        peak = vbslq_f32(vcgtq_f32(magnitude, peak), magnitude, peak);
+        squares = vmlaq_f32(squares, v, v);
+        addClips(magnitude);
+    }
+
+    // Mask so sánh là 0xFFFFFFFF (= -1) ở lane đúng: trừ đi để cộng 1
+    void addClips(float32x4_t magnitude)
+    {
+        clips = vsubq_u32(clips, vcgtq_f32(magnitude, vdupq_n_f32(1.0f)));
+    }
+
+    void store(Levels& levels, int channel) const
+    {
+        const float32x2_t peakHalf = vpmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+        const float lanePeak = max(vget_lane_f32(peakHalf, 0), vget_lane_f32(peakHalf, 1));
+        if (lanePeak > levels.peak[channel])
+        {
+            levels.peak[channel] = lanePeak;
+        }
+        const float32x2_t sumHalf = vadd_f32(vget_low_f32(squares), vget_high_f32(squares));
+        levels.sumSquares[channel] += vget_lane_f32(sumHalf, 0) + vget_lane_f32(sumHalf, 1);
+        const uint32x2_t clipHalf = vadd_u32(vget_low_u32(clips), vget_high_u32(clips));
+        levels.clips += vget_lane_u32(clipHalf, 0) + vget_lane_u32(clipHalf, 1);
+    }
+};
+
+template <bool Metered>
+void accumulateStereoNeonImpl(float* out, const float* in, size_t inStride, size_t frames,
+                              const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 2)
+    {
+        accumulateStereoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    // vld2/vst2 tách L R thành hai vector 4 frame, gain của frame i là start + step * i
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t index = vld1q_f32(lanes);
+    const float32x4_t four = vdupq_n_f32(4.0f);
+    const float32x4_t left = vdupq_n_f32(gain.left);
+    const float32x4_t right = vdupq_n_f32(gain.right);
+    const float32x4_t leftStep = vdupq_n_f32(gain.leftStep);
+    const float32x4_t rightStep = vdupq_n_f32(gain.rightStep);
+    ChannelMeterNeon leftMeter;
+    ChannelMeterNeon rightMeter;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const float32x4x2_t x = vld2q_f32(in + i * 2);
+        float32x4x2_t lr = vld2q_f32(out + i * 2);
+        const float32x4_t l = vmulq_f32(x.val[0], vmlaq_f32(left, leftStep, index));
+        const float32x4_t r = vmulq_f32(x.val[1], vmlaq_f32(right, rightStep, index));
+        lr.val[0] = vaddq_f32(lr.val[0], l);
+        lr.val[1] = vaddq_f32(lr.val[1], r);
+        vst2q_f32(out + i * 2, lr);
+        if (Metered)
+        {
+            leftMeter.add(l);
+            rightMeter.add(r);
+        }
+        index = vaddq_f32(index, four);
+    }
+    if (Metered)
+    {
+        leftMeter.store(*levels, 0);
+        rightMeter.store(*levels, 1);
+    }
+    accumulateStereoScalarImpl<Metered>(out + i * 2, in + i * 2, 2, frames - i, offsetGain(gain, i), levels);
+}
+
+template <bool Metered>
+void spreadMonoNeonImpl(float* out, const float* in, size_t inStride, size_t frames,
+                        const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 1)
+    {
+        spreadMonoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t index = vld1q_f32(lanes);
+    const float32x4_t four = vdupq_n_f32(4.0f);
+    const float32x4_t left = vdupq_n_f32(gain.left);
+    const float32x4_t right = vdupq_n_f32(gain.right);
+    const float32x4_t leftStep = vdupq_n_f32(gain.leftStep);
+    const float32x4_t rightStep = vdupq_n_f32(gain.rightStep);
+    ChannelMeterNeon leftMeter;
+    ChannelMeterNeon rightMeter;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const float32x4_t m = vld1q_f32(in + i);
+        // Cộng cùng một mẫu mono vào cả hai kênh, mỗi kênh một gain
+        float32x4x2_t lr = vld2q_f32(out + i * 2);
+        const float32x4_t l = vmulq_f32(m, vmlaq_f32(left, leftStep, index));
+        const float32x4_t r = vmulq_f32(m, vmlaq_f32(right, rightStep, index));
+        lr.val[0] = vaddq_f32(lr.val[0], l);
+        lr.val[1] = vaddq_f32(lr.val[1], r);
+        vst2q_f32(out + i * 2, lr);
+        if (Metered)
+        {
+            leftMeter.add(l);
+            rightMeter.add(r);
+        }
+        index = vaddq_f32(index, four);
+    }
+    if (Metered)
+    {
+        leftMeter.store(*levels, 0);
+        rightMeter.store(*levels, 1);
+    }
+    spreadMonoScalarImpl<Metered>(out + i * 2, in + i, 1, frames - i, offsetGain(gain, i), levels);
+}
+
+inline bool anyNaNNeon(float32x4_t x)
+{
+    const uint32x4_t ordered = vceqq_f32(x, x);
+    const uint32x2_t halves = vand_u32(vget_low_u32(ordered), vget_high_u32(ordered));
+    return (vget_lane_u32(halves, 0) & vget_lane_u32(halves, 1)) == 0;
+}
+
+float limitNeon(float* buffer, size_t samples, float lastValidOutput, Levels* levels)
+{
+    const float32x4_t kneeStart = vdupq_n_f32(KNEE_START);
+    const float32x4_t kneeEnd = vdupq_n_f32(KNEE_END);
+    const float32x4_t a = vdupq_n_f32(KNEE_A);
+    const float32x4_t b = vdupq_n_f32(KNEE_B);
+    const float32x4_t c = vdupq_n_f32(KNEE_C);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+    // Lane 0, 2 là kênh trái, 1, 3 là kênh phải (i luôn chia hết cho 4)
+    ChannelMeterNeon meter;
+
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(buffer + i);
+        if (anyNaNNeon(x))
+        {
+            lastValidOutput = limitTail(buffer, i, i + 4, lastValidOutput, levels);
+            continue;
+        }
+        const float32x4_t ax = vabsq_f32(x);
+        const float32x4_t knee = vmlaq_f32(c, vmlaq_f32(b, a, ax), ax);
+        float32x4_t y = vbslq_f32(vcltq_f32(ax, kneeEnd), knee, one);
+        // Lấy lại dấu của x
+        y = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(y),
+                                            vandq_u32(vreinterpretq_u32_f32(x), signMask)));
+        y = vbslq_f32(vcleq_f32(ax, kneeStart), x, y);
+        vst1q_f32(buffer + i, y);
+        if (levels)
+        {
+            const float32x4_t ay = vabsq_f32(y);
+            meter.peak = vbslq_f32(vcgtq_f32(ay, meter.peak), ay, meter.peak);
+            meter.squares = vmlaq_f32(meter.squares, y, y);
+            meter.addClips(ax);
+        }
+        lastValidOutput = vgetq_lane_f32(y, 3);
+    }
+    if (levels)
+    {
+        // Gộp theo lane chẵn/lẻ
+        const float32x2x2_t peak = vuzp_f32(vget_low_f32(meter.peak), vget_high_f32(meter.peak));
+        const float32x2_t peakLR = vmax_f32(peak.val[0], peak.val[1]);
+        const float32x2x2_t squares = vuzp_f32(vget_low_f32(meter.squares), vget_high_f32(meter.squares));
+        const float32x2_t squaresLR = vadd_f32(squares.val[0], squares.val[1]);
+        for (int channel = 0; channel < 2; channel++)
+        {
+            const float lanePeak = channel == 0 ? vget_lane_f32(peakLR, 0) : vget_lane_f32(peakLR, 1);
+            if (lanePeak > levels->peak[channel])
+            {
+                levels->peak[channel] = lanePeak;
+            }
+            levels->sumSquares[channel] += channel == 0 ? vget_lane_f32(squaresLR, 0) : vget_lane_f32(squaresLR, 1);
+        }
+        const uint32x2_t clipHalf = vadd_u32(vget_low_u32(meter.clips), vget_high_u32(meter.clips));
+        levels->clips += vget_lane_u32(clipHalf, 0) + vget_lane_u32(clipHalf, 1);
+    }
+    return limitTail(buffer, i, samples, lastValidOutput, levels);
+}
+
+void accumulateStereoNeon(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                          Levels* levels)
+{
+    if (levels)
+    {
+        accumulateStereoNeonImpl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        accumulateStereoNeonImpl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+void spreadMonoNeon(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                    Levels* levels)
+{
+    if (levels)
+    {
+        spreadMonoNeonImpl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        spreadMonoNeonImpl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+#endif // MIX_USE_NEON
+
+// ------------------------------- SSE2 -------------------------------
+
+#if defined(MIX_USE_SSE2)
+
+// Mức theo 4 lane interleaved: lane chẵn là kênh trái, lẻ là kênh phải
+struct MeterSse2
+{
+    __m128 peak = _mm_setzero_ps();
+    __m128 squares = _mm_setzero_ps();
+    uint32_t clips = 0;
+
+    void add(__m128 v)
+    {
+        const __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+        addLevel(v, magnitude);
+        addClips(magnitude);
+    }
+
+    // _mm_max_ps trả về toán hạng thứ hai khi có NaN: đặt peak cũ ở đó để NaN không ghi đè
+    void addLevel(__m128 v, __m128 magnitude)
+    {
+        peak = _mm_max_ps(magnitude, peak);
+        squares = _mm_add_ps(squares, _mm_mul_ps(v, v));
+    }
+
+    void addClips(__m128 magnitude)
+    {
+        clips += countMask4(_mm_movemask_ps(_mm_cmpgt_ps(magnitude, _mm_set1_ps(1.0f))));
+    }
+
+    void store(Levels& levels) const
+    {
+        float lanePeak[4];
+        float laneSquares[4];
+        _mm_storeu_ps(lanePeak, peak);
+        _mm_storeu_ps(laneSquares, squares);
+        for (int channel = 0; channel < 2; channel++)
+        {
+            levels.peak[channel] = max(levels.peak[channel], max(lanePeak[channel], lanePeak[channel + 2]));
+            levels.sumSquares[channel] += laneSquares[channel] + laneSquares[channel + 2];
+        }
+        levels.clips += clips;
+    }
+};
+
+template <bool Metered>
+void accumulateStereoSse2Impl(float* out, const float* in, size_t inStride, size_t frames,
+                              const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 2)
+    {
+        accumulateStereoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    // Mỗi vector là 2 frame L R L R: gain = start + step * [i, i, i+1, i+1]
+    const __m128 start = _mm_setr_ps(gain.left, gain.right, gain.left, gain.right);
+    const __m128 step = _mm_setr_ps(gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep);
+    MeterSse2 meter;
+    size_t i = 0;
+    if (isConstant(gain))
+    {
+        for (; i + 4 <= frames; i += 4)
+        {
+            const __m128 v0 = _mm_mul_ps(_mm_loadu_ps(in + i * 2), start);
+            const __m128 v1 = _mm_mul_ps(_mm_loadu_ps(in + i * 2 + 4), start);
+            _mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), v0));
+            _mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), v1));
+            if (Metered)
+            {
+                meter.add(v0);
+                meter.add(v1);
+            }
+        }
+    }
+    else
+    {
+        __m128 index = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        for (; i + 2 <= frames; i += 2)
+        {
+            const __m128 g = _mm_add_ps(start, _mm_mul_ps(step, index));
+            const __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i * 2), g);
+            _mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), v));
+            if (Metered)
+            {
+                meter.add(v);
+            }
+            index = _mm_add_ps(index, two);
+        }
+    }
+    if (Metered)
+    {
+        meter.store(*levels);
+    }
+    accumulateStereoScalarImpl<Metered>(out + i * 2, in + i * 2, 2, frames - i, offsetGain(gain, i), levels);
+}
+
+template <bool Metered>
+void spreadMonoSse2Impl(float* out, const float* in, size_t inStride, size_t frames,
+                        const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 1)
+    {
+        spreadMonoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    const __m128 start = _mm_setr_ps(gain.left, gain.right, gain.left, gain.right);
+    const __m128 step = _mm_setr_ps(gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep);
+    __m128 index = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    MeterSse2 meter;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const __m128 m = _mm_loadu_ps(in + i);
+        // m0 m0 m1 m1 / m2 m2 m3 m3
+        const __m128 lo = _mm_unpacklo_ps(m, m);
+        const __m128 hi = _mm_unpackhi_ps(m, m);
+        const __m128 gainLo = _mm_add_ps(start, _mm_mul_ps(step, index));
+        const __m128 gainHi = _mm_add_ps(start, _mm_mul_ps(step, _mm_add_ps(index, two)));
+        const __m128 v0 = _mm_mul_ps(lo, gainLo);
+        const __m128 v1 = _mm_mul_ps(hi, gainHi);
+        _mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), v0));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), v1));
+        if (Metered)
+        {
+            meter.add(v0);
+            meter.add(v1);
+        }
+        index = _mm_add_ps(index, four);
+    }
+    if (Metered)
+    {
+        meter.store(*levels);
+    }
+    spreadMonoScalarImpl<Metered>(out + i * 2, in + i, 1, frames - i, offsetGain(gain, i), levels);
+}
+
+float limitSse2(float* buffer, size_t samples, float lastValidOutput, Levels* levels)
+{
+    const __m128 kneeStart = _mm_set1_ps(KNEE_START);
+    const __m128 kneeEnd = _mm_set1_ps(KNEE_END);
+    const __m128 a = _mm_set1_ps(KNEE_A);
+    const __m128 b = _mm_set1_ps(KNEE_B);
+    const __m128 c = _mm_set1_ps(KNEE_C);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    MeterSse2 meter;
+
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(buffer + i);
+        if (_mm_movemask_ps(_mm_cmpunord_ps(x, x)) != 0)
+        {
+            lastValidOutput = limitTail(buffer, i, i + 4, lastValidOutput, levels);
+            continue;
+        }
+        const __m128 ax = _mm_andnot_ps(signMask, x);
+        const __m128 knee = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(a, ax), b), ax), c);
+        const __m128 inKnee = _mm_cmplt_ps(ax, kneeEnd);
+        __m128 y = _mm_or_ps(_mm_and_ps(inKnee, knee), _mm_andnot_ps(inKnee, one));
+        y = _mm_or_ps(y, _mm_and_ps(x, signMask));
+        const __m128 linear = _mm_cmple_ps(ax, kneeStart);
+        y = _mm_or_ps(_mm_and_ps(linear, x), _mm_andnot_ps(linear, y));
+        _mm_storeu_ps(buffer + i, y);
+        if (levels)
+        {
+            // Output đã qua limiter, clip đếm theo input
+            meter.addLevel(y, _mm_andnot_ps(signMask, y));
+            meter.addClips(ax);
+        }
+        lastValidOutput = buffer[i + 3];
+    }
+    if (levels)
+    {
+        meter.store(*levels);
+    }
+    return limitTail(buffer, i, samples, lastValidOutput, levels);
+}
+
+void accumulateStereoSse2(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                          Levels* levels)
+{
+    if (levels)
+    {
+        accumulateStereoSse2Impl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        accumulateStereoSse2Impl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+void spreadMonoSse2(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                    Levels* levels)
+{
+    if (levels)
+    {
+        spreadMonoSse2Impl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        spreadMonoSse2Impl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+#endif // MIX_USE_SSE2
+
+// ------------------------------- AVX2 -------------------------------
+
+#if defined(MIX_USE_AVX2)
+
+// Như MeterSse2 với 8 lane
+struct MeterAvx2
+{
+    __m256 peak;
+    __m256 squares;
+    uint32_t clips;
+
+    MIX_TARGET_AVX2 MeterAvx2()
+        : peak(_mm256_setzero_ps()), squares(_mm256_setzero_ps()), clips(0)
+    {
+    }
+
+    MIX_TARGET_AVX2 void add(__m256 v)
+    {
+        const __m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+        addLevel(v, magnitude);
+        addClips(magnitude);
+    }
+
+    MIX_TARGET_AVX2 void addLevel(__m256 v, __m256 magnitude)
+    {
+        peak = _mm256_max_ps(magnitude, peak);
+        squares = _mm256_add_ps(squares, _mm256_mul_ps(v, v));
+    }
+
+    MIX_TARGET_AVX2 void addClips(__m256 magnitude)
+    {
+        clips += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(magnitude, _mm256_set1_ps(1.0f), _CMP_GT_OQ)));
+    }
+
+    MIX_TARGET_AVX2 void store(Levels& levels) const
+    {
+        float lanePeak[8];
+        float laneSquares[8];
+        _mm256_storeu_ps(lanePeak, peak);
+        _mm256_storeu_ps(laneSquares, squares);
+        for (int channel = 0; channel < 2; channel++)
+        {
+            for (int lane = channel; lane < 8; lane += 2)
+            {
+                levels.peak[channel] = max(levels.peak[channel], lanePeak[lane]);
+                levels.sumSquares[channel] += laneSquares[lane];
+            }
+        }
+        levels.clips += clips;
+    }
+};
+
+template <bool Metered>
+MIX_TARGET_AVX2 void accumulateStereoAvx2Impl(float* out, const float* in, size_t inStride, size_t frames,
+                                              const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 2)
+    {
+        accumulateStereoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    // Mỗi vector là 4 frame: gain = start + step * [i, i, i+1, i+1, ..., i+3, i+3]
+    const __m256 start = _mm256_setr_ps(gain.left, gain.right, gain.left, gain.right,
+                                        gain.left, gain.right, gain.left, gain.right);
+    const __m256 step = _mm256_setr_ps(gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep,
+                                       gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep);
+    __m256 index = _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    MeterAvx2 meter;
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        const __m256 g = _mm256_add_ps(start, _mm256_mul_ps(step, index));
+        const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i * 2), g);
+        _mm256_storeu_ps(out + i * 2, _mm256_add_ps(_mm256_loadu_ps(out + i * 2), v));
+        if (Metered)
+        {
+            meter.add(v);
+        }
+        index = _mm256_add_ps(index, four);
+    }
+    if (Metered)
+    {
+        meter.store(*levels);
+    }
+    accumulateStereoScalarImpl<Metered>(out + i * 2, in + i * 2, 2, frames - i, offsetGain(gain, i), levels);
+}
+
+template <bool Metered>
+MIX_TARGET_AVX2 void spreadMonoAvx2Impl(float* out, const float* in, size_t inStride, size_t frames,
+                                        const StereoGain& gain, Levels* levels)
+{
+    if (inStride != 1)
+    {
+        spreadMonoScalarImpl<Metered>(out, in, inStride, frames, gain, levels);
+        return;
+    }
+    const __m256 start = _mm256_setr_ps(gain.left, gain.right, gain.left, gain.right,
+                                        gain.left, gain.right, gain.left, gain.right);
+    const __m256 step = _mm256_setr_ps(gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep,
+                                       gain.leftStep, gain.rightStep, gain.leftStep, gain.rightStep);
+    __m256 index = _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    MeterAvx2 meter;
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8)
+    {
+        const __m256 m = _mm256_loadu_ps(in + i);
+        // unpack làm trong từng nửa 128 bit: ghép lại để được m0 m0 .. m3 m3 / m4 m4 .. m7 m7
+        const __m256 lo = _mm256_unpacklo_ps(m, m);
+        const __m256 hi = _mm256_unpackhi_ps(m, m);
+        const __m256 first = _mm256_permute2f128_ps(lo, hi, 0x20);
+        const __m256 second = _mm256_permute2f128_ps(lo, hi, 0x31);
+        const __m256 gainFirst = _mm256_add_ps(start, _mm256_mul_ps(step, index));
+        const __m256 gainSecond = _mm256_add_ps(start, _mm256_mul_ps(step, _mm256_add_ps(index, four)));
+        const __m256 v0 = _mm256_mul_ps(first, gainFirst);
+        const __m256 v1 = _mm256_mul_ps(second, gainSecond);
+        _mm256_storeu_ps(out + i * 2, _mm256_add_ps(_mm256_loadu_ps(out + i * 2), v0));
+        _mm256_storeu_ps(out + i * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(out + i * 2 + 8), v1));
+        if (Metered)
+        {
+            meter.add(v0);
+            meter.add(v1);
+        }
+        index = _mm256_add_ps(index, eight);
+    }
+    if (Metered)
+    {
+        meter.store(*levels);
+    }
+    spreadMonoScalarImpl<Metered>(out + i * 2, in + i, 1, frames - i, offsetGain(gain, i), levels);
+}
+
+MIX_TARGET_AVX2 float limitAvx2(float* buffer, size_t samples, float lastValidOutput, Levels* levels)
+{
+    const __m256 kneeStart = _mm256_set1_ps(KNEE_START);
+    const __m256 kneeEnd = _mm256_set1_ps(KNEE_END);
+    const __m256 a = _mm256_set1_ps(KNEE_A);
+    const __m256 b = _mm256_set1_ps(KNEE_B);
+    const __m256 c = _mm256_set1_ps(KNEE_C);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    MeterAvx2 meter;
+
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(buffer + i);
+        if (_mm256_movemask_ps(_mm256_cmp_ps(x, x, _CMP_UNORD_Q)) != 0)
+        {
+            lastValidOutput = limitTail(buffer, i, i + 8, lastValidOutput, levels);
+            continue;
+        }
+        const __m256 ax = _mm256_andnot_ps(signMask, x);
+        const __m256 knee = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(a, ax), b), ax), c);
+        __m256 y = _mm256_blendv_ps(one, knee, _mm256_cmp_ps(ax, kneeEnd, _CMP_LT_OQ));
+        y = _mm256_or_ps(y, _mm256_and_ps(x, signMask));
+        y = _mm256_blendv_ps(y, x, _mm256_cmp_ps(ax, kneeStart, _CMP_LE_OQ));
+        _mm256_storeu_ps(buffer + i, y);
+        if (levels)
+        {
+            meter.addLevel(y, _mm256_andnot_ps(signMask, y));
+            meter.addClips(ax);
+        }
+        lastValidOutput = buffer[i + 7];
+    }
+    if (levels)
+    {
+        meter.store(*levels);
+    }
+    return limitTail(buffer, i, samples, lastValidOutput, levels);
+}
+
+MIX_TARGET_AVX2 void accumulateStereoAvx2(float* out, const float* in, size_t inStride, size_t frames,
+                                          const StereoGain& gain, Levels* levels)
+{
+    if (levels)
+    {
+        accumulateStereoAvx2Impl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        accumulateStereoAvx2Impl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+MIX_TARGET_AVX2 void spreadMonoAvx2(float* out, const float* in, size_t inStride, size_t frames,
+                                    const StereoGain& gain, Levels* levels)
+{
+    if (levels)
+    {
+        spreadMonoAvx2Impl<true>(out, in, inStride, frames, gain, levels);
+    }
+    else
+    {
+        spreadMonoAvx2Impl<false>(out, in, inStride, frames, gain, nullptr);
+    }
+}
+
+#endif // MIX_USE_AVX2
+
+const Kernels SCALAR_KERNELS = {
+    Isa::Scalar, "scalar", accumulateStereoScalar, spreadMonoScalar, limitScalar};
+
+#if defined(MIX_USE_NEON)
+const Kernels NEON_KERNELS = {
+    Isa::Neon, "neon", accumulateStereoNeon, spreadMonoNeon, limitNeon};
+#endif
+#if defined(MIX_USE_SSE2)
+const Kernels SSE2_KERNELS = {
+    Isa::Sse2, "sse2", accumulateStereoSse2, spreadMonoSse2, limitSse2};
+#endif
+#if defined(MIX_USE_AVX2)
+const Kernels AVX2_KERNELS = {
+    Isa::Avx2, "avx2", accumulateStereoAvx2, spreadMonoAvx2, limitAvx2};
+#endif
+
+} // namespace
+
+const Kernels* forIsa(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return &SCALAR_KERNELS;
+#if defined(MIX_USE_NEON)
+    case Isa::Neon:
+        // arm64 và armeabi-v7a của NDK (r21+) luôn có NEON
+        return &NEON_KERNELS;
+#endif
+#if defined(MIX_USE_SSE2)
+    case Isa::Sse2:
+        // SSE2 là baseline của x86_64 và ABI x86 của Android
+        return &SSE2_KERNELS;
+#endif
+#if defined(MIX_USE_AVX2)
+    case Isa::Avx2:
+        return __builtin_cpu_supports("avx2") ? &AVX2_KERNELS : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const Kernels& active()
+{
+    static const Kernels& selected = []() -> const Kernels& {
+        for (Isa isa : {Isa::Avx2, Isa::Sse2, Isa::Neon})
+        {
+            if (const Kernels* kernels = forIsa(isa))
+            {
+                return *kernels;
+            }
+        }
+        return SCALAR_KERNELS;
+    }();
+    return selected;
+}
+
+double benchmarkNsPerFrame(const Kernels& kernels, int busCount, size_t frames, int iterations)
+{
+    if (busCount < 1 || frames == 0 || iterations < 1)
+    {
+        return 0.0;
+    }
+
+    // Bus chẵn mono, bus lẻ stereo, biên độ đủ lớn để limiter phải nén khi nhiều bus
+    vector<vector<float>> buses(busCount);
+    for (int b = 0; b < busCount; b++)
+    {
+        const size_t channels = (b % 2 == 0) ? 1 : 2;
+        buses[b].resize(frames * channels);
+        for (size_t i = 0; i < buses[b].size(); i++)
+        {
+            buses[b][i] = 0.5f * sinf(0.01f * static_cast<float>(i * (b + 1)));
+        }
+    }
+    vector<float> mixBuffer(frames * 2);
+    float lastValidOutput = 0.0f;
+    const StereoGain gain = {0.8f, 0.8f, 0.0f, 0.0f};
+    Levels busLevels;
+    Levels masterLevels;
+
+    auto runOnce = [&]() {
+        memset(mixBuffer.data(), 0, mixBuffer.size() * sizeof(float));
+        for (int b = 0; b < busCount; b++)
+        {
+            busLevels = Levels();
+            if (b % 2 == 0)
+            {
+                kernels.spreadMono(mixBuffer.data(), buses[b].data(), 1, frames, gain, &busLevels);
+            }
+            else
+            {
+                kernels.accumulateStereo(mixBuffer.data(), buses[b].data(), 2, frames, gain, &busLevels);
+            }
+        }
+        masterLevels = Levels();
+        lastValidOutput = kernels.limit(mixBuffer.data(), frames * 2, lastValidOutput, &masterLevels);
+    };
+
+    // Làm nóng cache trước khi đo
+    for (int i = 0; i < iterations / 10 + 1; i++)
+    {
+        runOnce();
+    }
+    const auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        runOnce();
+    }
+    const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+
+    // Dùng kết quả để compiler không bỏ vòng lặp
+    volatile float sink = mixBuffer[frames] + lastValidOutput + busLevels.sumSquares[0] + masterLevels.peak[1];
+    (void)sink;
+    return static_cast<double>(elapsed.count()) / (static_cast<double>(iterations) * frames);
+}
+
+} // namespace mix
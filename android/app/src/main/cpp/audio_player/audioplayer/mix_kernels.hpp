@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Kernel mix của mixer (OboeLayer): cộng bus có gain (kèm ramp), nhân bus mono ra stereo và soft limiter.
+    Có bản NEON (arm64/armv7), SSE2 và AVX2 (x86), chọn một lần lúc chạy theo CPU.
+    Đường thường gặp (bus mono/stereo liền nhau) được vector hóa; bus stem đọc theo stride
+    từ PCM nhiều kênh thì dùng vòng lặp vô hướng. Không cấp phát, gọi được trên thread real-time.
+    Kernel đo mức (peak, tổng bình phương, số mẫu vượt 0 dBFS) ngay trong vòng lặp mix nếu được
+    truyền Levels, không cần lượt thứ hai trên buffer.
+*/
+namespace mix {
+
+enum class Isa {
+    Scalar,
+    Neon,
+    Sse2,
+    Avx2,
+};
+
+// Gain trái/phải của một đoạn: frame thứ i dùng left + leftStep * i, right + rightStep * i
+struct StereoGain {
+    float left;
+    float right;
+    float leftStep;
+    float rightStep;
+};
+
+// Mức tín hiệu kernel cộng dồn vào (kênh 0 = trái, 1 = phải). Bus: đo phần cộng vào mix (sau gain).
+// Master (limit): peak/bình phương của output, clips đếm mẫu input vượt 0 dBFS (limiter phải nén).
+struct Levels {
+    float peak[2] = {0.0f, 0.0f};
+    float sumSquares[2] = {0.0f, 0.0f};
+    uint32_t clips = 0; // Số mẫu có |x| > 1
+};
+
+struct Kernels {
+    Isa isa;
+    const char* name;
+
+    // Stereo lấy từ PCM inStride kênh (inStride = 2: liền nhau) -> cộng vào out stereo
+    // levels = nullptr: không đo mức
+    void (*accumulateStereo)(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                             Levels* levels);
+    // Mono lấy từ PCM inStride kênh (inStride = 1: liền nhau) -> cộng vào out stereo (L/R theo gain)
+    void (*spreadMono)(float* out, const float* in, size_t inStride, size_t frames, const StereoGain& gain,
+                       Levels* levels);
+    // Soft limiter tại chỗ theo flowgraph::Limiter, trần 0 dBFS (xem mix_kernels.cpp).
+    // Mẫu NaN được thay bằng output hợp lệ trước đó. Trả về output hợp lệ cuối cùng.
+    // buffer là stereo interleaved khi đo mức (mẫu chẵn = trái, lẻ = phải).
+    float (*limit)(float* buffer, size_t samples, float lastValidOutput, Levels* levels);
+};
+
+// Bộ kernel tốt nhất CPU hỗ trợ, chọn ở lần gọi đầu tiên
+const Kernels& active();
+
+// Bộ kernel của một ISA, nullptr nếu không build hoặc CPU không hỗ trợ
+const Kernels* forIsa(Isa isa);
+
+// Đo thời gian mix busCount bus (xen kẽ mono/stereo) + limiter, có đo mức như mixer, block frames frame stereo.
+// Trả về ns trên mỗi frame đầu ra. Chạy trên thread gọi, cấp phát buffer riêng.
+double benchmarkNsPerFrame(const Kernels& kernels, int busCount, size_t frames = 192, int iterations = 4000);
+
+} // namespace mix
@@ -0,0 +1,254 @@
+#include "null_audio_layer.hpp"
+#include "common.hpp"
+#include "rt_alloc_guard.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// Block render luôn vừa buffer mic của CaptureFeed
+static_assert(BusMixer::MAX_FRAMES_PER_ITERATION <= CaptureFeed::MAX_BLOCK_FRAMES, "capture block too small");
+
+// Giá trị hợp lệ cho config, tránh chia cho 0 và block lớn hơn buffer của mixer
+NullAudioLayer::Config sanitize(NullAudioLayer::Config config) {
+    config.sampleRate = max(config.sampleRate, 1);
+    config.channels = clamp(config.channels, 1, 2);
+    config.blockFrames = clamp<int32_t>(config.blockFrames, 1, BusMixer::MAX_FRAMES_PER_ITERATION);
+    config.clockRate = max(config.clockRate, 0.0);
+    config.outputLatencyMillis = max(config.outputLatencyMillis, 0.0);
+    return config;
+}
+
+} // namespace
+
+NullAudioLayer::Config NullAudioLayer::Config::fromEnvironment() {
+    Config config;
+    if (const char* pacing = getenv("AUDIO_LAYER_PACING")) {
+        if (strcmp(pacing, "unpaced") == 0) {
+            config.pacing = Pacing::Unpaced;
+        } else if (strcmp(pacing, "manual") == 0) {
+            config.pacing = Pacing::Manual;
+        }
+    }
+    if (const char* rate = getenv("AUDIO_LAYER_CLOCK_RATE")) {
+        config.clockRate = atof(rate);
+    }
+    if (const char* frames = getenv("AUDIO_LAYER_BLOCK_FRAMES")) {
+        config.blockFrames = atoi(frames);
+    }
+    if (const char* sampleRate = getenv("AUDIO_LAYER_SAMPLE_RATE")) {
+        config.sampleRate = atoi(sampleRate);
+    }
+    if (const char* latency = getenv("AUDIO_LAYER_LATENCY_MS")) {
+        config.outputLatencyMillis = atof(latency);
+    }
+    return sanitize(config);
+}
+
+NullAudioLayer::NullAudioLayer()
+    : NullAudioLayer(Config()) {
+}
+
+NullAudioLayer::NullAudioLayer(const Config& config)
+    : config(sanitize(config)), busTable(mixer.getBusTable()) {
+    mixer.setMeterBallistics(meterBallistics, this->config.sampleRate);
+    debugPrint("Creating NullAudioLayer (mix kernels: {})", mixer.getKernels().name);
+}
+
+NullAudioLayer::~NullAudioLayer() {
+    stop();
+    busTable.clear();
+}
+
+bool NullAudioLayer::initialize() {
+    block.assign(static_cast<size_t>(config.blockFrames) * config.channels, 0.0f);
+    framesRendered.store(0, memory_order_release);
+    busTable.clear();
+    return true;
+}
+
+void NullAudioLayer::shutdown() {
+    stop();
+    closeCapture();
+    // Không còn thread render nào đọc bảng
+    busTable.clear();
+}
+
+int NullAudioLayer::acquireInputBus(int channels) {
+    int busId = busTable.acquire(channels);
+    if (busId < 0) {
+        debugPrint("NullAudioLayer: failed to acquire bus with {} channels", channels);
+    }
+    return busId;
+}
+
+int NullAudioLayer::acquireStemBus(int sourceBusId, int firstChannel, int channels) {
+    return busTable.acquireStem(sourceBusId, firstChannel, channels);
+}
+
+void NullAudioLayer::releaseInputBus(int busId) {
+    if (busTable.isValid(busId)) {
+        busTable.release(busId);
+    }
+}
+
+void NullAudioLayer::setInputVolume(int busId, float volume) {
+    busTable.setVolume(busId, clamp(volume, 0.0f, MAX_INPUT_VOLUME));
+}
+
+void NullAudioLayer::muteInputBus(int busId, bool mute) {
+    busTable.setMuted(busId, mute);
+}
+
+void NullAudioLayer::setInputPan(int busId, float pan) {
+    busTable.setPan(busId, clamp(pan, -1.0f, 1.0f));
+}
+
+void NullAudioLayer::setAudioCallback(int busId, AudioCallback callback) {
+    if (!busTable.setCallback(busId, std::move(callback))) {
+        debugPrint("NullAudioLayer: failed to set audio callback - invalid bus {}", busId);
+    }
+}
+
+bool NullAudioLayer::setBusGraph(int busId, shared_ptr<ProcessingGraph> graph) {
+    return busTable.setGraph(busId, std::move(graph));
+}
+
+bool NullAudioLayer::getInputCpuStats(int busId, InputCpuStats& stats) {
+    return mixer.getCpuStats(busId, config.sampleRate, stats);
+}
+
+void NullAudioLayer::setMeterBallistics(const MeterBallistics& ballistics) {
+    meterBallistics = ballistics;
+    mixer.setMeterBallistics(meterBallistics, config.sampleRate);
+}
+
+int NullAudioLayer::getMeterLevels(MeterLevels* out, int maxCount) {
+    return mixer.readMeters(out, maxCount);
+}
+
+AudioCallback NullAudioLayer::openCapture(CaptureTap tap) {
+    captureFeed.open(std::move(tap), config.sampleRate);
+    return captureFeed.source();
+}
+
+void NullAudioLayer::closeCapture() {
+    captureFeed.close();
+}
+
+void NullAudioLayer::setEchoCancellation(bool enabled) {
+    captureFeed.setEchoCancellation(enabled);
+}
+
+bool NullAudioLayer::setInputEchoReference(int busId, bool include) {
+    return busTable.setEchoReference(busId, include);
+}
+
+bool NullAudioLayer::getEchoCancellerStats(AdaptiveEchoCanceller::Stats& stats) {
+    return captureFeed.getEchoCancellerStats(stats);
+}
+
+bool NullAudioLayer::setConfig(const Config& newConfig) {
+    if (playing.load(memory_order_acquire)) {
+        return false;
+    }
+    config = sanitize(newConfig);
+    mixer.setMeterBallistics(meterBallistics, config.sampleRate);
+    block.assign(static_cast<size_t>(config.blockFrames) * config.channels, 0.0f);
+    return true;
+}
+
+void NullAudioLayer::setMixTap(MixTap tap) {
+    if (!playing.load(memory_order_acquire)) {
+        mixTap = std::move(tap);
+    }
+}
+
+void NullAudioLayer::setCaptureInput(CaptureInput input) {
+    if (!playing.load(memory_order_acquire)) {
+        captureInput = std::move(input);
+    }
+}
+
+void NullAudioLayer::start() {
+    if (playing.exchange(true, memory_order_acq_rel)) {
+        return;
+    }
+    if (block.empty()) {
+        block.assign(static_cast<size_t>(config.blockFrames) * config.channels, 0.0f);
+    }
+    renderStats.resetPeriod();
+    if (config.pacing != Pacing::Manual) {
+        renderThread = thread(&NullAudioLayer::renderLoop, this);
+    }
+}
+
+void NullAudioLayer::stop() {
+    playing.store(false, memory_order_release);
+    if (renderThread.joinable()) {
+        renderThread.join();
+    }
+}
+
+bool NullAudioLayer::renderFrames(int64_t frames) {
+    if (config.pacing != Pacing::Manual || !playing.load(memory_order_acquire)) {
+        return false;
+    }
+    while (frames > 0) {
+        const int32_t count = static_cast<int32_t>(min<int64_t>(frames, config.blockFrames));
+        renderBlock(count);
+        frames -= count;
+    }
+    return true;
+}
+
+/*
+Block thứ n được render ở thời điểm start + n * blockFrames / (sampleRate * clockRate) theo thời gian thực.
+Đặt lịch theo mốc bắt đầu (không cộng dồn sleep) nên đồng hồ ảo không trôi so với đồng hồ thực.
+Nếu render chậm hơn lịch (máy CI bận) thì chạy tiếp ngay, không bỏ block.
+*/
+void NullAudioLayer::renderLoop() {
+    const auto startedAt = chrono::steady_clock::now();
+    const int64_t startFrame = getFramesRendered();
+    const bool paced = config.pacing == Pacing::VirtualClock && config.clockRate > 0.0;
+    const double nanosPerFrame = paced ? 1e9 / (config.sampleRate * config.clockRate) : 0.0;
+
+    while (playing.load(memory_order_acquire)) {
+        renderBlock(config.blockFrames);
+        if (paced) {
+            const auto due = startedAt + chrono::nanoseconds(static_cast<int64_t>(
+                                             (getFramesRendered() - startFrame) * nanosPerFrame));
+            this_thread::sleep_until(due);
+        }
+    }
+}
+
+void NullAudioLayer::renderBlock(int32_t frames) {
+    {
+        RT_NO_ALLOC_SCOPE("NullAudioLayer::renderBlock");
+        StreamStats::CallbackScope statsScope(renderStats, frames, config.sampleRate);
+        // Như OboeLayer: mic của block được đọc ngay trước khi mix block đó
+        if (float* mic = captureFeed.beginBlock(frames)) {
+            if (captureInput) {
+                captureInput(mic, frames);
+            } else {
+                memset(mic, 0, frames * sizeof(float));
+            }
+            captureFeed.endBlock(frames);
+        }
+        float* reference = captureFeed.referenceBlock();
+        mixer.render(block.data(), frames, config.channels, reference);
+        if (reference) {
+            captureFeed.endReference(frames);
+        }
+    }
+    if (mixTap) {
+        mixTap(block.data(), frames, config.channels);
+    }
+    onBlockRendered(block.data(), frames);
+    framesRendered.fetch_add(frames, memory_order_acq_rel);
+}
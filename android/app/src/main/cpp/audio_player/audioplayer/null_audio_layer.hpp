@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "audio_layer.hpp"
+#include "audio_stats.hpp"
+#include "bus_mixer.hpp"
+#include "capture_feed.hpp"
+
+/*
+    NullAudioLayer: AudioLayer không có thiết bị (Linux/CI). Một thread riêng kéo dữ liệu của các bus
+    theo block blockFrames frame, cùng BusMixer với OboeLayer nên kết quả mix giống hệt trên thiết bị.
+    Nhịp render theo một đồng hồ ảo (số frame đã render / sampleRate):
+    - VirtualClock: chờ tới thời điểm của block tiếp theo, clockRate = 1 là thời gian thực,
+      clockRate = 4 là nhanh gấp 4 (AudioSession vẫn thấy nhịp callback đều như thiết bị thật).
+    - Unpaced: không chờ, chạy nhanh nhất có thể (benchmark mixer/decode).
+    - Manual: không có thread, test gọi renderFrames() để đẩy đồng hồ ảo đi một cách tất định.
+    FileSinkAudioLayer ghi thêm kết quả mix ra file WAV.
+*/
+class NullAudioLayer : public AudioLayer {
+public:
+    enum class Pacing {
+        VirtualClock,
+        Unpaced,
+        Manual,
+    };
+
+    struct Config {
+        int sampleRate = 48000;
+        int channels = 2;                 // 1 hoặc 2
+        int32_t blockFrames = 192;        // Số frame mỗi lần render, tối đa BusMixer::MAX_FRAMES_PER_ITERATION
+        Pacing pacing = Pacing::VirtualClock;
+        double clockRate = 1.0;           // VirtualClock: tốc độ đồng hồ ảo so với thời gian thực
+        double outputLatencyMillis = 0.0; // Độ trễ đầu ra giả lập trả về từ getOutputLatencyMillis()
+
+        // Mặc định ghi đè bằng biến môi trường (CI):
+        // AUDIO_LAYER_PACING=clock|unpaced|manual, AUDIO_LAYER_CLOCK_RATE, AUDIO_LAYER_BLOCK_FRAMES,
+        // AUDIO_LAYER_SAMPLE_RATE, AUDIO_LAYER_LATENCY_MS
+        static Config fromEnvironment();
+    };
+
+    // Thread render gọi sau mỗi block (đã qua limiter), frames frame interleaved channels kênh
+    using MixTap = std::function<void(const float* mix, int32_t frames, int channels)>;
+    // Mic giả lập cho openCapture(): ghi frames mẫu mono trên thread render
+    using CaptureInput = std::function<void(float* mono, int32_t frames)>;
+
+    NullAudioLayer();
+    explicit NullAudioLayer(const Config& config);
+    ~NullAudioLayer() override;
+
+    bool initialize() override;
+    void shutdown() override;
+
+    int acquireInputBus(int channels = 1) override;
+    int acquireStemBus(int sourceBusId, int firstChannel, int channels) override;
+    void releaseInputBus(int busId) override;
+    void setInputVolume(int busId, float volume) override;
+    void muteInputBus(int busId, bool mute) override;
+    void setInputPan(int busId, float pan) override;
+
+    void setAudioCallback(int busId, AudioCallback callback) override;
+    bool setBusGraph(int busId, std::shared_ptr<ProcessingGraph> graph) override;
+    bool getInputCpuStats(int busId, InputCpuStats& stats) override;
+    void setMeterBallistics(const MeterBallistics& ballistics) override;
+    int getMeterLevels(MeterLevels* out, int maxCount) override;
+    AudioCallback openCapture(CaptureTap tap = nullptr) override;
+    void closeCapture() override;
+    void setEchoCancellation(bool enabled) override;
+    bool setInputEchoReference(int busId, bool include) override;
+    bool getEchoCancellerStats(AdaptiveEchoCanceller::Stats& stats) override;
+
+    void start() override;
+    void stop() override;
+
+    double getOutputLatencyMillis() const override { return config.outputLatencyMillis; }
+    int getSampleRate() const override { return config.sampleRate; }
+
+    const Config& getConfig() const { return config; }
+    // Chỉ đổi được khi đã stop()
+    bool setConfig(const Config& config);
+    // Chỉ set khi đã stop()
+    void setMixTap(MixTap tap);
+    // Chỉ set khi đã stop(). Không có thì mic giả lập là im lặng.
+    void setCaptureInput(CaptureInput input);
+
+    // Đồng hồ ảo: số frame đã render từ lúc initialize()
+    int64_t getFramesRendered() const { return framesRendered.load(std::memory_order_acquire); }
+    double getVirtualTimeSeconds() const { return static_cast<double>(getFramesRendered()) / config.sampleRate; }
+
+    // Pacing::Manual: render frames frame trên thread gọi (theo block blockFrames).
+    // false nếu không ở chế độ Manual hoặc chưa start().
+    bool renderFrames(int64_t frames);
+
+protected:
+    // Lớp con nhận từng block đã mix trên thread render (sau mix tap)
+    virtual void onBlockRendered(const float* /*mix*/, int32_t /*frames*/) {}
+
+private:
+    void renderLoop();
+    void renderBlock(int32_t frames);
+
+    Config config;
+    MeterBallistics meterBallistics; // Áp dụng lại khi đổi sample rate
+    BusMixer mixer;
+    BusTable& busTable;
+
+    std::vector<float> block;
+    MixTap mixTap;
+    CaptureInput captureInput;
+    CaptureFeed captureFeed;
+    // Thời gian/nhịp của từng block như callback của thiết bị
+    StreamStats renderStats{"null-output"};
+    std::thread renderThread;
+    std::atomic<bool> playing{false};
+    std::atomic<int64_t> framesRendered{0};
+};
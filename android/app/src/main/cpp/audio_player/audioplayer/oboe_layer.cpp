@@ -1,4 +1,5 @@
 #include "oboe_layer.hpp"
+#include "rt_alloc_guard.hpp"
 #include <algorithm>
 #include <android/log.h>
 #include <cmath>
@@ -10,9 +11,9 @@
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
 OboeLayer::OboeLayer()
-    : sampleRate(0), channels(0), bufferSize(0), playing(false)
+    : busTable(mixer.getBusTable()), sampleRate(0), channels(0), bufferSize(0), playing(false)
 {
-    LOGI("Creating OboeLayer instance");
+    LOGI("Creating OboeLayer instance (mix kernels: %s)", mixer.getKernels().name);
 }
 
 OboeLayer::~OboeLayer()
@@ -29,7 +30,8 @@ bool OboeLayer::initialize()
     LOGI("Initializing OboeLayer");
 
     this->sampleRate = 48000;
-    this->channels = 1;
+    // Đầu ra stereo, bus mono được nhân đôi sang hai kênh khi mix
+    this->channels = 2;
 
     // Cấu hình Oboe stream với các thiết lập tối ưu hóa triệt để
     oboe::AudioStreamBuilder builder;
@@ -51,7 +53,7 @@ bool OboeLayer::initialize()
         ->setUsage(oboe::Usage::Media)
         ->setContentType(oboe::ContentType::Music)
         ->setSessionId(oboe::SessionId::None)
-        ->setFramesPerCallback(512) // Tăng từ 256 lên 512
+        // Không đặt FramesPerCallback: callback theo từng burst cho độ trễ thấp nhất
         // Thêm các thiết lập mới
         ->setInputPreset(oboe::InputPreset::VoicePerformance)
         ->setDeviceId(oboe::kUnspecified);
@@ -80,30 +82,53 @@ bool OboeLayer::initialize()
         }
     }
 
+    // Thiết bị có thể không mở được stereo, mix theo số kênh thực tế của stream
+    channels = audioStream->getChannelCount();
+
     // Lấy kích thước buffer thực tế
     bufferSize = audioStream->getBufferSizeInFrames();
-    LOGI("Audio stream created successfully - bufferSize=%d, framesPerBurst=%d",
-         bufferSize, audioStream->getFramesPerBurst());
+    LOGI("Audio stream created successfully - bufferSize=%d, capacity=%d, framesPerBurst=%d",
+         bufferSize, audioStream->getBufferCapacityInFrames(), audioStream->getFramesPerBurst());
 
-    // Điều chỉnh buffer size để tránh underrun
-    int desiredBufferSize = audioStream->getFramesPerBurst() * 32; // Tăng từ 16 lên 32
-    if (bufferSize < desiredBufferSize)
+    if (audioStream->isXRunCountSupported())
     {
-        result = audioStream->setBufferSizeInFrames(desiredBufferSize);
-        if (result == oboe::Result::OK)
+        // Bắt đầu từ buffer nhỏ nhất, LatencyController tăng dần trong callback khi có xrun
+        int32_t initialFrames = latencyController.reset(audioStream->getFramesPerBurst(),
+                                                        audioStream->getBufferCapacityInFrames(), sampleRate);
+        auto applied = audioStream->setBufferSizeInFrames(initialFrames);
+        if (applied)
+        {
+            latencyController.onBufferSizeApplied(applied.value());
+        }
+        else
         {
-            bufferSize = audioStream->getBufferSizeInFrames();
-            LOGI("Adjusted buffer size to %d frames", bufferSize);
+            latencyController.disable(bufferSize);
         }
     }
-
-    // Khởi tạo các bus
-    for (int i = 0; i < MAX_BUSES; i++)
+    else
     {
-        buses[i] = BusInfo();
-        buses[i].volume = 1.0f;
-        buses[i].isMuted = false;
+        // Không đếm được xrun (OpenSL ES) nên không tự điều chỉnh được: dùng buffer lớn an toàn
+        int desiredBufferSize = audioStream->getFramesPerBurst() * FALLBACK_BUFFER_BURSTS;
+        if (bufferSize < desiredBufferSize)
+        {
+            auto applied = audioStream->setBufferSizeInFrames(desiredBufferSize);
+            if (applied)
+            {
+                bufferSize = applied.value();
+            }
+        }
+        latencyController.disable(bufferSize);
     }
+    bufferSize = latencyController.getBufferFrames();
+    LOGI("Output buffer size %d frames (%.1f ms)", bufferSize, bufferSize * 1000.0 / sampleRate);
+
+    // Ước lượng ban đầu cho độ trễ đầu ra, được thay bằng giá trị đo được khi stream chạy
+    outputLatencyMillis.store(bufferSize * 1000.0 / sampleRate);
+    latencyUpdatedAtMs.store(0);
+    mixer.setMeterBallistics(meterBallistics, sampleRate);
+
+    // Khởi tạo các bus
+    busTable.clear();
 
     return true;
 }
@@ -112,6 +137,7 @@ void OboeLayer::shutdown()
 {
     LOGI("Shutting down OboeLayer");
 
+    closeCapture();
     if (audioStream)
     {
         audioStream->stop();
@@ -119,31 +145,40 @@ void OboeLayer::shutdown()
         audioStream.reset();
     }
 
-    // Reset tất cả các bus
-    for (auto &bus : buses)
-    {
-        bus = BusInfo();
-    }
+    // Reset tất cả các bus (stream đã đóng, không còn callback nào đọc bảng)
+    busTable.clear();
 
     LOGI("OboeLayer shutdown completed");
 }
 
-int OboeLayer::acquireInputBus()
+int OboeLayer::acquireInputBus(int channels)
 {
-    for (int i = 0; i < MAX_BUSES; i++)
+    // Bus hơn 2 kênh chỉ dùng làm nguồn cho các bus stem
+    if (channels < 1 || channels > MAX_SOURCE_CHANNELS)
     {
-        if (!buses[i].inUse)
-        {
-            buses[i].inUse = true;
-            buses[i].isMuted = false;
-            buses[i].volume = 1.0f;
-            buses[i].channels = 1;
-            LOGI("Acquired bus %d with %d channels", i, 1);
-            return i;
-        }
+        LOGE("Unsupported bus channel count %d", channels);
+        return -1;
+    }
+    int busId = busTable.acquire(channels);
+    if (busId < 0)
+    {
+        LOGE("Failed to acquire bus - all buses in use");
+        return -1;
     }
-    LOGE("Failed to acquire bus - all buses in use");
-    return -1;
+    LOGI("Acquired bus %d with %d channels", busId, channels);
+    return busId;
+}
+
+int OboeLayer::acquireStemBus(int sourceBusId, int firstChannel, int channels)
+{
+    int busId = busTable.acquireStem(sourceBusId, firstChannel, channels);
+    if (busId < 0)
+    {
+        LOGE("Failed to acquire stem bus: channels %d+%d of bus %d", firstChannel, channels, sourceBusId);
+        return -1;
+    }
+    LOGI("Acquired stem bus %d: channels %d+%d of bus %d", busId, firstChannel, channels, sourceBusId);
+    return busId;
 }
 
 void OboeLayer::releaseInputBus(int busId)
@@ -151,7 +186,8 @@ void OboeLayer::releaseInputBus(int busId)
     if (isValidBus(busId))
     {
         LOGI("Releasing bus %d", busId);
-        buses[busId] = BusInfo(); // Reset to default state
+        // Trả về khi callback không còn chạy graph của bus này nữa
+        busTable.release(busId);
     }
 }
 
@@ -159,8 +195,8 @@ void OboeLayer::setInputVolume(int busId, float volume)
 {
     if (isValidBus(busId))
     {
-        volume = std::clamp(volume, 0.0f, 1.0f);
-        buses[busId].volume = volume;
+        volume = std::clamp(volume, 0.0f, MAX_INPUT_VOLUME);
+        busTable.setVolume(busId, volume);
         LOGI("Set volume for bus %d to %f", busId, volume);
     }
 }
@@ -169,16 +205,25 @@ void OboeLayer::muteInputBus(int busId, bool mute)
 {
     if (isValidBus(busId))
     {
-        buses[busId].isMuted = mute;
+        busTable.setMuted(busId, mute);
         LOGI("Set mute=%d for bus %d", mute, busId);
     }
 }
 
-void OboeLayer::setAudioCallback(int busId, AudioCallback callback)
+void OboeLayer::setInputPan(int busId, float pan)
 {
     if (isValidBus(busId))
     {
-        buses[busId].audioCallback = callback;
+        pan = std::clamp(pan, -1.0f, 1.0f);
+        busTable.setPan(busId, pan);
+        LOGI("Set pan for bus %d to %f", busId, pan);
+    }
+}
+
+void OboeLayer::setAudioCallback(int busId, AudioCallback callback)
+{
+    if (busTable.setCallback(busId, std::move(callback)))
+    {
         LOGI("Set audio callback for bus %d", busId);
     }
     else
@@ -187,6 +232,17 @@ void OboeLayer::setAudioCallback(int busId, AudioCallback callback)
     }
 }
 
+bool OboeLayer::setBusGraph(int busId, std::shared_ptr<ProcessingGraph> graph)
+{
+    if (!busTable.setGraph(busId, std::move(graph)))
+    {
+        LOGE("Failed to set processing graph for bus %d", busId);
+        return false;
+    }
+    LOGI("Set processing graph for bus %d", busId);
+    return true;
+}
+
 void OboeLayer::start()
 {
     if (!playing && audioStream)
@@ -205,6 +261,18 @@ void OboeLayer::start()
             }
         }
 
+        // Khoảng dừng trước khi start không tính vào jitter của chu kỳ callback
+        callbackStats.resetPeriod();
+        latencyController.resume();
+        {
+            // Mic start trước để đã có dữ liệu khi callback đầu ra đầu tiên tới
+            std::lock_guard<std::mutex> lock(captureMutex);
+            if (inputStream)
+            {
+                resetCapture();
+                inputStream->requestStart();
+            }
+        }
         oboe::Result result = audioStream->requestStart();
         if (result == oboe::Result::OK)
         {
@@ -233,7 +301,57 @@ void OboeLayer::stop()
         {
             LOGE("Failed to stop audio output - result=%s", oboe::convertToText(result));
         }
+
+        // Mic full-duplex dừng cùng output
+        std::lock_guard<std::mutex> lock(captureMutex);
+        if (inputStream)
+        {
+            inputStream->requestStop();
+        }
+    }
+}
+
+double OboeLayer::getOutputLatencyMillis() const
+{
+    // calculateLatencyMillis() không được gọi từ data callback (Oboe TechNote_ReleaseBuffer),
+    // callback chỉ đọc giá trị đã cache
+    if (std::this_thread::get_id() != callbackThreadId.load(std::memory_order_relaxed))
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+        if (now - latencyUpdatedAtMs.load(std::memory_order_relaxed) >= LATENCY_REFRESH_MS)
+        {
+            updateOutputLatency();
+        }
     }
+    return outputLatencyMillis.load(std::memory_order_relaxed);
+}
+
+void OboeLayer::updateOutputLatency() const
+{
+    // Thread khác đang đo thì dùng luôn giá trị cũ, không chờ
+    std::unique_lock<std::mutex> lock(latencyMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !audioStream || !playing)
+    {
+        return;
+    }
+
+    auto latency = audioStream->calculateLatencyMillis();
+    if (latency)
+    {
+        outputLatencyMillis.store(latency.value(), std::memory_order_relaxed);
+    }
+    else
+    {
+        // Không có timestamp (OpenSL ES, stream vừa start): ước lượng theo buffer đang dùng
+        outputLatencyMillis.store(latencyController.getBufferFrames() * 1000.0 / sampleRate,
+                                  std::memory_order_relaxed);
+    }
+    latencyUpdatedAtMs.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count(),
+                             std::memory_order_relaxed);
 }
 
 oboe::DataCallbackResult OboeLayer::onAudioReady(
@@ -241,152 +359,223 @@ oboe::DataCallbackResult OboeLayer::onAudioReady(
     void *audioData,
     int32_t numFrames)
 {
+    RT_NO_ALLOC_SCOPE("OboeLayer::onAudioReady");
+    StreamStats::CallbackScope statsScope(callbackStats, numFrames, sampleRate);
     float *outputBuffer = static_cast<float *>(audioData);
+    callbackThreadId.store(std::this_thread::get_id(), std::memory_order_relaxed);
 
-    // Xóa buffer đầu ra
-    memset(outputBuffer, 0, numFrames * channels * sizeof(float));
+    // AAudio đọc bộ đếm xrun từ bộ nhớ chia sẻ, gọi được trong callback (như oboe::LatencyTuner)
+    auto xruns = audioStream->getXRunCount();
+    if (xruns)
+    {
+        callbackStats.setXRunCount(xruns.value());
+    }
 
     if (!playing)
     {
+        memset(outputBuffer, 0, numFrames * channels * sizeof(float));
         return oboe::DataCallbackResult::Continue;
     }
 
-    // Tăng kích thước buffer tạm thời để xử lý nhiều dữ liệu hơn một lần
-    float mixBuffer[4096 * 2]; // Buffer lớn hơn cho xử lý hiệu quả
-    const int maxFramesPerIteration = 4096;
+    // Như oboe::LatencyTuner: AAudio cho phép đổi kích thước buffer ngay trong callback
+    int32_t newBufferFrames = latencyController.onCallback(xruns ? xruns.value() : -1, numFrames);
+    if (newBufferFrames > 0)
+    {
+        auto applied = audioStream->setBufferSizeInFrames(newBufferFrames);
+        latencyController.onBufferSizeApplied(applied ? applied.value() : -1);
+    }
 
-    // Xử lý từng bus
-    bool anyActiveStream = false;
-    
-    // Xử lý theo từng đoạn lớn hơn để giảm overhead
-    for (int frameOffset = 0; frameOffset < numFrames; frameOffset += maxFramesPerIteration)
+    // Mic (full-duplex) của mỗi đoạn được đọc ngay trước khi mix đoạn đó
+    for (int32_t offset = 0; offset < numFrames; offset += CaptureFeed::MAX_BLOCK_FRAMES)
     {
-        int framesToProcess = std::min(maxFramesPerIteration, numFrames - frameOffset);
-        
-        // Xóa buffer tạm thời
-        memset(mixBuffer, 0, framesToProcess * channels * sizeof(float));
-        
-        // Xử lý từng bus
-        for (int busId = 0; busId < MAX_BUSES; busId++)
+        int32_t frames = std::min(numFrames - offset, CaptureFeed::MAX_BLOCK_FRAMES);
+        captureInput(frames);
+        // Khử echo bật: nhạc của đoạn này làm reference cho mic của đoạn sau
+        float *reference = captureFeed.referenceBlock();
+        mixer.render(outputBuffer + offset * channels, frames, channels, reference);
+        if (reference)
         {
-            auto &bus = buses[busId];
+            captureFeed.endReference(frames);
+        }
+    }
+    return oboe::DataCallbackResult::Continue;
+}
 
-            if (!bus.inUse || bus.isMuted || !bus.audioCallback)
+void OboeLayer::captureInput(int32_t numFrames)
+{
+    float *block = captureFeed.beginBlock(numFrames);
+    if (!block)
+    {
+        return;
+    }
+    StreamStats::CallbackScope statsScope(captureStats, numFrames, sampleRate);
+
+    int32_t framesRead = 0;
+    auto available = inputStream->getAvailableFrames();
+    if (available)
+    {
+        int32_t framesAvailable = available.value();
+        if (captureCallbacksToDrain > 0)
+        {
+            // Vừa mở/start: bỏ phần mic tích lũy lúc khởi động để đọc sát đầu ghi của input.
+            // Chỉ tính các lần thực sự có dữ liệu, input có thể chưa chạy.
+            if (framesAvailable > 0)
             {
-                continue;
+                discardInput(block, framesAvailable);
+                captureCallbacksToDrain--;
             }
-
-            // Xử lý dựa trên số kênh của bus
-            if (bus.channels == 1)
+        }
+        else if (capturePrimed || framesAvailable >= numFrames)
+        {
+            // Input chạy nhanh hơn đầu ra (hai clock lệch nhau) hoặc callback bị trễ:
+            // bỏ phần dư thay vì để độ trễ của mic tăng dần
+            int32_t excess = framesAvailable - numFrames - captureBacklogFrames;
+            if (excess > 0)
             {
-                // Mono input
-                float tempBuffer[maxFramesPerIteration];
-
-                // Đọc audio từ callback
-                size_t framesRead = bus.audioCallback(tempBuffer, framesToProcess);
-
-                if (framesRead > 0)
-                {
-                    anyActiveStream = true;
-                    float busVolume = bus.volume;
-
-                    // Chuyển đổi từ mono sang stereo interleaved nếu cần
-                    if (channels == 2)
-                    {
-                        // Tối ưu hóa vòng lặp
-                        for (size_t i = 0; i < framesRead; i += 16)
-                        {
-                            // Xử lý 16 samples một lần
-                            for (size_t j = 0; j < 16 && i + j < framesRead; j++)
-                            {
-                                float sample = tempBuffer[i + j] * busVolume;
-                                mixBuffer[(i + j) * 2] += sample;     // Kênh trái
-                                mixBuffer[(i + j) * 2 + 1] += sample; // Kênh phải
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Mono output - tối ưu hóa vòng lặp
-                        for (size_t i = 0; i < framesRead; i += 16)
-                        {
-                            // Xử lý 16 samples một lần
-                            for (size_t j = 0; j < 16 && i + j < framesRead; j++)
-                            {
-                                mixBuffer[i + j] += tempBuffer[i + j] * busVolume;
-                            }
-                        }
-                    }
-                }
+                discardInput(block, excess);
+                captureStats.ring.addOverflow(excess);
             }
-            else if (bus.channels == 2)
+            auto read = inputStream->read(block, numFrames, 0);
+            framesRead = read ? read.value() : 0;
+            if (capturePrimed && framesRead < numFrames)
             {
-                // Stereo input
-                float tempBuffer[maxFramesPerIteration * 2];
-
-                // Đọc audio từ callback
-                size_t framesRead = bus.audioCallback(tempBuffer, framesToProcess);
-
-                if (framesRead > 0)
-                {
-                    anyActiveStream = true;
-                    float busVolume = bus.volume;
-
-                    if (channels == 2)
-                    {
-                        // Stereo output - tối ưu hóa vòng lặp
-                        for (size_t i = 0; i < framesRead; i += 16)
-                        {
-                            // Xử lý 16 samples một lần
-                            for (size_t j = 0; j < 16 && i + j < framesRead; j++)
-                            {
-                                mixBuffer[(i + j) * 2] += tempBuffer[(i + j) * 2] * busVolume;
-                                mixBuffer[(i + j) * 2 + 1] += tempBuffer[(i + j) * 2 + 1] * busVolume;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // Mono output - tối ưu hóa vòng lặp
-                        for (size_t i = 0; i < framesRead; i += 16)
-                        {
-                            // Xử lý 16 samples một lần
-                            for (size_t j = 0; j < 16 && i + j < framesRead; j++)
-                            {
-                                // Lấy trung bình của 2 kênh
-                                float monoSample = (tempBuffer[(i + j) * 2] + tempBuffer[(i + j) * 2 + 1]) * 0.5f * busVolume;
-                                mixBuffer[i + j] += monoSample;
-                            }
-                        }
-                    }
-                }
+                captureStats.ring.addUnderflow(numFrames - framesRead);
             }
+            capturePrimed = true;
         }
-        
-        // Copy dữ liệu từ mixBuffer sang outputBuffer
-        memcpy(outputBuffer + frameOffset * channels, mixBuffer, framesToProcess * channels * sizeof(float));
-        
-        // Áp dụng soft clipping sau khi đã copy
-        if (frameOffset % 4 == 0)
+    }
+
+    auto xruns = inputStream->getXRunCount();
+    if (xruns)
+    {
+        captureStats.setXRunCount(xruns.value());
+    }
+    captureFeed.endBlock(framesRead);
+}
+
+void OboeLayer::discardInput(float *scratch, int32_t numFrames)
+{
+    while (numFrames > 0)
+    {
+        auto read = inputStream->read(scratch, std::min(numFrames, CaptureFeed::MAX_BLOCK_FRAMES), 0);
+        if (!read || read.value() <= 0)
         {
-            for (int i = 0; i < framesToProcess * channels; i++)
-            {
-                float &sample = outputBuffer[frameOffset * channels + i];
-                if (sample > 0.98f || sample < -0.98f)
-                {
-                    float sign = (sample > 0) ? 1.0f : -1.0f;
-                    sample = sign * 0.98f;
-                }
-            }
+            return;
         }
+        numFrames -= read.value();
     }
+}
 
-    if (!anyActiveStream && playing)
+void OboeLayer::resetCapture()
+{
+    captureCallbacksToDrain = CAPTURE_DRAIN_CALLBACKS;
+    capturePrimed = false;
+    captureStats.resetPeriod();
+}
+
+AudioCallback OboeLayer::openCapture(CaptureTap tap)
+{
+    std::lock_guard<std::mutex> lock(captureMutex);
+    if (captureFeed.isOpen())
     {
-        return oboe::DataCallbackResult::Continue;
+        return captureFeed.source();
+    }
+    if (!audioStream)
+    {
+        LOGE("Cannot open capture - output stream not initialized");
+        return nullptr;
     }
 
-    return oboe::DataCallbackResult::Continue;
+    // Mono, cùng sample rate với đầu ra để đọc từng đoạn khớp frame với đầu ra
+    oboe::AudioStreamBuilder builder;
+    builder.setDirection(oboe::Direction::Input)
+        ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+        ->setSharingMode(oboe::SharingMode::Exclusive)
+        ->setFormat(oboe::AudioFormat::Float)
+        ->setChannelCount(1)
+        ->setSampleRate(audioStream->getSampleRate())
+        ->setSampleRateConversionQuality(oboe::SampleRateConversionQuality::Medium)
+        ->setInputPreset(oboe::InputPreset::VoicePerformance);
+
+    oboe::Result result = builder.openStream(inputStream);
+    if (result != oboe::Result::OK)
+    {
+        builder.setSharingMode(oboe::SharingMode::Shared);
+        result = builder.openStream(inputStream);
+        if (result != oboe::Result::OK)
+        {
+            LOGE("Failed to open capture stream: %s", oboe::convertToText(result));
+            inputStream.reset();
+            return nullptr;
+        }
+    }
+
+    // Buffer input lớn nhất để mic không overflow khi một callback đầu ra bị trễ,
+    // độ trễ thực được giữ thấp bằng cách bỏ phần dư quá CAPTURE_BACKLOG_BURSTS
+    inputStream->setBufferSizeInFrames(inputStream->getBufferCapacityInFrames());
+    captureBacklogFrames = inputStream->getFramesPerBurst() * CAPTURE_BACKLOG_BURSTS;
+    resetCapture();
+    if (playing)
+    {
+        inputStream->requestStart();
+    }
+    LOGI("Capture stream opened - sampleRate=%d, framesPerBurst=%d, sharing=%s",
+         inputStream->getSampleRate(), inputStream->getFramesPerBurst(),
+         oboe::convertToText(inputStream->getSharingMode()));
+
+    captureFeed.open(std::move(tap), audioStream->getSampleRate());
+    return captureFeed.source();
+}
+
+void OboeLayer::closeCapture()
+{
+    std::lock_guard<std::mutex> lock(captureMutex);
+    // Callback không còn đọc inputStream sau khi feed đóng
+    captureFeed.close();
+    if (inputStream)
+    {
+        inputStream->stop();
+        inputStream->close();
+        inputStream.reset();
+        LOGI("Capture stream closed");
+    }
+}
+
+void OboeLayer::setEchoCancellation(bool enabled)
+{
+    captureFeed.setEchoCancellation(enabled);
+    LOGI("Echo cancellation %s", enabled ? "enabled" : "disabled");
+}
+
+bool OboeLayer::setInputEchoReference(int busId, bool include)
+{
+    return busTable.setEchoReference(busId, include);
+}
+
+bool OboeLayer::getEchoCancellerStats(AdaptiveEchoCanceller::Stats &stats)
+{
+    std::lock_guard<std::mutex> lock(captureMutex);
+    return captureFeed.getEchoCancellerStats(stats);
+}
+
+bool OboeLayer::getInputCpuStats(int busId, InputCpuStats &stats)
+{
+    return mixer.getCpuStats(busId, sampleRate, stats);
+}
+
+void OboeLayer::setMeterBallistics(const MeterBallistics &ballistics)
+{
+    meterBallistics = ballistics;
+    // Chưa mở stream thì initialize() sẽ áp dụng
+    if (sampleRate > 0)
+    {
+        mixer.setMeterBallistics(meterBallistics, sampleRate);
+    }
+}
+
+int OboeLayer::getMeterLevels(MeterLevels *out, int maxCount)
+{
+    return mixer.readMeters(out, maxCount);
 }
 
 // Không định nghĩa lại các phương thức đã có trong header
\ No newline at end of file
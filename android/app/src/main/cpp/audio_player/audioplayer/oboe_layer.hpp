@@ -2,9 +2,16 @@
 
 #include <vector>
 #include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <oboe/Oboe.h>
 #include "audio_layer.hpp"
+#include "audio_stats.hpp"
+#include "bus_mixer.hpp"
+#include "capture_feed.hpp"
+#include "latency_controller.hpp"
 #include "common.hpp"
 
 class AudioSession;
@@ -12,24 +19,52 @@ class AudioSession;
 class OboeLayer : public AudioLayer, public oboe::AudioStreamCallback
 {
 private:
-    static constexpr int MAX_BUSES = 4; // Số lượng bus âm thanh tối đa để mix
-
-    struct BusInfo
-    {
-        bool inUse = false;
-        bool isMuted = false;
-        float volume = 1.0f;
-        uint8_t channels = 1;        // Số kênh của bus
-        AudioCallback audioCallback; // Callback để đọc dữ liệu âm thanh
-    };
+    static constexpr int MAX_SOURCE_CHANNELS = BusTable::MAX_SOURCE_CHANNELS;
+    // Buffer cố định (theo burst) khi stream không báo xrun để LatencyController điều chỉnh
+    static constexpr int FALLBACK_BUFFER_BURSTS = 32;
+    // Full-duplex: số callback đầu (có dữ liệu) sau khi mở/start mic mà phần mic tích lũy bị bỏ
+    static constexpr int32_t CAPTURE_DRAIN_CALLBACKS = 20;
+    // Mic được phép chờ sẵn thêm bấy nhiêu burst của input trước khi phần dư bị bỏ (drift giữa hai clock)
+    static constexpr int32_t CAPTURE_BACKLOG_BURSTS = 2;
 
     std::shared_ptr<oboe::AudioStream> audioStream;
-    std::array<BusInfo, MAX_BUSES> buses;
+    // Bảng bus + mix/limiter, onAudioReady gọi render()
+    BusMixer mixer;
+    BusTable &busTable;
 
     int sampleRate;
     int channels;
     int bufferSize;
     bool playing;
+    // Giữ lại để áp dụng lại theo sample rate khi mở stream
+    MeterBallistics meterBallistics;
+    // Thời gian/nhịp của onAudioReady và xrun của stream (FFI get_audio_stats)
+    StreamStats callbackStats{"playback"};
+    // Kích thước buffer đầu ra: bắt đầu nhỏ, tăng một burst mỗi lần xrun, giảm lại khi ổn định
+    LatencyController latencyController;
+
+    // Full-duplex: input stream không có callback, được đọc không chặn trong onAudioReady
+    // (cách của oboe::FullDuplexStream) rồi đưa vào mixer qua captureFeed
+    std::shared_ptr<oboe::AudioStream> inputStream;
+    std::mutex captureMutex;          // Thread app: mở/đóng input stream
+    CaptureFeed captureFeed;
+    StreamStats captureStats{"capture"};
+    // Chỉ audio thread (đặt trước khi feed mở hoặc stream start)
+    int32_t captureCallbacksToDrain = 0;
+    int32_t captureBacklogFrames = 0;
+    bool capturePrimed = false;       // Mic đã đủ một đoạn sau khi drain, từ đây thiếu là underflow
+    void captureInput(int32_t numFrames);
+    void discardInput(float *scratch, int32_t numFrames);
+    void resetCapture();
+
+    // Độ trễ đầu ra được cache lại vì calculateLatencyMillis() không được gọi từ data callback.
+    // Giá trị được làm mới (tối đa mỗi LATENCY_REFRESH_MS) bởi thread không phải audio callback.
+    static constexpr int64_t LATENCY_REFRESH_MS = 200;
+    mutable std::atomic<double> outputLatencyMillis{0.0};
+    mutable std::atomic<int64_t> latencyUpdatedAtMs{0};
+    mutable std::mutex latencyMutex;
+    std::atomic<std::thread::id> callbackThreadId{};
+    void updateOutputLatency() const;
 
     // Implement Oboe callback
     oboe::DataCallbackResult onAudioReady(
@@ -44,16 +79,30 @@ public:
     bool initialize() override;
     void shutdown() override;
 
-    int acquireInputBus() override;
+    int acquireInputBus(int channels = 1) override;
+    int acquireStemBus(int sourceBusId, int firstChannel, int channels) override;
     void releaseInputBus(int busId) override;
     void setInputVolume(int busId, float volume) override;
     void muteInputBus(int busId, bool mute) override;
+    void setInputPan(int busId, float pan) override;
 
     void setAudioCallback(int busId, AudioCallback callback) override;
+    bool setBusGraph(int busId, std::shared_ptr<ProcessingGraph> graph) override;
+    bool getInputCpuStats(int busId, InputCpuStats &stats) override;
+    void setMeterBallistics(const MeterBallistics &ballistics) override;
+    int getMeterLevels(MeterLevels *out, int maxCount) override;
+    AudioCallback openCapture(CaptureTap tap = nullptr) override;
+    void closeCapture() override;
+    void setEchoCancellation(bool enabled) override;
+    bool setInputEchoReference(int busId, bool include) override;
+    bool getEchoCancellerStats(AdaptiveEchoCanceller::Stats &stats) override;
 
     void start() override;
     void stop() override;
 
+    double getOutputLatencyMillis() const override;
+    int getSampleRate() const override { return sampleRate; }
+
     // Implement Oboe callbacks
     void onErrorBeforeClose(oboe::AudioStream *audioStream, oboe::Result error) override {}
     void onErrorAfterClose(oboe::AudioStream *audioStream, oboe::Result error) override {}
@@ -61,7 +110,7 @@ public:
 private:
     bool isValidBus(int busId) const
     {
-        return busId >= 0 && busId < MAX_BUSES;
+        return busTable.isValid(busId);
     }
 
     uint32_t getCurrentTimeMs() const
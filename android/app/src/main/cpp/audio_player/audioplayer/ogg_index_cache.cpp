@@ -0,0 +1,317 @@
+#include "ogg_index_cache.hpp"
+#include "common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+mutex cacheDirMutex;
+string cacheDirectory;
+bool useSidecar = false;
+
+constexpr char CACHE_MAGIC[4] = {'O', 'I', 'D', 'X'};
+constexpr char LOUDNESS_MAGIC[4] = {'R', '1', '2', '8'};
+constexpr uint32_t LOUDNESS_VERSION = 1;
+
+// Header cố định ở đầu file .idx, theo sau là đường dẫn file gốc và page_table
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;     // Kích thước file gốc (byte)
+    int64_t sourceMtime;     // mtime file gốc (đơn vị của file_time_type)
+    uint32_t pathLength;
+    uint32_t pageCount;
+    int64_t lastGranulePos;
+    uint32_t fileDuration;
+    int32_t serialno;
+    OpusHeader opusHeader;
+};
+
+// File .r128: header cố định rồi tới đường dẫn file gốc
+struct LoudnessRecord {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint32_t pathLength;
+    double loudness;         // LUFS
+};
+
+// Mỗi page chỉ lưu granule_pos, file_offset, size; index chính là vị trí trong bảng
+constexpr size_t PAGE_RECORD_SIZE = sizeof(int64_t) + sizeof(int64_t) + sizeof(uint32_t);
+
+struct SourceKey {
+    uint64_t size;
+    int64_t mtime;
+};
+
+bool getSourceKey(const string& fileName, SourceKey& key) {
+    error_code ec;
+    uintmax_t size = filesystem::file_size(fileName, ec);
+    if (ec) {
+        return false;
+    }
+    auto mtime = filesystem::last_write_time(fileName, ec);
+    if (ec) {
+        return false;
+    }
+    key.size = static_cast<uint64_t>(size);
+    key.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return true;
+}
+
+// Ghi ra file tạm rồi rename để không bao giờ để lại file cache ghi dở.
+// Tên file tạm do mkstemp tạo (cùng thư mục để rename không đổi filesystem), nên hai thread
+// hoặc hai process cùng ghi một cache không ghi chồng lên file tạm của nhau.
+bool writeAtomically(const string& path, const vector<unsigned char>& data) {
+    if (path.empty()) {
+        return false;
+    }
+    error_code ec;
+    filesystem::create_directories(filesystem::path(path).parent_path(), ec);
+    string tempPath = path + ".tmp.XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        debugPrint("Cannot write cache: {}", path);
+        return false;
+    }
+    FILE* fp = fdopen(fd, "wb");
+    if (!fp) {
+        close(fd);
+        ::remove(tempPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+        ::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void OggIndexCache::setCacheDirectory(const string& dir, bool sidecar) {
+    if (!dir.empty() && !sidecar) {
+        error_code ec;
+        filesystem::create_directories(dir, ec);
+    }
+    lock_guard<mutex> lock(cacheDirMutex);
+    cacheDirectory = dir;
+    useSidecar = sidecar;
+}
+
+string OggIndexCache::getCacheDirectory() {
+    {
+        lock_guard<mutex> lock(cacheDirMutex);
+        if (useSidecar) {
+            return string();
+        }
+        if (!cacheDirectory.empty()) {
+            return cacheDirectory;
+        }
+    }
+    // Chưa đặt thư mục: dùng thư mục con trong thư mục tạm (thư mục được tạo khi ghi cache)
+    error_code ec;
+    filesystem::path temp = filesystem::temp_directory_path(ec);
+    if (ec || temp.empty()) {
+        return string();
+    }
+    return (temp / "ogg_index_cache").string();
+}
+
+string OggIndexCache::cachePathFor(const string& fileName) {
+    {
+        lock_guard<mutex> lock(cacheDirMutex);
+        if (useSidecar) {
+            return fileName + ".idx";
+        }
+    }
+    string dir = getCacheDirectory();
+    if (dir.empty()) {
+        return string();
+    }
+    // Tên file cache là hash của đường dẫn, đường dẫn đầy đủ được kiểm tra lại khi load
+    char name[32];
+    snprintf(name, sizeof(name), "%016zx.idx", hash<string>{}(fileName));
+    return (filesystem::path(dir) / name).string();
+}
+
+bool OggIndexCache::load(const string& fileName, OggOpusFile& file) {
+    SourceKey key;
+    if (!getSourceKey(fileName, key)) {
+        return false;
+    }
+
+    const string cachePath = cachePathFor(fileName);
+    FILE* fp = fopen(cachePath.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+
+    // Đọc toàn bộ file cache trong một lần
+    vector<unsigned char> data;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long length = ftell(fp);
+        if (length > 0) {
+            data.resize(static_cast<size_t>(length));
+            rewind(fp);
+            if (fread(data.data(), 1, data.size(), fp) != data.size()) {
+                data.clear();
+            }
+        }
+    }
+    fclose(fp);
+
+    if (data.size() < sizeof(CacheHeader)) {
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != FORMAT_VERSION ||
+        header.sourceSize != key.size ||
+        header.sourceMtime != key.mtime ||
+        header.pageCount == 0) {
+        debugPrint("Index cache is stale: {}", cachePath);
+        return false;
+    }
+
+    const size_t expected = sizeof(CacheHeader) + header.pathLength +
+                            static_cast<size_t>(header.pageCount) * PAGE_RECORD_SIZE;
+    if (data.size() != expected) {
+        return false;
+    }
+
+    const unsigned char* cursor = data.data() + sizeof(CacheHeader);
+    if (header.pathLength != fileName.size() ||
+        memcmp(cursor, fileName.data(), header.pathLength) != 0) {
+        return false; // Trùng hash nhưng khác file
+    }
+    cursor += header.pathLength;
+
+    file.page_table.resize(header.pageCount);
+    for (uint32_t i = 0; i < header.pageCount; i++) {
+        OggPageIndex& page = file.page_table[i];
+        page.index = static_cast<uint16_t>(i);
+        memcpy(&page.granule_pos, cursor, sizeof(int64_t));
+        memcpy(&page.file_offset, cursor + sizeof(int64_t), sizeof(int64_t));
+        memcpy(&page.size, cursor + 2 * sizeof(int64_t), sizeof(uint32_t));
+        cursor += PAGE_RECORD_SIZE;
+    }
+
+    file.header = header.opusHeader;
+    file.serialno = header.serialno;
+    file.last_granulepos = header.lastGranulePos;
+    file.file_duration = header.fileDuration;
+    return true;
+}
+
+bool OggIndexCache::store(const string& fileName, const OggOpusFile& file) {
+    SourceKey key;
+    if (!getSourceKey(fileName, key) || file.page_table.empty()) {
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = FORMAT_VERSION;
+    header.sourceSize = key.size;
+    header.sourceMtime = key.mtime;
+    header.pathLength = static_cast<uint32_t>(fileName.size());
+    header.pageCount = static_cast<uint32_t>(file.page_table.size());
+    header.lastGranulePos = file.last_granulepos;
+    header.fileDuration = file.file_duration;
+    header.serialno = file.serialno;
+    header.opusHeader = file.header;
+
+    vector<unsigned char> data(sizeof(CacheHeader) + fileName.size() +
+                               file.page_table.size() * PAGE_RECORD_SIZE);
+    unsigned char* cursor = data.data();
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, fileName.data(), fileName.size());
+    cursor += fileName.size();
+    for (const auto& page : file.page_table) {
+        memcpy(cursor, &page.granule_pos, sizeof(int64_t));
+        memcpy(cursor + sizeof(int64_t), &page.file_offset, sizeof(int64_t));
+        memcpy(cursor + 2 * sizeof(int64_t), &page.size, sizeof(uint32_t));
+        cursor += PAGE_RECORD_SIZE;
+    }
+
+    return writeAtomically(cachePathFor(fileName), data);
+}
+
+string OggIndexCache::loudnessPathFor(const string& fileName) {
+    string path = cachePathFor(fileName);
+    if (path.empty()) {
+        return path;
+    }
+    return path.substr(0, path.size() - 4) + ".r128"; // Thay đuôi ".idx"
+}
+
+bool OggIndexCache::loadLoudness(const string& fileName, double& loudness) {
+    SourceKey key;
+    if (!getSourceKey(fileName, key)) {
+        return false;
+    }
+
+    FILE* fp = fopen(loudnessPathFor(fileName).c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    LoudnessRecord record;
+    vector<char> path(fileName.size());
+    bool ok = fread(&record, sizeof(record), 1, fp) == 1 &&
+              record.pathLength == fileName.size() &&
+              fread(path.data(), 1, path.size(), fp) == path.size();
+    fclose(fp);
+
+    if (!ok ||
+        memcmp(record.magic, LOUDNESS_MAGIC, sizeof(LOUDNESS_MAGIC)) != 0 ||
+        record.version != LOUDNESS_VERSION ||
+        record.sourceSize != key.size ||
+        record.sourceMtime != key.mtime ||
+        memcmp(path.data(), fileName.data(), path.size()) != 0) {
+        return false;
+    }
+    loudness = record.loudness;
+    return true;
+}
+
+bool OggIndexCache::storeLoudness(const string& fileName, double loudness) {
+    SourceKey key;
+    if (!getSourceKey(fileName, key)) {
+        return false;
+    }
+
+    LoudnessRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.magic, LOUDNESS_MAGIC, sizeof(LOUDNESS_MAGIC));
+    record.version = LOUDNESS_VERSION;
+    record.sourceSize = key.size;
+    record.sourceMtime = key.mtime;
+    record.pathLength = static_cast<uint32_t>(fileName.size());
+    record.loudness = loudness;
+
+    vector<unsigned char> data(sizeof(record) + fileName.size());
+    memcpy(data.data(), &record, sizeof(record));
+    memcpy(data.data() + sizeof(record), fileName.data(), fileName.size());
+    return writeAtomically(loudnessPathFor(fileName), data);
+}
+
+bool OggIndexCache::remove(const string& fileName) {
+    ::remove(loudnessPathFor(fileName).c_str());
+    return ::remove(cachePathFor(fileName).c_str()) == 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "opus_types.hpp"
+
+/*
+    OggIndexCache lưu page_table, thời lượng và OpusHeader của một file Ogg/Opus ra đĩa
+    để các lần loadFile sau không phải quét lại toàn bộ file.
+    - Khóa cache: đường dẫn + kích thước + mtime của file gốc, sai một trong ba thì bỏ qua cache
+    - Ghi vào thư mục cache của app (setCacheDirectory()); khi chưa đặt thì dùng thư mục tạm
+      của hệ thống, không có thư mục tạm thì không cache. File sidecar "<file>.idx" cạnh file gốc
+      chỉ được ghi khi setCacheDirectory(..., true), để không tự ghi thêm file vào thư mục nhạc
+    - Một lần load cache chỉ là một lần đọc toàn bộ file .idx
+    - Loudness (EBU R128) đo được lưu ở file ".r128" cạnh file .idx, cùng khóa cache,
+      vì được đo ở lượt phân tích riêng, không cùng lúc với việc dựng index
+*/
+class OggIndexCache {
+public:
+    // 2: OpusHeader có channel mapping (nb_streams, nb_coupled, stream_map)
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    // Thư mục chứa cache, chuỗi rỗng = thư mục mặc định. sidecar = true: ghi cạnh file gốc
+    static void setCacheDirectory(const std::string& dir, bool sidecar = false);
+    // Thư mục đang dùng, chuỗi rỗng nếu đang ghi sidecar hoặc không có thư mục nào dùng được
+    static std::string getCacheDirectory();
+
+    // Nạp header, serialno, page_table, last_granulepos, file_duration vào file.
+    // Trả về false nếu không có cache hoặc cache đã cũ.
+    static bool load(const std::string& fileName, OggOpusFile& file);
+
+    // Ghi cache sau khi đã quét file thành công
+    static bool store(const std::string& fileName, const OggOpusFile& file);
+
+    // Integrated loudness (LUFS) của file, chưa tính output gain trong OpusHeader
+    static bool loadLoudness(const std::string& fileName, double& loudness);
+    static bool storeLoudness(const std::string& fileName, double loudness);
+
+    // Xóa cache của file (nếu có)
+    static bool remove(const std::string& fileName);
+
+    // Chuỗi rỗng nếu không có chỗ để cache
+    static std::string cachePathFor(const std::string& fileName);
+    static std::string loudnessPathFor(const std::string& fileName);
+};
@@ -0,0 +1,214 @@
+#include "ogg_page_source.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Offset của CRC trong header page
+constexpr int CRC_OFFSET = 22;
+
+// Bảng CRC-32 của Ogg: đa thức 0x04c11db7, không đảo bit, giá trị đầu 0, không xor cuối
+struct CrcTable {
+    uint32_t entries[256];
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t r = i << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : (r << 1);
+            }
+            entries[i] = r;
+        }
+    }
+};
+
+uint32_t crcUpdate(uint32_t crc, const unsigned char* bytes, int64_t count) {
+    static const CrcTable table;
+    for (int64_t i = 0; i < count; i++) {
+        crc = (crc << 8) ^ table.entries[((crc >> 24) ^ bytes[i]) & 0xff];
+    }
+    return crc;
+}
+
+// CRC của page khi 4 byte CRC trong header được coi là 0
+uint32_t pageChecksum(const unsigned char* header, int64_t headerLen, const unsigned char* body, int64_t bodyLen) {
+    static const unsigned char zeros[4] = {0, 0, 0, 0};
+    uint32_t crc = crcUpdate(0, header, CRC_OFFSET);
+    crc = crcUpdate(crc, zeros, 4);
+    crc = crcUpdate(crc, header + CRC_OFFSET + 4, headerLen - CRC_OFFSET - 4);
+    return crcUpdate(crc, body, bodyLen);
+}
+
+} // namespace
+
+OggPageSource::~OggPageSource() {
+    close();
+}
+
+bool OggPageSource::open(const string& fileName) {
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        debugPrint("OggPageSource: cannot open {}", fileName);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // Mapping vẫn hợp lệ sau khi đóng file descriptor
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        debugPrint("OggPageSource: mmap failed for {}", fileName);
+        return false;
+    }
+
+    // File được đọc tuần tự khi phát, báo cho kernel đọc trước
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+    data = static_cast<const unsigned char*>(mapped);
+    length = st.st_size;
+    position = 0;
+    return true;
+}
+
+void OggPageSource::close() {
+    if (data) {
+        munmap(const_cast<unsigned char*>(data), length);
+        data = nullptr;
+    }
+    length = 0;
+    position = 0;
+}
+
+bool OggPageSource::seek(int64_t offset) {
+    if (!data || offset < 0 || offset > length) {
+        return false;
+    }
+    position = offset;
+    return true;
+}
+
+/*
+Tìm chữ ký "OggS" đầu tiên tính từ vị trí from.
+Trả về -1 nếu không còn page nào.
+*/
+int64_t OggPageSource::findCapturePattern(int64_t from) const {
+    while (from + 4 <= length) {
+        const void* hit = memchr(data + from, 'O', length - from);
+        if (!hit) {
+            return -1;
+        }
+        int64_t pos = static_cast<const unsigned char*>(hit) - data;
+        if (pos + 4 <= length && memcmp(data + pos, "OggS", 4) == 0) {
+            return pos;
+        }
+        from = pos + 1;
+    }
+    return -1;
+}
+
+/*
+Parse header của page tại offset theo định dạng Ogg:
+  [0..3]   "OggS"
+  [4]      version
+  [5]      header type
+  [6..13]  granule position
+  [14..25] serial, sequence, CRC
+  [26]     số segment, theo sau là bảng lacing
+Page chỉ hợp lệ khi CRC khớp (như ogg_sync_pageout), để sau khi đồng bộ lại giữa dữ liệu hỏng
+thì các byte tình cờ giống header không tới được decoder.
+Gán con trỏ header/body của ogg_page trỏ thẳng vào vùng mmap.
+*/
+bool OggPageSource::pageAt(int64_t offset, ogg_page* og) const {
+    if (!data || offset < 0 || offset + static_cast<int64_t>(PAGE_HEADER_SIZE) > length) {
+        return false;
+    }
+
+    const unsigned char* header = data + offset;
+    if (memcmp(header, "OggS", 4) != 0 || header[4] != 0) {
+        return false;
+    }
+
+    const int segments = header[26];
+    const int64_t headerLen = PAGE_HEADER_SIZE + segments;
+    if (offset + headerLen > length) {
+        return false;
+    }
+
+    int64_t bodyLen = 0;
+    for (int i = 0; i < segments; i++) {
+        bodyLen += header[PAGE_HEADER_SIZE + i];
+    }
+    if (offset + headerLen + bodyLen > length) {
+        return false; // Page bị cắt cụt ở cuối file
+    }
+
+    const unsigned char* body = header + headerLen;
+    const uint32_t stored = header[CRC_OFFSET] | (header[CRC_OFFSET + 1] << 8) |
+                            (header[CRC_OFFSET + 2] << 16) | (static_cast<uint32_t>(header[CRC_OFFSET + 3]) << 24);
+    if (pageChecksum(header, headerLen, body, bodyLen) != stored) {
+        return false;
+    }
+
+    // libogg chỉ đọc qua các con trỏ này, vùng mmap không bao giờ bị ghi
+    og->header = const_cast<unsigned char*>(header);
+    og->header_len = headerLen;
+    og->body = const_cast<unsigned char*>(body);
+    og->body_len = bodyLen;
+    return true;
+}
+
+int OggPageSource::nextPage(ogg_page* og, int64_t* pageOffset) {
+    return readPage(position, og, pageOffset);
+}
+
+int OggPageSource::readPage(int64_t& cursor, ogg_page* og, int64_t* pageOffset) const {
+    while (data && cursor < length) {
+        if (pageAt(cursor, og)) {
+            if (pageOffset) {
+                *pageOffset = cursor;
+            }
+            cursor += og->header_len + og->body_len;
+            return 1;
+        }
+
+        // Dữ liệu không phải page hợp lệ: đồng bộ lại tới "OggS" tiếp theo
+        int64_t next = findCapturePattern(cursor + 1);
+        if (next < 0) {
+            cursor = length;
+            break;
+        }
+        cursor = next;
+    }
+    return 0;
+}
+
+bool OggPageSource::lastPage(int serialno, ogg_page* og, int64_t* pageOffset) const {
+    if (!data) {
+        return false;
+    }
+    for (int64_t pos = length - static_cast<int64_t>(PAGE_HEADER_SIZE); pos >= 0; pos--) {
+        if (data[pos] != 'O' || memcmp(data + pos, "OggS", 4) != 0) {
+            continue;
+        }
+        if (pageAt(pos, og) &&
+            ogg_page_serialno(og) == serialno &&
+            ogg_page_granulepos(og) >= 0) {
+            if (pageOffset) {
+                *pageOffset = pos;
+            }
+            return true;
+        }
+    }
+    return false;
+}
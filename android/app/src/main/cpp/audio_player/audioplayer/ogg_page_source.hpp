@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <ogg/ogg.h>
+#include "common.hpp"
+
+/*
+    OggPageSource đọc các ogg_page trực tiếp từ file Ogg đã được mmap.
+    - ogg_page trả về trỏ thẳng vào vùng nhớ mmap: không fread, không copy qua ogg_sync_buffer
+    - Seek chỉ là đặt lại vị trí đọc theo OggPageIndex::file_offset
+    Vùng nhớ chỉ đọc, các con trỏ trong ogg_page có hiệu lực cho đến khi close().
+*/
+class OggPageSource {
+public:
+    static constexpr size_t PAGE_HEADER_SIZE = 27; // Header cố định, chưa tính segment table
+
+    OggPageSource() = default;
+    ~OggPageSource();
+
+    OggPageSource(const OggPageSource&) = delete;
+    OggPageSource& operator=(const OggPageSource&) = delete;
+
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    // Đọc page tại vị trí hiện tại rồi tiến tới page tiếp theo.
+    // Tự đồng bộ lại tới chữ ký "OggS" kế tiếp nếu gặp dữ liệu hỏng.
+    // pageOffset (nếu có) nhận vị trí byte đầu tiên của page trong file.
+    // Trả về 1 nếu đọc được page, 0 nếu đã hết file.
+    int nextPage(ogg_page* og, int64_t* pageOffset = nullptr);
+
+    // Giống nextPage nhưng dùng con trỏ đọc riêng của người gọi, không đụng tới vị trí đọc
+    // của source. Cho phép luồng khác (vd: luồng dựng index) đọc song song với luồng decode.
+    int readPage(int64_t& cursor, ogg_page* og, int64_t* pageOffset = nullptr) const;
+
+    // Parse page bắt đầu đúng tại offset, không thay đổi vị trí đọc
+    bool pageAt(int64_t offset, ogg_page* og) const;
+
+    // Quét ngược từ cuối file tìm page cuối cùng của stream serialno có granule_pos hợp lệ.
+    // Dùng để lấy thời lượng mà không phải đọc toàn bộ file.
+    bool lastPage(int serialno, ogg_page* og, int64_t* pageOffset = nullptr) const;
+
+    bool seek(int64_t offset);
+    int64_t tell() const { return position; }
+    int64_t size() const { return length; }
+
+private:
+    const unsigned char* data = nullptr; // Vùng nhớ mmap của toàn bộ file
+    int64_t length = 0;
+    int64_t position = 0;                // Vị trí đọc hiện tại (byte)
+
+    int64_t findCapturePattern(int64_t from) const;
+};
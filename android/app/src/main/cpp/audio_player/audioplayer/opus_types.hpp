@@ -1,12 +1,16 @@
 #pragma once
 #include <cstdint>
 #include <cstdio>
+#include <vector>
 #include <ogg/ogg.h>
+#include "ogg_page_source.hpp"
 
-#if defined(__ANDROID__)
+#if defined(__ANDROID__) || defined(AUDIO_OPUS_FLAT_INCLUDE)
     #include <opus.h>
+    #include <opus_multistream.h>
 #else
     #include <opus/opus.h>
+    #include <opus/opus_multistream.h>
 #endif
 
 struct OpusHeader {
@@ -15,9 +19,9 @@ struct OpusHeader {
     int preskip;
     uint32_t input_sample_rate;
     int gain;
-    int channel_mapping;
+    int channel_mapping;        // 0: mono/stereo một stream, 1/255: multistream
     int nb_streams;
-    int nb_coupled;
+    int nb_coupled;             // Số stream stereo, luôn đứng trước các stream mono
     unsigned char stream_map[255];
 };
 
@@ -38,14 +42,24 @@ struct OggPageStartPos {
 
 //Dùng để lưu trữ thông tin về file Ogg
 struct OggOpusFile {
-    FILE *fin;
+    OggPageSource source;   // File được mmap, đọc page trực tiếp không qua fread
     
     OpusHeader header;
-    ogg_sync_state oy;
+    int serialno;           // Serial number của logical stream Opus
     ogg_stream_state os;
     ogg_page og;
     ogg_packet op;
-    OpusDecoder *decoder;
+    OpusDecoder *decoder;           // channel_mapping = 0
+    OpusMSDecoder *msDecoder;       // channel_mapping != 0
+    int decodedChannels;            // Số kênh PCM mỗi frame decode ra
+
+    // Decode một packet thành PCM interleaved decodedChannels kênh, trả về số frame hoặc mã lỗi Opus
+    int decode(const unsigned char* packet, int bytes, float* pcm, int maxFrames) {
+        if (msDecoder) {
+            return opus_multistream_decode_float(msDecoder, packet, bytes, pcm, maxFrames, 0);
+        }
+        return opus_decode_float(decoder, packet, bytes, pcm, maxFrames, 0);
+    }
 
     // Index table structures
     std::vector<OggPageIndex> page_table;     // Lưu trữ tuần tự các page index
@@ -53,4 +67,14 @@ struct OggOpusFile {
     // Thông tin về thời lượng và vị trí
     ogg_int64_t last_granulepos;  // Granulepos của page cuối cùng
     uint32_t file_duration;           // Thời lượng (milliseconds)
+
+    ~OggOpusFile() {
+        if (decoder) {
+            opus_decoder_destroy(decoder);
+        }
+        if (msDecoder) {
+            opus_multistream_decoder_destroy(msDecoder);
+        }
+        ogg_stream_clear(&os);
+    }
 };
\ No newline at end of file
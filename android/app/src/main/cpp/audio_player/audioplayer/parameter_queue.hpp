@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/*
+    Hàng đợi thay đổi tham số một producer / một consumer, không khóa, không cấp phát.
+    Thread app đẩy thay đổi (nhiều thread app phải tự tuần tự hóa với nhau),
+    audio callback lấy ra ở đầu mỗi chu kỳ.
+    Đầy thì push() trả về false, người gọi phải có cách đồng bộ lại (vd: đọc lại toàn bộ tham số).
+*/
+template <typename T, size_t Capacity>
+class ParameterQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(const T& item) {
+        const size_t tail = writeIndex.load(std::memory_order_relaxed);
+        if (tail - readIndex.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+        items[tail & (Capacity - 1)] = item;
+        writeIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        const size_t head = readIndex.load(std::memory_order_relaxed);
+        if (head == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[head & (Capacity - 1)];
+        readIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> items{};
+    std::atomic<size_t> writeIndex{0};
+    std::atomic<size_t> readIndex{0};
+};
@@ -0,0 +1,102 @@
+#include "pcm_interleave.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define PCM_USE_NEON 1
+#elif defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+    #define PCM_USE_SSE 1
+#endif
+
+namespace pcm {
+
+void deinterleaveStereo(const float* in, float* left, float* right, size_t frames)
+{
+    size_t i = 0;
+#if defined(PCM_USE_NEON)
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t lr = vld2q_f32(in + i * 2);
+        vst1q_f32(left + i, lr.val[0]);
+        vst1q_f32(right + i, lr.val[1]);
+    }
+#elif defined(PCM_USE_SSE)
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(in + i * 2);     // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(in + i * 2 + 4); // L2 R2 L3 R3
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        left[i] = in[i * 2];
+        right[i] = in[i * 2 + 1];
+    }
+}
+
+void interleaveStereo(const float* left, const float* right, float* out, size_t frames)
+{
+    size_t i = 0;
+#if defined(PCM_USE_NEON)
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t lr;
+        lr.val[0] = vld1q_f32(left + i);
+        lr.val[1] = vld1q_f32(right + i);
+        vst2q_f32(out + i * 2, lr);
+    }
+#elif defined(PCM_USE_SSE)
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));     // L0 R0 L1 R1
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r)); // L2 R2 L3 R3
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        out[i * 2] = left[i];
+        out[i * 2 + 1] = right[i];
+    }
+}
+
+void deinterleave(const float* in, float* const* out, size_t channels, size_t frames)
+{
+    if (channels == 2)
+    {
+        deinterleaveStereo(in, out[0], out[1], frames);
+        return;
+    }
+    for (size_t c = 0; c < channels; c++)
+    {
+        float* dst = out[c];
+        const float* src = in + c;
+        for (size_t i = 0; i < frames; i++)
+        {
+            dst[i] = src[i * channels];
+        }
+    }
+}
+
+void interleave(const float* const* in, float* out, size_t channels, size_t frames)
+{
+    if (channels == 2)
+    {
+        interleaveStereo(in[0], in[1], out, frames);
+        return;
+    }
+    for (size_t c = 0; c < channels; c++)
+    {
+        const float* src = in[c];
+        float* dst = out + c;
+        for (size_t i = 0; i < frames; i++)
+        {
+            dst[i * channels] = src[i];
+        }
+    }
+}
+
+} // namespace pcm
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+    Chuyển đổi PCM float giữa dạng interleaved (L R L R ...) và planar (L L ... / R R ...).
+    Dùng NEON (arm64/armv7) hoặc SSE (x86) khi có, phần lẻ cuối xử lý vô hướng.
+    Không cấp phát bộ nhớ, gọi được trên thread real-time.
+*/
+namespace pcm {
+
+// in: frames * 2 mẫu interleaved -> left, right: frames mẫu mỗi kênh
+void deinterleaveStereo(const float* in, float* left, float* right, size_t frames);
+
+// left, right: frames mẫu mỗi kênh -> out: frames * 2 mẫu interleaved
+void interleaveStereo(const float* left, const float* right, float* out, size_t frames);
+
+// Số kênh bất kỳ (vd: PCM multistream nhiều stem), stereo dùng lại hai hàm trên
+void deinterleave(const float* in, float* const* out, size_t channels, size_t frames);
+void interleave(const float* const* in, float* out, size_t channels, size_t frames);
+
+} // namespace pcm
@@ -0,0 +1,114 @@
+#include "playback_clock.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+void PlaybackClock::reset(int64_t sourceFrame) {
+    head.store(0, memory_order_relaxed);
+    tail.store(0, memory_order_relaxed);
+    writtenOutput = 0;
+    readOutput = 0;
+    readSource = static_cast<double>(sourceFrame);
+    headSpeed.store(1.0, memory_order_relaxed);
+    startPosition.store(sourceFrame, memory_order_relaxed);
+    sourcePosition.store(sourceFrame, memory_order_release);
+}
+
+void PlaybackClock::onFramesWritten(size_t outputFrames, double speed) {
+    if (outputFrames == 0) {
+        return;
+    }
+    writtenOutput += outputFrames;
+
+    const size_t t = tail.load(memory_order_relaxed);
+    const size_t h = head.load(memory_order_acquire);
+
+    // Cùng tốc độ với segment cuối: chỉ kéo dài segment đó.
+    // Callback không bao giờ bỏ qua segment cuối nên ghi vào đây là an toàn.
+    // Nếu đã hết chỗ thì cũng gộp vào segment cuối (sai lệch nhỏ thay vì mất đồng bộ).
+    if (t > h && (segments[(t - 1) % MAX_SEGMENTS].speed == speed || t - h >= MAX_SEGMENTS)) {
+        segments[(t - 1) % MAX_SEGMENTS].endOutput.store(writtenOutput, memory_order_release);
+        return;
+    }
+
+    pushSegment(speed, false, 0);
+}
+
+void PlaybackClock::onDiscontinuity(int64_t sourceFrame, double speed) {
+    const size_t t = tail.load(memory_order_relaxed);
+    const size_t h = head.load(memory_order_acquire);
+    if (t - h >= MAX_SEGMENTS) {
+        return; // Hết chỗ: bỏ qua bước nhảy, vị trí sai lệch đến lần reset tiếp theo
+    }
+    pushSegment(speed, true, sourceFrame);
+}
+
+// Segment mới bắt đầu (và tạm kết thúc) tại writtenOutput hiện tại
+void PlaybackClock::pushSegment(double speed, bool jump, int64_t jumpTo) {
+    const size_t t = tail.load(memory_order_relaxed);
+    Segment& segment = segments[t % MAX_SEGMENTS];
+    segment.speed = speed;
+    segment.jump = jump;
+    segment.jumpTo = jumpTo;
+    segment.endOutput.store(writtenOutput, memory_order_relaxed);
+    tail.store(t + 1, memory_order_release);
+}
+
+void PlaybackClock::onFramesConsumed(size_t outputFrames) {
+    uint64_t remaining = outputFrames;
+    double speed = headSpeed.load(memory_order_relaxed);
+
+    while (remaining > 0) {
+        const size_t h = head.load(memory_order_relaxed);
+        const size_t t = tail.load(memory_order_acquire);
+        if (h == t) {
+            break;
+        }
+
+        const Segment& segment = segments[h % MAX_SEGMENTS];
+        const uint64_t end = segment.endOutput.load(memory_order_acquire);
+        speed = segment.speed;
+
+        const uint64_t take = min<uint64_t>(remaining, end > readOutput ? end - readOutput : 0);
+        readSource += take * speed;
+        readOutput += take;
+        remaining -= take;
+
+        if (readOutput < end) {
+            break;
+        }
+        if (h + 1 >= t) {
+            break; // Segment cuối, luồng decode có thể còn kéo dài nó
+        }
+        head.store(h + 1, memory_order_release);
+
+        // Bắt đầu đọc segment tiếp theo: áp dụng bước nhảy vị trí nếu có
+        const Segment& next = segments[(h + 1) % MAX_SEGMENTS];
+        if (next.jump) {
+            readSource = static_cast<double>(next.jumpTo);
+            startPosition.store(next.jumpTo, memory_order_relaxed);
+        }
+    }
+
+    // Đọc nhiều hơn số frame đã đăng ký (không xảy ra nếu producer gọi đúng thứ tự)
+    readSource += remaining * speed;
+    readOutput += remaining;
+
+    headSpeed.store(speed, memory_order_relaxed);
+    sourcePosition.store(static_cast<int64_t>(readSource), memory_order_release);
+}
+
+size_t PlaybackClock::outputFramesUntil(int64_t endFrame) const {
+    const double remainingSource = static_cast<double>(endFrame) - readSource;
+    if (remainingSource <= 0.0) {
+        return 0;
+    }
+    return static_cast<size_t>(ceil(remainingSource / headSpeed.load(memory_order_relaxed)));
+}
+
+int64_t PlaybackClock::presentedPosition(double latencyFrames) const {
+    const int64_t position = sourcePosition.load(memory_order_acquire) -
+                             static_cast<int64_t>(latencyFrames * headSpeed.load(memory_order_relaxed));
+    return max(position, startPosition.load(memory_order_relaxed));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+    PlaybackClock: đồng hồ phát tính theo số frame audio callback đã thực sự lấy khỏi RingBuffer,
+    không dùng steady_clock.
+    - Luồng decode ghi frame vào RingBuffer kèm tốc độ time-stretch của các frame đó
+      (onFramesWritten), các đoạn cùng tốc độ được gộp thành một segment
+    - Audio callback báo số frame đã đọc (onFramesConsumed), mỗi frame đầu ra được quy đổi
+      ngược về frame nguồn theo đúng tốc độ lúc nó được time-stretch
+    - Vị trí đọc được từ mọi thread mà không khóa
+
+    Một producer (luồng decode/seek) và một consumer (audio callback).
+    reset() chỉ được gọi khi callback chắc chắn không đọc RingBuffer (sau flushBuffer).
+*/
+class PlaybackClock {
+public:
+    static constexpr size_t MAX_SEGMENTS = 64; // Số lần đổi tốc độ tối đa còn nằm trong RingBuffer
+
+    // Đặt lại đồng hồ về sourceFrame khi RingBuffer vừa được làm rỗng
+    void reset(int64_t sourceFrame);
+
+    // Luồng decode: sắp ghi outputFrames vào RingBuffer, mỗi frame đầu ra ứng với speed frame nguồn.
+    // Phải gọi trước khi ghi để callback không bao giờ đọc frame chưa có trong đồng hồ.
+    void onFramesWritten(size_t outputFrames, double speed);
+
+    // Luồng decode: các frame ghi sau lời gọi này bắt đầu từ sourceFrame (vd: phát lặp A-B
+    // không làm rỗng RingBuffer). Callback nhảy vị trí đúng lúc đọc tới frame đó.
+    void onDiscontinuity(int64_t sourceFrame, double speed);
+
+    // Audio callback: vừa đọc outputFrames khỏi RingBuffer
+    void onFramesConsumed(size_t outputFrames);
+
+    // Audio callback: số frame đầu ra còn được phép đọc trước khi vị trí nguồn chạm endFrame
+    size_t outputFramesUntil(int64_t endFrame) const;
+
+    // Vị trí (frame nguồn, tính từ đầu file sau preskip) của frame tiếp theo callback sẽ đọc
+    int64_t position() const { return sourcePosition.load(std::memory_order_acquire); }
+
+    // Vị trí đang thực sự phát ra loa: lùi lại latencyFrames frame đầu ra,
+    // không lùi quá điểm reset/nhảy gần nhất
+    int64_t presentedPosition(double latencyFrames) const;
+
+    // Tốc độ của đoạn đang được callback đọc
+    double currentSpeed() const { return headSpeed.load(std::memory_order_relaxed); }
+
+private:
+    struct Segment {
+        std::atomic<uint64_t> endOutput{0}; // Chỉ số frame đầu ra (tích lũy) kết thúc segment
+        double speed{1.0};
+        bool jump{false};                   // Segment bắt đầu bằng một bước nhảy vị trí
+        int64_t jumpTo{0};
+    };
+
+    void pushSegment(double speed, bool jump, int64_t jumpTo);
+
+    Segment segments[MAX_SEGMENTS];
+    std::atomic<size_t> head{0}; // Segment callback đang đọc (consumer)
+    std::atomic<size_t> tail{0}; // Số segment đã đẩy vào (producer)
+
+    uint64_t writtenOutput = 0;  // Chỉ luồng decode dùng
+    uint64_t readOutput = 0;     // Chỉ callback dùng
+    double readSource = 0.0;     // Vị trí nguồn có phần lẻ, chỉ callback dùng
+
+    std::atomic<int64_t> sourcePosition{0};
+    std::atomic<int64_t> startPosition{0};
+    std::atomic<double> headSpeed{1.0};
+};
@@ -0,0 +1,188 @@
+#include "processing_graph.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+GraphPortOutput::GraphPortOutput(GraphNode& parent, int32_t channels, int32_t maxFrames)
+    : node(parent), channels(channels),
+      buffer(make_unique<float[]>(static_cast<size_t>(channels) * maxFrames)) {}
+
+bool GraphPortOutput::connect(GraphPortInput* input) {
+    if (input == nullptr || input->getChannels() != channels) {
+        debugPrint("GraphPortOutput: cannot connect {} channels to {} channels",
+                   channels, input ? input->getChannels() : 0);
+        return false;
+    }
+    input->connected = this;
+    return true;
+}
+
+GraphPortInput::GraphPortInput(GraphNode& parent, int32_t channels, int32_t maxFrames)
+    : channels(channels),
+      silence(make_unique<float[]>(static_cast<size_t>(channels) * maxFrames)) {
+    parent.inputs.push_back(this);
+}
+
+int32_t GraphNode::activeInputFrames(int32_t numFrames) const {
+    int32_t active = 0;
+    for (const GraphPortInput* input : inputs) {
+        if (input->getConnected() != nullptr) {
+            active = max(active, input->getConnected()->getNode().lastActiveFrames);
+        }
+    }
+    return min(active, numFrames);
+}
+
+int32_t CallbackSourceNode::onProcess(int32_t numFrames) {
+    float* buffer = output.getBuffer();
+    const int32_t channels = output.getChannels();
+    size_t framesRead = callback ? callback(buffer, static_cast<size_t>(numFrames)) : 0;
+    framesRead = min(framesRead, static_cast<size_t>(numFrames));
+    // Callback chỉ ghi framesRead frame, phần còn lại của block là im lặng
+    memset(buffer + framesRead * channels, 0, (numFrames - framesRead) * channels * sizeof(float));
+    return static_cast<int32_t>(framesRead);
+}
+
+int32_t GainNode::onProcess(int32_t numFrames) {
+    const float* in = input.getBuffer();
+    float* out = output.getBuffer();
+    const int32_t channels = output.getChannels();
+    if (started) {
+        ramp.setTarget(gain.load(memory_order_relaxed));
+    } else {
+        ramp.forceCurrent(gain.load(memory_order_relaxed));
+        started = true;
+    }
+    if (ramp.isRamping()) {
+        memcpy(out, in, numFrames * channels * sizeof(float));
+        ramp.apply(out, numFrames, channels);
+    } else {
+        const float value = ramp.target();
+        const int32_t samples = numFrames * channels;
+        for (int32_t i = 0; i < samples; i++) {
+            out[i] = in[i] * value;
+        }
+    }
+    return activeInputFrames(numFrames);
+}
+
+MixNode::MixNode(int32_t channels, int32_t maxFrames)
+    : output(*this, channels, maxFrames), maxFrames(maxFrames) {}
+
+GraphPortInput* MixNode::addInput(int32_t inputChannels) {
+    if (inputChannels != 1 && inputChannels != output.getChannels()) {
+        return nullptr;
+    }
+    ownedInputs.push_back(make_unique<GraphPortInput>(*this, inputChannels, maxFrames));
+    return ownedInputs.back().get();
+}
+
+int32_t MixNode::onProcess(int32_t numFrames) {
+    float* out = output.getBuffer();
+    const int32_t channels = output.getChannels();
+    memset(out, 0, numFrames * channels * sizeof(float));
+
+    for (const auto& input : ownedInputs) {
+        if (input->getConnected() == nullptr) {
+            continue;
+        }
+        const float* in = input->getBuffer();
+        if (input->getChannels() == channels) {
+            for (int32_t i = 0; i < numFrames * channels; i++) {
+                out[i] += in[i];
+            }
+        } else {
+            for (int32_t i = 0; i < numFrames; i++) {
+                for (int32_t c = 0; c < channels; c++) {
+                    out[i * channels + c] += in[i];
+                }
+            }
+        }
+    }
+    return activeInputFrames(numFrames);
+}
+
+/*
+DFS theo các input từ node output: node được thêm vào danh sách sau mọi node phía trên nó,
+nên chạy danh sách theo thứ tự là đủ để mỗi input đã có dữ liệu của block hiện tại.
+Node không nằm phía trên output thì không được chạy.
+*/
+bool ProcessingGraph::visit(GraphNode* node, vector<GraphNode*>& visiting) {
+    if (find(executionOrder.begin(), executionOrder.end(), node) != executionOrder.end()) {
+        return true;
+    }
+    if (find(visiting.begin(), visiting.end(), node) != visiting.end()) {
+        debugPrint("ProcessingGraph: cycle at node {}", node->getName());
+        return false;
+    }
+
+    visiting.push_back(node);
+    for (const GraphPortInput* input : node->getInputs()) {
+        GraphPortOutput* upstream = input->getConnected();
+        if (upstream != nullptr && !visit(&upstream->getNode(), visiting)) {
+            return false;
+        }
+    }
+    visiting.pop_back();
+    executionOrder.push_back(node);
+    return true;
+}
+
+bool ProcessingGraph::compile(GraphPortOutput& output) {
+    executionOrder.clear();
+    result = nullptr;
+
+    // Mọi node được nối phải thuộc graph này (graph sở hữu và giữ sống chúng)
+    auto owned = [this](const GraphNode* node) {
+        return any_of(nodes.begin(), nodes.end(),
+                      [node](const unique_ptr<GraphNode>& n) { return n.get() == node; });
+    };
+    if (!owned(&output.getNode())) {
+        debugPrint("ProcessingGraph: output node does not belong to this graph");
+        return false;
+    }
+
+    vector<GraphNode*> visiting;
+    if (!visit(&output.getNode(), visiting)) {
+        executionOrder.clear();
+        return false;
+    }
+    for (GraphNode* node : executionOrder) {
+        if (!owned(node)) {
+            debugPrint("ProcessingGraph: node {} does not belong to this graph", node->getName());
+            executionOrder.clear();
+            return false;
+        }
+    }
+
+    result = &output;
+    return true;
+}
+
+int32_t ProcessingGraph::process(int32_t numFrames) {
+    numFrames = min(numFrames, maxFrames);
+    int32_t active = 0;
+    for (GraphNode* node : executionOrder) {
+        active = node->onProcess(numFrames);
+        node->lastActiveFrames = active;
+    }
+    // Node cuối danh sách luôn là node của output
+    return active;
+}
+
+void ProcessingGraph::reset() {
+    for (auto& node : nodes) {
+        node->reset();
+        node->lastActiveFrames = 0;
+    }
+}
+
+shared_ptr<ProcessingGraph> ProcessingGraph::fromCallback(int32_t channels, int32_t maxFrames,
+                                                          AudioCallback callback) {
+    auto graph = make_shared<ProcessingGraph>(maxFrames);
+    auto* source = graph->addNode<CallbackSourceNode>(channels, std::move(callback));
+    graph->compile(source->output);
+    return graph;
+}
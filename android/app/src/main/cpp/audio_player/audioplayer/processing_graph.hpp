@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "audio_player_types.hpp"
+#include "gain_ramp.hpp"
+
+/*
+    Graph xử lý âm thanh theo block cho mỗi bus của mixer, cùng mô hình với
+    oboe::flowgraph::FlowGraphNode (node có port vào/ra, mỗi lần xử lý một block frame):
+    - Port có kiểu là số kênh: chỉ nối được output vào input cùng số kênh
+    - compile() sắp xếp topo các node phía trên output thành một danh sách phẳng.
+      process() chỉ chạy lần lượt danh sách đó: không đệ quy pull, không callCount,
+      mỗi node một lời gọi virtual cho cả block (không có virtual trên từng mẫu)
+    - Buffer của mọi port được cấp phát khi tạo node, process() không cấp phát
+
+    Dựng graph, connect và compile trên thread app; sau khi giao graph cho AudioLayer thì
+    chỉ audio callback gọi process(). Tham số của node (vd: gain) là atomic.
+*/
+
+class GraphNode;
+class GraphPortInput;
+
+// Output của node: buffer interleaved maxFrames * channels do node ghi trong onProcess()
+class GraphPortOutput {
+public:
+    GraphPortOutput(GraphNode& parent, int32_t channels, int32_t maxFrames);
+
+    GraphPortOutput(const GraphPortOutput&) = delete;
+    GraphPortOutput& operator=(const GraphPortOutput&) = delete;
+
+    // Nối vào input cùng số kênh. Trả về false nếu khác kiểu.
+    bool connect(GraphPortInput* input);
+
+    int32_t getChannels() const { return channels; }
+    float* getBuffer() { return buffer.get(); }
+    const float* getBuffer() const { return buffer.get(); }
+    GraphNode& getNode() const { return node; }
+
+private:
+    GraphNode& node;
+    const int32_t channels;
+    std::unique_ptr<float[]> buffer;
+};
+
+// Input của node: đọc thẳng buffer của output được nối, chưa nối thì đọc buffer im lặng
+class GraphPortInput {
+public:
+    GraphPortInput(GraphNode& parent, int32_t channels, int32_t maxFrames);
+
+    GraphPortInput(const GraphPortInput&) = delete;
+    GraphPortInput& operator=(const GraphPortInput&) = delete;
+
+    int32_t getChannels() const { return channels; }
+    const float* getBuffer() const { return connected ? connected->getBuffer() : silence.get(); }
+    GraphPortOutput* getConnected() const { return connected; }
+
+private:
+    friend class GraphPortOutput;
+    const int32_t channels;
+    GraphPortOutput* connected = nullptr;
+    std::unique_ptr<float[]> silence;
+};
+
+class GraphNode {
+public:
+    virtual ~GraphNode() = default;
+
+    // Đọc các input, ghi numFrames frame vào các output.
+    // Trả về số frame có dữ liệu thực (0 = node đang im lặng), phần còn lại đã được ghi 0.
+    virtual int32_t onProcess(int32_t numFrames) = 0;
+
+    // Xóa trạng thái nội bộ (bộ lọc, delay line...). Không gọi cùng lúc với process().
+    virtual void reset() {}
+
+    virtual const char* getName() const { return "GraphNode"; }
+
+    const std::vector<GraphPortInput*>& getInputs() const { return inputs; }
+
+protected:
+    friend class GraphPortInput;
+    std::vector<GraphPortInput*> inputs;
+
+    // Số frame có dữ liệu thực lớn nhất trong các input của lần process hiện tại
+    int32_t activeInputFrames(int32_t numFrames) const;
+
+private:
+    friend class ProcessingGraph;
+    int32_t lastActiveFrames = 0;
+};
+
+// Node sinh dữ liệu, không có input
+class GraphSource : public GraphNode {
+public:
+    GraphSource(int32_t channels, int32_t maxFrames)
+        : output(*this, channels, maxFrames) {}
+
+    GraphPortOutput output;
+};
+
+// Node một input một output
+class GraphFilter : public GraphNode {
+public:
+    GraphFilter(int32_t inputChannels, int32_t outputChannels, int32_t maxFrames)
+        : input(*this, inputChannels, maxFrames),
+          output(*this, outputChannels, maxFrames) {}
+
+    GraphPortInput input;
+    GraphPortOutput output;
+};
+
+/*
+    Nguồn lấy dữ liệu từ AudioCallback (vd: AudioSession::audioCallbackOgg).
+    std::function chỉ được gọi, không copy trên audio thread.
+*/
+class CallbackSourceNode : public GraphSource {
+public:
+    CallbackSourceNode(int32_t channels, AudioCallback callback, int32_t maxFrames)
+        : GraphSource(channels, maxFrames), callback(std::move(callback)) {}
+
+    int32_t onProcess(int32_t numFrames) override;
+    const char* getName() const override { return "CallbackSource"; }
+
+private:
+    AudioCallback callback;
+};
+
+// Nhân gain (đổi được từ thread khác, đổi gain được làm mượt như volume của bus)
+class GainNode : public GraphFilter {
+public:
+    GainNode(int32_t channels, int32_t maxFrames)
+        : GraphFilter(channels, channels, maxFrames) {}
+
+    void setGain(float value) { gain.store(value, std::memory_order_relaxed); }
+    float getGain() const { return gain.load(std::memory_order_relaxed); }
+
+    int32_t onProcess(int32_t numFrames) override;
+    void reset() override { started = false; }
+    const char* getName() const override { return "Gain"; }
+
+private:
+    std::atomic<float> gain{1.0f};
+    // Chỉ audio thread. Block đầu tiên dùng ngay gain đã đặt, chỉ các lần đổi sau mới có ramp.
+    GainRamp ramp;
+    bool started = false;
+};
+
+// Cộng nhiều input (mono hoặc cùng số kênh với output, mono được nhân ra mọi kênh)
+class MixNode : public GraphNode {
+public:
+    MixNode(int32_t channels, int32_t maxFrames);
+
+    // Thêm một input, chỉ gọi trước khi compile
+    GraphPortInput* addInput(int32_t inputChannels);
+
+    int32_t onProcess(int32_t numFrames) override;
+    const char* getName() const override { return "Mix"; }
+
+    GraphPortOutput output;
+
+private:
+    const int32_t maxFrames;
+    std::vector<std::unique_ptr<GraphPortInput>> ownedInputs;
+};
+
+class ProcessingGraph {
+public:
+    explicit ProcessingGraph(int32_t maxFrames)
+        : maxFrames(maxFrames) {}
+
+    ProcessingGraph(const ProcessingGraph&) = delete;
+    ProcessingGraph& operator=(const ProcessingGraph&) = delete;
+
+    // Tạo node thuộc graph: addNode<GainNode>(2) truyền thêm maxFrames vào sau các tham số
+    template <typename Node, typename... Args>
+    Node* addNode(Args&&... args) {
+        auto node = std::make_unique<Node>(std::forward<Args>(args)..., maxFrames);
+        Node* raw = node.get();
+        nodes.push_back(std::move(node));
+        return raw;
+    }
+
+    // Sắp xếp các node phía trên output thành danh sách thực thi.
+    // Trả về false nếu graph có vòng hoặc output không thuộc graph.
+    bool compile(GraphPortOutput& output);
+    bool isCompiled() const { return result != nullptr; }
+
+    // Audio thread: chạy danh sách thực thi, trả về số frame có dữ liệu thực của output
+    int32_t process(int32_t numFrames);
+    void reset();
+
+    const float* getOutput() const { return result->getBuffer(); }
+    int32_t getOutputChannels() const { return result->getChannels(); }
+    int32_t getMaxFrames() const { return maxFrames; }
+    size_t getExecutionSize() const { return executionOrder.size(); }
+
+    // Graph đơn giản nhất: một CallbackSourceNode làm output
+    static std::shared_ptr<ProcessingGraph> fromCallback(int32_t channels, int32_t maxFrames,
+                                                         AudioCallback callback);
+
+private:
+    bool visit(GraphNode* node, std::vector<GraphNode*>& visiting);
+
+    const int32_t maxFrames;
+    std::vector<std::unique_ptr<GraphNode>> nodes;
+    std::vector<GraphNode*> executionOrder;
+    GraphPortOutput* result = nullptr;
+};
@@ -2,12 +2,13 @@
 #include <cstring>
 #include <algorithm>
 
-RingBuffer::RingBuffer(size_t bufferSize)
-    : capacity(bufferSize)
+RingBuffer::RingBuffer(size_t bufferFrames, size_t channels)
+    : capacity(bufferFrames)
+    , channelCount(channels)
     , readIndex(0)
     , writeIndex(0) 
 {
-    buffer = new float[capacity];
+    buffer = new float[capacity * channelCount];
 }
 
 RingBuffer::~RingBuffer() {
@@ -25,12 +26,12 @@ size_t RingBuffer::write(const float* data, size_t frames) {
     const size_t firstPart = std::min(frames, capacity - write);
     
     // Ghi phần đầu tiên
-    memcpy(buffer + write, data, firstPart * sizeof(float));
+    memcpy(buffer + write * channelCount, data, firstPart * channelCount * sizeof(float));
     
     // Xử lý trường hợp wrap-around
     if (firstPart < frames) {
         const size_t secondPart = frames - firstPart;
-        memcpy(buffer, data + firstPart, secondPart * sizeof(float));
+        memcpy(buffer, data + firstPart * channelCount, secondPart * channelCount * sizeof(float));
     }
     
     writeIndex.store((write + frames) % capacity);
@@ -48,12 +49,12 @@ size_t RingBuffer::read(float* data, size_t frames) {
     const size_t firstPart = std::min(frames, capacity - read);
     
     // Đọc phần đầu tiên
-    memcpy(data, buffer + read, firstPart * sizeof(float));
+    memcpy(data, buffer + read * channelCount, firstPart * channelCount * sizeof(float));
     
     // Xử lý trường hợp wrap-around
     if (firstPart < frames) {
         const size_t secondPart = frames - firstPart;
-        memcpy(data + firstPart, buffer, secondPart * sizeof(float));
+        memcpy(data + firstPart * channelCount, buffer, secondPart * channelCount * sizeof(float));
     }
     
     readIndex.store((read + frames) % capacity);
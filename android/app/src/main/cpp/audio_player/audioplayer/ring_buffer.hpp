@@ -4,15 +4,20 @@
 #include <cstddef>
 #include "common.hpp"
 
+/*
+    RingBuffer một producer / một consumer chứa PCM interleaved.
+    Dung lượng và mọi số lượng trong API tính theo frame (mỗi frame = channels mẫu).
+*/
 class RingBuffer {
 private:
-    float* buffer;        // Buffer cho một kênh duy nhất
+    float* buffer;        // PCM interleaved, capacity * channelCount mẫu
     const size_t capacity;
+    const size_t channelCount;
     std::atomic<size_t> readIndex;
     std::atomic<size_t> writeIndex;
 
 public:
-    explicit RingBuffer(size_t bufferSize);
+    explicit RingBuffer(size_t bufferFrames, size_t channels = 1);
     ~RingBuffer();
 
     // Prevent copying
@@ -24,4 +29,5 @@ public:
     void clear();
     size_t availableForRead() const;
     size_t availableForWrite() const;
+    size_t channels() const { return channelCount; }
 }; 
\ No newline at end of file
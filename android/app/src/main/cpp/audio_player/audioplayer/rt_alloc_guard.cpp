@@ -0,0 +1,145 @@
+#include "rt_alloc_guard.hpp"
+
+#if defined(AUDIO_RT_ALLOC_TRAP)
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__ANDROID__)
+    #include <android/log.h>
+#endif
+
+/*
+    Thread-local được lưu bằng pthread key thay vì thread_local:
+    thread_local trong thư viện dlopen có thể tự gọi malloc ở lần truy cập đầu tiên.
+    Giá trị của key là tên vùng đang bị cấm cấp phát (nullptr = được phép).
+*/
+namespace {
+
+pthread_key_t scopeKey;
+pthread_once_t scopeKeyOnce = PTHREAD_ONCE_INIT;
+
+void createScopeKey() {
+    pthread_key_create(&scopeKey, nullptr);
+}
+
+const char* currentScope() {
+    pthread_once(&scopeKeyOnce, createScopeKey);
+    return static_cast<const char*>(pthread_getspecific(scopeKey));
+}
+
+void setScope(const char* where) {
+    pthread_once(&scopeKeyOnce, createScopeKey);
+    pthread_setspecific(scopeKey, where);
+}
+
+[[noreturn]] void trap(const char* what, const char* where) {
+    // Tắt kiểm tra trước khi ghi log để log không tự kích hoạt lại trap
+    setScope(nullptr);
+#if defined(__ANDROID__)
+    __android_log_print(ANDROID_LOG_FATAL, "RtAllocTrap", "%s on real-time path: %s", what, where);
+#else
+    const char prefix[] = "RtAllocTrap: allocation on real-time path: ";
+    write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    write(STDERR_FILENO, what, strlen(what));
+    write(STDERR_FILENO, " in ", 4);
+    write(STDERR_FILENO, where, strlen(where));
+    write(STDERR_FILENO, "\n", 1);
+#endif
+    abort();
+}
+
+inline void check(const char* what) {
+    if (const char* where = currentScope()) {
+        trap(what, where);
+    }
+}
+
+} // namespace
+
+namespace rt_alloc {
+
+ScopedNoAlloc::ScopedNoAlloc(const char* where)
+    : previous(currentScope()) {
+    setScope(where);
+}
+
+ScopedNoAlloc::~ScopedNoAlloc() {
+    setScope(previous);
+}
+
+} // namespace rt_alloc
+
+// malloc/free được bọc bằng -Wl,--wrap=... (xem CMakeLists.txt), áp dụng cho cả opus/ogg/rubberband
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    check("malloc");
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    check("calloc");
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    check("realloc");
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) {
+        check("free");
+    }
+    __real_free(ptr);
+}
+}
+
+// new/delete của libc++ nằm trong thư viện dùng chung nên --wrap không bắt được, thay thế trực tiếp
+void* operator new(size_t size) {
+    check("operator new");
+    if (void* ptr = __real_malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    check("operator new[]");
+    if (void* ptr = __real_malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr) {
+        check("operator delete");
+    }
+    __real_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    if (ptr) {
+        check("operator delete[]");
+    }
+    __real_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    operator delete[](ptr);
+}
+
+#endif // AUDIO_RT_ALLOC_TRAP
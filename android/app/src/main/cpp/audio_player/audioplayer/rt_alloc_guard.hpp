@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+    Kiểm tra cấp phát bộ nhớ trên đường phát real-time (chỉ dùng khi build kiểm tra).
+
+    Build với -DAUDIO_RT_ALLOC_TRAP=ON: trong phạm vi RT_NO_ALLOC_SCOPE() mọi
+    malloc/calloc/realloc/free và new/delete trên thread hiện tại sẽ ghi log rồi abort(),
+    chỉ ra đúng chỗ đường phát còn cấp phát bộ nhớ.
+    RT_ALLOW_ALLOC_SCOPE() tạm cho phép cấp phát bên trong (vd: callback của ứng dụng).
+    Build bình thường: macro rỗng, không tốn chi phí.
+*/
+#if defined(AUDIO_RT_ALLOC_TRAP)
+
+namespace rt_alloc {
+
+class ScopedNoAlloc {
+public:
+    // where = nullptr: cho phép cấp phát trong phạm vi này
+    explicit ScopedNoAlloc(const char* where);
+    ~ScopedNoAlloc();
+
+    ScopedNoAlloc(const ScopedNoAlloc&) = delete;
+    ScopedNoAlloc& operator=(const ScopedNoAlloc&) = delete;
+
+private:
+    const char* previous;
+};
+
+} // namespace rt_alloc
+
+#define RT_NO_ALLOC_SCOPE(where) rt_alloc::ScopedNoAlloc rtNoAllocScope_(where)
+#define RT_ALLOW_ALLOC_SCOPE() rt_alloc::ScopedNoAlloc rtAllowAllocScope_(nullptr)
+
+#else
+
+#define RT_NO_ALLOC_SCOPE(where) do {} while (0)
+#define RT_ALLOW_ALLOC_SCOPE() do {} while (0)
+
+#endif
@@ -25,6 +25,7 @@ public:
     void start();
     void stop();
     void submitTask(Task task);
+    size_t threadCount() const { return workers_.size(); }
 
 private:
     std::vector<std::thread> workers_;
@@ -1,4 +1,8 @@
 #include "android_karaoke.hpp"
+#include "audio_player/audioplayer/audio_player.hpp"
+#include "audio_player/audioplayer/bus_table.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <android/log.h>
 
@@ -13,6 +17,12 @@ oboe::DataCallbackResult MicrophoneRecorder::onAudioReady(
     void *audioData,
     int32_t numFrames)
 {
+    StreamStats::CallbackScope statsScope(callbackStats, numFrames, sampleRate);
+    auto xruns = audioStream->getXRunCount();
+    if (xruns)
+    {
+        callbackStats.setXRunCount(xruns.value());
+    }
 
     float *inputBuffer = static_cast<float *>(audioData);
     int numSamples = numFrames; // Mono nên frames = samples
@@ -23,19 +33,57 @@ oboe::DataCallbackResult MicrophoneRecorder::onAudioReady(
         recordingCallback(inputBuffer, numFrames);
     }
 
-    // Lưu dữ liệu vào ring buffer - chỉ khi cần thiết
-    if (isRecording)
+    // Đưa vào ring của writer - chỉ khi cần thiết
+    if (isRecording.load(std::memory_order_acquire))
     {
-        // Sử dụng lock-free writing thay vì mutex
-        recordedBuffer.write(inputBuffer, numSamples);
+        storeRecorded(inputBuffer, numSamples);
     }
 
     return oboe::DataCallbackResult::Continue;
 }
 
+void MicrophoneRecorder::onCapturedAudio(const float *buffer, size_t frameCount)
+{
+    if (isRecording.load(std::memory_order_acquire) && capturedRecording.load(std::memory_order_acquire))
+    {
+        storeRecorded(buffer, frameCount);
+    }
+}
+
+void MicrophoneRecorder::storeRecorded(const float *buffer, size_t frameCount)
+{
+    // Chỉ chép vào ring của writer, thread ghi lo phần I/O
+    size_t dropped = writer.push(buffer, frameCount);
+    if (dropped > 0)
+    {
+        callbackStats.ring.addOverflow(dropped);
+    }
+}
+
+bool MicrophoneRecorder::beginTake(int rate)
+{
+    if (outputPath.empty())
+    {
+        return true;
+    }
+    takePath = std::move(outputPath);
+    outputPath.clear();
+    takeSampleRate = rate;
+    if (!writer.start(takePath, outputFormat, rate))
+    {
+        LOGE("Failed to open recording file: %s (%d Hz)", takePath.c_str(), rate);
+        takePath.clear();
+        return false;
+    }
+    LOGD("Recording to %s (%s, %d Hz)", takePath.c_str(),
+         outputFormat == RecordingWriter::Format::Opus ? "opus" : "wav", rate);
+    return true;
+}
+
 MicrophoneRecorder::MicrophoneRecorder()
-    : inputStream(nullptr), isRecording(false), sampleRate(48000),
-      bufferSize(64) // Giảm mạnh kích thước buffer để giảm độ trễ
+    : inputStream(nullptr), isRecording(false), capturedRecording(false), sampleRate(48000),
+      bufferSize(64), // Giảm mạnh kích thước buffer để giảm độ trễ
+      captureSampleRate(48000), outputFormat(RecordingWriter::Format::Wav)
 {
     LOGD("MicrophoneRecorder constructor");
 }
@@ -102,7 +150,8 @@ bool MicrophoneRecorder::startRecording()
     if (isRecording)
     {
         LOGD("Already recording");
-        return true;
+        // Mic đang chạy chỉ để phát trực tiếp: take mới được ghi ngay trên nguồn đang chạy
+        return writer.isActive() || beginTake(capturedRecording ? captureSampleRate : inputStream->getSampleRate());
     }
 
     if (!inputStream)
@@ -111,156 +160,165 @@ bool MicrophoneRecorder::startRecording()
         return false;
     }
 
-    // Xóa dữ liệu đã ghi trước đó
-    recordedBuffer.clear();
+    callbackStats.resetPeriod();
+    // Mở file trước khi mic chạy, theo sample rate thật của stream
+    if (!beginTake(inputStream->getSampleRate()))
+    {
+        return false;
+    }
 
     // Bắt đầu input stream
     oboe::Result result = inputStream->requestStart();
     if (result != oboe::Result::OK)
     {
         LOGE("Failed to start input stream. Error: %s", oboe::convertToText(result));
+        writer.stop();
         return false;
     }
 
-    isRecording = true;
+    isRecording.store(true, std::memory_order_release);
     LOGD("Recording started");
     return true;
 }
 
-void MicrophoneRecorder::stopRecording()
+bool MicrophoneRecorder::startCapturedRecording(int rate)
 {
-    if (!isRecording)
+    captureSampleRate = rate;
+    if (isRecording && capturedRecording)
     {
-        return;
+        return true;
     }
 
-    if (inputStream)
+    if (isRecording)
     {
-        inputStream->requestStop();
+        // Hai input stream cùng lúc thường bị hệ thống làm im một bên: nhường mic cho AudioLayer
+        if (inputStream)
+        {
+            inputStream->requestStop();
+        }
+        // Header của file mang sample rate lúc mở: rate khác thì đóng take đó, ghi tiếp sang file mới
+        if (writer.isActive() && takeSampleRate != rate)
+        {
+            const std::string previousPath = takePath;
+            writer.stop();
+            const size_t slash = previousPath.find_last_of('/');
+            const size_t dot = previousPath.find_last_of('.');
+            const size_t split = (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                                     ? dot
+                                     : previousPath.size();
+            // Giữ file đã đặt cho take kế tiếp (nếu có)
+            std::string pendingPath = std::move(outputPath);
+            outputPath = previousPath.substr(0, split) + "-" + std::to_string(rate) + "Hz" +
+                         previousPath.substr(split);
+            LOGD("Capture rate %d Hz differs from take rate %d Hz: %s closed, continuing in %s", rate,
+                 takeSampleRate, previousPath.c_str(), outputPath.c_str());
+            const bool opened = beginTake(rate);
+            outputPath = std::move(pendingPath);
+            if (!opened)
+            {
+                isRecording.store(false, std::memory_order_release);
+                return false;
+            }
+        }
+    }
+    else if (!beginTake(rate))
+    {
+        return false;
     }
 
-    isRecording = false;
-    LOGD("Recording stopped");
-}
-
-void MicrophoneRecorder::setRecordingCallback(RecordingCallback callback)
-{
-    recordingCallback = std::move(callback);
+    capturedRecording.store(true, std::memory_order_release);
+    isRecording.store(true, std::memory_order_release);
+    LOGD("Recording from full-duplex capture");
+    return true;
 }
 
-std::vector<float> MicrophoneRecorder::getRecordedData() const
+void MicrophoneRecorder::stopRecording()
 {
-    // Trích xuất toàn bộ dữ liệu từ ring buffer
-    std::vector<float> result;
-
-    // Lấy kích thước dữ liệu có sẵn
-    size_t availableData = recordedBuffer.getAvailableData();
-    if (availableData == 0)
+    if (!isRecording)
     {
-        return result; // Trả về vector rỗng nếu không có dữ liệu
+        return;
     }
 
-    // Cấp phát bộ nhớ cho vector kết quả
-    result.resize(availableData);
-
-    // Tạo một buffer tạm thời cho dữ liệu
-    std::vector<float> tempData(availableData);
-
-    // Đọc dữ liệu vào buffer tạm thời
-    // Sử dụng một phương pháp an toàn hơn thay vì sao chép toàn bộ ring buffer
-    // LockFreeRingBuffer không thể được sao chép do có các atomic members
-    size_t read = const_cast<LockFreeRingBuffer<float, RECORDER_BUFFER_SIZE> &>(recordedBuffer).read(tempData.data(), availableData);
+    if (inputStream && !capturedRecording)
+    {
+        inputStream->requestStop();
+    }
 
-    // Sao chép dữ liệu đã đọc vào vector kết quả
-    std::copy(tempData.begin(), tempData.begin() + read, result.begin());
+    isRecording.store(false, std::memory_order_release);
+    capturedRecording.store(false, std::memory_order_release);
 
-    // Điều chỉnh kích thước của result nếu không đọc được đủ dữ liệu
-    if (read < availableData)
+    // Ghi nốt phần còn trong ring và hoàn tất header
+    if (writer.isActive())
     {
-        result.resize(read);
+        const bool ok = writer.stop();
+        LOGD("Recording saved to %s: %.2f seconds, %llu frames dropped%s", takePath.c_str(),
+             static_cast<double>(writer.getFramesWritten()) / takeSampleRate,
+             static_cast<unsigned long long>(writer.getDroppedFrames()), ok ? "" : ", write error");
     }
+    LOGD("Recording stopped");
+}
 
-    return result;
+void MicrophoneRecorder::setOutputFile(const std::string &filePath, RecordingWriter::Format format)
+{
+    outputPath = filePath;
+    outputFormat = format;
 }
 
-bool MicrophoneRecorder::saveToFile(const std::string &filePath)
+void MicrophoneRecorder::setRecordingCallback(RecordingCallback callback)
 {
-    // Trích xuất dữ liệu trước
-    std::vector<float> recordedData = getRecordedData();
+    recordingCallback = std::move(callback);
+}
 
-    if (recordedData.empty())
+bool MicrophoneRecorder::saveToFile(const std::string &filePath)
+{
+    if (isRecording)
     {
-        LOGE("No recorded data to save");
+        LOGE("Stop recording before saving");
         return false;
     }
-
-    // Mở file để ghi
-    FILE *file = fopen(filePath.c_str(), "wb");
-    if (!file)
+    if (takePath.empty() || writer.getFramesWritten() == 0)
     {
-        LOGE("Failed to open file for writing: %s", filePath.c_str());
+        LOGE("No recorded data to save");
         return false;
     }
+    if (filePath == takePath)
+    {
+        return true;
+    }
 
-    // Số lượng mẫu (sample) đã ghi âm
-    size_t totalSamples = recordedData.size();
-
-    // Kích thước dữ liệu âm thanh tính bằng byte
-    uint32_t dataSize = totalSamples * sizeof(int16_t);
-
-    // Cấu trúc header WAV file
-    // RIFF header
-    fwrite("RIFF", 1, 4, file);
-    uint32_t fileSize = 36 + dataSize; // Kích thước toàn bộ file - 8 byte
-    fwrite(&fileSize, 1, 4, file);
-    fwrite("WAVE", 1, 4, file);
-
-    // Format chunk
-    fwrite("fmt ", 1, 4, file);
-    uint32_t fmtSize = 16; // PCM format chunk size
-    fwrite(&fmtSize, 1, 4, file);
-    uint16_t audioFormat = 1; // PCM = 1
-    fwrite(&audioFormat, 1, 2, file);
-    uint16_t numChannels = 1; // Mono
-    fwrite(&numChannels, 1, 2, file);
-    uint32_t sampleRateWav = sampleRate;
-    fwrite(&sampleRateWav, 1, 4, file);
-    uint32_t byteRate = sampleRate * 1 * sizeof(int16_t); // Mono, nên channels = 1
-    fwrite(&byteRate, 1, 4, file);
-    uint16_t blockAlign = 1 * sizeof(int16_t); // Mono, nên channels = 1
-    fwrite(&blockAlign, 1, 2, file);
-    uint16_t bitsPerSample = 16; // 16-bit
-    fwrite(&bitsPerSample, 1, 2, file);
-
-    // Data chunk
-    fwrite("data", 1, 4, file);
-    fwrite(&dataSize, 1, 4, file);
-
-    // Chuyển đổi từ float (-1.0 đến 1.0) sang int16_t (-32768 đến 32767)
-    std::vector<int16_t> pcmData(totalSamples);
-    for (size_t i = 0; i < totalSamples; i++)
-    {
-        float sample = recordedData[i];
-        // Giới hạn phạm vi
-        if (sample > 1.0f)
-            sample = 1.0f;
-        if (sample < -1.0f)
-            sample = -1.0f;
-        // Chuyển đổi sang int16_t
-        pcmData[i] = static_cast<int16_t>(sample * 32767.0f);
-    }
-
-    // Ghi dữ liệu âm thanh
-    fwrite(pcmData.data(), sizeof(int16_t), totalSamples, file);
-
-    // Đóng file
-    fclose(file);
+    // Take đã nằm trên đĩa: đổi tên, khác phân vùng thì chép theo từng đoạn (bộ nhớ cố định)
+    if (std::rename(takePath.c_str(), filePath.c_str()) != 0)
+    {
+        FILE *source = fopen(takePath.c_str(), "rb");
+        FILE *target = source ? fopen(filePath.c_str(), "wb") : nullptr;
+        if (!target)
+        {
+            LOGE("Failed to open file for writing: %s", filePath.c_str());
+            if (source)
+            {
+                fclose(source);
+            }
+            return false;
+        }
+        std::vector<char> block(1 << 16);
+        bool ok = true;
+        size_t read;
+        while (ok && (read = fread(block.data(), 1, block.size(), source)) > 0)
+        {
+            ok = fwrite(block.data(), 1, read, target) == read;
+        }
+        fclose(source);
+        ok = fclose(target) == 0 && ok;
+        if (!ok)
+        {
+            LOGE("Failed to write recording to %s", filePath.c_str());
+            return false;
+        }
+        std::remove(takePath.c_str());
+    }
 
     LOGD("Saved recorded audio to file: %s", filePath.c_str());
-    LOGD("  - Sample rate: %d Hz", sampleRate);
-    LOGD("  - Channels: 1 (mono)");
-    LOGD("  - Duration: %.2f seconds", static_cast<float>(totalSamples) / sampleRate);
-
+    takePath = filePath;
     return true;
 }
 
@@ -292,7 +350,13 @@ int MicrophoneRecorder::getSampleRate() const
 Karaoke::Karaoke()
     : recorder(std::make_unique<MicrophoneRecorder>()),
       player(std::make_unique<KaraokePlayer>()),
-      livePlayback(false)
+      livePlayback(false),
+      micVolume(1.0f),
+      captureLayer(nullptr),
+      micBusId(-1),
+      micGain(nullptr),
+      echoCancellation(true),
+      vocalChain(std::make_shared<VocalChain>())
 {
     LOGD("Karaoke constructor");
 }
@@ -300,10 +364,13 @@ Karaoke::Karaoke()
 Karaoke::~Karaoke()
 {
     LOGD("Karaoke destructor");
+    stopDuplexMonitor();
     if (recorder && recorder->isCurrentlyRecording())
     {
         recorder->stopRecording();
     }
+    // Tap của mic full-duplex trỏ tới recorder
+    releaseCapture();
 
     if (player)
     {
@@ -329,22 +396,33 @@ bool Karaoke::initialize()
         return false;
     }
 
+    // Vocal chain cho đường MicrophonePlayer, engine full-duplex chuẩn bị lại theo sample rate của nó
+    vocalChain->prepare(recorder->getSampleRate());
+    monitorBlock.assign(VocalChain::MAX_BLOCK_FRAMES, 0.0f);
+
     // Thiết lập callback từ microphone để stream trực tiếp đến player
-    // Direct pass-through để giảm độ trễ tối đa
+    // Vocal chain chạy tại chỗ ngay trên callback của mic, không thêm buffer nào khác
     recorder->setRecordingCallback([this](const float *buffer, size_t frameCount)
                                    {
         if (livePlayback && player) {
-            // Truyền trực tiếp dữ liệu âm thanh đến player, không xử lý
-            player->addAudioFromMic(buffer, frameCount);
+            size_t done = 0;
+            while (done < frameCount) {
+                const size_t count = std::min(frameCount - done, monitorBlock.size());
+                std::copy(buffer + done, buffer + done + count, monitorBlock.begin());
+                vocalChain->process(monitorBlock.data(), static_cast<int32_t>(count));
+                player->addAudioFromMic(monitorBlock.data(), count);
+                done += count;
+            }
         } });
 
     return true;
 }
 
-bool Karaoke::startRecording()
+bool Karaoke::startRecording(const std::string &filePath, RecordingWriter::Format format)
 {
     // Ghi âm bình thường, không phát trực tiếp
     livePlayback = false;
+    recorder->setOutputFile(filePath, format);
     return recorder->startRecording();
 }
 
@@ -356,6 +434,7 @@ void Karaoke::stopRecording()
     {
         stopLivePlayback();
     }
+    releaseCapture();
 }
 
 bool Karaoke::saveRecordingToFile(const std::string &filePath)
@@ -365,13 +444,34 @@ bool Karaoke::saveRecordingToFile(const std::string &filePath)
 
 bool Karaoke::startLivePlayback()
 {
-    // Đảm bảo player đã được khởi tạo
+    if (livePlayback)
+    {
+        LOGD("Live playback already active");
+        return true;
+    }
+
+    // Ưu tiên engine full-duplex: mic và nhạc nền trong cùng một callback, không ring buffer
+    if (startDuplexMonitor())
+    {
+        livePlayback = true;
+        // Thiết lập âm lượng phù hợp cho mono
+        setMicVolume(3.0f);
+        LOGD("Live playback started on the full-duplex engine");
+        return true;
+    }
+
+    // Không có engine full-duplex: stream mic và stream phát riêng như trước
     if (!player)
     {
         LOGE("Player not initialized");
         return false;
     }
 
+    // Callback của recorder chưa chạy vocal chain khi livePlayback còn false
+    if (vocalChain->getSampleRate() != recorder->getSampleRate())
+    {
+        vocalChain->prepare(recorder->getSampleRate());
+    }
     // Đánh dấu chế độ phát trực tiếp trước khi bắt đầu
     livePlayback = true;
 
@@ -384,7 +484,7 @@ bool Karaoke::startLivePlayback()
     }
 
     // Thiết lập âm lượng phù hợp cho mono
-    player->setVolume(3.0f);
+    setMicVolume(3.0f);
     LOGD("Mic volume set to 3.0 for clarity");
 
     // Bắt đầu recorder sau
@@ -407,6 +507,8 @@ void Karaoke::stopLivePlayback()
 {
     livePlayback = false;
 
+    stopDuplexMonitor();
+
     // Dừng player
     if (player)
     {
@@ -418,6 +520,93 @@ void Karaoke::stopLivePlayback()
     LOGD("Live playback stopped");
 }
 
+bool Karaoke::startDuplexMonitor()
+{
+    AudioLayer *layer = AudioPlayer::getInstance()->getAudioLayer();
+    if (!layer)
+    {
+        return false;
+    }
+
+    // Recorder nhận nguyên block mic trên audio thread, chỉ lưu khi đang ghi
+    MicrophoneRecorder *micRecorder = recorder.get();
+    AudioCallback capture = layer->openCapture([micRecorder](const float *buffer, size_t frameCount)
+                                               { micRecorder->onCapturedAudio(buffer, frameCount); });
+    if (!capture)
+    {
+        LOGD("Full-duplex capture unavailable");
+        return false;
+    }
+    captureLayer = layer;
+
+    int busId = layer->acquireInputBus(1);
+    if (busId < 0)
+    {
+        releaseCapture();
+        return false;
+    }
+    // Reference của bộ khử echo là nhạc, không gồm giọng đã phát ra từ chính bus mic.
+    // Loại bus ra trước khi gắn graph để không block nào của giọng lọt vào reference
+    layer->setInputEchoReference(busId, false);
+
+    // livePlayback còn false nên callback của recorder không chạy vocal chain trong lúc chuẩn bị lại
+    if (vocalChain->getSampleRate() != layer->getSampleRate())
+    {
+        vocalChain->prepare(layer->getSampleRate());
+    }
+
+    // Graph của mic: nguồn full-duplex -> vocal chain -> gain của mic
+    // (tới 5.0, quá 1.0 thì limiter của mixer chặn)
+    auto graph = std::make_shared<ProcessingGraph>(BusTable::MAX_BLOCK_FRAMES);
+    auto *source = graph->addNode<CallbackSourceNode>(1, std::move(capture));
+    auto *effects = graph->addNode<VocalChainNode>(vocalChain);
+    auto *gain = graph->addNode<GainNode>(1);
+    gain->setGain(micVolume);
+    source->output.connect(&effects->input);
+    effects->output.connect(&gain->input);
+    if (!graph->compile(gain->output) || !layer->setBusGraph(busId, graph))
+    {
+        LOGE("Failed to set up the microphone bus");
+        layer->releaseInputBus(busId);
+        releaseCapture();
+        return false;
+    }
+
+    micBusId = busId;
+    micGraph = std::move(graph);
+    micGain = gain;
+
+    layer->setEchoCancellation(echoCancellation);
+
+    // Mic đã do AudioLayer đọc, recorder ghi từ đó thay vì mở input stream thứ hai
+    recorder->startCapturedRecording(layer->getSampleRate());
+    return true;
+}
+
+void Karaoke::stopDuplexMonitor()
+{
+    if (micBusId < 0)
+    {
+        return;
+    }
+    // Trả về khi callback không còn chạy vocal chain của mic
+    captureLayer->releaseInputBus(micBusId);
+    micBusId = -1;
+    micGain = nullptr;
+    micGraph.reset();
+    releaseCapture();
+}
+
+void Karaoke::releaseCapture()
+{
+    if (!captureLayer || micBusId >= 0 || recorder->isCurrentlyRecording())
+    {
+        return;
+    }
+    captureLayer->closeCapture();
+    captureLayer = nullptr;
+}
+
 bool Karaoke::isLivePlaybackActive() const
 {
     return livePlayback;
@@ -426,14 +615,30 @@ bool Karaoke::isLivePlaybackActive() const
 // Các phương thức điều chỉnh âm lượng
 void Karaoke::setMicVolume(float volume)
 {
+    // Cùng giới hạn với MicrophonePlayer
+    micVolume = std::clamp(volume, 0.0f, 5.0f);
+    if (micGain)
+    {
+        micGain->setGain(micVolume);
+    }
     if (player)
     {
-        player->setVolume(volume);
-        LOGD("Karaoke mic volume set to %f", volume);
+        player->setVolume(micVolume);
     }
+    LOGD("Karaoke mic volume set to %f", micVolume);
 }
 
 float Karaoke::getMicVolume() const
 {
-    return player ? player->getVolume() : 1.0f;
+    return micVolume;
+}
+
+void Karaoke::setEchoCancellation(bool enabled)
+{
+    echoCancellation = enabled;
+    if (captureLayer)
+    {
+        captureLayer->setEchoCancellation(enabled);
+    }
+    LOGD("Karaoke echo cancellation %s", enabled ? "enabled" : "disabled");
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <oboe/Oboe.h>
+#include <atomic>
 #include <vector>
 #include <mutex>
 #include <functional>
@@ -8,12 +9,14 @@
 #include <memory>
 #include "audio_player/audioplayer/common.hpp"
 #include "android_mic_player.hpp"
-
-// Kích thước buffer cho recorder
-constexpr size_t RECORDER_BUFFER_SIZE = 1 << 17; // 131072 samples (~2.7s ở 48kHz mono)
+#include "audio_player/audioplayer/audio_stats.hpp"
+#include "audio_player/audioplayer/processing_graph.hpp"
+#include "vocal_chain.hpp"
+#include "recording_writer.hpp"
 
 // Forward declarations
 class AudioPlayer;
+class AudioLayer;
 
 class MicrophoneRecorder : public oboe::AudioStreamCallback {
 public:
@@ -21,12 +24,20 @@ public:
 
 private:
     std::shared_ptr<oboe::AudioStream> inputStream;
-    bool isRecording;
+    // Đặt trên thread app, đọc trên audio thread (onAudioReady, onCapturedAudio)
+    std::atomic<bool> isRecording;
+    std::atomic<bool> capturedRecording; // Ghi từ mic full-duplex của AudioLayer, inputStream không chạy
     int sampleRate;
     int bufferSize;
-    // Sử dụng lock-free ring buffer thay vì vector và mutex
-    LockFreeRingBuffer<float, RECORDER_BUFFER_SIZE> recordedBuffer;
+    int captureSampleRate; // Sample rate của mic full-duplex
+    // Take được ghi thẳng xuống file trong lúc hát (ring nhỏ + thread ghi), không giữ trong bộ nhớ
+    RecordingWriter writer;
+    std::string outputPath; // File cho take kế tiếp, rỗng thì chỉ đọc mic (phát trực tiếp)
+    RecordingWriter::Format outputFormat;
+    std::string takePath;   // File của take gần nhất
+    int takeSampleRate = 0;
     RecordingCallback recordingCallback;
+    StreamStats callbackStats{"mic-recorder"}; // Thời gian callback, xrun, số mẫu bị bỏ khi ring của writer đầy
 
     // Oboe callback implementation
     oboe::DataCallbackResult onAudioReady(
@@ -34,6 +45,10 @@ private:
         void *audioData,
         int32_t numFrames) override;
 
+    void storeRecorded(const float *buffer, size_t frameCount);
+    // Mở file cho take mới nếu đã có setOutputFile()
+    bool beginTake(int rate);
+
 public:
     MicrophoneRecorder();
     ~MicrophoneRecorder();
@@ -41,11 +56,22 @@ public:
     bool initialize();
     void shutdown();
 
+    // File (ghi đè) cho lần startRecording()/startCapturedRecording() kế tiếp, chỉ dùng cho một take.
+    // Không đặt thì recorder chỉ đọc mic cho callback, không ghi gì.
+    void setOutputFile(const std::string &filePath, RecordingWriter::Format format = RecordingWriter::Format::Wav);
+
     bool startRecording();
+    // Ghi từ block mic mà AudioLayer đọc trong callback full-duplex (sample rate rate) thay vì
+    // inputStream. Đang ghi bằng inputStream thì dừng stream đó và ghi tiếp vào cùng file; nếu
+    // sample rate khác thì file đó được đóng lại và phần còn lại ghi vào "<tên>-<rate>Hz.<đuôi>".
+    bool startCapturedRecording(int rate);
     void stopRecording();
     void setRecordingCallback(RecordingCallback callback);
 
-    std::vector<float> getRecordedData() const;
+    // Audio thread: tap của AudioLayer::openCapture()
+    void onCapturedAudio(const float *buffer, size_t frameCount);
+
+    // Chuyển file của take đã ghi xong sang filePath (đổi tên, khác phân vùng thì chép theo từng đoạn)
     bool saveToFile(const std::string &filePath);
 
     bool isCurrentlyRecording() const;
@@ -60,6 +86,26 @@ private:
     std::unique_ptr<MicrophoneRecorder> recorder;
     std::unique_ptr<KaraokePlayer> player;
     bool livePlayback; // Trạng thái phát trực tiếp từ microphone
+    float micVolume;
+
+    // Full-duplex: mic được đọc trong callback của AudioLayer (cùng nhạc nền) và phát qua một bus.
+    // captureLayer = nullptr thì phát trực tiếp bằng MicrophonePlayer như trước
+    // (AudioPlayer chưa khởi tạo hoặc không mở được mic).
+    AudioLayer *captureLayer;
+    int micBusId;                            // -1 khi không phát mic qua bus
+    std::shared_ptr<ProcessingGraph> micGraph; // mic -> vocal chain -> gain
+    GainNode *micGain;                       // Thuộc micGraph
+    bool echoCancellation;                   // Khử tiếng nhạc lọt vào mic (full-duplex)
+
+    // Hiệu ứng giọng hát khi phát trực tiếp, chạy trong graph của bus mic (full-duplex)
+    // hoặc trên callback của recorder (MicrophonePlayer)
+    std::shared_ptr<VocalChain> vocalChain;
+    std::vector<float> monitorBlock; // Block đã qua vocal chain gửi cho MicrophonePlayer
+
+    bool startDuplexMonitor();
+    void stopDuplexMonitor();
+    // Đóng mic full-duplex khi không còn phát hay ghi từ nó
+    void releaseCapture();
 
 public:
     Karaoke();
@@ -67,8 +113,10 @@ public:
 
     bool initialize();
 
-    // Chế độ ghi âm thông thường (không phát lại)
-    bool startRecording();
+    // Chế độ ghi âm thông thường (không phát lại). Có filePath thì take được ghi thẳng xuống file
+    // trong lúc hát (WAV/RF64 hoặc Opus), độ dài không giới hạn.
+    bool startRecording(const std::string &filePath = std::string(),
+                        RecordingWriter::Format format = RecordingWriter::Format::Wav);
     void stopRecording();
     bool saveRecordingToFile(const std::string &filePath);
 
@@ -85,4 +133,12 @@ public:
     // Điều chỉnh âm lượng microphone
     void setMicVolume(float volume);
     float getMicVolume() const;
+
+    // Tham số và bypass của hiệu ứng giọng hát, đổi được khi đang phát
+    VocalChain &getVocalChain() { return *vocalChain; }
+
+    // Khử tiếng nhạc nền lọt từ loa vào mic (chỉ ở chế độ full-duplex), mặc định bật.
+    // Đổi được khi đang phát, bật lại thì bộ lọc học lại từ đầu.
+    void setEchoCancellation(bool enabled);
+    bool isEchoCancellationEnabled() const { return echoCancellation; }
 };
@@ -85,6 +85,7 @@ bool MicrophonePlayer::start()
 
     // Xóa buffer
     clearBuffer();
+    callbackStats.resetPeriod();
 
     // Bắt đầu output stream
     oboe::Result result = outputStream->requestStart();
@@ -122,6 +123,12 @@ oboe::DataCallbackResult MicrophonePlayer::onAudioReady(
     void *audioData,
     int32_t numFrames)
 {
+    StreamStats::CallbackScope statsScope(callbackStats, numFrames, sampleRate);
+    auto xruns = stream->getXRunCount();
+    if (xruns) {
+        callbackStats.setXRunCount(xruns.value());
+    }
+
     // Buffer tạm thời cho dữ liệu âm thanh từ ring buffer
     // Fix cứng mono (1 channel)
     int totalSamples = numFrames; // Mono nên frames = samples
@@ -140,16 +147,21 @@ oboe::DataCallbackResult MicrophonePlayer::onAudioReady(
 
     // Đọc dữ liệu âm thanh từ ring buffer - lock-free
     size_t framesRead = ringBuffer.read(tempBuffer, totalSamples);
+    if (isPlaying && framesRead < static_cast<size_t>(totalSamples)) {
+        callbackStats.ring.addUnderflow(totalSamples - framesRead);
+    }
 
-    // Chỉ áp dụng volume, không áp dụng bất kỳ bộ lọc nào khác
-    if (framesRead > 0 && volume != 1.0f) {
+    // Chỉ áp dụng volume (có ramp), không áp dụng bất kỳ bộ lọc nào khác
+    volumeRamp.setTarget(volume.load(std::memory_order_relaxed));
+    if (framesRead > 0 && (volumeRamp.isRamping() || volumeRamp.target() != 1.0f)) {
+        volumeRamp.apply(tempBuffer, totalSamples, 1);
         for (size_t i = 0; i < totalSamples; i++) {
-            tempBuffer[i] *= volume;
-            
             // Giới hạn biên độ tránh clipping
             if (tempBuffer[i] > 1.0f) tempBuffer[i] = 1.0f;
             if (tempBuffer[i] < -1.0f) tempBuffer[i] = -1.0f;
         }
+    } else {
+        volumeRamp.advance(totalSamples);
     }
 
     // Sao chép dữ liệu vào output buffer - direct pass through
@@ -172,12 +184,17 @@ size_t MicrophonePlayer::addAudioData(const float *data, size_t numSamples)
 
     // Ưu tiên độ trễ thấp: xóa buffer nếu đang đầy
     if (ringBuffer.getAvailableSpace() < numSamples) {
+        callbackStats.ring.addOverflow(ringBuffer.getAvailableData());
         clearBuffer();
         LOGD("Buffer reset to minimize latency");
     }
     
     // Add data to ring buffer - lock-free, direct pass-through
-    return ringBuffer.write(data, numSamples);
+    size_t written = ringBuffer.write(data, numSamples);
+    if (written < numSamples) {
+        callbackStats.ring.addOverflow(numSamples - written);
+    }
+    return written;
 }
 
 bool MicrophonePlayer::isCurrentlyPlaying() const
@@ -221,13 +238,13 @@ void MicrophonePlayer::setVolume(float newVolume)
     if (newVolume > 5.0f)
         newVolume = 5.0f;
 
-    volume = newVolume;
-    LOGD("Mic volume set to %f", volume);
+    volume.store(newVolume, std::memory_order_relaxed);
+    LOGD("Mic volume set to %f", newVolume);
 }
 
 float MicrophonePlayer::getVolume() const
 {
-    return volume;
+    return volume.load(std::memory_order_relaxed);
 }
 
 // Triển khai KaraokePlayer
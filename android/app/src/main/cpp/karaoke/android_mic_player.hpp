@@ -11,6 +11,8 @@
 #include <array>
 #include <memory>
 #include "../audio_player/audioplayer/common.hpp"
+#include "../audio_player/audioplayer/gain_ramp.hpp"
+#include "../audio_player/audioplayer/audio_stats.hpp"
 
 // Kích thước mặc định cho ring buffer tính bằng số mẫu
 constexpr size_t DEFAULT_RING_BUFFER_SIZE = 8192; // Giảm kích thước buffer để giảm độ trễ nhưng vẫn đủ lớn
@@ -210,8 +212,10 @@ private:
     std::atomic<bool> isPlaying;
     int sampleRate;
     int bufferSize;
-    float volume; // Thêm biến volume để điều chỉnh âm lượng mic
+    std::atomic<float> volume; // Volume đích, set từ thread app
+    GainRamp volumeRamp;       // Làm mượt volume trong callback, tránh click khi đổi volume
     PlaybackCallback playbackCallback;
+    StreamStats callbackStats{"mic-player"}; // Thời gian callback, xrun, underflow/overflow của ring buffer
 
     // Oboe callback implementation
     oboe::DataCallbackResult onAudioReady(
@@ -31,6 +31,8 @@
 // }
 #include "karaoke_factory.cpp"
 #include "ogg_play.hpp"
+#include "reverb_processor.hpp"
+#include <algorithm>
 #include <thread> // Thêm thư viện std::thread
 #include <mutex>  // Thêm thư viện std::mutex cho thread safety (nếu cần)
 
@@ -96,4 +98,20 @@ extern "C"
         karaoke_thread.detach();
         ogg_thread.detach();
     }
+
+    // Microbenchmark reverb của vocal chain: ns trên mỗi mẫu khi xử lý theo block frames mẫu (vd: 64).
+    // baselineNs (có thể null) nhận kết quả của bản reverb cũ đo cùng cách để so sánh.
+    double karaoke_benchmark_reverb(int frames, double *baselineNs)
+    {
+        const size_t blockFrames = static_cast<size_t>(std::max(frames, 1));
+        const double ns = ReverbProcessor::benchmarkNsPerFrame(blockFrames);
+        const double baseline = ReverbProcessor::benchmarkBaselineNsPerFrame(blockFrames);
+        LOGI("Reverb benchmark %s, %d frames: %.2f ns/frame (baseline %.2f ns/frame)",
+             ReverbProcessor::simdName(), frames, ns, baseline);
+        if (baselineNs != nullptr)
+        {
+            *baselineNs = baseline;
+        }
+        return ns;
+    }
 }
\ No newline at end of file
@@ -241,8 +241,7 @@ OSStatus MicrophonePlayer::handleOutputCallback(AudioUnitRenderActionFlags* ioAc
     // Áp dụng reverb nếu được bật
     if (framesRead > 0 && reverbProcessor) {
         // Áp dụng reverb trực tiếp vào tempBuffer thay vì tạo vector mới
-        auto reverbedData = reverbProcessor->process(tempBuffer.data(), tempBuffer.size());
-        std::copy(reverbedData.begin(), reverbedData.end(), tempBuffer.begin());
+        reverbProcessor->process(tempBuffer.data(), tempBuffer.size());
     }
     
     // Áp dụng hệ số volume vào tất cả các mẫu nếu cần
@@ -297,7 +296,7 @@ MicrophonePlayer::MicrophonePlayer(size_t bufferSize)
     , volume(1.0f)       // Âm lượng mặc định là 1.0 (100%)
 {
     echoCanceller = std::make_unique<EchoCanceller>(sampleRate, channels);
-    reverbProcessor = std::make_unique<ReverbProcessor>();
+    reverbProcessor = std::make_unique<ReverbProcessor>(sampleRate);
     
     // Mặc định ban đầu sẽ tắt echo cancellation
     echoCanceller->setEnabled(false);
@@ -585,7 +584,7 @@ void MicrophonePlayer::setReverbDryMix(float dry) {
 
 void MicrophonePlayer::enableReverb(bool enable) {
     if (enable && !reverbProcessor) {
-        reverbProcessor = std::make_unique<ReverbProcessor>();
+        reverbProcessor = std::make_unique<ReverbProcessor>(sampleRate);
     } else if (!enable) {
         reverbProcessor.reset();
     }
@@ -1,80 +1,111 @@
 #include "pitch_processor.hpp"
-#include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <rubberband/RubberBandLiveShifter.h>
 
-PitchProcessor::PitchProcessor() {
-    // Khởi tạo Rubber Band với các thông số tối ưu cho xử lý thời gian thực
-    RubberBand::RubberBandStretcher::Options options = 
-        RubberBand::RubberBandStretcher::OptionProcessRealTime |
-        RubberBand::RubberBandStretcher::OptionPitchHighQuality |
-        RubberBand::RubberBandStretcher::OptionChannelsTogether;
-    
-    stretcher = std::make_unique<RubberBand::RubberBandStretcher>(
-        44100,  // Sample rate
-        1,      // Channels (mono)
-        options
-    );
-    
-    timeRatio = 1.0;  // Không thay đổi tốc độ
-    pitchScale = std::pow(2.0, 0.0 / 12.0); // Mặc định tăng 5 cung
-    
-    // Cập nhật thông số cho Rubber Band
-    stretcher->setPitchScale(pitchScale);
-    stretcher->setTimeRatio(timeRatio);
-    
-    // Cấu hình các thông số xử lý
-    stretcher->setMaxProcessSize(1024);
-    stretcher->setExpectedInputDuration(0);
-    
-    std::cout << "PitchProcessor initialized with pitch shift: 5.0 semitones" << std::endl;
+namespace {
+
+// Sau reset(), tín hiệu mới được mở dần trong khoảng này để không bị click
+constexpr size_t FADE_IN_FRAMES = 256;
+// Lệch pitch nhỏ nhất dùng khi làm nóng resampler (xem constructor)
+constexpr float NEAR_UNITY_SEMITONES = 0.0001f;
+
+double semitonesToScale(float semitones) {
+    return std::pow(2.0, semitones / 12.0);
+}
+
+} // namespace
+
+PitchProcessor::PitchProcessor(int sampleRate) {
+    // Cửa sổ ngắn cho trễ thấp nhất, giữ formant cho giọng hát, mono
+    shifter = std::make_unique<RubberBand::RubberBandLiveShifter>(
+        static_cast<size_t>(std::max(sampleRate, 1)),
+        1,
+        RubberBand::RubberBandLiveShifter::OptionWindowShort |
+        RubberBand::RubberBandLiveShifter::OptionFormantPreserved);
+
+    blockSize = shifter->getBlockSize();
+    inputBlock.assign(blockSize, 0.0f);
+    outputBlock.assign(blockSize, 0.0f);
+
+    // Cho shifter chạy vài block im lặng ngay tại đây, vì hai chỗ cấp phát trên audio thread:
+    // - block đầu tiên (và setPitchScale trước nó) đo lại trễ resampler
+    // - mỗi resampler (vào/ra) có hai state đổi nhau mỗi lần đổi tỷ lệ, và cấp phát lại khi tỷ lệ
+    //   mới cần bảng phase (theo tử số phân số, lớn nhất khi tỷ lệ rất gần 1) hoặc buffer (lớn nhất
+    //   ở tỷ lệ 2:1) lớn hơn state đó từng có. Chuỗi dưới đây đưa cả hai state của mỗi resampler
+    //   qua hai trường hợp xấu nhất, sau đó mọi tỷ lệ trong -12..12 semitone đều không cấp phát nữa.
+    const double up = semitonesToScale(NEAR_UNITY_SEMITONES);    // Resampler vào, tử số ~96000
+    const double down = semitonesToScale(-NEAR_UNITY_SEMITONES); // Resampler ra, tử số ~96000
+    const float* inputPtrs[1] = { inputBlock.data() };
+    float* outputPtrs[1] = { outputBlock.data() };
+    for (double scale : { 1.0, up, 2.0, 1.5, up, 2.0, down, 0.5, 0.75, down, 0.5, 1.0 }) {
+        shifter->setPitchScale(scale);
+        shifter->shift(inputPtrs, outputPtrs);
+    }
+    std::fill(outputBlock.begin(), outputBlock.end(), 0.0f);
+
+    latency.store(blockSize + shifter->getStartDelay(), std::memory_order_relaxed);
 }
 
 PitchProcessor::~PitchProcessor() = default;
 
-void PitchProcessor::setPitchShift(float semitones) {
-    // Chuyển đổi semitones thành tỷ lệ pitch
-    pitchScale = std::pow(2.0, semitones / 12.0);
-    
-    // Giới hạn phạm vi thay đổi pitch
-    pitchScale = std::max(0.5, std::min(2.0, pitchScale));
-    
-    // Cập nhật thông số cho Rubber Band
-    stretcher->setPitchScale(pitchScale);
-    stretcher->setTimeRatio(timeRatio);
-    
-    std::cout << "Setting pitch scale to: " << pitchScale << " (semitones: " << semitones << ")" << std::endl;
+void PitchProcessor::setPitchShift(float value) {
+    semitones.store(std::clamp(value, -12.0f, 12.0f), std::memory_order_relaxed);
 }
 
-std::vector<float> PitchProcessor::process(const float* input, size_t numSamples) {
-    if (numSamples == 0) {
-        return std::vector<float>();
+void PitchProcessor::applyPitchScale() {
+    const float target = semitones.load(std::memory_order_relaxed);
+    if (target == appliedSemitones) {
+        return;
     }
+    appliedSemitones = target;
+    shifter->setPitchScale(semitonesToScale(target));
+    // Start delay của shifter phụ thuộc tỷ lệ pitch
+    latency.store(blockSize + shifter->getStartDelay(), std::memory_order_relaxed);
+}
+
+void PitchProcessor::reset() {
+    // shifter->reset() cấp phát nên không dùng trên audio thread: shifter chạy tiếp, output được
+    // tắt tiếng tới khi phần tín hiệu cũ còn trong shifter ra hết rồi mở dần
+    std::fill(inputBlock.begin(), inputBlock.end(), 0.0f);
+    std::fill(outputBlock.begin(), outputBlock.end(), 0.0f);
+    fill = 0;
+    muteRemaining = getLatency() + blockSize;
+    fadeGain = 0.0f;
+}
 
-    // Chuẩn bị buffer đầu vào
-    inputBuffer.assign(input, input + numSamples);
-    
-    // Tạo mảng con trỏ cho Rubber Band
-    const float* inputPtrs[1] = { inputBuffer.data() };
-    
-    // Xử lý âm thanh
-    stretcher->process(inputPtrs, numSamples, false);
-    
-    // Lấy kết quả đã xử lý
-    outputBuffer.clear();
-    outputBuffer.reserve(numSamples);
-    
-    // Lấy các mẫu đã xử lý
-    size_t available = stretcher->available();
-    if (available > 0) {
-        outputBuffer.resize(available);
-        float* outputPtrs[1] = { outputBuffer.data() };
-        stretcher->retrieve(outputPtrs, available);
+void PitchProcessor::applyFadeIn(float* samples, size_t numSamples) {
+    const float step = 1.0f / FADE_IN_FRAMES;
+    for (size_t i = 0; i < numSamples; i++) {
+        if (muteRemaining > 0) {
+            muteRemaining--;
+            samples[i] = 0.0f;
+        } else {
+            fadeGain = std::min(fadeGain + step, 1.0f);
+            samples[i] *= fadeGain;
+        }
     }
-    
-    // Nếu không có mẫu nào được xử lý, trả về dữ liệu gốc
-    if (outputBuffer.empty()) {
-        outputBuffer.assign(input, input + numSamples);
+}
+
+void PitchProcessor::process(const float* input, float* output, size_t numSamples) {
+    size_t done = 0;
+    while (done < numSamples) {
+        const size_t count = std::min(numSamples - done, blockSize - fill);
+        // Chép mẫu vào trước khi ghi mẫu ra: input và output có thể là cùng một buffer
+        std::copy(input + done, input + done + count, inputBlock.begin() + fill);
+        std::copy(outputBlock.begin() + fill, outputBlock.begin() + fill + count, output + done);
+        if (fadeGain < 1.0f) {
+            applyFadeIn(output + done, count);
+        }
+        fill += count;
+        done += count;
+
+        if (fill == blockSize) {
+            applyPitchScale();
+            const float* inputPtrs[1] = { inputBlock.data() };
+            float* outputPtrs[1] = { outputBlock.data() };
+            shifter->shift(inputPtrs, outputPtrs);
+            fill = 0;
+        }
     }
-    
-    return outputBuffer;
-} 
\ No newline at end of file
+}
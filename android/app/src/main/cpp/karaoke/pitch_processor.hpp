@@ -1,24 +1,58 @@
 #pragma once
 
-#include <vector>
+#include <atomic>
+#include <cstddef>
 #include <memory>
-#include <rubberband/RubberBandStretcher.h>
+#include <vector>
 
+namespace RubberBand {
+class RubberBandLiveShifter;
+}
+
+/*
+    PitchProcessor: dịch pitch giọng hát theo từng block, trễ cố định (RubberBandLiveShifter, R3).
+    - Shifter chỉ nhận block đúng getBlockSize() frame: mẫu vào được gom vào một block đệm,
+      đủ block thì dịch, mẫu ra lấy từ block đã dịch trước đó. Mỗi lần process() trả về đúng
+      số mẫu đã đưa vào, với trễ cố định getLatency().
+    - setPitchShift() đặt được từ thread bất kỳ, áp dụng trước block kế tiếp trên audio thread.
+    - Formant được giữ nguyên khi dịch để giọng không bị méo kiểu "chipmunk".
+    Cấp phát trong constructor, process() không cấp phát, không khóa.
+*/
 class PitchProcessor {
 public:
-    PitchProcessor();
+    explicit PitchProcessor(int sampleRate = 48000);
     ~PitchProcessor();
 
-    // Process audio data and return processed samples
-    std::vector<float> process(const float* input, size_t numSamples);
+    PitchProcessor(const PitchProcessor&) = delete;
+    PitchProcessor& operator=(const PitchProcessor&) = delete;
+
+    // Audio thread: ghi đúng numSamples mẫu vào output (được trùng với input)
+    void process(const float* input, float* output, size_t numSamples);
+    void process(float* inout, size_t numSamples) { process(inout, inout, numSamples); }
+    // Bỏ tín hiệu cũ, bắt đầu lại từ im lặng (cùng thread với process, không cấp phát)
+    void reset();
 
-    // Set pitch shift in semitones
+    // Trễ từ mẫu vào tới mẫu ra tương ứng (frame): block đệm + start delay của shifter
+    size_t getLatency() const { return latency.load(std::memory_order_relaxed); }
+    size_t getBlockSize() const { return blockSize; }
+
+    // Set pitch shift in semitones (-12..12)
     void setPitchShift(float semitones);
+    float getPitchShift() const { return semitones.load(std::memory_order_relaxed); }
 
 private:
-    std::unique_ptr<RubberBand::RubberBandStretcher> stretcher;
-    std::vector<float> inputBuffer;
-    std::vector<float> outputBuffer;
-    double timeRatio;
-    double pitchScale;
-}; 
\ No newline at end of file
+    void applyPitchScale();
+    void applyFadeIn(float* samples, size_t numSamples);
+
+    std::unique_ptr<RubberBand::RubberBandLiveShifter> shifter;
+    size_t blockSize;
+    std::vector<float> inputBlock;  // Mẫu vào đang gom
+    std::vector<float> outputBlock; // Block đã dịch, đang trả ra
+    size_t fill = 0;                // Số mẫu đã gom (cũng là vị trí đọc trong outputBlock)
+
+    std::atomic<float> semitones{0.0f};
+    float appliedSemitones = 0.0f; // Chỉ audio thread
+    size_t muteRemaining = 0;      // Sau reset(): số mẫu còn phải tắt tiếng
+    float fadeGain = 1.0f;
+    std::atomic<size_t> latency{0};
+};
@@ -0,0 +1,364 @@
+#include "recording_writer.hpp"
+#include "audio_player/audioplayer/common.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <ogg/ogg.h>
+
+#if defined(__ANDROID__) || defined(AUDIO_OPUS_FLAT_INCLUDE)
+    #include <opus.h>
+#else
+    #include <opus/opus.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr uint16_t WAVE_FORMAT_PCM = 1;
+constexpr uint32_t BYTES_PER_SAMPLE = sizeof(int16_t);
+constexpr uint32_t DS64_BYTES = 28; // riff size, data size, số frame (64-bit mỗi trường), số bảng
+// RIFF (12) + JUNK/ds64 (8 + 28) + fmt (8 + 16) + header chunk data (8)
+constexpr uint32_t WAV_HEADER_BYTES = 12 + 8 + DS64_BYTES + 8 + 16 + 8;
+constexpr int HEADER_UPDATE_SECONDS = 5;
+
+constexpr int OPUS_BITRATE = 64000;
+constexpr int OPUS_MAX_PACKET_BYTES = 4000;
+constexpr int OPUS_GRANULE_RATE = 48000; // Granule position của Ogg Opus luôn theo 48 kHz
+
+void putLE(uint8_t*& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *out++ = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void putTag(uint8_t*& out, const char* tag) {
+    for (int i = 0; i < 4; i++) {
+        *out++ = static_cast<uint8_t>(tag[i]);
+    }
+}
+
+bool isOpusRate(int rate) {
+    return rate == 8000 || rate == 12000 || rate == 16000 || rate == 24000 || rate == 48000;
+}
+
+} // namespace
+
+struct RecordingWriter::OpusStream {
+    OpusEncoder* encoder = nullptr;
+    ogg_stream_state stream;
+    vector<float> frame;  // 20 ms đang gom
+    size_t fill = 0;
+    vector<unsigned char> packet;
+    int preSkip = 0;      // Theo 48 kHz
+    int lookahead = 0;    // Theo sampleRate
+    int64_t packetNo = 0;
+    int64_t inputFrames = 0;   // Số mẫu thật đã nhận (theo sampleRate)
+    int64_t encodedFrames = 0; // Số frame (theo sampleRate) đã đưa vào encoder, gồm cả phần bù im lặng
+
+    ~OpusStream() {
+        if (encoder) {
+            opus_encoder_destroy(encoder);
+            ogg_stream_clear(&stream);
+        }
+    }
+};
+
+RecordingWriter::RecordingWriter() = default;
+
+RecordingWriter::~RecordingWriter() {
+    stop();
+}
+
+bool RecordingWriter::start(const string& path, Format newFormat, int rate) {
+    stop();
+
+    if (newFormat == Format::Opus && !isOpusRate(rate)) {
+        debugPrint("RecordingWriter: Opus does not support {} Hz", rate);
+        return false;
+    }
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        debugPrint("RecordingWriter: cannot open {}", path);
+        return false;
+    }
+
+    format = newFormat;
+    sampleRate = rate;
+    failed = false;
+    headerFrames = 0;
+    framesWritten.store(0, memory_order_relaxed);
+    droppedFrames.store(0, memory_order_relaxed);
+
+    // Ring chỉ cấp phát lại khi sample rate cần ring lớn hơn
+    const size_t ringFrames = static_cast<size_t>(rate) * RING_SECONDS;
+    if (ringFrames > ringCapacity) {
+        ring = make_unique<RingBuffer>(ringFrames);
+        ringCapacity = ringFrames;
+    }
+    ring->clear();
+    chunk.resize(CHUNK_FRAMES);
+    pcm.resize(CHUNK_FRAMES);
+
+    if (format == Format::Wav) {
+        writeWavHeader();
+    } else if (!openOpus()) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    running.store(true, memory_order_release);
+    writerThread = thread(&RecordingWriter::writerLoop, this);
+    accepting.store(true, memory_order_release);
+    return true;
+}
+
+bool RecordingWriter::stop() {
+    if (!file) {
+        return false;
+    }
+
+    // Không còn push() nào đang ghi vào ring thì thread ghi lấy được hết mẫu.
+    // Store accepting / load pushing ở đây và fetch_add pushing / load accepting trong push() là
+    // kiểu Dekker: cần seq_cst để hai phía không cùng đọc giá trị cũ của nhau
+    accepting.store(false, memory_order_seq_cst);
+    while (pushing.load(memory_order_seq_cst) > 0) {
+        this_thread::yield();
+    }
+    running.store(false, memory_order_release);
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
+
+    if (format == Format::Wav) {
+        writeWavHeader();
+    } else {
+        finishOpus();
+        opus.reset();
+    }
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
+
+size_t RecordingWriter::push(const float* samples, size_t frames) {
+    pushing.fetch_add(1, memory_order_seq_cst);
+    size_t dropped = 0;
+    if (accepting.load(memory_order_seq_cst)) {
+        dropped = frames - ring->write(samples, frames);
+        if (dropped > 0) {
+            droppedFrames.fetch_add(dropped, memory_order_relaxed);
+        }
+    }
+    pushing.fetch_sub(1, memory_order_acq_rel);
+    return dropped;
+}
+
+void RecordingWriter::writerLoop() {
+    while (true) {
+        // Đọc cờ trước khi lấy dữ liệu: lượt cuối thấy mọi mẫu đã push() trước stop()
+        const bool finishing = !running.load(memory_order_acquire);
+        drain();
+        if (finishing) {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(DRAIN_MILLIS));
+    }
+}
+
+void RecordingWriter::drain() {
+    size_t read;
+    while ((read = ring->read(chunk.data(), chunk.size())) > 0) {
+        if (format == Format::Wav) {
+            writeWav(chunk.data(), read);
+        } else {
+            writeOpus(chunk.data(), read);
+        }
+        const uint64_t total = framesWritten.fetch_add(read, memory_order_relaxed) + read;
+        if (format == Format::Wav && total - headerFrames >= static_cast<uint64_t>(sampleRate) * HEADER_UPDATE_SECONDS) {
+            headerFrames = total;
+            writeWavHeader();
+            fflush(file);
+        }
+    }
+}
+
+void RecordingWriter::writeWav(const float* samples, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        const float sample = clamp(samples[i], -1.0f, 1.0f);
+        pcm[i] = static_cast<int16_t>(sample * 32767.0f);
+    }
+    writeBytes(pcm.data(), frames * BYTES_PER_SAMPLE);
+}
+
+void RecordingWriter::writeWavHeader() {
+    // Gọi từ thread ghi, hoặc từ start()/stop() khi thread không chạy
+    const uint64_t frames = framesWritten.load(memory_order_relaxed);
+    const uint64_t dataBytes = frames * BYTES_PER_SAMPLE;
+    const uint64_t riffBytes = WAV_HEADER_BYTES - 8 + dataBytes;
+    const bool rf64 = riffBytes > numeric_limits<uint32_t>::max();
+
+    uint8_t header[WAV_HEADER_BYTES];
+    uint8_t* out = header;
+    putTag(out, rf64 ? "RF64" : "RIFF");
+    putLE(out, rf64 ? numeric_limits<uint32_t>::max() : riffBytes, 4);
+    putTag(out, "WAVE");
+
+    // RF64: kích thước thật nằm trong ds64, RIFF thường: chunk JUNK cùng kích thước được bỏ qua
+    putTag(out, rf64 ? "ds64" : "JUNK");
+    putLE(out, DS64_BYTES, 4);
+    putLE(out, rf64 ? riffBytes : 0, 8);
+    putLE(out, rf64 ? dataBytes : 0, 8);
+    putLE(out, rf64 ? frames : 0, 8);
+    putLE(out, 0, 4); // Không có bảng kích thước chunk khác
+
+    putTag(out, "fmt ");
+    putLE(out, 16, 4);
+    putLE(out, WAVE_FORMAT_PCM, 2);
+    putLE(out, 1, 2); // Mono
+    putLE(out, static_cast<uint32_t>(sampleRate), 4);
+    putLE(out, static_cast<uint32_t>(sampleRate) * BYTES_PER_SAMPLE, 4); // Byte mỗi giây
+    putLE(out, BYTES_PER_SAMPLE, 2);                                     // Block align
+    putLE(out, 16, 2);                                                   // Bit mỗi mẫu
+
+    putTag(out, "data");
+    putLE(out, rf64 ? numeric_limits<uint32_t>::max() : dataBytes, 4);
+
+    fseek(file, 0, SEEK_SET);
+    writeBytes(header, sizeof(header));
+    fseek(file, 0, SEEK_END);
+}
+
+bool RecordingWriter::openOpus() {
+    auto stream = make_unique<OpusStream>();
+    int error = OPUS_OK;
+    OpusEncoder* encoder = opus_encoder_create(sampleRate, 1, OPUS_APPLICATION_AUDIO, &error);
+    if (error != OPUS_OK || !encoder) {
+        debugPrint("RecordingWriter: opus_encoder_create failed: {}", opus_strerror(error));
+        return false;
+    }
+    if (ogg_stream_init(&stream->stream, rand()) != 0) {
+        opus_encoder_destroy(encoder);
+        return false;
+    }
+    stream->encoder = encoder;
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(OPUS_BITRATE));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
+
+    opus_encoder_ctl(encoder, OPUS_GET_LOOKAHEAD(&stream->lookahead));
+    stream->preSkip = stream->lookahead * (OPUS_GRANULE_RATE / sampleRate);
+    stream->frame.assign(sampleRate / 50, 0.0f); // 20 ms
+    stream->packet.resize(OPUS_MAX_PACKET_BYTES);
+    opus = std::move(stream);
+
+    // OpusHead và OpusTags, mỗi gói một page riêng
+    uint8_t head[19];
+    uint8_t* out = head;
+    memcpy(out, "OpusHead", 8);
+    out += 8;
+    putLE(out, 1, 1); // Version
+    putLE(out, 1, 1); // Mono
+    putLE(out, static_cast<uint32_t>(opus->preSkip), 2);
+    putLE(out, static_cast<uint32_t>(sampleRate), 4);
+    putLE(out, 0, 2); // Output gain
+    putLE(out, 0, 1); // Channel mapping 0
+
+    const char vendor[] = "karaoke recorder";
+    const uint32_t vendorLength = sizeof(vendor) - 1;
+    uint8_t tags[8 + 4 + sizeof(vendor) - 1 + 4];
+    out = tags;
+    memcpy(out, "OpusTags", 8);
+    out += 8;
+    putLE(out, vendorLength, 4);
+    memcpy(out, vendor, vendorLength);
+    out += vendorLength;
+    putLE(out, 0, 4); // Không có comment
+
+    ogg_packet packet{};
+    packet.packet = head;
+    packet.bytes = sizeof(head);
+    packet.b_o_s = 1;
+    packet.packetno = opus->packetNo++;
+    ogg_stream_packetin(&opus->stream, &packet);
+    writeOggPages(true);
+
+    packet.packet = tags;
+    packet.bytes = sizeof(tags);
+    packet.b_o_s = 0;
+    packet.packetno = opus->packetNo++;
+    ogg_stream_packetin(&opus->stream, &packet);
+    writeOggPages(true);
+    return !failed;
+}
+
+void RecordingWriter::writeOpus(const float* samples, size_t frames) {
+    size_t done = 0;
+    while (done < frames) {
+        const size_t count = min(frames - done, opus->frame.size() - opus->fill);
+        copy(samples + done, samples + done + count, opus->frame.begin() + opus->fill);
+        opus->fill += count;
+        opus->inputFrames += static_cast<int64_t>(count);
+        done += count;
+        if (opus->fill == opus->frame.size()) {
+            encodeOpusFrame(false);
+        }
+    }
+    writeOggPages(false);
+}
+
+void RecordingWriter::finishOpus() {
+    // Encoder trễ lookahead mẫu: bù im lặng tới khi mẫu thật cuối cùng đã ra khỏi encoder, nếu không
+    // ~6.5 ms cuối bị mất và granule cuối vượt quá số mẫu giải mã được (RFC 7845, end trimming).
+    // Chỉ gói cuối mang end-of-stream, granule của nó đánh dấu mẫu thật cuối cùng.
+    const int64_t frameSize = static_cast<int64_t>(opus->frame.size());
+    bool last = false;
+    while (!last) {
+        fill_n(opus->frame.begin() + opus->fill, opus->frame.size() - opus->fill, 0.0f);
+        last = opus->encodedFrames + frameSize >= opus->inputFrames + opus->lookahead;
+        encodeOpusFrame(last);
+    }
+    writeOggPages(true);
+}
+
+void RecordingWriter::encodeOpusFrame(bool last) {
+    const int frameSize = static_cast<int>(opus->frame.size());
+    const int bytes = opus_encode_float(opus->encoder, opus->frame.data(), frameSize,
+                                        opus->packet.data(), static_cast<opus_int32>(opus->packet.size()));
+    opus->encodedFrames += frameSize;
+    opus->fill = 0;
+    if (bytes < 0) {
+        failed = true;
+        return;
+    }
+
+    ogg_packet packet{};
+    packet.packet = opus->packet.data();
+    packet.bytes = bytes;
+    packet.e_o_s = last ? 1 : 0;
+    // Granule: số mẫu (48 kHz, gồm cả pre-skip) giải mã được tới hết gói này
+    const int64_t granuleFrames = last ? opus->inputFrames + opus->lookahead : opus->encodedFrames;
+    packet.granulepos = granuleFrames * (OPUS_GRANULE_RATE / sampleRate);
+    packet.packetno = opus->packetNo++;
+    if (ogg_stream_packetin(&opus->stream, &packet) != 0) {
+        failed = true;
+    }
+}
+
+void RecordingWriter::writeOggPages(bool flush) {
+    ogg_page page;
+    while (flush ? ogg_stream_flush(&opus->stream, &page) : ogg_stream_pageout(&opus->stream, &page)) {
+        writeBytes(page.header, page.header_len);
+        writeBytes(page.body, page.body_len);
+    }
+}
+
+void RecordingWriter::writeBytes(const void* data, size_t bytes) {
+    if (fwrite(data, 1, bytes, file) != bytes) {
+        failed = true;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "audio_player/audioplayer/ring_buffer.hpp"
+
+/*
+    RecordingWriter: ghi giọng hát (mono) xuống file ngay trong lúc hát, không giới hạn độ dài,
+    bộ nhớ cố định.
+    - Audio thread chỉ push() vào một RingBuffer một producer / một consumer (RING_SECONDS giây),
+      không cấp phát, không khóa, không I/O.
+    - Thread ghi lấy dữ liệu ra mỗi DRAIN_MILLIS ms và ghi tiếp vào file:
+      WAV PCM 16-bit (header tự chuyển sang RF64 khi dữ liệu vượt giới hạn 4 GB của RIFF,
+      chỗ cho chunk ds64 được giữ sẵn bằng chunk JUNK) hoặc Ogg Opus.
+    - Header WAV được cập nhật định kỳ nên app bị dừng đột ngột vẫn còn file đọc được.
+    - I/O chậm quá RING_SECONDS giây thì mẫu mới bị bỏ và được đếm (getDroppedFrames()).
+    start()/stop() gọi trên thread app.
+*/
+class RecordingWriter {
+public:
+    enum class Format : int32_t {
+        Wav,  // PCM 16-bit, RF64 khi dài hơn giới hạn của RIFF
+        Opus  // Ogg Opus, sample rate phải là 8/12/16/24/48 kHz
+    };
+
+    RecordingWriter();
+    ~RecordingWriter();
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    // Mở (ghi đè) file và bắt đầu thread ghi. false nếu không mở được file hoặc định dạng
+    // không hỗ trợ sample rate này.
+    bool start(const std::string& path, Format format, int sampleRate);
+    // Ngừng nhận mẫu, ghi nốt phần còn trong ring, hoàn tất header rồi đóng file.
+    // false nếu có lỗi ghi trong cả take.
+    bool stop();
+
+    // Audio thread: trả về số mẫu bị bỏ vì ring đầy (0 khi không ghi)
+    size_t push(const float* samples, size_t frames);
+
+    bool isActive() const { return accepting.load(std::memory_order_acquire); }
+    uint64_t getFramesWritten() const { return framesWritten.load(std::memory_order_relaxed); }
+    uint64_t getDroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int RING_SECONDS = 2;
+    static constexpr int DRAIN_MILLIS = 20;
+    static constexpr size_t CHUNK_FRAMES = 4096; // Số mẫu thread ghi lấy ra mỗi lượt
+
+    struct OpusStream;
+
+    void writerLoop();
+    void drain();
+    void writeWav(const float* samples, size_t frames);
+    void writeWavHeader();
+    bool openOpus();
+    void writeOpus(const float* samples, size_t frames);
+    void finishOpus();
+    void encodeOpusFrame(bool last);
+    void writeOggPages(bool flush);
+    void writeBytes(const void* data, size_t bytes);
+
+    std::unique_ptr<RingBuffer> ring;
+    size_t ringCapacity = 0;
+    std::thread writerThread;
+    std::atomic<bool> accepting{false}; // Audio thread được push()
+    std::atomic<int> pushing{0};        // Số lần push() đang chạy
+    std::atomic<bool> running{false};   // Thread ghi còn chạy (false: ghi nốt rồi thoát)
+
+    FILE* file = nullptr;
+    Format format = Format::Wav;
+    int sampleRate = 48000;
+    bool failed = false; // Có lần ghi lỗi, chỉ thread ghi (hoặc start/stop khi thread không chạy)
+    std::vector<float> chunk;
+    std::vector<int16_t> pcm;
+    uint64_t headerFrames = 0; // Số frame lúc cập nhật header WAV định kỳ lần cuối
+    std::unique_ptr<OpusStream> opus;
+
+    std::atomic<uint64_t> framesWritten{0};
+    std::atomic<uint64_t> droppedFrames{0};
+};
@@ -1,218 +1,358 @@
 #include "reverb_processor.hpp"
-#include <cmath>
 #include <algorithm>
-#include <iostream>
-
-ReverbProcessor::ReverbProcessor() {
-    // Default parameters
-    roomSize = 0.5f;
-    damping = 0.5f;
-    wetMix = 0.33f;
-    dryMix = 0.7f;
-    enabled = true;
-    
-    // Initialize delay lines
-    initializeDelayLines();
-}
-
-ReverbProcessor::~ReverbProcessor() {
-    // Clean up
-}
-
-void ReverbProcessor::initializeDelayLines() {
-    // Sử dụng nhiều delay line hơn với các khoảng thời gian khác nhau
-    // để tạo ra âm thanh phản xạ tự nhiên hơn
-    delayLines.resize(NUM_DELAY_LINES);
-    
-    // Các giá trị delay dựa trên các phản xạ trong một căn phòng thực tế
-    // Độ trễ dài hơn cho phòng lớn hơn và nghe tự nhiên hơn
-    const float delays[NUM_DELAY_LINES] = {
-        0.0437f,  // ~21ms
-        0.0581f,  // ~28ms
-        0.0671f,  // ~32ms
-        0.0829f,  // ~40ms
-        0.0991f,  // ~48ms
-        0.1139f   // ~55ms
-    };
-    
-    // Giảm feedback và gain để tránh tiếng rè
-    const float feedbacks[NUM_DELAY_LINES] = {
-        0.30f, 0.28f, 0.26f, 0.24f, 0.22f, 0.20f
-    };
-    
-    const float gains[NUM_DELAY_LINES] = {
-        0.60f, 0.55f, 0.50f, 0.45f, 0.40f, 0.35f
-    };
-    
-    // Tạo các delay line với thời gian delay khác nhau
-    for (int i = 0; i < NUM_DELAY_LINES; ++i) {
-        auto& line = delayLines[i];
-        size_t delaySamples = static_cast<size_t>(delays[i] * 48000); // 48kHz sample rate
-        
-        // Đảm bảo buffer đủ lớn
-        line.buffer.resize(delaySamples, 0.0f);
-        line.writeIndex = 0;
-        line.feedback = feedbacks[i];
-        line.gain = gains[i];
-        line.lastSample = 0.0f; // Khởi tạo mẫu cuối cùng
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define REVERB_USE_NEON 1
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define REVERB_USE_SSE2 1
+#endif
+
+namespace {
+
+// Thông số gốc của Freeverb (tính ở 44100 Hz)
+constexpr float TUNING_SAMPLE_RATE = 44100.0f;
+constexpr uint32_t COMB_TUNING[8] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+constexpr uint32_t ALLPASS_TUNING[4] = {556, 441, 341, 225};
+constexpr float FIXED_GAIN = 0.015f;
+constexpr float SCALE_WET = 3.0f;
+constexpr float SCALE_DAMP = 0.4f;
+constexpr float SCALE_ROOM = 0.28f;
+constexpr float OFFSET_ROOM = 0.7f;
+constexpr float ALLPASS_FEEDBACK = 0.5f;
+constexpr float SMOOTHING_MILLIS = 20.0f;
+constexpr float SETTLED_DELTA = 1e-5f;
+// Giữ trạng thái comb không rơi xuống số denormal khi đầu vào im lặng (chậm trên nhiều CPU)
+constexpr float ANTI_DENORMAL = 1e-18f;
+
+uint32_t nextPowerOfTwo(uint32_t value) {
+    uint32_t size = 1;
+    while (size < value) {
+        size <<= 1;
     }
-    
-    // Khởi tạo buffer cho low-pass filter
-    filterBuffer.resize(2, 0.0f);
+    return size;
 }
 
-void ReverbProcessor::setRoomSize(float size) {
-    roomSize = std::clamp(size, 0.0f, 1.0f);
-    
-    // Điều chỉnh feedback dựa trên kích thước phòng 
-    // Phòng lớn hơn = echo lâu tàn hơn
-    for (int i = 0; i < NUM_DELAY_LINES; ++i) {
-        // Tăng feedback cho phòng lớn
-        delayLines[i].feedback = 0.30f + (0.5f * roomSize);
+// Vector 4 lane tối thiểu cho comb/allpass bank
+#if defined(REVERB_USE_NEON)
+
+using Vec = float32x4_t;
+inline Vec load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, Vec v) { vst1q_f32(p, v); }
+inline Vec broadcast(float x) { return vdupq_n_f32(x); }
+inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+inline Vec mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+// [x, v0, v1, v2]
+inline Vec shiftIn(Vec v, float x) { return vextq_f32(vdupq_n_f32(x), v, 3); }
+inline float lane3(Vec v) { return vgetq_lane_f32(v, 3); }
+inline float sum(Vec v) {
+    const float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+constexpr const char* SIMD_NAME = "neon";
+
+#elif defined(REVERB_USE_SSE2)
+
+using Vec = __m128;
+inline Vec load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec broadcast(float x) { return _mm_set1_ps(x); }
+inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec shiftIn(Vec v, float x) {
+    const Vec shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+    return _mm_move_ss(shifted, _mm_set_ss(x));
+}
+inline float lane3(Vec v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+inline float sum(Vec v) {
+    const Vec high = _mm_movehl_ps(v, v);
+    const Vec pair = _mm_add_ps(v, high);
+    return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+constexpr const char* SIMD_NAME = "sse2";
+
+#else
+
+struct Vec {
+    float lane[4];
+};
+inline Vec load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, Vec v) { std::copy(v.lane, v.lane + 4, p); }
+inline Vec broadcast(float x) { return {{x, x, x, x}}; }
+inline Vec add(Vec a, Vec b) { return {{a.lane[0] + b.lane[0], a.lane[1] + b.lane[1], a.lane[2] + b.lane[2], a.lane[3] + b.lane[3]}}; }
+inline Vec sub(Vec a, Vec b) { return {{a.lane[0] - b.lane[0], a.lane[1] - b.lane[1], a.lane[2] - b.lane[2], a.lane[3] - b.lane[3]}}; }
+inline Vec mul(Vec a, Vec b) { return {{a.lane[0] * b.lane[0], a.lane[1] * b.lane[1], a.lane[2] * b.lane[2], a.lane[3] * b.lane[3]}}; }
+inline Vec shiftIn(Vec v, float x) { return {{x, v.lane[0], v.lane[1], v.lane[2]}}; }
+inline float lane3(Vec v) { return v.lane[3]; }
+inline float sum(Vec v) { return (v.lane[0] + v.lane[1]) + (v.lane[2] + v.lane[3]); }
+constexpr const char* SIMD_NAME = "scalar";
+
+#endif
+
+} // namespace
+
+ReverbProcessor::ReverbProcessor(int sampleRate)
+    : sampleRate(std::max(sampleRate, 1)),
+      roomSize(0.5f),
+      damping(0.5f),
+      wetMix(0.33f),
+      dryMix(0.7f),
+      enabled(true) {
+    // Delay theo Freeverb quy đổi sang sample rate hiện tại, buffer lớn hơn delay dài nhất
+    const float scale = this->sampleRate / TUNING_SAMPLE_RATE;
+    uint32_t longestComb = 1;
+    for (int i = 0; i < NUM_COMBS; ++i) {
+        combDelay[i] = std::max<uint32_t>(static_cast<uint32_t>(COMB_TUNING[i] * scale), 1);
+        longestComb = std::max(longestComb, combDelay[i]);
+    }
+    uint32_t longestAllpass = 1;
+    for (int i = 0; i < NUM_ALLPASSES; ++i) {
+        allpassDelay[i] = std::max<uint32_t>(static_cast<uint32_t>(ALLPASS_TUNING[i] * scale), 1);
+        longestAllpass = std::max(longestAllpass, allpassDelay[i]);
     }
+    const uint32_t combSize = nextPowerOfTwo(longestComb + 1);
+    const uint32_t allpassSize = nextPowerOfTwo(longestAllpass + 1);
+    combMask = combSize - 1;
+    allpassMask = allpassSize - 1;
+    combBuffer = std::make_unique<float[]>(static_cast<size_t>(combSize) * NUM_COMBS);
+    allpassBuffer = std::make_unique<float[]>(static_cast<size_t>(allpassSize) * NUM_ALLPASSES);
+
+    smoothing = 1.0f - std::exp(-1000.0f / (SMOOTHING_MILLIS * this->sampleRate));
+    feedback = roomSize.load() * SCALE_ROOM + OFFSET_ROOM;
+    damp = damping.load() * SCALE_DAMP;
+    wet = wetMix.load() * SCALE_WET;
+    dry = dryMix.load();
+    reset();
+}
+
+ReverbProcessor::~ReverbProcessor() = default;
+
+void ReverbProcessor::reset() {
+    std::fill(combBuffer.get(), combBuffer.get() + (combMask + 1) * NUM_COMBS, 0.0f);
+    std::fill(allpassBuffer.get(), allpassBuffer.get() + (allpassMask + 1) * NUM_ALLPASSES, 0.0f);
+    std::fill(combFilter, combFilter + NUM_COMBS, 0.0f);
+    std::fill(allpassOutput, allpassOutput + NUM_ALLPASSES, 0.0f);
+    position = 0;
+}
+
+void ReverbProcessor::setRoomSize(float size) {
+    roomSize.store(std::clamp(size, 0.0f, 1.0f), std::memory_order_relaxed);
 }
 
 void ReverbProcessor::setDamping(float value) {
-    damping = std::clamp(value, 0.0f, 1.0f);
-    // Damping cao hơn = lọc low-pass nhiều hơn, âm thanh mềm hơn
+    damping.store(std::clamp(value, 0.0f, 1.0f), std::memory_order_relaxed);
 }
 
-void ReverbProcessor::setWetMix(float wet) {
-    wetMix = std::clamp(wet, 0.0f, 1.0f);
+void ReverbProcessor::setWetMix(float value) {
+    wetMix.store(std::clamp(value, 0.0f, 1.0f), std::memory_order_relaxed);
 }
 
-void ReverbProcessor::setDryMix(float dry) {
-    dryMix = std::clamp(dry, 0.0f, 1.0f);
+void ReverbProcessor::setDryMix(float value) {
+    dryMix.store(std::clamp(value, 0.0f, 1.0f), std::memory_order_relaxed);
 }
 
 void ReverbProcessor::setEnabled(bool enable) {
-    enabled = enable;
-    
-    // Reset các delay line khi bật lại
+    // Bật lại thì xóa đuôi cũ: process() có thể đang chạy nên chỉ báo, audio thread xóa ở block kế tiếp
     if (enable) {
-        for (auto& line : delayLines) {
-            std::fill(line.buffer.begin(), line.buffer.end(), 0.0f);
-            line.writeIndex = 0;
-            line.lastSample = 0.0f;
-        }
-        
-        std::fill(filterBuffer.begin(), filterBuffer.end(), 0.0f);
+        resetPending.store(true, std::memory_order_release);
     }
+    enabled.store(enable, std::memory_order_release);
 }
 
-float ReverbProcessor::lowPassFilter(float input, float coeff, int channel) {
-    // Áp dụng low-pass filter với hệ số cao hơn để lọc mạnh hơn
-    float output = input * (1.0f - coeff) + filterBuffer[channel] * coeff;
-    filterBuffer[channel] = output;
-    return output;
-}
-
-void ReverbProcessor::processDelayLine(DelayLine& line, const float* input, float* output, size_t numSamples) {
-    const size_t bufferSize = line.buffer.size();
-    const float dampCoeff = damping * 0.5f; // Hệ số damping
-    
-    for (size_t i = 0; i < numSamples; ++i) {
-        // Tính toán vị trí đọc với wrap-around
-        size_t readIndex = (line.writeIndex + bufferSize - 1) % bufferSize;
-        
-        // Lấy mẫu delay
-        float delayedSample = line.buffer[readIndex];
-        
-        // Áp dụng low-pass filter (damping)
-        delayedSample = lowPassFilter(delayedSample, dampCoeff, 0);
-        
-        // Áp dụng feedback và gain
-        float feedbackSample = delayedSample * line.feedback;
-        
-        // Kết hợp đầu vào với feedback
-        float processedSample = input[i] + feedbackSample;
-        
-        // Hạn chế để tránh quá tải
-        processedSample = std::clamp(processedSample, -1.0f, 1.0f);
-        
-        // Áp dụng gain
-        processedSample *= line.gain;
-        
-        // Lưu vào delay buffer
-        line.buffer[line.writeIndex] = processedSample;
-        
-        // Kết hợp đầu vào với đầu ra
-        output[i] = input[i] * dryMix + delayedSample * wetMix;
-        
-        // Cập nhật vị trí ghi với wrap-around
-        line.writeIndex = (line.writeIndex + 1) % bufferSize;
+void ReverbProcessor::process(float* inout, size_t numSamples) {
+    if (!enabled.load(std::memory_order_acquire) || numSamples == 0) {
+        // Reverb tắt: giữ nguyên đầu vào
+        return;
     }
-}
+    if (resetPending.exchange(false, std::memory_order_acquire)) {
+        reset();
+    }
+
+    const float targetFeedback = roomSize.load(std::memory_order_relaxed) * SCALE_ROOM + OFFSET_ROOM;
+    const float targetDamp = damping.load(std::memory_order_relaxed) * SCALE_DAMP;
+    const float targetWet = wetMix.load(std::memory_order_relaxed) * SCALE_WET;
+    const float targetDry = dryMix.load(std::memory_order_relaxed);
+
+    float* const combs = combBuffer.get();
+    float* const allpasses = allpassBuffer.get();
+    Vec filterLow = load(combFilter);
+    Vec filterHigh = load(combFilter + 4);
+    Vec allpassOut = load(allpassOutput);
+    const Vec allpassFeedback = broadcast(ALLPASS_FEEDBACK);
+    alignas(16) float written[NUM_COMBS];
+    uint32_t pos = position;
 
-std::vector<float> ReverbProcessor::process(const float* input, size_t numSamples) {
-    if (!enabled || numSamples == 0) {
-        // Nếu reverb bị tắt, trả về bản sao của đầu vào
-        return std::vector<float>(input, input + numSamples);
+    // Tham số đã tới đích thì bỏ qua bước làm mượt trên từng mẫu
+    const bool settled = std::fabs(targetFeedback - feedback) < SETTLED_DELTA && std::fabs(targetDamp - damp) < SETTLED_DELTA &&
+                         std::fabs(targetWet - wet) < SETTLED_DELTA && std::fabs(targetDry - dry) < SETTLED_DELTA;
+    if (settled) {
+        feedback = targetFeedback;
+        damp = targetDamp;
+        wet = targetWet;
+        dry = targetDry;
     }
-    
-    std::vector<float> output(numSamples, 0.0f);
-    std::vector<float> tempBuffer(numSamples);
-    
-    // Sao chép đầu vào vào đầu ra với dry mix
+    Vec combFeedback = broadcast(feedback);
+    Vec damp1 = broadcast(damp);
+    Vec damp2 = broadcast(1.0f - damp);
+
     for (size_t i = 0; i < numSamples; ++i) {
-        output[i] = input[i] * dryMix;
+        if (!settled) {
+            feedback += (targetFeedback - feedback) * smoothing;
+            damp += (targetDamp - damp) * smoothing;
+            wet += (targetWet - wet) * smoothing;
+            dry += (targetDry - dry) * smoothing;
+            combFeedback = broadcast(feedback);
+            damp1 = broadcast(damp);
+            damp2 = broadcast(1.0f - damp);
+        }
+
+        const float dryInput = inout[i];
+        const Vec input = broadcast(dryInput * FIXED_GAIN + ANTI_DENORMAL);
+
+        // Comb bank: output = buffer, filter = output*(1-damp) + filter*damp,
+        // buffer = input + filter*feedback (ghi vào ô lane đó đọc lại sau delay của nó)
+        const float* combSlot = combs + (pos & combMask) * NUM_COMBS;
+        const Vec outLow = load(combSlot);
+        const Vec outHigh = load(combSlot + 4);
+        filterLow = add(mul(outLow, damp2), mul(filterLow, damp1));
+        filterHigh = add(mul(outHigh, damp2), mul(filterHigh, damp1));
+        store(written, add(input, mul(filterLow, combFeedback)));
+        store(written + 4, add(input, mul(filterHigh, combFeedback)));
+        for (int c = 0; c < NUM_COMBS; ++c) {
+            combs[((pos + combDelay[c]) & combMask) * NUM_COMBS + c] = written[c];
+        }
+        const float combSum = sum(add(outLow, outHigh));
+
+        // Allpass bank: lane j lấy output mẫu trước của lane j-1, lane 0 lấy tổng comb
+        const Vec allpassIn = shiftIn(allpassOut, combSum);
+        const Vec buffered = load(allpasses + (pos & allpassMask) * NUM_ALLPASSES);
+        allpassOut = sub(buffered, allpassIn);
+        store(written, add(allpassIn, mul(buffered, allpassFeedback)));
+        for (int a = 0; a < NUM_ALLPASSES; ++a) {
+            allpasses[((pos + allpassDelay[a]) & allpassMask) * NUM_ALLPASSES + a] = written[a];
+        }
+
+        inout[i] = dryInput * dry + lane3(allpassOut) * wet;
+        ++pos;
     }
-    
-    // Xử lý qua tất cả các delay line
-    for (auto& line : delayLines) {
-        // Xử lý delay line
-        std::fill(tempBuffer.begin(), tempBuffer.end(), 0.0f);
-        
-        // Tính delay line
-        for (size_t i = 0; i < numSamples; ++i) {
-            const size_t bufferSize = line.buffer.size();
-            size_t readIndex = line.writeIndex;
-            
-            // Lấy mẫu delay
-            float delayedSample = line.buffer[readIndex];
-            
-            // Áp dụng low-pass filter mạnh hơn để giảm rè
-            float dampCoeff = damping * 0.85f;
-            delayedSample = delayedSample * (1.0f - dampCoeff) + line.lastSample * dampCoeff;
-            line.lastSample = delayedSample;
-            
-            // Lưu kết quả vào buffer tạm
-            tempBuffer[i] = delayedSample * wetMix;
-            
-            // Áp dụng feedback với hệ số giảm để tránh tích lũy tiếng rè
-            float newSample = input[i] + (delayedSample * line.feedback * 0.9f);
-            
-            // Clipping để tránh quá tải - giảm threshold xuống
-            newSample = std::clamp(newSample, -0.95f, 0.95f);
-            
-            // Áp dụng gain
-            newSample *= line.gain;
-            
-            // Cập nhật buffer
-            line.buffer[line.writeIndex] = newSample;
-            
-            // Cập nhật write index
-            line.writeIndex = (line.writeIndex + 1) % bufferSize;
+
+    store(combFilter, filterLow);
+    store(combFilter + 4, filterHigh);
+    store(allpassOutput, allpassOut);
+    position = pos;
+}
+
+const char* ReverbProcessor::simdName() {
+    return SIMD_NAME;
+}
+
+namespace {
+
+// ReverbProcessor trước khi chuyển sang Freeverb (6 delay line có feedback, chia lấy dư, cố định
+// 48 kHz), chỉ giữ lại làm mốc cho benchmark
+class BaselineReverb {
+public:
+    BaselineReverb() {
+        const float delays[NUM_DELAY_LINES] = {0.0437f, 0.0581f, 0.0671f, 0.0829f, 0.0991f, 0.1139f};
+        const float gains[NUM_DELAY_LINES] = {0.60f, 0.55f, 0.50f, 0.45f, 0.40f, 0.35f};
+        for (int i = 0; i < NUM_DELAY_LINES; ++i) {
+            auto& line = delayLines[i];
+            line.buffer.assign(static_cast<size_t>(delays[i] * 48000), 0.0f);
+            line.feedback = 0.30f + 0.5f * roomSize;
+            line.gain = gains[i];
         }
-        
-        // Kết hợp buffer tạm với đầu ra
+    }
+
+    void process(float* inout, size_t numSamples) {
+        const float dampCoeff = damping * 0.85f;
         for (size_t i = 0; i < numSamples; ++i) {
-            output[i] += tempBuffer[i];
+            const float input = inout[i];
+            float output = input * dryMix;
+            for (auto& line : delayLines) {
+                const size_t bufferSize = line.buffer.size();
+                float delayedSample = line.buffer[line.writeIndex];
+                delayedSample = delayedSample * (1.0f - dampCoeff) + line.lastSample * dampCoeff;
+                line.lastSample = delayedSample;
+                output += delayedSample * wetMix;
+                float newSample = input + (delayedSample * line.feedback * 0.9f);
+                newSample = std::clamp(newSample, -0.95f, 0.95f);
+                line.buffer[line.writeIndex] = newSample * line.gain;
+                line.writeIndex = (line.writeIndex + 1) % bufferSize;
+            }
+            if (output > 0.8f) {
+                output = 0.8f + (output - 0.8f) * 0.5f;
+            } else if (output < -0.8f) {
+                output = -0.8f + (output + 0.8f) * 0.5f;
+            }
+            inout[i] = std::clamp(output, -1.0f, 1.0f);
         }
     }
-    
-    // Giới hạn đầu ra để tránh clipping và thêm một lớp lọc nhẹ cuối cùng
-    for (size_t i = 0; i < numSamples; ++i) {
-        // Soft clipping để tránh biến dạng
-        if (output[i] > 0.8f) {
-            output[i] = 0.8f + (output[i] - 0.8f) * 0.5f;
-        } else if (output[i] < -0.8f) {
-            output[i] = -0.8f + (output[i] + 0.8f) * 0.5f;
-        }
-        
-        // Giới hạn cuối cùng
-        output[i] = std::clamp(output[i], -1.0f, 1.0f);
+
+private:
+    static constexpr int NUM_DELAY_LINES = 6;
+
+    struct DelayLine {
+        std::vector<float> buffer;
+        size_t writeIndex = 0;
+        float feedback = 0.0f;
+        float gain = 0.0f;
+        float lastSample = 0.0f;
+    };
+
+    DelayLine delayLines[NUM_DELAY_LINES];
+    float roomSize = 0.5f;
+    float damping = 0.5f;
+    float wetMix = 0.33f;
+    float dryMix = 0.7f;
+};
+
+// Đo reverb.process() theo block frames mẫu, trả về ns trên mỗi mẫu
+template <typename Reverb>
+double measureNsPerFrame(Reverb& reverb, size_t frames, int iterations) {
+    if (frames == 0 || iterations < 1) {
+        return 0.0;
+    }
+
+    std::vector<float> source(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        source[i] = 0.5f * std::sin(0.01f * static_cast<float>(i));
+    }
+    std::vector<float> block(frames);
+    auto runOnce = [&]() {
+        std::copy(source.begin(), source.end(), block.begin());
+        reverb.process(block.data(), frames);
+    };
+
+    // Làm nóng cache trước khi đo
+    for (int i = 0; i < iterations / 10 + 1; ++i) {
+        runOnce();
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        runOnce();
     }
-    
-    return output;
-} 
\ No newline at end of file
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+
+    // Dùng kết quả để compiler không bỏ vòng lặp
+    volatile float sink = block[frames / 2];
+    (void)sink;
+    return static_cast<double>(elapsed.count()) / (static_cast<double>(iterations) * frames);
+}
+
+} // namespace
+
+double ReverbProcessor::benchmarkNsPerFrame(size_t frames, int iterations) {
+    ReverbProcessor reverb(48000);
+    return measureNsPerFrame(reverb, frames, iterations);
+}
+
+double ReverbProcessor::benchmarkBaselineNsPerFrame(size_t frames, int iterations) {
+    BaselineReverb reverb;
+    return measureNsPerFrame(reverb, frames, iterations);
+}
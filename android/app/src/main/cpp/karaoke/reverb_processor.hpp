@@ -1,49 +1,83 @@
 #pragma once
 
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
+/*
+    ReverbProcessor: reverb kiểu Freeverb (Jezar) cho giọng hát mono, xử lý tại chỗ.
+    - 8 comb song song (lọc thông thấp trong vòng feedback) rồi 4 allpass nối tiếp, độ dài delay
+      theo bảng của Freeverb quy đổi theo sample rate
+    - Delay line dài lũy thừa của 2, vị trí lấy bằng mask thay vì chia lấy dư
+    - Comb bank chạy trong hai vector 4 lane, allpass bank trong một vector 4 lane (NEON/SSE2,
+      không có thì vòng lặp vô hướng). Các lane xen kẽ trong cùng buffer và mỗi lane ghi trước vào
+      ô sẽ được đọc sau đúng delay của nó, nên cả bank đọc bằng một lần load liền nhau.
+    - Allpass nối tiếp được tính song song kiểu pipeline: lane j là allpass j, nhận output của
+      lane j-1 từ mẫu trước (đuôi reverb trễ thêm 3 mẫu)
+    - Tham số đặt từ thread bất kỳ, audio thread làm mượt (~20ms) tới giá trị mới
+    Cấp phát trong constructor, process() không cấp phát, không khóa.
+*/
 class ReverbProcessor {
 public:
-    ReverbProcessor();
+    explicit ReverbProcessor(int sampleRate = 48000);
     ~ReverbProcessor();
 
-    // Process audio data and return processed samples
-    std::vector<float> process(const float* input, size_t numSamples);
+    ReverbProcessor(const ReverbProcessor&) = delete;
+    ReverbProcessor& operator=(const ReverbProcessor&) = delete;
+
+    // Real-time: xử lý tại chỗ
+    void process(float* inout, size_t numSamples);
+    // Xóa đuôi reverb (cùng thread với process)
+    void reset();
 
     // Set reverb parameters
     void setRoomSize(float size);    // 0.0 to 1.0
     void setDamping(float damping);  // 0.0 to 1.0
     void setWetMix(float wet);       // 0.0 to 1.0
     void setDryMix(float dry);       // 0.0 to 1.0
-    void setEnabled(bool enable);    // Enable/disable reverb
+    void setEnabled(bool enable);    // Enable/disable reverb, bật lại thì xóa đuôi cũ
+
+    int getSampleRate() const { return sampleRate; }
+
+    // Bộ lệnh SIMD đang dùng: "neon", "sse2" hoặc "scalar"
+    static const char* simdName();
+    // Đo process() theo block frames mẫu, trả về ns trên mỗi mẫu. Chạy trên thread gọi, có cấp phát.
+    static double benchmarkNsPerFrame(size_t frames = 64, int iterations = 20000);
+    // Cùng phép đo với bản cài đặt cũ (6 delay line, trước Freeverb) làm mốc so sánh
+    static double benchmarkBaselineNsPerFrame(size_t frames = 64, int iterations = 20000);
 
 private:
-    static constexpr int NUM_DELAY_LINES = 6;
-    
-    struct DelayLine {
-        std::vector<float> buffer;
-        size_t writeIndex;
-        float feedback;
-        float gain;
-        float lastSample;  // For smoothing between samples
-    };
-    
-    std::vector<DelayLine> delayLines;
-    std::vector<float> filterBuffer;  // Buffer for low-pass filter
-    
-    float roomSize;
-    float damping;
-    float wetMix;
-    float dryMix;
-    bool enabled;
-    
-    // Low-pass filter implementation
-    float lowPassFilter(float input, float coeff, int channel);
-    
-    // Process a single delay line
-    void processDelayLine(DelayLine& line, const float* input, float* output, size_t numSamples);
-    
-    // Initialize delay lines
-    void initializeDelayLines();
-}; 
\ No newline at end of file
+    static constexpr int NUM_COMBS = 8;
+    static constexpr int NUM_ALLPASSES = 4;
+
+    const int sampleRate;
+
+    // Comb: combSize ô * NUM_COMBS lane, allpass: allpassSize ô * NUM_ALLPASSES lane
+    std::unique_ptr<float[]> combBuffer;
+    std::unique_ptr<float[]> allpassBuffer;
+    uint32_t combMask = 0;
+    uint32_t allpassMask = 0;
+    uint32_t combDelay[NUM_COMBS];
+    uint32_t allpassDelay[NUM_ALLPASSES];
+    uint32_t position = 0;
+
+    // Trạng thái lọc của từng comb và output mẫu trước của từng allpass
+    alignas(16) float combFilter[NUM_COMBS];
+    alignas(16) float allpassOutput[NUM_ALLPASSES];
+
+    // Giá trị đích, đặt từ thread bất kỳ
+    std::atomic<float> roomSize;
+    std::atomic<float> damping;
+    std::atomic<float> wetMix;
+    std::atomic<float> dryMix;
+    std::atomic<bool> enabled;
+    std::atomic<bool> resetPending{false}; // setEnabled(true): process() xóa đuôi ở block kế tiếp
+
+    // Giá trị đang dùng (đã làm mượt), chỉ audio thread
+    float feedback;
+    float damp;
+    float wet;
+    float dry;
+    float smoothing;
+};
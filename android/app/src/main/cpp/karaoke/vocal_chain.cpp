@@ -0,0 +1,270 @@
+#include "vocal_chain.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+constexpr float GATE_FLOOR_DB = -40.0f;
+constexpr float GATE_ATTACK_MILLIS = 1.0f;
+constexpr float GATE_RELEASE_MILLIS = 100.0f;
+constexpr float GATE_HOLD_MILLIS = 50.0f;
+constexpr float COMP_ATTACK_MILLIS = 5.0f;
+constexpr float COMP_RELEASE_MILLIS = 120.0f;
+constexpr float PRESENCE_FREQUENCY = 3000.0f;
+constexpr float AIR_FREQUENCY = 10000.0f;
+
+float dbToGain(float db) {
+    return powf(10.0f, db / 20.0f);
+}
+
+// Hệ số làm mượt một cực: sau millis ms thì đi được ~63% quãng đường tới target
+float smoothingCoefficient(float millis, int32_t sampleRate) {
+    return 1.0f - expf(-1000.0f / (millis * sampleRate));
+}
+
+} // namespace
+
+void VocalChain::Biquad::setHighPass(float frequency, float q, float sampleRate) {
+    const float w0 = 2.0f * PI * frequency / sampleRate;
+    const float alpha = sinf(w0) / (2.0f * q);
+    const float cosw0 = cosf(w0);
+    const float a0 = 1.0f + alpha;
+    b0 = (1.0f + cosw0) / 2.0f / a0;
+    b1 = -(1.0f + cosw0) / a0;
+    b2 = b0;
+    a1 = -2.0f * cosw0 / a0;
+    a2 = (1.0f - alpha) / a0;
+}
+
+void VocalChain::Biquad::setPeak(float frequency, float q, float gainDb, float sampleRate) {
+    const float a = powf(10.0f, gainDb / 40.0f);
+    const float w0 = 2.0f * PI * frequency / sampleRate;
+    const float alpha = sinf(w0) / (2.0f * q);
+    const float cosw0 = cosf(w0);
+    const float a0 = 1.0f + alpha / a;
+    b0 = (1.0f + alpha * a) / a0;
+    b1 = -2.0f * cosw0 / a0;
+    b2 = (1.0f - alpha * a) / a0;
+    a1 = b1;
+    a2 = (1.0f - alpha / a) / a0;
+}
+
+void VocalChain::Biquad::setHighShelf(float frequency, float gainDb, float sampleRate) {
+    // Độ dốc shelf S = 1
+    const float a = powf(10.0f, gainDb / 40.0f);
+    const float w0 = 2.0f * PI * frequency / sampleRate;
+    const float cosw0 = cosf(w0);
+    const float alpha = sinf(w0) / 2.0f * sqrtf(2.0f);
+    const float twoSqrtAAlpha = 2.0f * sqrtf(a) * alpha;
+    const float a0 = (a + 1.0f) - (a - 1.0f) * cosw0 + twoSqrtAAlpha;
+    b0 = a * ((a + 1.0f) + (a - 1.0f) * cosw0 + twoSqrtAAlpha) / a0;
+    b1 = -2.0f * a * ((a - 1.0f) + (a + 1.0f) * cosw0) / a0;
+    b2 = a * ((a + 1.0f) + (a - 1.0f) * cosw0 - twoSqrtAAlpha) / a0;
+    a1 = 2.0f * ((a - 1.0f) - (a + 1.0f) * cosw0) / a0;
+    a2 = ((a + 1.0f) - (a - 1.0f) * cosw0 - twoSqrtAAlpha) / a0;
+}
+
+void VocalChain::Biquad::process(float* samples, int32_t numFrames) {
+    float s1 = z1;
+    float s2 = z2;
+    for (int32_t i = 0; i < numFrames; i++) {
+        const float x = samples[i];
+        const float y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        samples[i] = y;
+    }
+    z1 = s1;
+    z2 = s2;
+}
+
+VocalChain::VocalChain() = default;
+
+VocalChain::~VocalChain() = default;
+
+void VocalChain::prepare(int32_t rate) {
+    sampleRate = max(rate, 1);
+    pitch = make_unique<PitchProcessor>(sampleRate);
+    reverb = make_unique<ReverbProcessor>(sampleRate);
+    // Block đầu tiên tính hệ số và xóa trạng thái mọi hiệu ứng đang bật
+    appliedVersion = 0;
+    activeMask = 0;
+    resetPending.store(false, memory_order_relaxed);
+}
+
+void VocalChain::setBypass(Effect effect, bool bypass) {
+    if (bypass) {
+        bypassMask.fetch_or(bit(effect), memory_order_release);
+    } else {
+        bypassMask.fetch_and(~bit(effect), memory_order_release);
+    }
+}
+
+bool VocalChain::isBypassed(Effect effect) const {
+    return (bypassMask.load(memory_order_acquire) & bit(effect)) != 0;
+}
+
+int32_t VocalChain::getLatencyFrames() const {
+    if (!pitch || isBypassed(Effect::Pitch)) {
+        return 0;
+    }
+    return static_cast<int32_t>(pitch->getLatency());
+}
+
+void VocalChain::setParam(atomic<float>& param, float value) {
+    param.store(value, memory_order_relaxed);
+    paramVersion.fetch_add(1, memory_order_release);
+}
+
+void VocalChain::applyParams() {
+    const float nyquistLimit = sampleRate * 0.45f;
+
+    gateThreshold = dbToGain(gateThresholdDb.load(memory_order_relaxed));
+    gateFloor = dbToGain(GATE_FLOOR_DB);
+    gateAttack = smoothingCoefficient(GATE_ATTACK_MILLIS, sampleRate);
+    gateRelease = smoothingCoefficient(GATE_RELEASE_MILLIS, sampleRate);
+    gateHoldFrames = static_cast<int32_t>(GATE_HOLD_MILLIS * sampleRate / 1000.0f);
+
+    equalizer[0].setHighPass(clamp(lowCutHz.load(memory_order_relaxed), 20.0f, 1000.0f), 0.707f, sampleRate);
+    equalizer[1].setPeak(min(PRESENCE_FREQUENCY, nyquistLimit), 1.0f,
+                         clamp(presenceDb.load(memory_order_relaxed), -12.0f, 12.0f), sampleRate);
+    equalizer[2].setHighShelf(min(AIR_FREQUENCY, nyquistLimit),
+                              clamp(airDb.load(memory_order_relaxed), -12.0f, 12.0f), sampleRate);
+
+    compThreshold = compThresholdDb.load(memory_order_relaxed);
+    compSlope = 1.0f / max(compRatio.load(memory_order_relaxed), 1.0f) - 1.0f;
+    compMakeup = dbToGain(clamp(makeupDb.load(memory_order_relaxed), 0.0f, 24.0f));
+    compAttack = smoothingCoefficient(COMP_ATTACK_MILLIS, sampleRate);
+    compRelease = smoothingCoefficient(COMP_RELEASE_MILLIS, sampleRate);
+
+    pitch->setPitchShift(clamp(pitchSemitones.load(memory_order_relaxed), -12.0f, 12.0f));
+
+    reverb->setRoomSize(reverbRoomSize.load(memory_order_relaxed));
+    reverb->setDamping(reverbDamping.load(memory_order_relaxed));
+    reverb->setWetMix(reverbWet.load(memory_order_relaxed));
+    reverb->setDryMix(reverbDry.load(memory_order_relaxed));
+}
+
+void VocalChain::applyBypass() {
+    const uint32_t all = (1u << static_cast<int32_t>(Effect::Count)) - 1;
+    const uint32_t active = ~bypassMask.load(memory_order_acquire) & all;
+    // Hiệu ứng vừa được bật lại bắt đầu từ trạng thái sạch, không phát lại đuôi cũ
+    resetEffects(active & ~activeMask);
+    activeMask = active;
+}
+
+void VocalChain::resetEffects(uint32_t effects) {
+    if (effects & bit(Effect::Gate)) {
+        gateEnvelope = 0.0f;
+        gateGain = 1.0f;
+        gateHoldRemaining = 0;
+    }
+    if (effects & bit(Effect::Equalizer)) {
+        for (auto& filter : equalizer) {
+            filter.reset();
+        }
+    }
+    if (effects & bit(Effect::Compressor)) {
+        compEnvelope = 0.0f;
+    }
+    if (effects & bit(Effect::Pitch)) {
+        pitch->reset();
+    }
+    if (effects & bit(Effect::Reverb)) {
+        reverb->reset();
+    }
+}
+
+void VocalChain::process(float* inout, int32_t numFrames) {
+    if (!pitch) {
+        // Chưa prepare(): để nguyên tín hiệu
+        return;
+    }
+
+    const uint32_t version = paramVersion.load(memory_order_acquire);
+    if (version != appliedVersion) {
+        appliedVersion = version;
+        applyParams();
+    }
+    applyBypass();
+    if (resetPending.exchange(false, memory_order_acq_rel)) {
+        resetEffects(activeMask);
+    }
+
+    int32_t done = 0;
+    while (done < numFrames) {
+        float* block = inout + done;
+        const int32_t count = min(numFrames - done, MAX_BLOCK_FRAMES);
+        if (activeMask & bit(Effect::Gate)) {
+            processGate(block, count);
+        }
+        if (activeMask & bit(Effect::Equalizer)) {
+            for (auto& filter : equalizer) {
+                filter.process(block, count);
+            }
+        }
+        if (activeMask & bit(Effect::Compressor)) {
+            processCompressor(block, count);
+        }
+        if (activeMask & bit(Effect::Pitch)) {
+            pitch->process(block, static_cast<size_t>(count));
+        }
+        if (activeMask & bit(Effect::Reverb)) {
+            reverb->process(block, static_cast<size_t>(count));
+        }
+        done += count;
+    }
+}
+
+void VocalChain::processGate(float* samples, int32_t numFrames) {
+    // Envelope đỉnh nhả trong ~10ms, gain mở nhanh (attack) và đóng chậm (release) sau thời gian hold
+    const float envelopeRelease = 1.0f - smoothingCoefficient(10.0f, sampleRate);
+    float envelope = gateEnvelope;
+    float gain = gateGain;
+    for (int32_t i = 0; i < numFrames; i++) {
+        const float level = fabsf(samples[i]);
+        envelope = level > envelope ? level : envelope * envelopeRelease;
+
+        float target = gateFloor;
+        if (envelope >= gateThreshold) {
+            gateHoldRemaining = gateHoldFrames;
+            target = 1.0f;
+        } else if (gateHoldRemaining > 0) {
+            gateHoldRemaining--;
+            target = 1.0f;
+        }
+        gain += (target - gain) * (target > gain ? gateAttack : gateRelease);
+        samples[i] *= gain;
+    }
+    gateEnvelope = envelope;
+    gateGain = gain;
+}
+
+void VocalChain::processCompressor(float* samples, int32_t numFrames) {
+    float envelope = compEnvelope;
+    for (int32_t i = 0; i < numFrames; i++) {
+        const float level = fabsf(samples[i]);
+        envelope += (level - envelope) * (level > envelope ? compAttack : compRelease);
+
+        float gain = compMakeup;
+        const float overDb = 20.0f * log10f(max(envelope, 1e-6f)) - compThreshold;
+        if (overDb > 0.0f) {
+            gain *= dbToGain(overDb * compSlope);
+        }
+        samples[i] *= gain;
+    }
+    compEnvelope = envelope;
+}
+
+int32_t VocalChainNode::onProcess(int32_t numFrames) {
+    float* out = output.getBuffer();
+    memcpy(out, input.getBuffer(), numFrames * sizeof(float));
+    chain->process(out, numFrames);
+    // Đuôi reverb còn kêu sau khi mic im lặng: luôn coi cả block là dữ liệu thực
+    return numFrames;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "audio_player/audioplayer/processing_graph.hpp"
+#include "pitch_processor.hpp"
+#include "reverb_processor.hpp"
+
+/*
+    VocalChain: chuỗi hiệu ứng cho giọng hát (mono), xử lý tại chỗ trên block mic:
+    gate -> EQ -> compressor -> pitch -> reverb
+
+    - prepare() cấp phát mọi thứ (pitch shifter, delay line) trên thread app khi chain chưa chạy.
+      process() không cấp phát, không khóa.
+    - Tham số và bypass là atomic, đặt được từ thread bất kỳ. Audio thread thấy phiên bản tham số
+      đổi thì tính lại hệ số ở đầu block kế tiếp.
+    - Bật lại một hiệu ứng thì trạng thái cũ của nó (bộ lọc, envelope, delay line) được xóa.
+    - Chỉ một audio thread gọi process() tại một thời điểm.
+*/
+class VocalChain {
+public:
+    enum class Effect : int32_t {
+        Gate,
+        Equalizer,
+        Compressor,
+        Pitch,
+        Reverb,
+        Count
+    };
+
+    // Block dài hơn được chia nhỏ
+    static constexpr int32_t MAX_BLOCK_FRAMES = 256;
+
+    VocalChain();
+    ~VocalChain();
+
+    VocalChain(const VocalChain&) = delete;
+    VocalChain& operator=(const VocalChain&) = delete;
+
+    // Thread app, không có audio thread nào đang gọi process()
+    void prepare(int32_t sampleRate);
+    int32_t getSampleRate() const { return sampleRate; }
+
+    // Audio thread
+    void process(float* inout, int32_t numFrames);
+    // Mọi thread: xóa trạng thái của mọi hiệu ứng ở block kế tiếp
+    void requestReset() { resetPending.store(true, std::memory_order_release); }
+
+    void setBypass(Effect effect, bool bypass);
+    bool isBypassed(Effect effect) const;
+
+    // Gate: dưới ngưỡng thì giảm xuống mức sàn (dB âm)
+    void setGateThreshold(float thresholdDb) { setParam(gateThresholdDb, thresholdDb); }
+    // EQ: lọc cắt trầm (Hz), presence quanh 3kHz và air (shelf từ 10kHz), đơn vị dB
+    void setLowCut(float frequency) { setParam(lowCutHz, frequency); }
+    void setPresence(float gainDb) { setParam(presenceDb, gainDb); }
+    void setAir(float gainDb) { setParam(airDb, gainDb); }
+    // Compressor
+    void setCompressorThreshold(float thresholdDb) { setParam(compThresholdDb, thresholdDb); }
+    void setCompressorRatio(float ratio) { setParam(compRatio, ratio); }
+    void setMakeupGain(float gainDb) { setParam(makeupDb, gainDb); }
+    // Pitch (semitone, -12..12)
+    void setPitchShift(float semitones) { setParam(pitchSemitones, semitones); }
+    // Reverb (0..1)
+    void setReverbRoomSize(float size) { setParam(reverbRoomSize, size); }
+    void setReverbDamping(float damping) { setParam(reverbDamping, damping); }
+    void setReverbWetMix(float wet) { setParam(reverbWet, wet); }
+    void setReverbDryMix(float dry) { setParam(reverbDry, dry); }
+
+    // Trễ do chain thêm vào (pitch), tính theo frame
+    int32_t getLatencyFrames() const;
+
+private:
+    // Biquad dạng transposed direct form II, hệ số theo RBJ Audio EQ Cookbook
+    struct Biquad {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+        float z1 = 0.0f, z2 = 0.0f;
+
+        void setHighPass(float frequency, float q, float sampleRate);
+        void setPeak(float frequency, float q, float gainDb, float sampleRate);
+        void setHighShelf(float frequency, float gainDb, float sampleRate);
+        void process(float* samples, int32_t numFrames);
+        void reset() { z1 = z2 = 0.0f; }
+    };
+
+    static uint32_t bit(Effect effect) { return 1u << static_cast<int32_t>(effect); }
+    void setParam(std::atomic<float>& param, float value);
+    void applyParams();
+    void applyBypass();
+    void resetEffects(uint32_t effects);
+
+    void processGate(float* samples, int32_t numFrames);
+    void processCompressor(float* samples, int32_t numFrames);
+
+    int32_t sampleRate = 0;
+    std::unique_ptr<PitchProcessor> pitch;
+    std::unique_ptr<ReverbProcessor> reverb;
+
+    // Tham số, đặt từ thread bất kỳ
+    std::atomic<float> gateThresholdDb{-50.0f};
+    std::atomic<float> lowCutHz{100.0f};
+    std::atomic<float> presenceDb{2.0f};
+    std::atomic<float> airDb{1.5f};
+    std::atomic<float> compThresholdDb{-18.0f};
+    std::atomic<float> compRatio{3.0f};
+    std::atomic<float> makeupDb{3.0f};
+    std::atomic<float> pitchSemitones{0.0f};
+    std::atomic<float> reverbRoomSize{0.5f};
+    std::atomic<float> reverbDamping{0.5f};
+    std::atomic<float> reverbWet{0.25f};
+    std::atomic<float> reverbDry{0.75f};
+    std::atomic<uint32_t> paramVersion{1};
+    // Pitch thêm trễ nên mặc định bỏ qua
+    std::atomic<uint32_t> bypassMask{1u << static_cast<int32_t>(Effect::Pitch)};
+    std::atomic<bool> resetPending{false};
+
+    // Chỉ audio thread (và prepare())
+    uint32_t appliedVersion = 0;
+    uint32_t activeMask = 0;
+    std::array<Biquad, 3> equalizer;
+    float gateThreshold = 0.0f;
+    float gateFloor = 0.0f;
+    float gateEnvelope = 0.0f;
+    float gateGain = 1.0f;
+    int32_t gateHoldFrames = 0;
+    int32_t gateHoldRemaining = 0;
+    float gateAttack = 0.0f;
+    float gateRelease = 0.0f;
+    float compThreshold = 0.0f;
+    float compSlope = 0.0f;
+    float compMakeup = 1.0f;
+    float compEnvelope = 0.0f;
+    float compAttack = 0.0f;
+    float compRelease = 0.0f;
+};
+
+// Vocal chain trong graph của bus mic: chép input ra output rồi xử lý tại chỗ
+class VocalChainNode : public GraphFilter {
+public:
+    VocalChainNode(std::shared_ptr<VocalChain> chain, int32_t maxFrames)
+        : GraphFilter(1, 1, maxFrames), chain(std::move(chain)) {}
+
+    int32_t onProcess(int32_t numFrames) override;
+    void reset() override { chain->requestReset(); }
+    const char* getName() const override { return "VocalChain"; }
+
+private:
+    std::shared_ptr<VocalChain> chain;
+};
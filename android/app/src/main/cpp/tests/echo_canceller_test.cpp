@@ -0,0 +1,193 @@
+#include "audio_player/audioplayer/echo_canceller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+/*
+    Kiểm tra offline AdaptiveEchoCanceller, không cần thiết bị: nhạc giả qua đường echo giả (trễ
+    echoDelayMillis + đáp ứng xung suy giảm) cộng giọng giả hát chồng ở giữa, rồi đường echo đổi trễ
+    ở cuối. Thất bại (exit code 1) khi echo khử được dưới ngưỡng lúc chỉ có nhạc, lúc hát chồng hoặc
+    sau khi đường echo đổi, khi giọng bị khử theo (near-end SNR thấp), hoặc khi độ trễ chốt được
+    lệch xa độ trễ thật.
+*/
+
+namespace {
+
+constexpr int BLOCK_FRAMES = AdaptiveEchoCanceller::BLOCK_FRAMES;
+
+// Ngưỡng ERLE (dB) tối thiểu, bản hiện tại đạt ~45-50 dB (hát chồng ~14-22 dB)
+constexpr double MIN_ERLE_DB = 30.0;
+constexpr double MIN_PATH_CHANGE_ERLE_DB = 30.0;
+constexpr double MIN_DOUBLE_TALK_ERLE_DB = 10.0;
+// Giọng trong output so với phần còn lại lúc hát chồng, bản hiện tại đạt ~20-28 dB
+constexpr double MIN_NEAR_END_SNR_DB = 15.0;
+// Độ trễ ước lượng là trọng tâm năng lượng của echo nên muộn hơn độ trễ thật một chút
+constexpr int MAX_DELAY_ERROR_FRAMES = 4 * BLOCK_FRAMES;
+
+struct Report {
+    int32_t trueDelayFrames = 0;
+    int32_t estimatedDelayFrames = -1; // -1 nếu chưa tìm được
+    double erleDb = 0.0;               // Chỉ có nhạc, sau khi hội tụ
+    double doubleTalkErleDb = 0.0;     // Echo khử được trong lúc hát chồng
+    double nearEndSnrDb = 0.0;         // Giọng trong output so với phần còn lại, lúc hát chồng
+    double pathChangeErleDb = 0.0;     // Sau khi độ trễ của đường echo đổi giữa chừng
+    double nsPerFrame = 0.0;           // pushReference() + process() cho mỗi mẫu
+};
+
+Report runSynthetic(int rate, int echoDelayMillis) {
+    const size_t second = static_cast<size_t>(rate);
+    const size_t total = 16 * second;
+    // Giai đoạn: 0-6s chỉ nhạc, 6-10s hát chồng, 12s đường echo trễ thêm 30ms
+    const size_t voiceBegin = 6 * second;
+    const size_t voiceEnd = 10 * second;
+    const size_t pathChange = 12 * second;
+
+    uint32_t seed = 12345;
+    auto noise = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(static_cast<int32_t>(seed)) / 2147483648.0f;
+    };
+
+    // Nhạc giả: nhiễu màu đổi mức mỗi ~100ms (nhịp) cộng hợp âm đổi mỗi 1s
+    vector<float> music(total);
+    const float PI = 3.14159265358979f;
+    const float chords[4][3] = { { 261.6f, 329.6f, 392.0f }, { 220.0f, 261.6f, 329.6f },
+                                 { 174.6f, 220.0f, 261.6f }, { 196.0f, 246.9f, 293.7f } };
+    float colored = 0.0f;
+    float beat = 0.0f;
+    for (size_t n = 0; n < total; n++) {
+        if (n % (second / 10) == 0) {
+            beat = 0.3f + 0.7f * fabsf(noise());
+        }
+        colored = 0.7f * colored + 0.3f * noise();
+        const float* chord = chords[(n / second) % 4];
+        float tones = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            tones += sinf(2.0f * PI * chord[i] * n / rate);
+        }
+        music[n] = 0.25f * beat * colored + 0.01f * tones;
+    }
+
+    // Đường echo: đáp ứng xung suy giảm 30ms, tổng gain ~0.5
+    const size_t tail = static_cast<size_t>(0.03 * rate);
+    vector<float> response(tail);
+    float responseEnergy = 0.0f;
+    for (size_t i = 0; i < tail; i++) {
+        response[i] = noise() * expf(-5.0f * i / tail);
+        responseEnergy += response[i] * response[i];
+    }
+    for (auto& tap : response) {
+        tap *= 0.5f / sqrtf(responseEnergy);
+    }
+
+    // Giọng giả: hài của 220 Hz có vibrato, mở theo từng âm tiết
+    vector<float> voice(total, 0.0f);
+    float phase = 0.0f;
+    for (size_t n = voiceBegin; n < voiceEnd; n++) {
+        const float t = static_cast<float>(n) / rate;
+        phase += 2.0f * PI * 220.0f * (1.0f + 0.01f * sinf(2.0f * PI * 5.0f * t)) / rate;
+        const float syllable = 0.5f + 0.5f * sinf(2.0f * PI * 2.0f * t);
+        voice[n] = 0.1f * syllable * (sinf(phase) + 0.5f * sinf(2.0f * phase) + 0.25f * sinf(3.0f * phase));
+    }
+
+    const size_t delay = static_cast<size_t>(max(echoDelayMillis, 0)) * rate / 1000;
+    const size_t changedDelay = delay + static_cast<size_t>(0.03 * rate);
+    vector<float> echo(total, 0.0f);
+    vector<float> mic(total);
+    for (size_t n = 0; n < total; n++) {
+        const size_t lag = n < pathChange ? delay : changedDelay;
+        float sum = 0.0f;
+        for (size_t i = 0; i < tail && i + lag <= n; i++) {
+            sum += response[i] * music[n - lag - i];
+        }
+        echo[n] = sum;
+        mic[n] = echo[n] + voice[n] + 1e-4f * noise();
+    }
+
+    // Chạy như callback phát: khử echo cho mic rồi đẩy nhạc của cùng đoạn (block lẻ để thử FIFO)
+    AdaptiveEchoCanceller canceller(rate);
+    Report report;
+    report.trueDelayFrames = static_cast<int32_t>(delay);
+    vector<float> output(mic);
+    const size_t callbackFrames = 240;
+    const auto begin = chrono::steady_clock::now();
+    for (size_t offset = 0; offset < total; offset += callbackFrames) {
+        const size_t count = min(callbackFrames, total - offset);
+        canceller.process(output.data() + offset, count);
+        canceller.pushReference(music.data() + offset, count);
+        if (offset < voiceBegin && offset + count >= voiceBegin) {
+            const AdaptiveEchoCanceller::Stats stats = canceller.getStats();
+            report.estimatedDelayFrames = stats.delayLocked ? stats.delayFrames : -1;
+        }
+    }
+    const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+    report.nsPerFrame = static_cast<double>(elapsed.count()) / total;
+
+    // Output trễ BLOCK_FRAMES mẫu so với mic. Phần còn lại = output - giọng (echo sót + nhiễu)
+    auto measure = [&](size_t from, size_t to, double& echoEnergy, double& voiceEnergy, double& residual) {
+        echoEnergy = voiceEnergy = residual = 0.0;
+        for (size_t n = from; n < to; n++) {
+            const double left = output[n + BLOCK_FRAMES] - voice[n];
+            echoEnergy += static_cast<double>(echo[n]) * echo[n];
+            voiceEnergy += static_cast<double>(voice[n]) * voice[n];
+            residual += left * left;
+        }
+        residual = max(residual, 1e-20);
+    };
+    double echoEnergy, voiceEnergy, residual;
+    measure(4 * second, voiceBegin, echoEnergy, voiceEnergy, residual);
+    report.erleDb = 10.0 * log10(echoEnergy / residual);
+    measure(voiceBegin + second, voiceEnd, echoEnergy, voiceEnergy, residual);
+    report.doubleTalkErleDb = 10.0 * log10(echoEnergy / residual);
+    report.nearEndSnrDb = 10.0 * log10(voiceEnergy / residual);
+    measure(14 * second, total - BLOCK_FRAMES, echoEnergy, voiceEnergy, residual);
+    report.pathChangeErleDb = 10.0 * log10(echoEnergy / residual);
+    return report;
+}
+
+} // namespace
+
+int main() {
+    const int cases[][2] = { { 48000, 120 }, { 48000, 40 }, { 44100, 250 } };
+    int failures = 0;
+    for (const auto& c : cases) {
+        const Report report = runSynthetic(c[0], c[1]);
+        printf("%d Hz, echo %d ms: delay %d frames (true %d), ERLE %.1f dB, double-talk %.1f dB "
+               "(near-end SNR %.1f dB), after path change %.1f dB, %.1f ns/frame\n",
+               c[0], c[1], report.estimatedDelayFrames, report.trueDelayFrames, report.erleDb,
+               report.doubleTalkErleDb, report.nearEndSnrDb, report.pathChangeErleDb, report.nsPerFrame);
+        if (report.estimatedDelayFrames < 0) {
+            printf("  FAIL: delay not locked\n");
+            failures++;
+        } else if (abs(report.estimatedDelayFrames - report.trueDelayFrames) > MAX_DELAY_ERROR_FRAMES) {
+            printf("  FAIL: delay %d frames is more than %d frames from %d\n", report.estimatedDelayFrames,
+                   MAX_DELAY_ERROR_FRAMES, report.trueDelayFrames);
+            failures++;
+        }
+        if (report.erleDb < MIN_ERLE_DB) {
+            printf("  FAIL: ERLE %.1f dB < %.1f dB\n", report.erleDb, MIN_ERLE_DB);
+            failures++;
+        }
+        if (report.doubleTalkErleDb < MIN_DOUBLE_TALK_ERLE_DB) {
+            printf("  FAIL: ERLE during double-talk %.1f dB < %.1f dB\n", report.doubleTalkErleDb,
+                   MIN_DOUBLE_TALK_ERLE_DB);
+            failures++;
+        }
+        if (report.nearEndSnrDb < MIN_NEAR_END_SNR_DB) {
+            printf("  FAIL: near-end SNR during double-talk %.1f dB < %.1f dB\n", report.nearEndSnrDb,
+                   MIN_NEAR_END_SNR_DB);
+            failures++;
+        }
+        if (report.pathChangeErleDb < MIN_PATH_CHANGE_ERLE_DB) {
+            printf("  FAIL: ERLE after path change %.1f dB < %.1f dB\n", report.pathChangeErleDb,
+                   MIN_PATH_CHANGE_ERLE_DB);
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}